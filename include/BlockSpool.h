@@ -0,0 +1,99 @@
+#ifndef BLOCK_SPOOL_H
+#define BLOCK_SPOOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FlashStorage.h"
+
+// 闪存暂存区（store-and-forward）：上游断开或积压时把已封装的块追加到闪存环形日志，恢复后按写入顺序读出上传。
+// 记录先写入RAM缓冲区，缓冲区满时整段按页对齐顺序写入闪存；写入位置之前的扇区由service()逐个预先擦除，
+// 避免写入时集中擦除。读出时尚未写入闪存的记录直接从RAM缓冲区读取。
+// 位置信息只保存在RAM中，重启后暂存区为空（旧数据由epoch区分，不会被误读）。
+// 不依赖Arduino，只由一个任务调用（非线程安全），可在主机上配合FileStorage测试
+class BlockSpool {
+public:
+    struct Stats {
+        uint32_t capacityBytes;
+        uint32_t usedBytes;          // 已写入未读出的字节数（含RAM缓冲区和区域末尾的跳过部分）
+        uint32_t pendingRecords;     // 待读出的记录数
+        uint32_t recordsWritten;
+        uint32_t recordsRead;
+        uint32_t recordsRejected;    // 暂存区满或记录过长而未写入的记录数
+        uint32_t corruptRecords;     // 校验失败或无法读出而丢失的记录数
+        uint32_t bytesFlushed;       // 写入闪存的累计字节数（含页对齐填充）
+        uint32_t flushes;
+        uint32_t sectorsErased;
+        uint32_t inlineErases;       // 写入时才擦除的扇区数（预擦除未跟上）
+        uint32_t writeErrors;
+        uint32_t readErrors;
+    };
+
+    BlockSpool();
+
+    // writeBuffer由调用者分配，大小须为页大小的整数倍且不超过区域大小；
+    // epoch每次启动不同，用于区分上次运行残留在闪存中的记录
+    bool begin(FlashStorage* storage, uint8_t* writeBuffer, size_t bufferSize, uint32_t epoch);
+    bool isReady() const { return storage != nullptr; }
+
+    // 追加一条记录，暂存区满时返回false（保留已暂存的旧数据，不覆盖）
+    bool append(const void* data, size_t length);
+
+    // 按写入顺序读出下一条记录，返回长度；无记录时返回0。长度超过maxLength的记录被丢弃
+    size_t readNext(void* data, size_t maxLength);
+
+    bool hasPending() const { return pendingRecords > 0; }
+    uint32_t getPendingRecords() const { return pendingRecords; }
+
+    // 把RAM缓冲区中的记录写入闪存（按页填充）
+    bool flush();
+
+    // 预擦除写入位置之后的一个扇区，返回是否执行了擦除。写入方在空闲时调用
+    bool service();
+
+    // 丢弃所有待读出的记录
+    void clear();
+
+    // 单条记录的最大长度
+    size_t getMaxRecordLength() const;
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    struct RecordHeader {
+        uint16_t magic;
+        uint16_t length;     // 载荷长度
+        uint32_t seq;        // 记录序号（本次启动内递增）
+        uint32_t epoch;
+        uint32_t crc;        // 载荷CRC32
+    };
+    static const uint16_t RECORD_MAGIC = 0x5053;   // "SP"
+
+    FlashStorage* storage;
+    size_t capacity;
+    uint8_t* buffer;
+    size_t bufferSize;
+    uint32_t epoch;
+
+    // 逻辑位置单调递增，物理偏移为位置对capacity取模
+    uint64_t bufferStart;    // RAM缓冲区对应的位置（页对齐）
+    size_t bufferFill;
+    uint64_t readPos;
+    uint64_t erasedEnd;      // 此位置之前（到写入位置为止）的扇区已擦除
+    uint32_t writeSeq;
+    uint32_t readSeq;
+    uint32_t pendingRecords;
+
+    Stats stats;
+
+    uint64_t writeEnd() const { return bufferStart + bufferFill; }
+    size_t physical(uint64_t pos) const { return pos % capacity; }
+    uint64_t sectorFloor(uint64_t pos) const { return pos - pos % FlashStorage::SECTOR_SIZE; }
+    static size_t recordSize(size_t length);
+    static uint64_t roundUp(uint64_t value, uint64_t unit);
+
+    bool readBytes(uint64_t pos, void* data, size_t length);
+    bool eraseAt(uint64_t pos);
+};
+
+#endif // BLOCK_SPOOL_H
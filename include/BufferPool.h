@@ -48,8 +48,8 @@ private:
     // 预分配数据块
     void preallocateBlocks();
     
-    // 创建新数据块
-    DataBlock* createBlock();
+    // 创建新数据块；池外临时块（省电模式暂存时会大量出现）优先放在PSRAM
+    DataBlock* createBlock(bool preferPsram = false);
 };
 
 #endif // BUFFER_POOL_H
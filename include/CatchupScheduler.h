@@ -0,0 +1,83 @@
+#ifndef CATCHUP_SCHEDULER_H
+#define CATCHUP_SCHEDULER_H
+
+#include <stdint.h>
+
+// 补传调度器：闪存暂存区有积压时，编码任务在实时流（SensorData中最新的块）和补传流
+// （暂存区中最旧的块）之间按字节份额交替取块。只有一路有块时不限份额；两路都有块时
+// 补传流占backlogShare，链路容量相对实时数据量有余量时份额提高，最多到maxShare，
+// 实时流始终至少保留(1 - maxShare)的带宽。
+// 只包含调度逻辑，不依赖Arduino和网络库，所有时间和链路估计由调用者传入，可在主机上单独测试
+class CatchupScheduler {
+public:
+    enum class Stream : uint8_t {
+        LIVE = 0,
+        BACKLOG
+    };
+
+    CatchupScheduler();
+
+    // baseShare：链路无余量时补传流的字节份额；maxShare：补传流份额上限；
+    // liveMargin：为实时流预留的容量倍数（容量须超过实时数据量的该倍数才提高补传份额）
+    void configure(float baseShare, float maxShare, float liveMargin);
+
+    // 每轮调用：capacity为估计的上行容量(bytes/s，未知时为0)，backlogPending表示暂存区有待补传的块。
+    // 每秒更新一次实时数据量估计和补传份额，返回true表示补传开始或结束
+    bool update(uint32_t now, float capacity, bool backlogPending);
+
+    // 选择下一条消息取哪一路的块
+    Stream select(bool liveReady, bool backlogReady) const;
+
+    // 记录一条已编码的消息
+    void onMessage(Stream stream, uint32_t bytes, uint8_t blockCount);
+
+    // 记录因实时流积压而转入暂存区（改为补传）的块数，计入实时数据量
+    void onLiveDemoted(uint32_t blocks);
+
+    bool isCatchingUp() const { return catchingUp; }
+    float getBacklogShare() const { return share; }
+    float getLiveRate() const { return liveRate; }
+
+    struct Stats {
+        uint32_t liveMessages;
+        uint32_t backlogMessages;
+        uint32_t liveBytes;
+        uint32_t backlogBytes;
+        uint32_t demotedBlocks;     // 实时流积压时转为补传的块数
+        uint32_t catchups;          // 补传次数（暂存区由空变为非空再清空算一次）
+        uint32_t lastCatchupMs;     // 最近一次补传从开始到清空的时长
+        uint32_t maxCatchupMs;
+    };
+    const Stats& getStats() const { return stats; }
+
+    // 补传期间两路实际的字节占比中补传流的份额(0-1)
+    float getMeasuredShare() const;
+
+    // 重新开始统计（不改变补传状态）
+    void resetStats();
+
+private:
+    float baseShare;
+    float maxShare;
+    float liveMargin;
+
+    float share;                // 当前补传份额
+    float balance;              // 补传流按份额应得而未得的字节数：>=0时轮到补传流
+    bool catchingUp;
+    uint32_t catchupStartTime;
+
+    // 实时数据量估计
+    uint32_t lastRateTime;
+    uint32_t intervalLiveBytes;
+    uint32_t intervalDemotedBlocks;
+    float liveBytesPerBlock;
+    float liveRate;             // bytes/s
+
+    // 补传期间的字节数，用于计算实际份额
+    uint32_t catchupLiveBytes;
+    uint32_t catchupBacklogBytes;
+
+    Stats stats;
+};
+
+#endif // CATCHUP_SCHEDULER_H
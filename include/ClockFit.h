@@ -0,0 +1,48 @@
+#ifndef CLOCK_FIT_H
+#define CLOCK_FIT_H
+
+#include <stdint.h>
+
+// 时钟拟合：由一组（传感器时间S, ESP32时间E）样本拟合 E(ms) = slope * S + intercept。
+// 传感器时间和ESP32时间都以第一个样本为原点居中，差值用整数计算（兼容传感器时间回绕），
+// 累加用double，毫秒级时间戳达到数百万时斜率仍可精确到1ppm以下。
+// 不依赖Arduino，可在主机上单独测试
+class ClockFit {
+public:
+    struct Sample {
+        uint32_t sensorTimeMs;  // 传感器时间（毫秒）
+        int64_t espTimeUs;      // ESP32时间（微秒）
+    };
+
+    struct Result {
+        double slope;           // ESP32时间/传感器时间
+        double intercept;       // 截距(ms)：E(ms) = slope * S + intercept
+        double residualRms;     // 残差均方根(ms)
+        double residualMax;     // 残差绝对值最大值(ms)
+        double slopeError;      // 斜率的标准误差，样本少或跨度短时较大
+        uint32_t spanMs;        // 样本的传感器时间跨度
+        uint16_t count;         // 参与拟合的样本数（下包络拟合为保留的桶最小值个数）
+        uint16_t rejected;      // 残差超过阈值而剔除的样本数
+    };
+
+    // 下包络拟合的最大分桶数
+    static const uint8_t MAX_ENVELOPE_BUCKETS = 16;
+
+    // 最小二乘拟合斜率和截距，样本少于2个或传感器时间没有跨度时返回false
+    static bool fitLeastSquares(const Sample* samples, uint16_t count, Result& result);
+
+    // 斜率固定为slope，只拟合截距（样本太少或斜率不可信时使用）
+    static bool fitOffset(const Sample* samples, uint16_t count, double slope, Result& result);
+
+    // 下包络拟合：到达延迟（BLE连接间隔、UART批量）只会使ESP32时间偏晚，最小二乘的截距会偏晚平均延迟，
+    // 并被重传尖峰拖动。按传感器时间把样本分成bucketCount个桶，每桶取延迟最小的样本，
+    // 对桶最小值做最小二乘（斜率偏差超过maxSkewPpm时固定斜率为1），再剔除残差绝对值超过outlierMs的桶最小值后重新拟合。
+    // 残差统计针对保留的桶最小值；有效桶少于2个时返回false
+    static bool fitLowerEnvelope(const Sample* samples, uint16_t count, uint8_t bucketCount, double outlierMs,
+                                 double maxSkewPpm, Result& result);
+
+    // 斜率相对1的偏差(ppm)
+    static double skewPpm(double slope) { return (slope - 1.0) * 1e6; }
+};
+
+#endif // CLOCK_FIT_H
@@ -0,0 +1,54 @@
+#ifndef CLOCK_LATCH_H
+#define CLOCK_LATCH_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 时钟参数发布：单写者、多读者的双副本顺序锁（latch），T为可平凡复制的参数快照。
+// 写者先递增序号再改写偶数副本、再递增序号再改写奇数副本，读者按序号的奇偶读取当前没有被改写的副本，
+// 读完序号不变即为一致的快照，否则重读。读者从不等待写者，写者在改写途中被抢占时读者仍能读到完整的旧副本，
+// 因此同核的高优先级任务读取也不会自旋。
+// 写者必须唯一（由调用者保证）。不依赖Arduino，可在主机上单独测试
+template <typename T>
+class ClockLatch {
+public:
+    ClockLatch() : sequence(0), retries(0), copies() {}
+
+    // 写者调用
+    void publish(const T& value) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+
+        // 序号变为奇数：读者转读副本1，改写副本0
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        copies[0] = value;
+
+        // 序号变为偶数：读者转读副本0，改写副本1
+        sequence.store(seq + 2, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_release);
+        copies[1] = value;
+    }
+
+    // 任意任务调用，不阻塞
+    void read(T& value) const {
+        while (true) {
+            uint32_t seq = sequence.load(std::memory_order_acquire);
+            value = copies[seq & 1];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == seq) {
+                return;
+            }
+            retries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t getVersion() const { return sequence.load(std::memory_order_relaxed) / 2; }
+    uint32_t getRetries() const { return retries.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> sequence;
+    mutable std::atomic<uint32_t> retries;     // 读取期间遇到发布而重读的次数
+    T copies[2];
+};
+
+#endif // CLOCK_LATCH_H
@@ -0,0 +1,89 @@
+#ifndef CLOCK_TRACKER_H
+#define CLOCK_TRACKER_H
+
+#include <stdint.h>
+
+// 时钟跟踪器：校准完成后由每个时间对持续更新传感器时钟到ESP32时钟的映射，
+// 跟随温度变化引起的晶振漂移。模型以最近一个时间对为锚点：
+//   E(ms) = anchorEsp + (1 + skew) * (S - anchorSensor)
+// 每个时间对按二阶锁相环（PI环）更新：误差的一部分作为相位修正计入锚点，误差积分修正skew，
+// 每次更新O(1)。设置下包络窗口时先在窗口内取误差最小值再修正一次，跟踪到达延迟的下包络（最小延迟），
+// 不随平均延迟和重传尖峰偏移。相位修正按传感器时间的流逝限速（不超过maxSlewPpm），
+// 因此按传感器时间顺序计算的时间戳单调不减；误差超过重锁阈值（如传感器重启）时直接重新锁定。
+// 不依赖Arduino，可在主机上单独测试
+class ClockTracker {
+public:
+    struct Stats {
+        uint32_t updates;       // 已处理的时间对数
+        uint32_t corrections;   // 修正次数（下包络模式下每个窗口一次）
+        uint32_t slewLimited;   // 相位修正被限速的次数
+        uint32_t relocks;       // 误差过大重新锁定的次数
+        float errorRms;         // 修正所用误差的指数滑动均方根(ms)
+        float maxError;         // 锁定以来修正所用误差绝对值的最大值(ms)
+        float lastError;        // 最近一次修正所用的误差(ms)
+    };
+
+    // 模型快照，可复制给其他任务计算时间戳
+    struct Model {
+        bool anchored;
+        uint32_t anchorSensor;
+        double anchorEsp;
+        double slope;
+        double intercept;       // 锚定前使用：E = slope * S + intercept
+    };
+
+    ClockTracker();
+
+    // timeConstantMs：相位修正的时间常数，积分时间常数取其2倍（临界阻尼）；
+    // maxSlewPpm：相位修正速度上限；maxSkewPpm：skew上限；relockThresholdMs：重新锁定的误差阈值；
+    // envelopeWindowMs：下包络窗口（传感器时间），0表示每个时间对都修正
+    void configure(float timeConstantMs, float maxSlewPpm, float maxSkewPpm, float relockThresholdMs,
+                   float envelopeWindowMs = 0.0f);
+
+    // 以拟合结果 E(ms) = slope * S + intercept 开始跟踪，锚点取下一个时间对的传感器时间
+    void start(double slope, double intercept);
+    void stop();
+    bool isActive() const { return active; }
+
+    // 处理一个时间对，返回false表示误差超过阈值而重新锁定
+    bool update(uint32_t sensorTimeMs, int64_t espTimeUs);
+
+    // 估计传感器时间对应的ESP32时间(ms)
+    double estimate(uint32_t sensorTimeMs) const { return evaluate(getModel(), sensorTimeMs); }
+
+    Model getModel() const;
+    static double evaluate(const Model& model, uint32_t sensorTimeMs);
+    static double interceptOf(const Model& model);
+
+    // 当前模型等价的 E = slope * S + intercept（锚点附近有效，传感器时间回绕后截距会跳变）
+    double getSlope() const { return 1.0 + skew; }
+    double getIntercept() const { return interceptOf(getModel()); }
+    double getSkewPpm() const { return skew * 1e6; }
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    float timeConstantMs;
+    float maxSlew;
+    float maxSkew;
+    float relockThresholdMs;
+    float envelopeWindowMs;
+
+    bool active;
+    bool anchored;
+    uint32_t anchorSensor;      // 锚点传感器时间(ms)
+    double anchorEsp;           // 锚点ESP32时间(ms)
+    double skew;
+    double startIntercept;      // 开始跟踪后第一个时间对之前使用的截距
+
+    // 下包络窗口：窗口内模型不变，误差可直接比较
+    bool windowOpen;
+    uint32_t windowStart;       // 窗口第一个时间对的传感器时间
+    double windowMinError;
+
+    Stats stats;
+
+    void relock(uint32_t sensorTimeMs, double espTimeMs);
+};
+
+#endif // CLOCK_TRACKER_H
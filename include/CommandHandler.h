@@ -9,6 +9,7 @@
 
 // 前向声明
 class BluetoothConfig;
+class SessionRecorder;
 
 // CLI命令处理器类
 class CommandHandler {
@@ -22,6 +23,9 @@ public:
     // 设置蓝牙配置模块
     void setBluetoothConfig(BluetoothConfig* btConfig);
     
+    // 设置会话记录器
+    void setSessionRecorder(SessionRecorder* recorder);
+    
     // 处理输入命令（从Serial0）
     void processCommand(const String& command);
     
@@ -73,6 +77,24 @@ public:
     // 显示缓冲区状态
     void showBufferStatus(const String& args = "");
     
+    // 显示延迟统计（latency [reset]）
+    void showLatency(const String& args = "");
+    
+    // UDP实时流开关与统计（udp [on|off|reset]）
+    void controlUdpStream(const String& args = "");
+    
+    // 本地WebSocket服务器开关与统计（local [on|off|reset]）
+    void controlLocalServer(const String& args = "");
+    
+    // 省电上传模式开关与统计（power [on|off|reset]）
+    void controlPowerSave(const String& args = "");
+    
+    // 闪存暂存区开关与统计（spool [on|off|reset]）
+    void controlSpool(const String& args = "");
+    
+    // 会话记录开关、统计与查询（record [on|off|reset|list|query <会话> [起始ms 结束ms] [传感器]]）
+    void controlRecorder(const String& args = "");
+    
     // 实时显示传感器数据
     void showRealtimeData(const String& args = "");
     
@@ -88,6 +110,7 @@ private:
     SensorData* sensorData;
     TimeSync* timeSync;
     BluetoothConfig* bluetoothConfig;
+    SessionRecorder* sessionRecorder;
     
     // 命令输入缓冲区
     String inputBuffer;
@@ -105,7 +128,7 @@ private:
     
     static const Command commands[];
 
-    static const size_t COMMAND_COUNT = 22;
+    static const size_t COMMAND_COUNT = 28;
     
     // 解析命令参数
     String parseCommand(const String& input, String& args);
@@ -137,6 +160,9 @@ private:
     // 显示UART配置
     void showUartConfig(const String& args = "");
     
+    // 显示一个延迟直方图
+    void printLatencyHistogram(const char* name, const LatencyHistogram& histogram);
+    
     // 格式化时间戳
     String formatTimestamp(uint64_t timestamp);
     
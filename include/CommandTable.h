@@ -0,0 +1,26 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 命令名的FNV-1a哈希，命令表中的哈希在编译期计算
+constexpr uint32_t hashCommandName(const char* name, uint32_t hash = 2166136261u) {
+    return *name ? hashCommandName(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+// 在命令表中查找命令：先比较哈希，哈希相同再比较名称确认，不复制名称、不分配内存。
+// Entry须包含hash（uint32_t）和name（const char*）字段。不依赖Arduino，可在主机上单独测试
+template <typename Entry>
+const Entry* findCommand(const Entry* table, size_t count, const char* name) {
+    uint32_t hash = hashCommandName(name);
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].hash == hash && strcmp(table[i].name, name) == 0) {
+            return &table[i];
+        }
+    }
+    return nullptr;
+}
+
+#endif // COMMAND_TABLE_H
@@ -13,6 +13,23 @@ public:
     static const uint16_t SERVER_PORT;
     static const char* WEBSOCKET_PATH;
     
+    // UDP实时流配置（低延迟实时显示，WebSocket仍负责控制和可靠归档）
+    static const bool UDP_STREAM_ENABLED;               // 启动时是否开启，运行中可用udp命令切换
+    static const char* UDP_STREAM_HOST;                 // 接收端IP或主机名
+    static const uint16_t UDP_STREAM_PORT;
+    static const size_t UDP_DATAGRAM_SIZE;              // 每个数据报的最大字节数（含16字节头，不超过MTU）
+    static const uint32_t UDP_RESOLVE_RETRY_MS;         // 主机名解析失败后的重试间隔
+    
+    // 本地WebSocket服务器配置（局域网客户端直接接收数据，不经过远程服务器）
+    static const bool LOCAL_SERVER_ENABLED;             // 启动时是否开启，运行中可用local命令切换
+    static const uint16_t LOCAL_SERVER_PORT;
+    static const uint8_t LOCAL_SERVER_MAX_CLIENTS;      // 不超过WEBSOCKETS_SERVER_CLIENT_MAX
+    static const bool LOCAL_SERVER_SOFTAP;              // 同时开启SoftAP供客户端直连
+    static const char* LOCAL_AP_SSID;
+    static const char* LOCAL_AP_PASSWORD;              // 不少于8个字符，未设置时不开启SoftAP
+    static const size_t LOCAL_FRAGMENT_SIZE;            // 转发给本地客户端的每个分片的字节数（一个TCP MSS）
+    static const uint32_t LOCAL_CLIENT_STALL_MS;        // 未写完的消息超过此时长没有进展时断开客户端
+    
     // UART配置
     static const uint32_t UART_BAUD_RATE;
     static const int UART_TX_PIN;
@@ -22,6 +39,7 @@ public:
     static const size_t RING_BUFFER_SIZE;
     static const size_t BLOCK_POOL_SIZE;
     static const size_t MAX_FRAMES_PER_BLOCK;
+    static const size_t BLOCK_QUEUE_DEPTH;      // SensorData到传输层的待发送队列深度
     
     // 任务配置
     static const uint32_t UART_TASK_STACK_SIZE;
@@ -34,12 +52,70 @@ public:
     static const uint32_t CLI_TASK_PRIORITY;
     static const uint32_t MONITOR_TASK_PRIORITY;
     
+    static const uint32_t NETWORK_LOOP_INTERVAL_MS;     // 网络任务最长等待间隔（保证webSocket.loop()调用频率）
+    
+    // 编码任务配置（把块编码为待发送消息，网络任务只负责发送）
+    static const uint32_t ENCODER_TASK_STACK_SIZE;
+    static const uint32_t ENCODER_TASK_PRIORITY;
+    static const BaseType_t ENCODER_TASK_CORE;          // 默认Core 0，利用UART任务之外的空闲时间
+    static const uint8_t ENCODE_BUFFER_COUNT;           // 预分配的输出缓冲区数量
+    static const size_t ENCODE_BUFFER_SIZE;             // 每个输出缓冲区的字节数（需容纳合并后的最大消息）
+    
     // 传感器配置
     static const uint8_t SENSOR_COUNT;
     static const uint8_t FRAME_SIZE;
     
+    // 上传速率控制配置
+    static const uint32_t RATE_CONTROL_INTERVAL_MS;     // 控制周期
+    static const uint32_t RATE_CONTROL_HOLD_MS;         // 等级变化后的最短保持时间
+    static const uint8_t RATE_RECOVER_INTERVALS;        // 恢复前需要连续无积压的周期数
+    static const uint32_t RATE_QUEUE_HIGH_WATERMARK;    // 队列达到此深度且仍在增长时降级
+    static const uint32_t RATE_QUEUE_LOW_WATERMARK;     // 队列不超过此深度视为无积压
+    static const uint8_t COALESCE_MAX_BLOCKS;           // 合并发送时每条消息最多包含的块数
+    static const uint8_t DECIMATION_FACTOR;             // 抽帧等级下每个传感器每N帧保留1帧
+    static const uint8_t LOW_PRIORITY_SENSOR_MASK;      // 优先丢弃等级下丢弃的传感器（bit0=ID1）
+    
+    // 省电上传配置（数据块暂存后集中上传，其间无线电进入modem-sleep）
+    static const bool POWER_SAVE_ENABLED;               // 启动时是否开启，运行中可用power命令切换
+    static const uint32_t POWER_BATCH_WINDOW_MS;        // 两次集中上传之间的暂存窗口
+    static const uint32_t POWER_MAX_BURST_MS;           // 单次集中上传的最长时间
+    static const uint16_t POWER_HOLD_MAX_BLOCKS;        // 暂存块数上限
+    static const uint16_t POWER_FLUSH_THRESHOLD_BLOCKS; // 暂存块数达到此值时提前上传
+    static const uint32_t POWER_IDLE_LOOP_INTERVAL_MS;  // 空闲阶段网络任务的最长等待间隔
+    
+    // 闪存暂存配置（上游断开或积压时块写入spiffs分区，恢复后按序上传）
+    static const bool SPOOL_ENABLED;                    // 启动时是否开启，运行中可用spool命令切换
+    static const size_t SPOOL_REGION_OFFSET;            // 暂存区在spiffs分区中的偏移（扇区对齐）
+    static const size_t SPOOL_REGION_SIZE;              // 暂存区大小（扇区对齐）
+    static const size_t SPOOL_WRITE_BUFFER_SIZE;        // RAM写缓冲区，写满后整段写入闪存（页对齐）
+    static const uint32_t SPOOL_BACKLOG_BLOCKS;         // 无空闲输出缓冲区且排队块数达到此值时开始暂存
+    static const float CATCHUP_BACKLOG_SHARE;           // 补传时补传流的最低字节份额（链路无余量时）
+    static const float CATCHUP_MAX_BACKLOG_SHARE;       // 链路有余量时补传份额的上限，其余始终留给实时流
+    static const float CATCHUP_LIVE_MARGIN;             // 容量超过实时数据量的该倍数后，剩余部分才给补传流
+    static const uint32_t CATCHUP_LIVE_QUEUE_BLOCKS;    // 补传期间实时流最多保留的排队块数，更早的块转入暂存区
+    
+    // 会话记录配置（每个采集会话完整记录到spiffs分区，可按时间范围查询）
+    static const bool RECORDER_ENABLED;                 // 启动时是否开启，运行中可用record命令切换
+    static const size_t RECORDER_REGION_OFFSET;         // 记录区在spiffs分区中的偏移（扇区对齐）
+    static const size_t RECORDER_REGION_SIZE;           // 记录区大小（段大小的整数倍）
+    static const size_t RECORDER_SEGMENT_SIZE;          // 段大小（扇区对齐），每段有一个摘要，查询按段跳过
+    static const size_t RECORDER_WRITE_BUFFER_SIZE;     // RAM写缓冲区（页对齐）
+    static const uint8_t RECORDER_QUEUE_ITEMS;          // 采集路径与记录任务之间的槽位数，耗尽时不记录新块
+    static const uint32_t RECORDER_FLUSH_INTERVAL_MS;   // 写缓冲区定期落盘的间隔
+    static const uint32_t RECORDER_TASK_STACK_SIZE;
+    static const uint32_t RECORDER_TASK_PRIORITY;
+    static const BaseType_t RECORDER_TASK_CORE;
+    static const uint32_t RESEND_PROGRESS_INTERVAL_MS;  // resend命令的进度ack间隔
+    
+    // 重连配置（指数退避+随机抖动）
+    static const uint32_t WIFI_RECONNECT_BASE_DELAY_MS;
+    static const uint32_t WIFI_RECONNECT_MAX_DELAY_MS;
+    static const uint32_t SERVER_RECONNECT_BASE_DELAY_MS;
+    static const uint32_t SERVER_RECONNECT_MAX_DELAY_MS;
+    
     // 时间配置
     static const uint32_t HEARTBEAT_INTERVAL;
+    static const uint32_t PING_INTERVAL_MS;
     static const uint32_t STATUS_INTERVAL;
     static const uint32_t HEALTH_CHECK_INTERVAL;
     
@@ -47,6 +123,18 @@ public:
     static const uint32_t TIME_SYNC_INTERVAL_MS;        // 时间同步间隔(毫秒)
     static const uint8_t TIME_SYNC_CALC_COUNT;          // 每个传感器计算次数
     static const uint32_t TIME_SYNC_CALC_INTERVAL_MS;   // 参数计算间隔(毫秒)
+    static const float TIME_SYNC_MAX_SKEW_PPM;          // 拟合斜率相对1的偏差上限，超过时认为斜率不可信
+    static const float TIME_SYNC_TRACK_TIME_CONSTANT_MS; // 校准后漂移跟踪的相位时间常数(毫秒)
+    static const float TIME_SYNC_MAX_SLEW_PPM;          // 跟踪时时间戳修正速度上限
+    static const float TIME_SYNC_RELOCK_THRESHOLD_MS;   // 跟踪误差超过该值（如传感器重启）时直接重新锁定
+    static const bool TIME_SYNC_LOWER_ENVELOPE;         // 拟合和跟踪到达延迟的下包络（最小延迟）而不是平均值
+    static const uint8_t TIME_SYNC_ENVELOPE_BUCKETS;    // 校准窗口按传感器时间分桶数，每桶取最小延迟
+    static const float TIME_SYNC_OUTLIER_MS;            // 桶最小值的残差超过该值时剔除
+    static const float TIME_SYNC_TRACK_ENVELOPE_MS;     // 跟踪时取最小误差的窗口(毫秒)
+    static const uint32_t NTP_SYNC_INTERVAL_MS;         // NTP周期重新同步间隔(毫秒)
+    static const float NTP_MAX_SLEW_PPM;                // NTP偏移修正速度上限
+    static const float NTP_STEP_THRESHOLD_MS;           // NTP误差超过该值时直接跳变
+    static const float NTP_MAX_DRIFT_PPM;               // ESP32时钟相对UTC的漂移估计上限
     
     // 设备配置
     static const char* DEVICE_CODE;
@@ -0,0 +1,107 @@
+#ifndef FLASH_STORAGE_H
+#define FLASH_STORAGE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// 原始闪存存储接口：按偏移读写、按扇区擦除（NOR闪存写入前目标区域必须已擦除为0xFF）。
+// 固件中由spiffs分区直接提供（不经过文件系统），主机构建（未定义ARDUINO）时用普通文件模拟分区，
+// 上层的暂存/记录逻辑可在主机上单独编译测试
+class FlashStorage {
+public:
+    static const size_t SECTOR_SIZE = 4096;   // 擦除单位
+    static const size_t PAGE_SIZE = 256;      // 写入单位（写入按页对齐时效率最高）
+
+    virtual ~FlashStorage() {}
+
+    virtual size_t size() const = 0;
+    virtual bool read(size_t offset, void* data, size_t length) = 0;
+    virtual bool write(size_t offset, const void* data, size_t length) = 0;
+    virtual bool eraseSector(size_t offset) = 0;   // offset须按扇区对齐
+
+    // 只读内存映射：返回[offset, offset + length)在地址空间中的指针，读取不经过中间缓冲区；
+    // 不支持映射或越界时返回nullptr，调用者改用read
+    virtual const uint8_t* map(size_t, size_t) { return nullptr; }
+
+    // 闪存记录共用的CRC-32（多项式0xEDB88320），crc传入上一段的结果可分段计算
+    static uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+};
+
+// 存储中的一段区域：暂存区和会话记录各用分区的一部分，偏移相对于区域起点
+class FlashRegion : public FlashStorage {
+public:
+    FlashRegion();
+
+    // offset和length须按扇区对齐且不超出parent
+    bool begin(FlashStorage* parent, size_t offset, size_t length);
+
+    size_t size() const override { return length; }
+    bool read(size_t offset, void* data, size_t length) override;
+    bool write(size_t offset, const void* data, size_t length) override;
+    bool eraseSector(size_t offset) override;
+    const uint8_t* map(size_t offset, size_t length) override;
+
+private:
+    FlashStorage* parent;
+    size_t base;
+    size_t length;
+
+    bool inRange(size_t offset, size_t length) const;
+};
+
+#ifdef ARDUINO
+
+#include <esp_partition.h>
+
+// 直接读写数据分区（esp_partition_*），绕过SPIFFS，写入为大块顺序写
+class PartitionStorage : public FlashStorage {
+public:
+    PartitionStorage();
+    ~PartitionStorage() override;
+
+    // 按子类型和标签查找数据分区，label为nullptr时取第一个该子类型的分区
+    bool begin(esp_partition_subtype_t subtype, const char* label = nullptr);
+
+    const esp_partition_t* getPartition() const { return partition; }
+
+    size_t size() const override;
+    bool read(size_t offset, void* data, size_t length) override;
+    bool write(size_t offset, const void* data, size_t length) override;
+    bool eraseSector(size_t offset) override;
+
+    // 第一次调用时把整个分区映射到数据地址空间（esp_partition_mmap），映射失败后不再尝试。
+    // 写入和擦除由esp_partition_*负责使缓存失效，映射的内容与闪存一致
+    const uint8_t* map(size_t offset, size_t length) override;
+
+private:
+    const esp_partition_t* partition;
+    const uint8_t* mapped;
+    esp_partition_mmap_handle_t mapHandle;
+    bool mapFailed;
+};
+
+#else
+
+// 主机构建：用文件模拟分区，新建或长度不足时填充为0xFF（已擦除状态）
+class FileStorage : public FlashStorage {
+public:
+    FileStorage();
+    ~FileStorage() override;
+
+    bool open(const char* path, size_t size);
+    void close();
+
+    size_t size() const override { return length; }
+    bool read(size_t offset, void* data, size_t length) override;
+    bool write(size_t offset, const void* data, size_t length) override;
+    bool eraseSector(size_t offset) override;
+
+private:
+    FILE* file;
+    size_t length;
+};
+
+#endif
+
+#endif // FLASH_STORAGE_H
@@ -0,0 +1,42 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 延迟直方图：固定的对数分桶，记录min/max/平均值并按桶估算百分位。
+// 不加锁，由单个任务写入，其他任务读取仅用于诊断显示。样本由调用者传入，不依赖Arduino，可在主机上单独测试
+class LatencyHistogram {
+public:
+    static const size_t BUCKET_COUNT = 14;
+    
+    LatencyHistogram();
+    
+    // 记录一个延迟样本(ms)
+    void record(uint32_t valueMs);
+    
+    // 清空所有样本
+    void reset();
+    
+    uint32_t getCount() const { return count; }
+    uint32_t getMin() const { return count > 0 ? minValue : 0; }
+    uint32_t getMax() const { return maxValue; }
+    float getAvg() const;
+    
+    // 估算百分位（如99.0表示p99），返回样本所在桶的上界，且不超过最大值
+    uint32_t getPercentile(float percentile) const;
+    
+    // 获取桶的上界和计数，用于显示分布
+    static uint32_t getBucketBound(size_t index);
+    uint32_t getBucketCount(size_t index) const;
+    
+private:
+    static const uint32_t bucketBounds[BUCKET_COUNT];
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t count;
+    uint32_t minValue;
+    uint32_t maxValue;
+    uint64_t sum;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,79 @@
+#ifndef LOCAL_FANOUT_H
+#define LOCAL_FANOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 本地转发的逐客户端分片写入：消息按分片（一个TCP MSS）写给各客户端，每片之前检查该客户端可写
+// （套接字可写只保证约2个MSS的空间，整条消息一次写入会阻塞网络任务）。写不完的客户端记下进度，
+// 余下的分片在之后的pump()/broadcast()中继续写；只有写不完时才把余下部分复制到该客户端的缓冲区。
+// 上一条消息未写完的客户端跳过新消息（实时显示只关心最新数据），超过卡住时限没有进展的客户端被断开。
+// 套接字操作通过Sink完成，时间由调用者传入（ms）。不依赖Arduino，可在主机上单独测试
+class LocalFanout {
+public:
+    static const uint8_t MAX_CLIENTS = 8;
+
+    class Sink {
+    public:
+        virtual ~Sink() {}
+        // 客户端的发送缓冲区至少能放下一个分片
+        virtual bool isWritable(uint8_t client) = 0;
+        // 写一个分片（首片为text帧，后续为continuation帧，末片置FIN）
+        virtual bool sendFragment(uint8_t client, const uint8_t* data, size_t length, bool first, bool fin) = 0;
+        // 断开客户端（卡住或写入失败，未写完的消息已无法补全）
+        virtual void disconnect(uint8_t client) = 0;
+    };
+
+    struct Stats {
+        uint32_t clientSends;       // 完整写给客户端的消息数（每个客户端计一次）
+        uint32_t clientSkips;       // 客户端不可写或上一条消息未写完而跳过的消息数
+        uint32_t deferredSends;     // 一轮没有写完、余下分片稍后继续写的消息数
+        uint32_t sendFailures;      // 写入失败而断开的次数
+        uint32_t stalledClients;    // 超过卡住时限没有进展而断开的客户端数
+    };
+
+    explicit LocalFanout(Sink* sink);
+    ~LocalFanout();
+
+    // fragmentSize：每个分片的字节数；stallTimeoutMs：未写完的消息多久没有进展时断开客户端
+    void configure(size_t fragmentSize, uint32_t stallTimeoutMs);
+
+    void addClient(uint8_t client);
+    void removeClient(uint8_t client);
+    bool isPending(uint8_t client) const { return client < MAX_CLIENTS && clients[client].pending; }
+
+    // 先继续写未写完的消息，再把新消息写给空闲且可写的客户端（data只在调用期间使用）。
+    // 返回是否有客户端收到或开始接收本条消息
+    bool broadcast(const char* data, size_t length, uint32_t now);
+
+    // 继续写未写完的消息并检查卡住的客户端，网络任务每轮调用
+    void pump(uint32_t now);
+
+    const Stats& getStats() const { return stats; }
+    void resetStats();
+
+private:
+    struct Client {
+        bool connected;
+        bool pending;           // 有未写完的消息
+        char* buffer;           // 未写完部分的副本（首次需要时分配，断开时释放）
+        size_t bufferSize;
+        size_t length;          // 副本中待写的字节数
+        size_t offset;          // 副本中已写入的字节数
+        uint32_t lastProgress;  // 最近一次写入分片的时刻
+    };
+
+    Sink* sink;
+    size_t fragmentSize;
+    uint32_t stallTimeoutMs;
+    Client clients[MAX_CLIENTS];
+    Stats stats;
+
+    // 从offset处写到写完或不可写为止。continuation表示消息的首片已经写过。
+    // 写入失败时断开客户端并返回false
+    bool writeFragments(uint8_t client, const char* data, size_t length, size_t& offset, bool continuation, uint32_t now);
+    void releaseClient(Client& client);
+    void dropClient(uint8_t client);
+};
+
+#endif // LOCAL_FANOUT_H
@@ -0,0 +1,72 @@
+#ifndef LOCAL_STREAM_SERVER_H
+#define LOCAL_STREAM_SERVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebSocketsServer.h>
+#include "LocalFanout.h"
+
+// WebSocketsServer扩展：按分片写入单个客户端并检测其套接字是否可写，作为LocalFanout的Sink，慢客户端不阻塞网络任务
+class LocalWebSocketServer : public WebSocketsServer, public LocalFanout::Sink {
+public:
+    explicit LocalWebSocketServer(uint16_t port) : WebSocketsServer(port) {}
+
+    bool isWritable(uint8_t client) override;
+    bool sendFragment(uint8_t client, const uint8_t* data, size_t length, bool first, bool fin) override;
+    void disconnect(uint8_t client) override { WebSocketsServer::disconnect(client); }
+};
+
+// 本地WebSocket服务器：把上传给服务器的同一份已编码数据消息转发给局域网内的客户端（如平板），
+// 不经过远程服务器。可在STA网络上运行，也可开启SoftAP供客户端直连。只在网络任务中使用
+class LocalStreamServer {
+public:
+    struct Stats {
+        bool running;
+        uint8_t clients;            // 当前连接的客户端数
+        uint8_t peakClients;
+        uint32_t rejectedClients;   // 超过上限被断开的连接数
+        uint32_t messagesBroadcast; // 至少发给一个客户端的消息数
+        uint32_t clientSends;       // 完整写入客户端的消息数（每个客户端计一次）
+        uint32_t clientSkips;       // 客户端不可写或上一条消息未写完而跳过的消息数
+        uint32_t deferredSends;     // 一轮没有写完、余下分片稍后继续写的消息数
+        uint32_t stalledClients;    // 未写完的消息长时间没有进展而断开的客户端数
+        uint32_t sendFailures;
+        float avgFanoutUs;          // 每条消息转发给全部客户端的平均耗时(us)
+        uint32_t maxFanoutUs;
+    };
+
+    LocalStreamServer();
+
+    // 启动服务器（按配置同时开启SoftAP）
+    bool begin();
+
+    // 断开所有客户端并停止服务器
+    void stop();
+
+    bool isRunning() const { return running; }
+    bool hasClients() const { return running && clientCount > 0; }
+
+    // 网络任务周期调用，处理握手和客户端消息，继续写未写完的消息
+    void loop();
+
+    // 把一条已编码消息按分片写给所有空闲且可写的客户端（直接使用调用者的缓冲区，
+    // 只有某个客户端写不完时才复制余下部分），不阻塞网络任务
+    void broadcast(const char* data, size_t length);
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    LocalWebSocketServer server;
+    LocalFanout fanout;
+    bool running;
+    bool softApStarted;
+    bool clientConnected[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint8_t clientCount;
+    Stats stats;
+
+    static void serverEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+    void handleEvent(uint8_t num, WStype_t type);
+};
+
+#endif // LOCAL_STREAM_SERVER_H
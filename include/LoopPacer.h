@@ -0,0 +1,41 @@
+#ifndef LOOP_PACER_H
+#define LOOP_PACER_H
+
+#include <stdint.h>
+
+// 网络任务节拍：被唤醒后连续发送所有已就绪的消息，本轮处理时间达到时间片后让出一次（只让出、不等待），
+// 使webSocket.loop()的调用间隔不超过时间片加一条消息的写入时间；没有待发送的消息时等待块封装的通知，
+// 最长等待间隔到期后仍醒来处理WebSocket事件。吞吐只受发送耗时限制，不受等待间隔限制。
+// 时间由调用者传入（ms）。不依赖Arduino，可在主机上单独测试
+class LoopPacer {
+public:
+    explicit LoopPacer(uint32_t sliceMs = 10) : sliceMs(sliceMs), roundStart(0), yielded(false) {}
+
+    void setSlice(uint32_t sliceMs) { this->sliceMs = sliceMs; }
+    uint32_t getSlice() const { return sliceMs; }
+
+    // 一轮发送开始
+    void beginRound(uint32_t nowMs) {
+        roundStart = nowMs;
+        yielded = false;
+    }
+
+    // 每写完一条消息后调用：本轮已用满时间片时返回true，调用者停止发送并让出
+    bool shouldYield(uint32_t nowMs) {
+        if (nowMs - roundStart >= sliceMs) {
+            yielded = true;
+        }
+        return yielded;
+    }
+
+    // 本轮结束后的最长等待时长：因时间片用尽让出时为0（仍有消息待发送），否则为idleWaitMs
+    uint32_t nextWaitMs(uint32_t idleWaitMs) const { return yielded ? 0 : idleWaitMs; }
+    bool hasYielded() const { return yielded; }
+
+private:
+    uint32_t sliceMs;
+    uint32_t roundStart;
+    bool yielded;
+};
+
+#endif // LOOP_PACER_H
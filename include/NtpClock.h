@@ -0,0 +1,74 @@
+#ifndef NTP_CLOCK_H
+#define NTP_CLOCK_H
+
+#include <stdint.h>
+
+// NTP时钟模型：由周期性的NTP测量（ESP32时间esp_timer_get_time()与UTC时间，均为微秒）
+// 维护偏移 offset = UTC - ESP32时间 及其漂移率。
+// 漂移由最近若干次测量的最小二乘斜率估计；新测量与当前模型的误差按不超过maxSlewPpm的速度逐渐修正，
+// 偏移连续变化，全局时间戳不会跳变或倒退。首次测量或误差超过stepThresholdMs时直接跳变。
+// 模型是ESP32时间的分段线性函数，发布一次即可在任意时刻计算偏移，不需要周期更新。
+// 不依赖Arduino，可在主机上单独测试
+class NtpClock {
+public:
+    static const uint8_t HISTORY_SIZE = 8;
+
+    // 偏移模型：slewEndUs之前按driftPpm+slewPpm变化，之后按driftPpm变化
+    struct Model {
+        bool valid;
+        int64_t anchorEspUs;
+        int64_t anchorOffsetUs;
+        int64_t slewEndUs;
+        float driftPpm;
+        float slewPpm;
+    };
+
+    struct Measurement {
+        int64_t espUs;          // 测量时的ESP32时间
+        int64_t offsetUs;       // 测得的偏移
+        int32_t errorUs;        // 测得的偏移与测量前模型的差值（首次或跳变时为0）
+        float driftPpm;         // 测量后估计的漂移
+        bool stepped;           // 本次测量直接跳变
+    };
+
+    struct Stats {
+        uint32_t measurements;
+        uint32_t steps;         // 直接跳变次数（含首次）
+        uint32_t slews;         // 逐渐修正次数
+        int32_t maxErrorUs;     // 逐渐修正的误差绝对值最大值
+    };
+
+    NtpClock();
+
+    // maxSlewPpm：修正速度上限；stepThresholdMs：超过该误差直接跳变；maxDriftPpm：漂移估计上限
+    void configure(float maxSlewPpm, float stepThresholdMs, float maxDriftPpm);
+
+    // 加入一次NTP测量，返回更新后的模型
+    const Model& addMeasurement(int64_t espUs, int64_t utcUs);
+    void reset();
+
+    const Model& getModel() const { return model; }
+    static int64_t offsetAt(const Model& model, int64_t espUs);
+
+    // 最近的测量，index为0表示最新；返回false表示没有该条
+    bool getHistory(uint8_t index, Measurement& measurement) const;
+    uint8_t getHistoryCount() const { return historyCount; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    float maxSlewPpm;
+    float stepThresholdUs;
+    float maxDriftPpm;
+
+    Model model;
+    Measurement history[HISTORY_SIZE];
+    uint8_t historyHead;        // 下一条写入位置
+    uint8_t historyCount;
+    Stats stats;
+
+    // 用历史测量估计漂移(ppm)和espUs处的偏移，少于2条时返回false
+    bool fitHistory(int64_t espUs, float& driftPpm, int64_t& offsetUs) const;
+    void step(int64_t espUs, int64_t offsetUs);
+};
+
+#endif // NTP_CLOCK_H
@@ -0,0 +1,79 @@
+#ifndef POWER_SCHEDULER_H
+#define POWER_SCHEDULER_H
+
+#include <stdint.h>
+
+// 省电上传调度器：空闲阶段数据块暂存、无线电进入modem-sleep，
+// 窗口到期（或暂存块过多、需要立即上传）时进入突发阶段一次性上传。
+// 只包含调度逻辑，不依赖Arduino和网络库，所有时间和队列状态由调用者传入，可在主机上单独测试
+class PowerScheduler {
+public:
+    enum class Phase : uint8_t {
+        ALWAYS_ON = 0,  // 省电模式关闭，无线电常开
+        IDLE,           // 暂存数据块，无线电休眠
+        BURST           // 上传暂存数据，无线电常开
+    };
+
+    PowerScheduler();
+
+    // windowMs：两次突发之间的暂存窗口；maxBurstMs：单次突发的最长时间（链路异常时也会回到空闲）；
+    // flushThreshold：暂存块数达到该值时提前突发
+    void configure(uint32_t windowMs, uint32_t maxBurstMs, uint32_t flushThreshold);
+
+    // 开启/关闭省电模式，开启后先进入空闲阶段
+    void setEnabled(bool enabled, uint32_t now);
+    bool isEnabled() const { return phase != Phase::ALWAYS_ON; }
+
+    // 每轮调用：heldBlocks为当前暂存块数，drained表示暂存和待确认数据已全部上传，
+    // flushRequested表示需要立即上传（如停止采集）。返回true表示阶段发生变化
+    bool update(uint32_t now, uint32_t heldBlocks, bool drained, bool flushRequested);
+
+    Phase getPhase() const { return phase; }
+    bool shouldHoldBlocks() const { return phase == Phase::IDLE; }
+    bool isRadioNeeded() const { return phase != Phase::IDLE; }
+
+    // 每次进入突发阶段后返回一次true，心跳随突发发送
+    bool consumeHeartbeatDue();
+
+    // 距下一次计划突发的时间(ms)，非空闲阶段返回0
+    uint32_t getTimeToNextBurst(uint32_t now) const;
+
+    // 开启以来无线电常开时间的占比(0-1)，以及按此估计的每分钟无线电常开时间(ms)
+    float getDutyCycle(uint32_t now) const;
+    float getRadioOnMsPerMinute(uint32_t now) const;
+
+    uint32_t getBurstCount() const { return burstCount; }
+    uint32_t getBurstTimeouts() const { return burstTimeouts; }
+    uint32_t getEarlyFlushes() const { return earlyFlushes; }
+    uint32_t getLastBurstMs() const { return lastBurstMs; }
+    uint32_t getMaxBurstMs() const { return maxBurstMs; }
+
+    // 重新开始统计（不改变当前阶段）
+    void resetStats(uint32_t now);
+
+    static const char* getPhaseName(Phase phase);
+
+private:
+    Phase phase;
+    uint32_t windowMs;
+    uint32_t burstLimitMs;
+    uint32_t flushThreshold;
+
+    uint32_t phaseStartTime;    // 当前阶段开始时刻
+    bool heartbeatDue;
+
+    // 统计
+    uint32_t statsStartTime;
+    uint32_t radioOnMs;         // 已结束的突发阶段累计时长
+    uint32_t burstCount;
+    uint32_t burstTimeouts;     // 因超过最长时间而结束的突发次数
+    uint32_t earlyFlushes;      // 窗口未到期即开始的突发次数
+    uint32_t lastBurstMs;
+    uint32_t maxBurstMs;
+
+    void enterBurst(uint32_t now, bool early);
+    void enterIdle(uint32_t now);
+    uint32_t countedBurstStart() const;
+};
+
+#endif // POWER_SCHEDULER_H
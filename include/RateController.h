@@ -0,0 +1,89 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 上传降级等级，逐级叠加（高等级包含低等级的全部措施）
+enum class UploadLevel : uint8_t {
+    NORMAL = 0,         // 每块一条消息，完整JSON
+    COALESCE,           // 多个已就绪块合并为一条消息，减少每消息开销
+    COMPACT,            // 紧凑编码：每帧一个定点整数数组
+    DECIMATE,           // 按传感器抽帧
+    PRIORITY_DROP,      // 丢弃低优先级传感器的帧
+    COUNT
+};
+
+// 上传速率控制器：根据发送完成情况估计上行可持续吞吐量，结合待发送队列的增长决定降级等级。
+// 与网络库无关，所有时间和参数由调用者传入，不依赖Arduino，可在主机上单独测试
+class RateController {
+public:
+    RateController();
+    
+    // intervalMs：控制周期；queueHighWatermark：队列达到此深度且仍在增长时降级；
+    // queueLowWatermark：队列不超过此深度视为无积压；holdMs：等级变化后的最短保持时间；
+    // recoverIntervals：恢复前需要连续无积压的周期数
+    void configure(uint32_t intervalMs, uint32_t queueHighWatermark, uint32_t queueLowWatermark, 
+                   uint32_t holdMs, uint8_t recoverIntervals);
+    
+    // 记录写入套接字的字节数
+    void onBytesWritten(size_t bytes);
+    
+    // 记录一条数据消息的编码大小及其包含的块数，用于估计每块字节数
+    void onMessageEncoded(size_t bytes, uint8_t blockCount);
+    
+    // 记录一次因套接字不可写造成的发送暂停
+    void onSendStall();
+    
+    // 重新开始测量（未采集或断线期间调用），下一次update只建立基准
+    void restartMeasurement() { lastUpdateTime = 0; }
+    
+    // 是否到了下一个控制周期
+    bool isUpdateDue(uint32_t now) const;
+    
+    // 每个控制周期调用一次：queuedBlocks为待发送队列深度，droppedBlocks为累计丢弃块数。
+    // 返回true表示等级发生变化
+    bool update(uint32_t now, uint32_t queuedBlocks, uint32_t droppedBlocks);
+    
+    UploadLevel getLevel() const { return level; }
+    UploadLevel getPreviousLevel() const { return previousLevel; }
+    
+    // 估计的上行容量和当前等级下的数据产生速率(bytes/s)
+    float getCapacityEstimate() const { return capacityEstimate; }
+    float getDemandEstimate() const { return demandEstimate; }
+    uint32_t getLevelChanges() const { return levelChanges; }
+    
+    static const char* getLevelName(UploadLevel level);
+    
+    // 各等级相对NORMAL的数据量估计比例
+    static float getLevelRatio(UploadLevel level);
+    
+private:
+    uint32_t intervalMs;
+    uint32_t queueHighWatermark;
+    uint32_t queueLowWatermark;
+    uint32_t holdMs;
+    uint8_t recoverIntervals;
+    
+    UploadLevel level;
+    UploadLevel previousLevel;
+    
+    uint32_t lastUpdateTime;
+    uint32_t lastLevelChangeTime;
+    uint32_t intervalBytes;         // 本周期写入套接字的字节数
+    uint32_t intervalStalls;        // 本周期发送暂停次数
+    uint32_t lastQueuedBlocks;
+    uint32_t lastDroppedBlocks;
+    uint8_t calmIntervals;          // 连续无积压、无暂停的周期数
+    uint8_t failedProbes;           // 升级后很快又降级的次数，用于加长下一次恢复前的等待
+    bool probing;                   // 最近一次等级变化是否为恢复（升级）
+    
+    float capacityEstimate;
+    float demandEstimate;
+    float bytesPerBlock;            // 当前等级下每块的平均编码字节数
+    uint32_t levelChanges;
+    
+    void setLevel(UploadLevel newLevel, uint32_t now);
+};
+
+#endif // RATE_CONTROLLER_H
@@ -0,0 +1,45 @@
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+#include <stdint.h>
+
+// 断线重连的指数退避：第n次尝试后的间隔为base * 2^(n-1)，上限max，叠加±25%随机抖动，避免多台网关同时重连。
+// 同时记录链路断开时刻，恢复时给出断开到恢复的耗时。WiFi层和WebSocket层各用一个实例。
+// 时间和随机数由调用者传入，不依赖Arduino，可在主机上单独测试
+class ReconnectBackoff {
+public:
+    ReconnectBackoff();
+
+    void configure(uint32_t baseDelayMs, uint32_t maxDelayMs);
+
+    // 链路断开：记录断开时刻，尝试次数清零，立即允许下一次尝试（已断开时不改变断开时刻）
+    void onLinkDown(uint32_t now);
+
+    // 链路恢复：尝试次数清零，返回断开到恢复的耗时(ms)，未处于断开状态时返回0
+    uint32_t onLinkUp(uint32_t now);
+    bool isDown() const { return down; }
+
+    // 尝试次数清零并立即允许下一次尝试（下层链路恢复或手动连接时）
+    void retryNow(uint32_t now);
+
+    // 下一次尝试到期时计为一次尝试、按退避安排再下一次并返回true。random为随机数（如esp_random()）
+    bool poll(uint32_t now, uint32_t random);
+
+    uint32_t getAttempts() const { return attempts; }
+    uint32_t getCurrentDelay() const { return currentDelay; }
+    uint32_t getNextAttemptTime() const { return nextAttemptTime; }
+
+    // 第attempts次尝试后的退避间隔
+    static uint32_t computeDelay(uint32_t attempts, uint32_t baseDelayMs, uint32_t maxDelayMs, uint32_t random);
+
+private:
+    uint32_t baseDelayMs;
+    uint32_t maxDelayMs;
+    uint32_t attempts;          // 自上次连接成功以来的尝试次数
+    uint32_t nextAttemptTime;   // 下一次允许尝试的时刻
+    uint32_t currentDelay;      // 当前退避间隔(ms)
+    uint32_t downSince;         // 断开时刻
+    bool down;
+};
+
+#endif // RECONNECT_BACKOFF_H
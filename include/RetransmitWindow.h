@@ -0,0 +1,74 @@
+#ifndef RETRANSMIT_WINDOW_H
+#define RETRANSMIT_WINDOW_H
+
+#include <stdint.h>
+
+// 重传窗口：已发送但未被服务器累计确认的数据消息，按序列号递增排列，容量N条。
+// 连接断开后从最旧的条目开始按序重传（resendCursor），追平后才发送新消息。
+// Entry须包含seq（uint32_t）和transmissions（发送次数，0表示尚未写入套接字）字段。
+// 只由网络任务访问，不加锁。不依赖Arduino，可在主机上单独测试
+template <typename Entry, uint8_t N>
+class RetransmitWindow {
+public:
+    RetransmitWindow() : entries(), head(0), count(0), resendCursor(0) {}
+
+    static uint8_t capacity() { return N; }
+    uint8_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    bool isFull() const { return count >= N; }
+
+    // offset为相对最旧条目的位置
+    Entry& at(uint8_t offset) { return entries[(head + offset) % N]; }
+    const Entry& at(uint8_t offset) const { return entries[(head + offset) % N]; }
+    Entry& front() { return entries[head]; }
+
+    // 追加新消息的条目（调用者先检查isFull），返回窗口中的副本
+    Entry& push(const Entry& entry) {
+        Entry& slot = entries[(head + count) % N];
+        slot = entry;
+        count++;
+        return slot;
+    }
+
+    // 移除最旧的条目（已确认或丢弃），重传位置随之前移
+    void popFront() {
+        head = (head + 1) % N;
+        count--;
+        if (resendCursor > 0) {
+            resendCursor--;
+        }
+    }
+
+    // 最旧的条目可被ackSeq的累计确认释放：seq <= ackSeq（差值比较兼容序列号回绕）且已发送过
+    bool canRelease(uint32_t ackSeq) const {
+        return count > 0 && (int32_t)(entries[head].seq - ackSeq) <= 0 && entries[head].transmissions > 0;
+    }
+
+    // 连接重建：窗口内所有条目重新发送
+    void rewind() { resendCursor = 0; }
+    bool hasResend() const { return resendCursor < count; }
+    Entry& resendEntry() { return at(resendCursor); }
+    uint8_t getResendCursor() const { return resendCursor; }
+
+    // 序列号为seq的消息已全部写入套接字，重传位置移到其后。
+    // 重传期间该条目可能已被迟到的确认释放，此时返回nullptr
+    Entry* onWritten(uint32_t seq) {
+        if (count == 0) {
+            return nullptr;
+        }
+        uint32_t offset = seq - entries[head].seq;
+        if ((int32_t)offset < 0 || offset >= count) {
+            return nullptr;
+        }
+        resendCursor = offset + 1;
+        return &at(offset);
+    }
+
+private:
+    Entry entries[N];
+    uint8_t head;           // 最旧未确认条目的位置
+    uint8_t count;          // 未确认条目数
+    uint8_t resendCursor;   // 待重传的窗口偏移（等于count表示无需重传）
+};
+
+#endif // RETRANSMIT_WINDOW_H
@@ -5,6 +5,11 @@
 
 // 前向声明
 class BufferPool;
+class SessionRecorder;
+class SessionManifest;
+
+// 传感器数量（ID 1-4）
+#define SENSOR_DATA_SENSOR_COUNT 4
 
 // 传感器数据类型定义
 struct SensorFrame {
@@ -15,6 +20,7 @@ struct SensorFrame {
     float gyro[3];          // 角速度 x,y,z
     float angle[3];         // 角度 x,y,z
     bool valid;             // 数据有效性标志
+    bool ntpSynced;         // rawTimestamp是否为UTC时间（传感器已校准且NTP已同步），否则为传感器或ESP32开机后的时间
 };
 
 // 批量数据块结构
@@ -25,6 +31,13 @@ struct DataBlock {
     uint32_t blockId;
     uint32_t createTime;
     bool isFull;
+    uint8_t sensorFrameCounts[SENSOR_DATA_SENSOR_COUNT]; // 块内每个传感器的帧数（封装时统计）
+};
+
+// 待发送队列满时的丢弃策略（唯一的丢弃点在SensorData）
+enum class BlockDropPolicy {
+    DROP_OLDEST,    // 丢弃队列中最旧的块，保留最新数据
+    DROP_NEWEST     // 丢弃刚封装的块，保留已排队的数据
 };
 
 // 传感器数据管理类
@@ -37,11 +50,39 @@ public:
     bool addFrame(const SensorFrame& frame);
     
     // 获取下一个完整的数据块
+    // 所有权规则：块在队列中时归SensorData所有；取出后归调用者（传输层）所有，
+    // 调用者必须在处理完成后通过releaseBlock()归还
     DataBlock* getNextBlock();
     
     // 释放数据块
     void releaseBlock(DataBlock* block);
     
+    // 为从闪存暂存区读回的块分配缓冲区，内容由调用者填充，之后同样通过releaseBlock()归还
+    DataBlock* allocateBlock();
+    
+    // 归还已写入闪存暂存区的块（数据尚未上传，不计入已发送）
+    void recycleBlock(DataBlock* block);
+    
+    // 丢弃队列中所有待发送的块（未在采集时调用）
+    uint32_t discardQueuedBlocks();
+    
+    // 设置/获取队列满时的丢弃策略
+    void setDropPolicy(BlockDropPolicy policy);
+    BlockDropPolicy getDropPolicy() const;
+    
+    // 设置数据块消费任务，块封装完成后通过任务通知唤醒该任务
+    void setConsumerTask(TaskHandle_t task);
+    
+    // 设置会话记录器，块封装完成后（包括随后被丢弃的块）复制一份给它
+    void setSessionRecorder(SessionRecorder* recorder);
+    
+    // 设置会话清单，封装和丢弃块时在mutex内更新其采集侧字段
+    void setSessionManifest(SessionManifest* manifest);
+    
+    // 块记录格式（闪存暂存区和会话记录共用）：块头字段后接有效帧，output至少sizeof(DataBlock)
+    static size_t serializeBlock(const DataBlock* block, uint8_t* output);
+    static bool deserializeBlock(const uint8_t* data, size_t length, DataBlock* block);
+    
     // 获取统计信息
     struct Stats {
         uint32_t totalFrames;
@@ -49,6 +90,13 @@ public:
         uint32_t blocksCreated;
         uint32_t blocksSent;
         float avgFrameRate;
+        // 待发送队列统计
+        uint32_t queuedBlocks;                                   // 当前排队块数
+        uint32_t peakQueuedBlocks;                               // 排队块数峰值
+        uint32_t queuedFrames[SENSOR_DATA_SENSOR_COUNT];         // 每个传感器当前排队帧数
+        uint32_t droppedBlocks;                                  // 队列满被丢弃的块数
+        uint32_t droppedFramesBySensor[SENSOR_DATA_SENSOR_COUNT];// 每个传感器被丢弃的帧数
+        uint32_t discardedBlocks;                                // 非采集期间清理的块数
     };
     Stats getStats() const;
     
@@ -64,11 +112,21 @@ private:
     SemaphoreHandle_t mutex;
     BufferPool* bufferPool;
     bool ownsBufferPool;
+    TaskHandle_t consumerTask;  // 等待数据块的任务（网络任务）
+    SessionRecorder* sessionRecorder;
+    SessionManifest* sessionManifest;
+    BlockDropPolicy dropPolicy;
     Stats stats;
     uint32_t lastStatsTime;
     uint32_t frameCountSinceLastStats;
     
     void updateStats();
+    void notifyConsumer();
+    void sealBlock(DataBlock* block);
+    void enqueueSealedBlock(DataBlock* block);
+    void accountQueued(const DataBlock* block, bool added);
+    void dropBlock(DataBlock* block);
+    void freeBlock(DataBlock* block);
     DataBlock* createNewBlock();
 };
 
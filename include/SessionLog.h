@@ -0,0 +1,233 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FlashStorage.h"
+
+// 会话记录的日志结构存储格式：区域划分为固定大小的段（segment），按环形顺序使用，满后回收最旧的段。
+// 每个段只属于一个采集会话，布局为：
+//   段头（段序号、会话号、session_id） | 块记录（按写入顺序追加，按页对齐批量写入） | ... | 段摘要（最后一页）
+// 段摘要在段写满或会话结束时写入，包含时间范围、记录数和每个传感器第一条记录的偏移。
+// 启动时只读取每个段的段头和摘要建立内存索引（未写摘要的段扫描恢复一次），
+// 按时间范围查询时只读取时间范围重叠的段。
+// 不依赖Arduino，只由一个任务调用（非线程安全），可在主机上配合FileStorage测试
+class SessionLog {
+public:
+    static const uint8_t SENSOR_COUNT = 4;      // 与SENSOR_DATA_SENSOR_COUNT一致
+    static const size_t MAX_SEGMENTS = 64;
+
+    // 追加记录时由调用者提供的元数据
+    struct RecordInfo {
+        uint64_t minTimestamp;                  // 记录内帧的最小/最大时间戳(ms)
+        uint64_t maxTimestamp;
+        uint8_t sensorFrames[SENSOR_COUNT];     // 各传感器帧数
+    };
+
+    // 查询时返回给回调的记录
+    struct RecordView {
+        uint32_t sessionNumber;
+        uint32_t segmentSeq;
+        uint32_t offset;                        // 记录在段内的偏移
+        uint64_t minTimestamp;
+        uint64_t maxTimestamp;
+        uint8_t sensorMask;                     // bit0=传感器1
+        const uint8_t* payload;
+        size_t length;
+    };
+    typedef bool (*RecordCallback)(const RecordView& record, void* context);   // 返回false停止查询
+
+    struct QueryStats {
+        uint32_t segmentsTouched;               // 实际读取的段数
+        uint32_t segmentsSkipped;               // 按索引跳过的同会话段数
+        uint32_t recordsScanned;
+        uint32_t recordsMatched;
+        uint32_t corruptRecords;
+    };
+
+    // 内存索引中的段信息
+    struct SegmentInfo {
+        bool valid;
+        bool sealed;
+        bool sessionEnd;                        // 会话的最后一个段
+        uint32_t segmentSeq;                    // 全局递增，决定段的先后
+        uint32_t sessionNumber;                 // 本地会话号，全局递增
+        uint32_t startTime;                     // 会话开始时刻（调用者提供）
+        uint64_t minTimestamp;
+        uint64_t maxTimestamp;
+        uint32_t recordCount;
+        uint32_t dataEnd;                       // 记录区结束偏移
+        uint32_t sensorOffset[SENSOR_COUNT];    // 各传感器第一条记录的偏移，0表示段内没有该传感器
+        uint32_t sensorFrames[SENSOR_COUNT];
+    };
+
+    // 按会话汇总的信息（由段索引汇总，不读闪存）
+    struct SessionSummary {
+        uint32_t sessionNumber;
+        uint32_t startTime;
+        uint64_t minTimestamp;
+        uint64_t maxTimestamp;
+        uint32_t recordCount;
+        uint32_t frameCount;
+        uint16_t segmentCount;
+        bool complete;                          // 会话正常结束（最旧的段可能已被回收）
+    };
+
+    struct Stats {
+        uint32_t segmentCount;                  // 区域中的段数
+        uint32_t usedSegments;
+        uint32_t recordsWritten;
+        uint32_t recordsRejected;               // 未在会话中或记录过长
+        uint32_t bytesFlushed;
+        uint32_t flushes;
+        uint32_t segmentsSealed;
+        uint32_t segmentsReclaimed;             // 为新数据回收的旧段数
+        uint32_t segmentsRecovered;             // 启动时扫描恢复的未封闭段数
+        uint32_t sectorsErased;
+        uint32_t inlineErases;                  // 打开新段时才擦除的扇区数（预擦除未跟上）
+        uint32_t writeErrors;
+        uint32_t readErrors;
+    };
+
+    SessionLog();
+
+    // segmentSize须为扇区大小的整数倍；writeBuffer大小须为页大小的整数倍。加载索引，返回是否成功
+    bool begin(FlashStorage* storage, size_t segmentSize, uint8_t* writeBuffer, size_t bufferSize);
+    bool isReady() const { return storage != nullptr; }
+
+    // 开始新会话（上一个会话未结束时先结束），返回本地会话号，失败返回0
+    uint32_t beginSession(const char* sessionId, uint32_t startTime);
+    void endSession();
+    bool inSession() const { return sessionOpen; }
+    uint32_t getActiveSession() const { return sessionOpen ? sessionNumber : 0; }
+
+    // 追加一条块记录，不在会话中或记录过长时返回false
+    bool append(const void* data, size_t length, const RecordInfo& info);
+
+    // 把RAM缓冲区中的记录写入闪存（按页填充），用于定期落盘
+    bool flush();
+
+    // 会话进行中预擦除下一个段的一个扇区，返回是否执行了擦除
+    bool service();
+
+    // 分多次读取的查询游标：保存查询条件和读取位置，两次读取之间可以继续追加和回收段
+    struct Cursor {
+        uint32_t sessionNumber;
+        uint64_t fromTimestamp;
+        uint64_t toTimestamp;
+        uint8_t sensorId;
+        uint32_t segmentSeq;                    // 当前段的序号
+        uint32_t offset;                        // 当前段内下一条记录的偏移，0表示尚未进入该段
+        bool finished;
+        QueryStats stats;
+    };
+
+    // 按查询条件初始化游标，从会话最早的段开始
+    void openCursor(Cursor& cursor, uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp,
+                    uint8_t sensorId) const;
+
+    // 读取下一条匹配的记录，没有更多记录时返回false。存储支持映射时record.payload直接指向映射的闪存，
+    // 否则读入scratch；载荷只在下一次调用SessionLog之前有效。
+    // 读到会话仍在写入的段末尾时返回false但不结束游标，之后追加的记录还能继续读到
+    bool next(Cursor& cursor, RecordView& record, uint8_t* scratch, size_t scratchSize);
+
+    // 查询会话中与[fromTimestamp, toTimestamp]重叠的记录，sensorId为0表示全部传感器。
+    // 载荷的位置同next()，返回匹配的记录数
+    uint32_t query(uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp, uint8_t sensorId,
+                   uint8_t* scratch, size_t scratchSize, RecordCallback callback, void* context,
+                   QueryStats* queryStats = nullptr);
+
+    // 按会话号升序列出会话，返回数量
+    size_t listSessions(SessionSummary* output, size_t maxSessions) const;
+
+    // 按session_id查找会话（逐段读段头比较），同一session_id有多个会话时返回最新的，找不到返回0
+    uint32_t findSession(const char* sessionId);
+
+    // 读出会话的session_id（取自会话第一个仍保留的段头）
+    bool getSessionId(uint32_t sessionNumber, char* output, size_t outputSize);
+
+    const SegmentInfo& getSegment(size_t slot) const { return segments[slot]; }
+    size_t getSegmentCount() const { return segmentCount; }
+    size_t getSegmentSize() const { return segmentSize; }
+
+    Stats getStats() const;
+    void resetStats();
+
+private:
+    struct SegmentHeader {
+        uint32_t magic;
+        uint32_t segmentSeq;
+        uint32_t sessionNumber;
+        uint32_t startTime;
+        char sessionId[32];
+        uint32_t crc;
+    };
+
+    struct SegmentSummary {
+        uint32_t magic;
+        uint32_t segmentSeq;
+        uint64_t minTimestamp;
+        uint64_t maxTimestamp;
+        uint32_t recordCount;
+        uint32_t dataEnd;
+        uint32_t sensorOffset[SENSOR_COUNT];
+        uint32_t sensorFrames[SENSOR_COUNT];
+        uint8_t sessionEnd;
+        uint8_t reserved[3];
+        uint32_t crc;
+    };
+
+    struct RecordHeader {
+        uint16_t magic;
+        uint16_t length;
+        uint32_t crc;
+        uint64_t minTimestamp;
+        uint64_t maxTimestamp;
+        uint8_t sensorMask;
+        uint8_t reserved[7];
+    };
+
+    static const uint32_t SEGMENT_MAGIC = 0x48474553;   // "SEGH"
+    static const uint32_t SUMMARY_MAGIC = 0x53474553;   // "SEGS"
+    static const uint16_t RECORD_MAGIC = 0x5252;        // "RR"
+
+    FlashStorage* storage;
+    size_t segmentSize;
+    size_t segmentCount;
+    uint8_t* buffer;
+    size_t bufferSize;
+
+    SegmentInfo segments[MAX_SEGMENTS];
+    
+    // 当前会话：第一条记录到达时才打开段，没有数据的会话不占用段
+    bool sessionOpen;
+    uint32_t sessionNumber;
+    uint32_t sessionStartTime;
+    char sessionId[32];
+    
+    int16_t activeSlot;             // 正在写入的段，-1表示当前没有打开的段
+    uint16_t nextSlot;              // 下一个要使用的段
+    uint32_t nextSegmentSeq;
+    uint32_t nextSessionNumber;
+    uint32_t bufferStart;           // RAM缓冲区对应的段内偏移（页对齐）
+    size_t bufferFill;
+    uint16_t erasedSectors;         // nextSlot中已预擦除的扇区数
+
+    Stats stats;
+
+    size_t summaryOffset() const { return segmentSize - FlashStorage::PAGE_SIZE; }
+    size_t slotAddress(size_t slot) const { return slot * segmentSize; }
+    static size_t recordSize(size_t length);
+    static size_t firstRecordOffset();
+
+    void loadIndex();
+    bool loadSegment(size_t slot);
+    void recoverSegment(size_t slot);
+    bool openSegment();
+    void sealSegment(bool sessionEnd);
+    bool writeSummary(size_t slot);
+    bool eraseNextSector();
+    bool readRecordHeader(size_t slot, size_t offset, RecordHeader& header);
+};
+
+#endif // SESSION_LOG_H
@@ -0,0 +1,99 @@
+#ifndef SESSION_MANIFEST_H
+#define SESSION_MANIFEST_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 会话清单：采集期间增量统计每个传感器封装、上传和网关丢弃的帧数，帧的时间范围、块号范围，
+// 以及已上传帧（量化后的定点值，不是编码后的JSON载荷）的校验和，随upload_complete发送，
+// 服务器不必重新扫描整个会话即可核对，只对不一致的传感器或区间发起resend。
+// 采集侧（SensorData，core 0）、编码侧（编码任务）、begin()和snapshot()（CLI/网络任务）来自不同任务，
+// 每次调用在setLock()设置的锁内完成，每个块只加锁一次。不依赖Arduino，可在主机上单独测试
+class SessionManifest {
+public:
+    static const uint8_t SENSOR_COUNT = 4;      // 与SENSOR_DATA_SENSOR_COUNT一致
+    static const uint8_t CHANNEL_VALUES = 9;    // acc、gyro、angle各3个
+
+    struct SensorEntry {
+        // 采集侧
+        uint32_t capturedFrames;        // 封装进块的帧数
+        uint32_t queueDroppedFrames;    // 待发送队列满或停止采集后清理而丢弃的帧数
+        uint64_t firstTimestamp;        // 封装的帧中最早/最晚的rawTimestamp(ms)
+        uint64_t lastTimestamp;
+        // 编码侧
+        uint32_t uploadedFrames;        // 首次编码进数据消息的帧数（不含重传和resend补发）
+        uint32_t skippedFrames;         // 因降级、订阅过滤或暂存区满而未上传的帧数
+        uint32_t checksum;              // 已上传帧的frameChecksum之和(mod 2^32)，与消息顺序和合并方式无关
+    };
+
+    // 某一时刻的完整清单，snapshot()在锁内复制
+    struct Snapshot {
+        SensorEntry sensors[SENSOR_COUNT];
+        uint32_t firstBlockId;
+        uint32_t lastBlockId;
+        uint32_t blockCount;
+
+        // sensorId为1-4
+        const SensorEntry& getSensor(uint8_t sensorId) const { return sensors[sensorId - 1]; }
+
+        // 所有传感器的合计
+        uint32_t getCapturedFrames() const;
+        uint32_t getUploadedFrames() const;
+        uint32_t getDroppedFrames() const;      // 队列丢弃和未上传的帧之和
+        uint32_t getChecksum() const;
+    };
+
+    // 跨任务互斥，由持有者提供（固件中为FreeRTOS互斥锁）；未设置时不加锁（主机测试）
+    class Lock {
+    public:
+        virtual ~Lock() {}
+        virtual void lock() = 0;
+        virtual void unlock() = 0;
+    };
+
+    SessionManifest();
+    void setLock(Lock* lock) { mutex = lock; }
+
+    // 开始新会话：清零并开始统计封装的块；结束后仍统计剩余块的上传和丢弃，直到下一次begin
+    void begin();
+    void end();
+    bool isCapturing() const { return capturing; }
+
+    // 采集侧：封装完成的块（各传感器的帧数和rawTimestamp(ms)范围，没有帧的传感器忽略其时间戳），以及丢弃的块
+    void onBlockSealed(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT],
+                       const uint64_t firstTimestamps[SENSOR_COUNT], const uint64_t lastTimestamps[SENSOR_COUNT]);
+    void onBlockDropped(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT]);
+
+    // 编码侧：数据消息序列化成功后提交块中各传感器首次编码的帧数、校验和之和（frameChecksum）
+    // 和未编码的帧数；无法编码的块整块按未上传计入。
+    // 以下调用和onBlockDropped只统计本会话封装的块（块号在清单的块号范围内），会话开始前遗留的块不计入
+    void onBlockEncoded(uint32_t blockId, const uint8_t uploadedFrames[SENSOR_COUNT],
+                        const uint32_t checksums[SENSOR_COUNT], const uint8_t skippedFrames[SENSOR_COUNT]);
+    void onBlockSkipped(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT]);
+
+    // 帧校验和：对小端字节序的 {u8 sensor_id, u32 timestamp, i32 values[9]} 计算CRC-32，
+    // values为量化后的定点值（acc*1000，gyro和angle*100，四舍五入，与紧凑编码相同），未订阅的通道为0。
+    // 只取决于帧本身，与编码格式、消息合并和重传无关
+    static uint32_t frameChecksum(uint8_t sensorId, uint32_t timestamp, const int32_t values[CHANNEL_VALUES]);
+
+    Snapshot snapshot() const;
+
+private:
+    Snapshot state;
+    std::atomic<bool> capturing;
+    Lock* mutex;
+
+    // 在mutex内执行一次调用
+    class Guard {
+    public:
+        explicit Guard(Lock* lock) : lock(lock) { if (lock) lock->lock(); }
+        ~Guard() { if (lock) lock->unlock(); }
+    private:
+        Lock* lock;
+    };
+
+    void clear();
+    bool inSession(uint32_t blockId) const;
+};
+
+#endif // SESSION_MANIFEST_H
@@ -0,0 +1,137 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#include <Arduino.h>
+#include "SensorData.h"
+#include "SessionLog.h"
+
+// 会话记录器：把每个采集会话（start_collection到stop_collection）封装的所有块完整记录到闪存，
+// 之后可按会话和时间范围查询。
+// 采集路径只把块复制到空闲槽位后放入队列（不等待，无空闲槽位时计入丢弃），
+// 由记录任务写入SessionLog，闪存写入和擦除不会阻塞数据接收。
+class SessionRecorder {
+public:
+    struct Stats {
+        uint32_t offeredBlocks;      // 会话中提交的块数
+        uint32_t recordedBlocks;     // 已写入会话记录的块数
+        uint32_t droppedBlocks;      // 无空闲槽位而未记录的块数
+        uint32_t failedBlocks;       // 写入会话记录失败的块数
+        uint32_t peakQueuedItems;    // 队列深度峰值
+    };
+
+    SessionRecorder();
+    ~SessionRecorder();
+
+    // storage为spiffs分区中划给会话记录的区域，加载段索引
+    bool initialize(FlashStorage* storage);
+    bool isReady() const { return ready; }
+
+    // 开关记录（关闭后新会话不再记录，进行中的会话照常结束）
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+
+    // 网络任务调用：开始/结束会话，在记录任务中按顺序生效
+    void startSession(const char* sessionId);
+    void stopSession();
+    bool isRecording() const { return recording; }
+
+    // 采集路径调用（持有SensorData的mutex）：块封装完成时复制一份，不等待
+    void offer(const DataBlock* block);
+
+    // 记录任务：处理队列中的事件和块，空闲时定期落盘并预擦除下一段
+    void process();
+
+    // 列出会话，返回数量
+    size_t listSessions(SessionLog::SessionSummary* output, size_t maxSessions);
+    bool getSessionId(uint32_t sessionNumber, char* output, size_t outputSize);
+
+    // 按时间范围（rawTimestamp，ms）查询会话中的块，sensorId为0表示全部传感器。
+    // 回调收到的是读回的块，返回false停止查询；返回匹配的块数。
+    // 按游标逐条读取，每条记录单独持锁，回调在锁外执行，查询期间记录任务照常写入
+    typedef bool (*BlockCallback)(const DataBlock& block, void* context);
+    uint32_t query(uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp, uint8_t sensorId,
+                   BlockCallback callback, void* context, SessionLog::QueryStats* queryStats = nullptr);
+
+    // 按服务器的session_id查找本地会话号（同一session_id取最新的会话），找不到返回0
+    uint32_t findSession(const char* sessionId);
+
+    // 补发：从会话记录中按范围读回块，由编码任务在没有实时块和暂存块时逐块读取
+    struct ResendRange {
+        uint32_t sessionNumber;
+        uint8_t sensorId;           // 0表示全部传感器，否则块中只保留该传感器的帧
+        uint64_t fromTimestamp;     // rawTimestamp(ms)，只保留范围内的帧
+        uint64_t toTimestamp;
+        uint32_t fromBlockId;       // 块号范围（同一会话内块号递增）
+        uint32_t toBlockId;
+    };
+    enum class ResendRead : uint8_t {
+        BLOCK,      // 已读出一个块
+        PENDING,    // 本轮没有读出块（记录任务占用或扫描了过多不匹配的记录），稍后再读
+        DONE        // 范围内的块已读完或补发已取消
+    };
+
+    // 开始补发（替换进行中的补发），会话不存在时返回false。
+    // 会话仍在记录时范围截止到当前已记录的数据
+    bool startResend(const ResendRange& range);
+    void cancelResend();
+    bool isResending() const { return resendActive; }
+
+    // 编码任务调用，不等待记录任务：读出下一个匹配的块到block
+    ResendRead readResend(DataBlock* block);
+
+    // 补发进度：读出的块数和游标的扫描统计
+    uint32_t getResendBlocks() const { return resendBlocks; }
+    SessionLog::QueryStats getResendStats() const { return resendCursor.stats; }
+
+    Stats getStats() const { return stats; }
+    SessionLog::Stats getLogStats();
+    uint32_t getActiveSession();
+    uint32_t getQueuedItems() const;
+    void resetStats();
+
+private:
+    enum ItemKind : uint8_t {
+        ITEM_BLOCK,
+        ITEM_START,
+        ITEM_STOP
+    };
+
+    // 队列槽位：块序列化后的记录及其索引信息，或会话开始/结束事件
+    struct Item {
+        ItemKind kind;
+        uint16_t length;
+        SessionLog::RecordInfo info;
+        char sessionId[32];
+        uint32_t startTime;
+        uint8_t data[sizeof(DataBlock)];
+    };
+
+    SessionLog sessionLog;
+    SemaphoreHandle_t logMutex;     // 记录任务与CLI查询共用SessionLog
+    QueueHandle_t freeItemQueue;    // 空闲槽位索引
+    QueueHandle_t readyItemQueue;   // 待写入的槽位索引（保持提交顺序）
+    Item* items;
+    uint8_t* writeBuffer;
+    uint8_t* queryBuffer;           // 查询时读出的记录
+    DataBlock* queryBlock;
+
+    bool ready;
+    volatile bool enabled;
+    volatile bool recording;
+    uint32_t lastFlushTime;
+    Stats stats;
+
+    // 补发状态，游标只在持有logMutex时访问
+    SessionLog::Cursor resendCursor;
+    ResendRange resendRange;
+    volatile bool resendActive;
+    volatile uint32_t resendBlocks;
+
+    // 取空闲槽位，timeout为0时不等待
+    int takeItem(TickType_t timeout);
+    void handleItem(Item& item);
+    // 按补发范围筛选块中的帧，返回剩余帧数
+    uint8_t filterResendFrames(DataBlock* block) const;
+};
+
+#endif // SESSION_RECORDER_H
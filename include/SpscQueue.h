@@ -0,0 +1,64 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// 单生产者、单消费者的定长无锁队列，T为可平凡复制的元素，N为2的幂。
+// 生产者只写head、消费者只写tail，各自用release发布、用acquire读取对方的位置，两边都不等待；
+// 队列满时push返回false并计入溢出数，元素不覆盖。
+// 生产者和消费者各自必须唯一（由调用者保证，例如消费者的操作都在同一把锁内）。不依赖Arduino，可在主机上单独测试
+template <typename T, uint32_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0), overflows(0), items() {}
+
+    // 生产者调用
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用
+    bool pop(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用：丢弃当前所有元素，返回丢弃的个数
+    uint32_t clear() {
+        uint32_t h = head.load(std::memory_order_acquire);
+        uint32_t dropped = h - tail.load(std::memory_order_relaxed);
+        tail.store(h, std::memory_order_release);
+        return dropped;
+    }
+
+    // 任意任务调用，只作统计：先读tail再读head，结果不会为负
+    uint32_t size() const {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_acquire) - t;
+    }
+    uint32_t getOverflows() const { return overflows.load(std::memory_order_relaxed); }
+    static uint32_t capacity() { return N; }
+
+private:
+    std::atomic<uint32_t> head;         // 下一个写入位置，只由生产者写
+    std::atomic<uint32_t> tail;         // 下一个读取位置，只由消费者写
+    std::atomic<uint32_t> overflows;    // 队列满而丢弃的元素数
+    T items[N];
+};
+
+#endif // SPSC_QUEUE_H
@@ -8,6 +8,8 @@
 #include "TimeSync.h"
 #include "BufferPool.h"
 #include "BluetoothConfig.h"
+#include "FlashStorage.h"
+#include "SessionRecorder.h"
 
 // 任务管理器类
 class TaskManager {
@@ -37,9 +39,17 @@ private:
     SensorData* sensorData;
     BluetoothConfig* bluetoothConfig;
     
+    // spiffs数据分区（直接读写）及划给闪存暂存区和会话记录的部分
+    PartitionStorage* dataPartition;
+    FlashRegion* spoolRegion;
+    FlashRegion* recorderRegion;
+    SessionRecorder* sessionRecorder;
+    
     // 任务句柄
     TaskHandle_t uartTaskHandle;
     TaskHandle_t networkTaskHandle;
+    TaskHandle_t encoderTaskHandle;
+    TaskHandle_t recorderTaskHandle;
     TaskHandle_t cliTaskHandle;
     TaskHandle_t monitorTaskHandle;
     TaskHandle_t timeSyncTaskHandle;
@@ -48,6 +58,8 @@ private:
     // 任务函数
     static void uartTask(void* parameter);
     static void networkTask(void* parameter);
+    static void encoderTask(void* parameter);
+    static void recorderTask(void* parameter);
     static void cliTask(void* parameter);
     static void monitorTask(void* parameter);
     static void timeSyncTask(void* parameter);
@@ -74,6 +86,8 @@ private:
     // 创建任务
     bool createUartTask();
     bool createNetworkTask();
+    bool createEncoderTask();
+    bool createRecorderTask();
     bool createCliTask();
     bool createMonitorTask();
     bool createTimeSyncTask();
@@ -82,6 +96,8 @@ private:
     // 任务循环
     void uartTaskLoop();
     void networkTaskLoop();
+    void encoderTaskLoop();
+    void recorderTaskLoop();
     void cliTaskLoop();
     void monitorTaskLoop();
     void timeSyncTaskLoop();
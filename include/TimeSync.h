@@ -6,9 +6,18 @@
 #include <time.h>
 #include <esp_sntp.h>
 #include "Config.h"
+#include "ClockFit.h"
+#include "ClockTracker.h"
+#include "ClockLatch.h"
+#include "SpscQueue.h"
+#include "NtpClock.h"
+#include "TimestampFormatter.h"
 
 // 滑动窗口大小
 #define SLIDING_WINDOW_SIZE 50
+// 每个传感器待加入校准窗口的时间对队列长度（2的幂）：100Hz时后台任务每100ms取出约10个，
+// 取锁失败时下一轮再取，64个可容纳约600ms的积压
+#define TIME_PAIR_QUEUE_SIZE 64
 // 传感器数量（与Config::SENSOR_COUNT保持一致）
 #define TIME_SYNC_SENSOR_COUNT 4
 
@@ -42,23 +51,24 @@ public:
     // 开始自动校准（三个传感器各三轮取平均）
     void startAutoCalibration();
     
-    // 添加传感器时间戳对（S, E）到滑动窗口（快速操作）
+    // 添加传感器时间戳对（S, E）（快速操作，不加锁）：校准中放入该传感器的时间对队列，由后台任务加入滑动窗口
     void addTimePair(uint8_t sensorId, uint32_t sensorTimeMs, int64_t espTimeUs);
     
-    // 计算时间戳：T = a*S + b + N（快速操作）
-    uint64_t calculateTimestamp(uint8_t sensorId, uint32_t sensorTimeMs);
+    // 计算时间戳：T = a*S + b + N（快速操作，不加锁），校准完成后a、b由时钟跟踪器持续修正，N按ESP32时间(us)逐渐修正
+    // ntpSynced非空时写入结果是否为UTC时间：传感器未就绪时返回原始时间，第一次NTP同步前N为0、T是ESP32开机后的时间
+    uint64_t calculateTimestamp(uint8_t sensorId, uint32_t sensorTimeMs, bool* ntpSynced = nullptr);
     
     // 后台拟合计算（在后台任务中调用）
     void performBackgroundFitting();
     
-    // 格式化时间戳为时/分/秒/毫秒格式
+    // 格式化时间戳为时/分/秒/毫秒格式（HHMMSSmmm，同一天内只做整数运算，只由UART任务调用）
     uint32_t formatTimestamp(uint64_t timestampMs);
     
-    // 获取NTP时间差N（毫秒）
+    // 获取当前的NTP时间差N（毫秒）
     int64_t getNtpOffset() const;
     
     // 获取线性回归参数a和b（指定传感器）
-    bool getLinearParams(uint8_t sensorId, float& a, float& b) const;
+    bool getLinearParams(uint8_t sensorId, double& a, double& b) const;
     
     // 检查时间同步是否就绪（指定传感器）
     bool isTimeSyncReady(uint8_t sensorId) const;
@@ -69,7 +79,7 @@ public:
     // 检查时间同步是否激活
     bool isTimeSyncActive() const;
     
-    // 检查NTP是否已初始化完成
+    // 检查NTP是否已初始化完成（收到第一次NTP同步）
     bool isNtpInitialized() const;
     
     // 检查指定传感器是否正在校准中
@@ -85,9 +95,27 @@ public:
     struct Stats {
         uint32_t totalPairs;
         uint32_t validPairs;
-        int64_t ntpOffset;
-        float linearParamA[TIME_SYNC_SENSOR_COUNT];
-        float linearParamB[TIME_SYNC_SENSOR_COUNT];
+        bool ntpValid;
+        int64_t ntpOffsetUs;            // 当前的NTP时间差N(us)
+        float ntpDriftPpm;              // ESP32时钟相对UTC的漂移(ppm)
+        int64_t ntpSlewRemainingUs;     // 尚未修正完的偏移(us)
+        NtpClock::Stats ntpStats;
+        uint8_t ntpHistoryCount;
+        NtpClock::Measurement ntpHistory[NtpClock::HISTORY_SIZE];   // 最近的NTP测量，0为最新
+        double linearParamA[TIME_SYNC_SENSOR_COUNT];
+        double linearParamB[TIME_SYNC_SENSOR_COUNT];
+        float residualRms[TIME_SYNC_SENSOR_COUNT];   // 最近一次拟合的残差均方根(ms)
+        float residualMax[TIME_SYNC_SENSOR_COUNT];   // 最近一次拟合的残差绝对值最大值(ms)
+        float fittedSkewPpm[TIME_SYNC_SENSOR_COUNT]; // 最近一次拟合的斜率偏差(ppm)，斜率不可信时为0
+        uint16_t fitRejected[TIME_SYNC_SENSOR_COUNT]; // 最近一次下包络拟合剔除的桶最小值个数
+        bool tracking[TIME_SYNC_SENSOR_COUNT];       // 校准完成后持续跟踪漂移
+        float trackSkewPpm[TIME_SYNC_SENSOR_COUNT];  // 跟踪的斜率偏差(ppm)
+        ClockTracker::Stats trackStats[TIME_SYNC_SENSOR_COUNT];
+        uint32_t syncedTimestamps[TIME_SYNC_SENSOR_COUNT];   // 按同步参数计算的时间戳数
+        uint32_t unsyncedTimestamps[TIME_SYNC_SENSOR_COUNT]; // 未就绪而返回原始时间的时间戳数，就绪后不再增加
+        uint32_t paramReadRetries;      // 读取参数时遇到并发发布而重读的次数
+        uint32_t pairQueueOverflows;    // 时间对队列满而未加入校准窗口的时间对数（所有传感器）
+        uint32_t pairQueuePeak;         // 后台任务取出前队列中最多的时间对数（所有传感器）
         bool syncReady[TIME_SYNC_SENSOR_COUNT];
         uint32_t lastUpdateTime;
         uint32_t windowSize;
@@ -103,7 +131,7 @@ private:
         bool valid;             // 数据有效性
     };
     
-    // 为每个传感器维护独立的滑动窗口
+    // 为每个传感器维护独立的滑动窗口，只在持有mutex时读写
     TimePair slidingWindows[TIME_SYNC_SENSOR_COUNT][SLIDING_WINDOW_SIZE];
     uint8_t windowIndex[TIME_SYNC_SENSOR_COUNT];
     uint8_t windowCount[TIME_SYNC_SENSOR_COUNT];
@@ -118,32 +146,82 @@ private:
     bool autoCalibrationActive;  // 是否正在进行自动校准
     uint8_t autoCalibrationRounds[TIME_SYNC_SENSOR_COUNT];  // 每个传感器已完成的校准轮数
     
-    // NTP相关
-    int64_t ntpOffsetMs;        // NTP时间差N（毫秒）
-    bool ntpInitialized;
+    // NTP相关：SNTP每NTP_SYNC_INTERVAL_MS同步一次，回调（lwIP任务）只把测量写入ntpSamples，
+    // 后台任务取出后更新ntpClock并把偏移模型发布到publishedNtp，calculateTimestamp读取快照，不加锁
+    struct NtpSample {
+        int64_t espUs;          // 回调时的esp_timer_get_time()
+        int64_t utcUs;          // SNTP设置的UTC时间
+    };
+    static ClockLatch<NtpSample> ntpSamples;
+    uint32_t ntpSampleVersion;  // 已处理的测量版本
+    NtpClock ntpClock;
+    ClockLatch<NtpClock::Model> publishedNtp;
     
     // 为每个传感器维护独立的线性回归参数
-    float paramA[TIME_SYNC_SENSOR_COUNT]; // 斜率参数a
-    float paramB[TIME_SYNC_SENSOR_COUNT]; // 截距参数b
+    double paramA[TIME_SYNC_SENSOR_COUNT]; // 斜率参数a
+    double paramB[TIME_SYNC_SENSOR_COUNT]; // 截距参数b(ms)，量级与运行时间相当，float精度不够
     bool paramsValid[TIME_SYNC_SENSOR_COUNT];
+    ClockFit::Result lastFit[TIME_SYNC_SENSOR_COUNT];    // 最近一次拟合结果
+    
+    // 校准完成后每个传感器的时钟跟踪器，只由addTimePair（UART任务）更新，
+    // 其他任务通过trackerCommand请求开始/停止；每次更新后把模型发布到publishedClocks，
+    // calculateTimestamp和统计读取发布的快照，不加锁、不回退到原始时间
+    enum TrackerCommand : uint8_t {
+        TRACKER_NONE = 0,
+        TRACKER_START,
+        TRACKER_STOP
+    };
+    ClockTracker trackers[TIME_SYNC_SENSOR_COUNT];
+    std::atomic<uint8_t> trackerCommand[TIME_SYNC_SENSOR_COUNT];
+    double commandSlope[TIME_SYNC_SENSOR_COUNT];     // TRACKER_START的初始参数，先写参数再写命令
+    double commandIntercept[TIME_SYNC_SENSOR_COUNT];
+    struct SensorClock {
+        bool ready;                     // 时间同步就绪，model可用
+        uint32_t epoch;                 // 发布时的clockEpoch，与当前值不同时视为未就绪
+        ClockTracker::Model model;
+        ClockTracker::Stats stats;
+        float skewPpm;
+    };
+    ClockLatch<SensorClock> publishedClocks[TIME_SYNC_SENSOR_COUNT];
+    // reset()递增clockEpoch使已发布的快照立即失效：发布者只能是UART任务（latch单写者），
+    // reset()不能直接改写latch。UART任务在执行请求前读取epoch并随快照发布（publishEpoch只由UART任务使用）
+    std::atomic<uint32_t> clockEpoch[TIME_SYNC_SENSOR_COUNT];
+    uint32_t publishEpoch[TIME_SYNC_SENSOR_COUNT];
+    
+    // HHMMSSmmm格式化，缓存本地日零点，只由UART任务使用
+    TimestampFormatter formatter;
+    
+    // 时间戳计数，只由UART任务写入
+    uint32_t syncedTimestamps[TIME_SYNC_SENSOR_COUNT];
+    uint32_t unsyncedTimestamps[TIME_SYNC_SENSOR_COUNT];
+    
+    // 校准用的时间对：addTimePair（UART任务）是队列唯一的生产者，不取锁；持有mutex的任务是唯一的消费者，
+    // 后台任务取出后加入滑动窗口，清空窗口时同时丢弃队列中的旧时间对
+    struct QueuedPair {
+        uint32_t sensorTimeMs;
+        int64_t espTimeUs;
+    };
+    SpscQueue<QueuedPair, TIME_PAIR_QUEUE_SIZE> pairQueues[TIME_SYNC_SENSOR_COUNT];
+    uint32_t pairQueuePeak;         // 只在持有mutex时写
     
     // 每个传感器的计算次数和平均值
     uint8_t calcCount[TIME_SYNC_SENSOR_COUNT];           // 每个传感器已计算次数
-    float paramASum[TIME_SYNC_SENSOR_COUNT];             // 参数A的累加和
-    float paramBSum[TIME_SYNC_SENSOR_COUNT];             // 参数B的累加和
+    double paramASum[TIME_SYNC_SENSOR_COUNT];            // 参数A的累加和
+    double paramBSum[TIME_SYNC_SENSOR_COUNT];            // 参数B的累加和
     bool calcCompleted[TIME_SYNC_SENSOR_COUNT];          // 每个传感器是否完成计算
     uint32_t lastCalcTime[TIME_SYNC_SENSOR_COUNT];       // 每个传感器上次计算时间
     
     // 互斥锁
     SemaphoreHandle_t mutex;
     
-    // NTP时间同步
+    // NTP时间同步：启动SNTP周期同步，不等待结果
     bool syncNtpTime();
     static void ntpCallback(struct timeval* tv);
-    static bool ntpCallbackCalled;
+    // 后台任务：处理新的NTP测量（持有mutex时调用）
+    void processNtpSample();
     
-    // 最小二乘法计算线性回归参数（指定传感器）
-    bool calculateLinearRegression(uint8_t sensorId, float& a, float& b);
+    // 最小二乘法计算线性回归参数（指定传感器），斜率偏差超过TIME_SYNC_MAX_SKEW_PPM时只拟合截距
+    bool calculateLinearRegression(uint8_t sensorId, ClockFit::Result& fit);
     
     // 验证时间对的有效性
     bool isValidTimePair(uint8_t sensorId, uint32_t sensorTimeMs, int64_t espTimeUs);
@@ -151,8 +229,23 @@ private:
     // 更新滑动窗口（指定传感器）
     void updateSlidingWindow(uint8_t sensorId, uint32_t sensorTimeMs, int64_t espTimeUs);
     
+    // 把时间对队列中的时间对加入滑动窗口，窗口满时停止，剩余的留到窗口清空后（持有mutex时调用）
+    void drainPairQueue(uint8_t sensorIndex);
+    
+    // 清空滑动窗口和时间对队列（持有mutex时调用）
+    void clearWindow(uint8_t sensorIndex);
+    
     // 验证传感器ID有效性
     bool isValidSensorId(uint8_t sensorId) const;
+    
+    // 请求UART任务开始/停止跟踪（任意任务调用）
+    void requestTracker(uint8_t sensorIndex, TrackerCommand command, double slope = 1.0, double intercept = 0.0);
+    // UART任务：执行待处理的请求
+    void applyTrackerCommand(uint8_t sensorIndex);
+    // UART任务：发布跟踪器的模型和统计
+    void publishClock(uint8_t sensorIndex);
+    // 任意任务：读取发布的快照，reset()之前发布的快照返回未就绪
+    void readClock(uint8_t sensorIndex, SensorClock& clock) const;
 };
 
 #endif // TIME_SYNC_H
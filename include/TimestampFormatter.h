@@ -0,0 +1,30 @@
+#ifndef TIMESTAMP_FORMATTER_H
+#define TIMESTAMP_FORMATTER_H
+
+#include <stdint.h>
+
+// 时间戳格式化：把毫秒时间戳转换为本地时间的十进制数HHMMSSmmm。
+// 缓存当前本地日的零点（含UTC偏移），同一天内只做整数运算，时间戳离开缓存的一天时才调用localtime_r刷新。
+// 假设一天内UTC偏移不变（当前时区CST-8没有夏令时）。
+// 缓存不加锁，只应由一个任务调用（UART任务）。不依赖Arduino，可在主机上单独测试
+class TimestampFormatter {
+public:
+    TimestampFormatter();
+
+    // 返回HHMMSSmmm，localtime_r失败时返回0
+    uint32_t format(uint64_t timestampMs);
+
+    // 丢弃缓存（时区变化后调用）
+    void invalidate();
+
+    uint32_t getRefreshes() const { return refreshes; }
+
+private:
+    uint64_t dayStartMs;    // 缓存的本地日零点（毫秒时间戳）
+    uint64_t dayEndMs;      // 下一个本地日零点，dayStartMs == dayEndMs表示缓存无效
+    uint32_t refreshes;
+
+    bool refresh(uint64_t timestampMs);
+};
+
+#endif // TIMESTAMP_FORMATTER_H
@@ -0,0 +1,92 @@
+#ifndef UDP_DATAGRAM_H
+#define UDP_DATAGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// UDP数据报头（小端序，16字节），每个数据报携带一条已编码数据消息的一个分片
+struct __attribute__((packed)) UdpDatagramHeader {
+    uint8_t magic[2];           // 'G' 'W'
+    uint8_t version;            // 协议版本
+    uint8_t fragmentIndex;      // 分片序号（从0开始）
+    uint8_t fragmentCount;      // 本消息的分片总数
+    uint8_t reserved;
+    uint16_t messageLength;     // 完整消息的字节数
+    uint32_t seq;               // 与WebSocket数据消息相同的序列号
+    uint32_t sendTime;          // 发送时刻millis()，接收端用于估计单向延迟抖动
+};
+
+// UDP实时流的数据报封装：消息按(datagramSize - 16)字节切分，第i片的载荷位于消息的i × (datagramSize - 16)处。
+// 不依赖Arduino，可在主机上单独测试
+class UdpDatagram {
+public:
+    static const uint8_t PROTOCOL_VERSION = 1;
+    static const size_t HEADER_SIZE = sizeof(UdpDatagramHeader);
+
+    // 消息的分片数，超过255片或消息超过64KB时返回0
+    static size_t fragmentCount(size_t length, size_t datagramSize);
+
+    // 把第index个分片（头+载荷）写入output（至少datagramSize字节），返回数据报长度
+    static size_t buildFragment(uint8_t* output, size_t datagramSize, uint32_t seq, uint32_t sendTime,
+                                const char* data, size_t length, uint8_t index);
+
+    // 校验数据报头（magic、版本、分片序号和长度），有效时复制头并返回载荷指针，否则返回nullptr
+    static const uint8_t* parse(const uint8_t* datagram, size_t length, size_t datagramSize, UdpDatagramHeader& header);
+};
+
+// 接收端参考实现：按seq重组分片，容忍丢失、乱序和重复。
+// 已交付过更大seq时迟到的旧消息直接丢弃（实时显示只关心最新数据）；重组中的消息超时仍不完整即丢弃，不请求重传。
+// 同时重组的消息数有上限，超出时丢弃最旧的未完成消息。时间由调用者传入（ms）。
+// 不依赖Arduino，可在主机上单独测试
+class UdpReassembler {
+public:
+    static const uint8_t SLOT_COUNT = 4;
+
+    struct Stats {
+        uint32_t datagrams;         // 收到的数据报
+        uint32_t delivered;         // 交付的完整消息
+        uint32_t stale;             // 早于已交付消息而丢弃的数据报
+        uint32_t duplicates;        // 重复的分片
+        uint32_t malformed;         // 头无效的数据报
+        uint32_t incomplete;        // 超时或被挤出而放弃的未完成消息
+        uint32_t skipped;           // 交付时跳过的seq数（丢失或未完成的消息）
+    };
+
+    // datagramSize须与发送端相同；maxMessage为可重组的最大消息字节数
+    UdpReassembler(size_t datagramSize, size_t maxMessage, uint32_t timeoutMs = 200);
+    ~UdpReassembler();
+
+    // 处理一个数据报。消息收齐时返回消息内容（在下一次调用前有效），并通过seq和messageLength返回；否则返回nullptr
+    const char* receive(const uint8_t* datagram, size_t length, uint32_t now, uint32_t& seq, size_t& messageLength);
+
+    // 丢弃超时的未完成消息（receive时也会检查）
+    void expire(uint32_t now);
+
+    bool hasDelivered() const { return delivered; }
+    uint32_t getLastSeq() const { return lastSeq; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Slot {
+        bool active;
+        uint32_t seq;
+        uint32_t firstTime;         // 收到第一个分片的时刻
+        uint16_t messageLength;
+        uint8_t fragmentCount;
+        uint8_t receivedCount;
+        uint8_t received[32];       // 分片位图（最多255片）
+        char* buffer;
+    };
+
+    size_t datagramSize;
+    size_t maxMessage;
+    uint32_t timeoutMs;
+    Slot slots[SLOT_COUNT];
+    bool delivered;
+    uint32_t lastSeq;           // 最近交付的seq
+    Stats stats;
+
+    Slot* findSlot(const UdpDatagramHeader& header, uint32_t now);
+};
+
+#endif // UDP_DATAGRAM_H
@@ -0,0 +1,58 @@
+#ifndef UDP_STREAMER_H
+#define UDP_STREAMER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "UdpDatagram.h"
+
+// UDP实时流：把编码任务产出的数据消息以数据报发送到配置的主机，用于实时显示。
+// 只发送新消息、不重传，丢失或乱序由接收端按seq丢弃（参考实现见UdpReassembler）；WebSocket通道仍负责控制和可靠归档
+class UdpStreamer {
+public:
+    struct Stats {
+        bool enabled;
+        bool targetResolved;
+        uint32_t messagesSent;      // 全部分片都已发出的消息数
+        uint32_t datagramsSent;
+        uint32_t bytesSent;         // 含数据报头
+        uint32_t sendErrors;        // 发送失败（协议栈缓冲区不足等）而放弃的消息数
+        uint32_t oversizeMessages;  // 超过分片上限而未发送的消息数
+        uint32_t resolveFailures;   // 目标主机名解析失败次数
+    };
+
+    UdpStreamer();
+
+    // 设置目标主机（IP或主机名）和端口
+    void setTarget(const char* host, uint16_t port);
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+
+    // 网络任务周期调用：WiFi连接时解析目标地址（主机名解析会阻塞，不在编码任务中进行）
+    void maintain(bool wifiConnected);
+
+    // 目标已解析且已启用，可以发送
+    bool isReady() const { return enabled && targetResolved; }
+
+    // 编码任务调用：把一条消息按分片发送，返回是否全部发出
+    bool sendMessage(uint32_t seq, const char* data, size_t length);
+
+    Stats getStats() const;
+    void resetStats();
+    const char* getTargetHost() const { return targetHost; }
+    uint16_t getTargetPort() const { return targetPort; }
+
+private:
+    WiFiUDP udp;
+    char targetHost[64];
+    uint16_t targetPort;
+    IPAddress targetIp;
+    volatile bool enabled;
+    volatile bool targetResolved;   // 先写targetIp再置位，编码任务只在置位后读取targetIp
+    uint32_t lastResolveAttempt;
+    uint8_t datagramBuffer[1500];   // 数据报头+分片载荷
+    Stats stats;
+};
+
+#endif // UDP_STREAMER_H
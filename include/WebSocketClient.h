@@ -4,11 +4,37 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WebSocketsClient.h>
+#include <ArduinoJson.h>
 #include "SensorData.h"
+#include "LatencyHistogram.h"
+#include "RateController.h"
+#include "UdpStreamer.h"
+#include "LocalStreamServer.h"
+#include "PowerScheduler.h"
+#include "BlockSpool.h"
+#include "CatchupScheduler.h"
+#include "SessionManifest.h"
+#include "RetransmitWindow.h"
+#include "LoopPacer.h"
+#include "ReconnectBackoff.h"
+#include "CommandTable.h"
+#include "ClockLatch.h"
+#include <atomic>
 
 // 前向声明
-class BufferPool;
 class CommandHandler;
+class SessionRecorder;
+class TimeSync;
+
+// WebSocketsClient扩展：提供分片发送和套接字可写检测，用于非阻塞发送数据消息
+class GatewayWebSocket : public WebSocketsClient {
+public:
+    // 发送消息的一个分片（首片为text帧，后续为continuation帧，末片置FIN）
+    bool sendFragment(const uint8_t* payload, size_t length, bool first, bool fin);
+    
+    // 检查TCP发送缓冲区是否可写（不阻塞）
+    bool isWritable();
+};
 
 // WebSocket客户端类，处理与服务器的通信
 class WebSocketClient {
@@ -25,11 +51,8 @@ public:
     // 断开连接
     void disconnect();
     
-    // 发送数据块
-    bool sendDataBlock(DataBlock* block);
-    
-    // 处理服务器命令
-    void handleServerCommand(const String& command);
+    // 处理服务器命令：payload须可写，命令在原缓冲区上就地解析（字符串字段直接指向payload）
+    void handleServerCommand(char* payload, size_t length);
     
     // 获取连接状态
     bool isConnected() const;
@@ -44,12 +67,127 @@ public:
         float avgSendRate;
         uint32_t lastHeartbeat;
         bool serverConnected;
+        // 重传窗口统计
+        uint32_t windowOccupancy;    // 当前未确认的块数
+        uint32_t retransmissions;    // 重传次数
+        uint32_t ackedBlocks;        // 已被服务器确认的块数
+        uint32_t lastAckedSeq;       // 最近一次累计确认的序列号
+        uint32_t unsequencedAcks;    // 不含ack_seq的响应数（忽略，不确认任何块）
+        float avgAckRtt;             // 平均ACK往返时间(ms)
+        uint32_t maxAckRtt;          // 最大ACK往返时间(ms)
+        // 非阻塞发送统计
+        uint32_t socketBytesQueued;  // 已写入TCP协议栈的累计字节数
+        uint32_t pendingBytes;       // 网关侧尚未写入套接字的字节数（当前消息剩余+控制通道排队消息）
+        uint32_t sendStalls;         // 因套接字不可写而暂停发送的次数
+        // 控制消息通道统计
+        uint32_t controlQueued;      // 进入控制通道的消息数
+        uint32_t controlSent;        // 已写入套接字的控制消息数
+        uint32_t controlDropped;     // 因通道满、消息过长或断线而丢弃的控制消息数
+        uint8_t controlLaneDepth;    // 当前排队的控制消息数
+        uint8_t controlLanePeak;     // 控制通道排队峰值
+        float avgControlLatency;     // 控制消息从入队到写入套接字的平均延迟(ms)
+        uint32_t maxControlLatency;  // 控制消息最大排队延迟(ms)
+        // 链路状态与重连统计
+        bool wifiConnected;
+        uint32_t wifiDisconnects;        // WiFi断开次数
+        uint32_t wifiReconnectAttempts;  // WiFi重连尝试次数
+        uint32_t lastWifiReconnectMs;    // 最近一次WiFi断开到恢复的耗时(ms)
+        uint32_t maxWifiReconnectMs;
+        uint32_t serverDisconnects;      // WebSocket断开次数
+        uint32_t lastServerReconnectMs;  // 最近一次WebSocket断开到恢复的耗时(ms)
+        uint32_t maxServerReconnectMs;
+        // WebSocket ping/pong往返统计（分布见getLatencyStats）
+        uint32_t pingsSent;
+        uint32_t pongsReceived;
+        uint32_t pingTimeouts;       // 下一次ping前仍未收到pong的次数
+        uint32_t lastPingRtt;        // 最近一次ping往返时间(ms)
+        // 上传速率控制
+        uint8_t uploadLevel;         // 当前降级等级（UploadLevel）
+        uint32_t levelChanges;       // 等级变化次数
+        float capacityEstimate;      // 估计的上行容量(bytes/s)
+        float demandEstimate;        // 当前等级下的数据产生速率(bytes/s)
+        uint32_t coalescedMessages;  // 包含多个块的数据消息数
+        uint32_t rateOmittedFrames;  // 因抽帧或优先丢弃未上传的帧数
+        uint32_t subscriptionOmittedFrames;  // 因服务器订阅设置未上传的帧数
+        // 编码阶段（编码任务）
+        uint32_t encodedMessages;    // 编码任务产出的数据消息数
+        uint32_t encodeFailures;     // 编码失败的消息数
+        uint32_t encoderStalls;      // 编码任务因无空闲输出缓冲区而等待的次数
+        uint8_t encodedReady;        // 已编码、等待发送的消息数
+        float encoderUtilization;    // 编码任务忙碌时间占比(%)
+        float transmitUtilization;   // 网络任务写套接字（含重传编码）的时间占比(%)
+        uint32_t parkedMessages;     // 上游断开期间因重传窗口满而暂留、等待上传的消息数
+        // 省电上传
+        uint8_t powerPhase;          // PowerScheduler::Phase
+        uint16_t heldBlocks;         // 当前暂存等待集中上传的块数
+        uint32_t powerBursts;        // 集中上传次数
+        float radioDutyCycle;        // 无线电常开时间占比(0-1)
+        float radioOnMsPerMinute;    // 估计的每分钟无线电常开时间(ms)
+        // 闪存暂存
+        uint32_t spooledBlocks;      // 写入闪存暂存区的块数
+        uint32_t unspooledBlocks;    // 从暂存区读回上传的块数
+        uint32_t spoolDroppedBlocks; // 暂存区满或写入失败而丢弃的块数
+        uint32_t spoolPendingBlocks; // 暂存区中待上传的块数
+        float spoolFill;             // 暂存区占用比例(%)
+        float spoolWriteRate;        // 写入闪存的速率(bytes/s)
+        float spoolDrainRate;        // 从暂存区读回的速率(blocks/s)
+        // 补传（暂存区有积压时实时流与补传流交替上传）
+        bool catchupActive;
+        float backlogShare;          // 当前补传流的目标字节份额(0-1)
+        float measuredBacklogShare;  // 本次/最近一次补传中补传流实际的字节占比(0-1)
+        uint32_t liveMessages;
+        uint32_t backlogMessages;
+        uint32_t demotedBlocks;      // 实时流积压时转入暂存区改为补传的块数
+        uint32_t lastCatchupMs;      // 最近一次补传从开始到暂存区清空的时长
+    };
+    
+    // 服务器订阅：每个传感器上传哪些通道以及采样率分频
+    static const uint8_t CHANNEL_ACC = 0x01;
+    static const uint8_t CHANNEL_GYRO = 0x02;
+    static const uint8_t CHANNEL_ANGLE = 0x04;
+    static const uint8_t CHANNEL_ALL = CHANNEL_ACC | CHANNEL_GYRO | CHANNEL_ANGLE;
+    static const uint8_t MAX_RATE_DIVISOR = 100;
+    struct SensorSubscription {
+        uint8_t channelMask;    // 通道掩码，0表示不上传该传感器
+        uint8_t rateDivisor;    // 每N帧上传1帧
     };
+    SensorSubscription getSubscription(uint8_t sensorId) const;
     Stats getStats() const;
     
     // 重置统计信息
     void resetStats();
     
+    // 延迟分布统计
+    struct LatencyStats {
+        LatencyHistogram pingRtt;       // WebSocket ping -> pong（WiFi+网络往返）
+        LatencyHistogram blockQueue;    // 实时流块封装 -> 首次写入套接字（网关内排队和发送）
+        LatencyHistogram blockAck;      // 块最近一次写入 -> 服务器确认（网络+服务器处理）
+        LatencyHistogram blockTotal;    // 实时流块封装 -> 服务器确认（端到端，补传的块不计入）
+    };
+    const LatencyStats& getLatencyStats() const { return latency; }
+    void resetLatencyStats();
+    
+    // UDP实时流（编码任务产出消息后同时以数据报发送）
+    UdpStreamer& getUdpStreamer() { return udpStreamer; }
+    
+    // 本地WebSocket服务器（与上游共用已编码消息缓冲区）
+    LocalStreamServer& getLocalServer() { return localServer; }
+    
+    // 省电上传模式（由网络任务在下一轮生效）
+    void setPowerSaveEnabled(bool enabled);
+    const PowerScheduler& getPowerScheduler() const { return powerScheduler; }
+    void resetPowerStats();
+    
+    // 闪存暂存区：storage为spiffs分区中划给暂存的区域，须在任务启动前设置
+    bool setSpoolStorage(FlashStorage* storage);
+    void setSpoolEnabled(bool enabled);
+    bool isSpoolEnabled() const { return spoolEnabled; }
+    BlockSpool::Stats getSpoolStats() const { return readEncoderSnapshot().spool; }
+    void resetSpoolStats();
+    
+    // 网络任务本轮最长等待间隔：上轮因时间片用尽让出时为0（不等待），省电空闲阶段放宽，减少唤醒
+    uint32_t getLoopIntervalMs() const;
+    
     // 设置设备信息
     void setDeviceInfo(const String& deviceCode, const String& sessionId);
     
@@ -65,18 +203,32 @@ public:
     // 主循环处理
     void loop();
     
-    // 处理发送队列
-    void processSendQueue();
+    // 发送已编码的数据消息（以及重传消息），只在网络任务中调用
+    // 返回true表示因时间片用尽提前退出，仍有消息待发送
+    bool processSendQueue();
+    
+    // 编码任务调用：从SensorData取块编码到空闲输出缓冲区，返回是否产出了一条消息。
+    // 每轮结束时发布编码任务的计数快照和drained状态
+    bool encodeNext();
+    
+    // 设置网络任务和编码任务句柄，用于相互通知（消息就绪/缓冲区空闲）
+    void setTaskHandles(TaskHandle_t networkTask, TaskHandle_t encoderTask);
     
     // 处理连接重试
     void handleConnectionRetry();
     
-    // 设置BufferPool实例用于正确释放数据块
-    void setBufferPool(BufferPool* bufferPool);
+    // 设置SensorData实例：数据块的唯一来源，发送确认后归还给它
+    void setSensorData(SensorData* sensorData);
     
     // 设置CommandHandler实例用于处理服务器命令
     void setCommandHandler(CommandHandler* commandHandler);
     
+    // 设置会话记录器，采集开始/停止时开始/结束会话记录
+    void setSessionRecorder(SessionRecorder* recorder);
+    
+    // 设置TimeSync实例，心跳和状态响应中报告NTP是否已同步
+    void setTimeSync(TimeSync* timeSync);
+    
     // 手动设置连接状态（用于调试）
     void setConnectionStatus(bool connected);
     
@@ -84,49 +236,403 @@ public:
     void sendUploadComplete();
     
 private:
-    WebSocketsClient webSocket;
+    GatewayWebSocket webSocket;
     String serverUrl;
     uint16_t serverPort;
-    String deviceCode;
-    String sessionId = "041025";
-    bool collectionActive;
-    bool uploadCompletePending;  // 标记是否等待发送upload_complete消息
+    char deviceCode[32];
+    char sessionId[32];
+    std::atomic<bool> collectionActive;
+    std::atomic<bool> uploadCompletePending;  // 标记是否等待发送upload_complete消息
     SemaphoreHandle_t mutex;
     Stats stats;
+    LatencyStats latency;
+    
+    // ping状态：ping载荷为发送时刻的millis()，收到pong时计算往返时间
+    uint32_t lastPingTime;
+    bool pingOutstanding;
+    
+    // 定期发送ping
+    void sendPingIfDue();
+    
+    // 处理pong
+    void handlePong(const uint8_t* payload, size_t length);
     uint32_t lastStatsTime;
     uint32_t blocksSentSinceLastStats;
     static uint32_t lastSendPrintTime;
     
-    // 网络状态
-    bool wifiConnected;
-    bool serverConnected;
-    uint32_t lastConnectionAttempt;
-    uint32_t connectionRetryInterval;
+    // 网络状态（wifiConnected由WiFi事件回调更新，serverConnected由网络任务更新、编码任务只读）
+    std::atomic<bool> wifiConnected;
+    std::atomic<bool> serverConnected;
+    
+    // 指数退避和断开时刻（WiFi层和WebSocket层各一份）
+    ReconnectBackoff wifiBackoff;
+    ReconnectBackoff serverBackoff;
+    
+    // WiFi事件回调（在WiFi事件任务中执行，只更新状态）
+    void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info);
     
     // 数据发送相关
-    QueueHandle_t sendQueue;
-    static const size_t MAX_QUEUE_SIZE = 20;
+    // 重传窗口：已发送但未被服务器累计确认的数据块（按序列号递增排列）
+    // 一条数据消息对应一个条目；合并发送时一条消息包含多个块
+    static const size_t MAX_COALESCED_BLOCKS = 4;
+    struct InFlightBlock {
+        DataBlock* blocks[MAX_COALESCED_BLOCKS];
+        uint8_t blockCount;
+        uint32_t seq;           // 数据消息序列号
+        uint32_t sentTime;      // 最近一次发送时间(ms)
+        uint8_t transmissions;  // 发送次数
+        bool backlog;           // 补传流的消息（块来自闪存暂存区），消息中带backlog标记
+        bool resend;            // resend命令补发的消息（块来自会话记录），同时带backlog和resend标记
+        bool skipped;           // 块无法编码，以跳过标记占用该序列号，确认后按丢弃归还
+    };
+    static const uint8_t RETRANSMIT_WINDOW_SIZE = 8;
+    RetransmitWindow<InFlightBlock, RETRANSMIT_WINDOW_SIZE> retransmitWindow;
+    uint32_t nextSeq;           // 下一个数据消息的序列号（单调递增）
     
-    // BufferPool实例，用于正确释放数据块
-    BufferPool* bufferPool;
+    // 上游断开且重传窗口已满时，已分配序列号的消息暂留在这里：只保留块，输出缓冲区归还给本地转发。
+    // 窗口有空位后按序移入窗口，由重传流程重新编码上传；序列号不留空洞，块不计为已发送
+    static const uint8_t PARKED_ENTRY_COUNT = 4;
+    InFlightBlock parkedEntries[PARKED_ENTRY_COUNT];
+    uint8_t parkedHead;
+    uint8_t parkedCount;
+    
+    // 把暂留的消息按序移入重传窗口（在取readySlotQueue中的新消息前调用，窗口内序列号保持递增）
+    void admitParkedEntries();
+    
+    // 当前正在分片发送的数据消息：新消息直接发送编码任务的输出缓冲区，重传消息在retransmitBuffer中重新编码
+    static const size_t SEND_CHUNK_SIZE = 1436;  // 每个分片的最大字节数（一个TCP MSS）
+    const char* txData;
+    size_t txLength;
+    size_t txOffset;            // 已写入套接字的字节数
+    uint32_t txSeq;
+    bool txActive;
+    LoopPacer sendPacer;        // processSendQueue的时间片（Config::NETWORK_LOOP_INTERVAL_MS）
+    int16_t txSlot;             // 正在发送的输出缓冲区索引，-1表示重传缓冲区
+    char* retransmitBuffer;     // 重传编码缓冲区（Config::ENCODE_BUFFER_SIZE字节）
+    
+    // 数据消息的JSON文档，启动时按合并后的最大帧数预分配，每次编码前clear()，不再每条消息分配堆内存。
+    // 编码任务（新消息和本地副本）和网络任务（重传）各用一个
+    DynamicJsonDocument* encodeDoc;
+    DynamicJsonDocument* retransmitDoc;
+    
+    // 数据消息大小的上界：消息头1024字节，完整JSON每帧256字节，紧凑编码每帧200字节。
+    // 同时覆盖JSON文档的内存占用和序列化后的字节数，用于限制合并的块数和预分配文档
+    static size_t encodedSizeBound(size_t frames, bool compact) { return 1024 + frames * (compact ? 200 : 256); }
+    
+    // 编码阶段：编码任务把已封装的块编码到预分配的输出缓冲区环中，网络任务只负责发送。
+    // 缓冲区索引在freeSlotQueue和readySlotQueue之间流转，序列号由编码任务按产出顺序分配
+    struct EncodedMessage {
+        InFlightBlock entry;        // 块和序列号，进入重传窗口时原样复制
+        char* buffer;
+        size_t length;
+        uint32_t omittedFrames;
+        uint32_t unsubscribedFrames;
+        bool localOnly;             // 只转发给本地客户端（块已写入闪存暂存区），不进入重传窗口
+    };
+    EncodedMessage* encodeSlots;
+    uint8_t encodeSlotCount;
+    QueueHandle_t freeSlotQueue;    // 空闲输出缓冲区索引
+    QueueHandle_t readySlotQueue;   // 已编码待发送的输出缓冲区索引（按序列号顺序）
+    bool encoderWaitingForSlot;     // 编码任务正在等待空闲输出缓冲区（用于统计等待次数）
+    TaskHandle_t networkTaskHandle;
+    TaskHandle_t encoderTaskHandle;
+    
+    // 编码所需的上下文：由网络任务在变化时发布，编码任务在每条消息开始时在互斥锁下复制
+    struct EncodeContext {
+        UploadLevel level;
+        SensorSubscription subscriptions[SENSOR_DATA_SENSOR_COUNT];
+        char deviceCode[32];
+        char sessionId[32];
+    };
+    EncodeContext publishedContext;
+    
+    // 发布编码上下文（设备信息或订阅变化后调用）
+    void publishEncodeContext();
+    
+    // 复制编码上下文，等级取速率控制器的当前值
+    void snapshotEncodeContext(EncodeContext& context);
+    
+    // 编码任务的计数、暂存区和补传状态：只由编码任务写入，每轮结束时整体发布到encoderLatch，
+    // 网络任务和CLI只读快照。resetStats()只置位encoderResetRequested，由编码任务在下一轮清零
+    struct EncoderSnapshot {
+        uint32_t encodedMessages;
+        uint32_t encodeFailures;
+        uint32_t encoderStalls;
+        uint32_t coalescedMessages;
+        uint32_t spooledBlocks;
+        uint32_t unspooledBlocks;
+        uint32_t spoolDroppedBlocks;
+        uint32_t busyUs;                // 忙碌时间累计(us)，用于计算利用率，不随统计清零
+        BlockSpool::Stats spool;
+        CatchupScheduler::Stats catchup;
+        bool catchingUp;
+        float backlogShare;
+        float measuredBacklogShare;
+    };
+    EncoderSnapshot encoderCounters;    // 编码任务的工作副本
+    ClockLatch<EncoderSnapshot> encoderLatch;
+    std::atomic<bool> encoderResetRequested;
+    
+    // 编码任务每轮开始时清除、结束时按本轮结果设置：没有取到块，且暂存环和暂存区都为空。
+    // 网络任务只检查这一个状态（先于readySlotQueue检查），不再分别读取编码任务的各项状态
+    std::atomic<bool> encoderDrained;
+    
+    // 编码任务：取一个块编码为一条消息，返回是否产出了消息
+    bool encodeMessage();
+    
+    // 编码任务：发布计数快照和drained状态
+    void publishEncoderState(bool drained);
+    
+    // 读取编码任务最近一次发布的快照
+    EncoderSnapshot readEncoderSnapshot() const;
+    
+    // 阶段忙碌时间累计(us)，用于计算利用率
+    uint32_t transmitBusyUs;
+    uint32_t lastEncoderBusyUs;
+    uint32_t lastTransmitBusyUs;
+    uint32_t lastUtilizationTime;
+    
+    // 高优先级控制通道：ACK、心跳、状态响应和upload_complete统一经此发送。
+    // 数据消息分片发送期间不能插入其他文本消息，每个消息边界先清空控制通道再开始下一条数据消息。
+    // 使用固定大小的槽位，入队不分配堆内存
+    static const size_t CONTROL_LANE_DEPTH = 8;
+    // status_response按分节发送，每节单独装入一个槽位（最大的stats节约0.85KB），新增字段只影响所在的节
+    static const size_t CONTROL_SLOT_SIZE = 1024;
+    // 消息前预留帧头空间，发送时库直接在槽位内组帧（并就地加掩码），不再为小消息分配副本
+    struct ControlSlot {
+        uint8_t header[WEBSOCKETS_MAX_HEADER_SIZE];
+        char data[CONTROL_SLOT_SIZE];
+        uint16_t length;
+        uint32_t enqueueTime;   // 入队时刻(ms)，用于统计排队延迟
+    };
+    static_assert(offsetof(ControlSlot, data) == WEBSOCKETS_MAX_HEADER_SIZE, "frame header must directly precede data");
+    ControlSlot controlLane[CONTROL_LANE_DEPTH];
+    uint8_t controlHead;
+    uint8_t controlCount;
+    
+    // SensorData实例，数据块的来源和归还对象
+    SensorData* sensorData;
     
     // CommandHandler实例，用于处理服务器命令
     CommandHandler* commandHandler;
     
-    // 创建JSON数据包
-    String createDataPacket(DataBlock* block);
+    // 会话记录器（可选）
+    SessionRecorder* sessionRecorder;
+    
+    // 时间同步模块（可选），用于报告NTP同步状态
+    TimeSync* timeSync;
+    
+    // resend命令：编码任务在实时流和补传流都没有块时从会话记录读回块（后台优先级），
+    // 网络任务按数据确认统计进度，定期和结束时用ack汇报。同一时间只有一个补发
+    struct ResendJob {
+        char commandId[32];
+        uint32_t sessionNumber;
+        volatile bool active;               // 网络任务开始/结束
+        volatile bool readDone;             // 编码任务：范围内的块已读完或已取消
+        volatile uint32_t encodedBlocks;    // 编码任务：已从记录取出待编码的块数
+        uint32_t finishedBlocks;            // 网络任务：已确认或因窗口满而丢弃的块数
+        uint32_t ackedBlocks;
+        uint32_t startTime;
+        uint32_t lastProgressTime;
+    };
+    ResendJob resendJob;
+    
+    // 上传速率控制器
+    RateController rateController;
+    
+    // UDP实时流发送器：网络任务负责地址解析，编码任务负责发送
+    UdpStreamer udpStreamer;
+    
+    // 本地WebSocket服务器：新消息开始上传时用同一缓冲区转发给局域网客户端
+    LocalStreamServer localServer;
+    
+    // 上游断开时仍向本地客户端转发已编码消息：窗口有空位时消息留在窗口中等待重连后发送，
+    // 窗口已满时转发后释放（不再上传），避免编码任务因缓冲区耗尽而停止
+    void fanOutWhileUpstreamDown();
+    
+    // 省电上传：空闲阶段编码任务把块移入暂存环，突发阶段先编码暂存的块。
+    // 暂存环只由编码任务读写，阶段由网络任务决定并通过holdBlocks通知编码任务
+    PowerScheduler powerScheduler;
+    DataBlock** heldBlocks;         // Config::POWER_HOLD_MAX_BLOCKS个指针
+    uint16_t heldHead;
+    std::atomic<uint16_t> heldCount;
+    std::atomic<bool> holdBlocks;
+    std::atomic<bool> powerSaveRequested;
+    bool powerResetRequested;
+    
+    // 按暂存和上传进度推进省电阶段，阶段变化时切换无线电省电模式
+    void updatePowerSchedule();
+    
+    // 编码任务：把SensorData中已封装的块移入暂存环
+    void holdPendingBlocks();
+    
+    // 闪存暂存：上游断开或积压时编码任务把块写入暂存区。上游恢复后暂存区中的块作为补传流
+    // 按写入顺序读回，与实时流按catchupScheduler的份额交替上传；补传期间实时流只保留最新的
+    // Config::CATCHUP_LIVE_QUEUE_BLOCKS个块，更早的块转入暂存区。暂存区只由编码任务读写
+    BlockSpool blockSpool;
+    CatchupScheduler catchupScheduler;
+    
+    // 会话清单：start_collection时清零，采集侧由SensorData更新，编码侧在新消息首次编码时更新，
+    // 随upload_complete发送（发送前在锁内复制快照）。各任务的调用由manifestLock互斥
+    struct ManifestLock : public SessionManifest::Lock {
+        SemaphoreHandle_t handle;
+        void lock() override { xSemaphoreTake(handle, portMAX_DELAY); }
+        void unlock() override { xSemaphoreGive(handle); }
+    };
+    ManifestLock manifestLock;
+    SessionManifest sessionManifest;
+    uint8_t* spoolWriteBuffer;      // Config::SPOOL_WRITE_BUFFER_SIZE字节
+    uint8_t* spoolRecordBuffer;     // 一条块记录
+    std::atomic<bool> spoolEnabled;
+    std::atomic<bool> spoolResetRequested;
+    uint32_t lastSpoolBytesFlushed;
+    uint32_t lastSpoolRecordsRead;
+    
+    // 编码任务：需要暂存时把暂存环和SensorData中的块写入暂存区（上游在线时保留最新的块给实时流），
+    // 返回暂存区是否有待上传的块
+    bool spoolIncomingBlocks();
+    
+    // 编码任务：把一个块写入暂存区并归还缓冲区（上游断开且有本地客户端时先编码一份只供本地转发）
+    void spoolBlock(DataBlock* block);
+    
+    // 编码任务：把已暂存的块编码为只转发给本地客户端的消息，无空闲输出缓冲区时返回false
+    bool encodeLocalCopy(DataBlock* block);
+    
+    // 释放只供本地转发的消息中的块并归还输出缓冲区
+    void releaseLocalOnly(uint8_t slotIndex);
+    
+    // 编码任务：从暂存区读回一个块，无块或读出失败时返回nullptr
+    DataBlock* unspoolBlock();
+    
+    // 编码任务：从指定的流取下一个待编码的块（补传流取闪存暂存区中的块，实时流先取暂存环再取SensorData）
+    DataBlock* takeNextBlock(CatchupScheduler::Stream stream);
+    
+    // 编码任务：从会话记录读回下一个补发的块，暂时没有或已读完时返回nullptr
+    DataBlock* takeResendBlock();
+    
+    // 网络任务：归还已确认（acked）或被丢弃的条目中的块，补发的块计入补发进度
+    void releaseEntryBlocks(InFlightBlock& entry, bool acked);
+    
+    // 网络任务：补发完成时发送最终进度，进行中按间隔发送进度
+    void updateResend();
+    
+    // 发送补发进度ack，state为running/complete/cancelled
+    void sendResendProgress(const char* state);
+    
+    // 按当前等级周期性更新速率控制器，等级变化时记录日志并通知服务器
+    void updateRateControl();
+    
+    // 发送upload_level消息
+    void sendUploadLevel();
+    
+    // 按编码上下文把条目中的块编码为JSON写入output，返回长度（0表示失败），
+    // 同时返回因降级和因订阅未编码的帧数。编码任务和网络任务（重传）都会调用，各自传入预分配的doc，不访问可变成员；
+    // 只有新消息的首次编码传入manifest，序列化成功后才提交上传和未上传的帧（失败时由调用者按整块跳过计入）
+    size_t createDataPacket(const InFlightBlock& entry, const EncodeContext& context, JsonDocument& doc, char* output, size_t outputSize,
+                            uint32_t& omittedFrames, uint32_t& unsubscribedFrames, SessionManifest* manifest = nullptr);
+    
+    // 块无法编码时生成跳过标记：同一序列号，只含block_ids和skipped字段，不含数据。
+    // 序列号不留空洞，服务器的累计确认照常推进。返回长度（outputSize过小时为0）
+    size_t createSkipPacket(const InFlightBlock& entry, const EncodeContext& context, char* output, size_t outputSize);
+    
+    // 按紧凑编码的定点比例量化一帧（acc*1000，gyro和angle*100），未订阅的通道为0。紧凑编码和清单校验和共用
+    static void quantizeFrame(const SensorFrame& frame, uint8_t channels, bool validAcc, 
+                              int32_t values[SessionManifest::CHANNEL_VALUES]);
+    
+    // 各传感器的订阅设置（默认全部通道、不分频），由网络任务修改，编码任务通过EncodeContext读取
+    SensorSubscription subscriptions[SENSOR_DATA_SENSOR_COUNT];
+    
+    // 处理subscribe命令，全部条目校验通过后才生效
+    bool handleSubscribeCommand(JsonDocument& doc, char* error, size_t errorSize);
+    
+    // 发送subscribe命令的ACK，附带生效后的订阅
+    void sendSubscriptionAck(const char* commandId, bool success, const char* error);
+    
+    // 将订阅写入JSON数组（ACK和status_response共用）
+    void appendSubscriptions(JsonArray array) const;
+    
+    // 当前等级下是否上传该帧；indexInSensor为该帧在本消息中同一传感器帧的序号
+    static bool shouldEncodeFrame(UploadLevel level, uint8_t sensorId, uint32_t indexInSensor);
+    
+    // 开始重传窗口中待重传位置的消息（在网络任务中重新编码）
+    bool beginRetransmit();
+    
+    // 取出下一条已编码的消息放入重传窗口并开始发送，无可发送消息时返回false
+    bool beginNextEncoded();
+    
+    // 当前消息结束（写完或放弃）后归还输出缓冲区
+    void finishTransmit();
+    
+    // 在套接字可写时继续写入当前消息，返回消息是否已全部写入
+    bool pumpTransmit();
+    
+    // 放弃当前未写完的消息（连接断开时调用），块仍保留在窗口中等待重传
+    void abortTransmit();
+    
+    // 将控制消息放入控制通道，不在数据消息中间时立即尝试发送；通道满时丢弃最旧的消息
+    bool sendControlMessage(const String& message);
+    bool sendControlMessage(const char* message, size_t length);
+    
+    // 将JSON文档直接序列化到控制通道槽位，不经过String
+    bool sendControlMessage(const JsonDocument& doc);
+    
+    // 取得下一个控制通道槽位（通道满时丢弃最旧的消息），写入后调用commitControlSlot
+    ControlSlot& acquireControlSlot();
+    bool commitControlSlot(ControlSlot& slot, size_t length);
+    
+    // 在消息边界发送控制通道中的消息，返回通道是否已清空（套接字不可写时保留剩余消息）
+    bool flushControlLane();
+    
+    // 处理服务器的累计确认，释放seq及之前的所有块
+    void handleDataAck(uint32_t ackSeq);
+    
+    // 将数据块归还给SensorData
+    void releaseBlock(DataBlock* block);
     
     // 处理WebSocket事件
     static void webSocketEvent(WStype_t type, uint8_t* payload, size_t length);
     
-    // 解析服务器命令
-    void parseServerCommand(const String& jsonCommand);
+    // 解析服务器命令（就地解析payload），按命令名哈希查表分发
+    void parseServerCommand(char* payload, size_t length);
+    
+    // 服务器命令表：按FNV-1a哈希查找，哈希相同再比较名称确认。
+    // 处理函数返回命令是否执行成功，字段均借用payload中的字符串，不分配堆内存
+    typedef bool (WebSocketClient::*ServerCommandHandler)(JsonDocument& doc, const char* commandId);
+    struct ServerCommand {
+        uint32_t hash;
+        const char* name;
+        ServerCommandHandler handler;
+        bool repliesItself;     // 处理函数自行发送ACK（如subscribe的ACK附带订阅）
+    };
+    static const ServerCommand SERVER_COMMANDS[];
+    static const size_t SERVER_COMMAND_COUNT;
+    
+    static const ServerCommand* findServerCommand(const char* name);
+    
+    // 各服务器命令的处理函数
+    bool onStartCollectionCommand(JsonDocument& doc, const char* commandId);
+    bool onStopCollectionCommand(JsonDocument& doc, const char* commandId);
+    bool onSyncCommand(JsonDocument& doc, const char* commandId);
+    bool onSetBatchCommand(JsonDocument& doc, const char* commandId);
+    bool onGetStatusCommand(JsonDocument& doc, const char* commandId);
+    bool onHeartbeatCommand(JsonDocument& doc, const char* commandId);
+    bool onDataAckCommand(JsonDocument& doc, const char* commandId);
+    bool onSubscribeCommand(JsonDocument& doc, const char* commandId);
+    bool onResendCommand(JsonDocument& doc, const char* commandId);
+    bool onCancelResendCommand(JsonDocument& doc, const char* commandId);
+    
+    // 保存命令中的session_id（支持数字和字符串）
+    void storeSessionId(JsonVariant value);
+    static void copySessionId(JsonVariant value, char* output, size_t outputSize);
     
     // 发送ACK响应
-    void sendAckResponse(const String& commandId, bool success);
+    void sendAckResponse(const char* commandId, bool success);
     
-    // 发送状态响应
-    void sendStatusResponse(const String& commandId);
+    // 发送状态响应：分为STATUS_SECTION_COUNT条status_response，各带section/part/parts，服务器按command_id合并
+    static const uint8_t STATUS_SECTION_COUNT = 4;
+    void sendStatusResponse(const char* commandId);
+    void beginStatusSection(JsonDocument& doc, const char* commandId, const char* section, uint8_t part);
+    void sendStatusSection(JsonDocument& doc, const char* section);
     
     // 更新统计信息
     void updateStats();
@@ -0,0 +1,236 @@
+#include "BlockSpool.h"
+#include <string.h>
+
+BlockSpool::BlockSpool() {
+    storage = nullptr;
+    capacity = 0;
+    buffer = nullptr;
+    bufferSize = 0;
+    epoch = 0;
+    bufferStart = 0;
+    bufferFill = 0;
+    readPos = 0;
+    erasedEnd = 0;
+    writeSeq = 0;
+    readSeq = 0;
+    pendingRecords = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool BlockSpool::begin(FlashStorage* storage, uint8_t* writeBuffer, size_t bufferSize, uint32_t epoch) {
+    if (!storage || !writeBuffer || bufferSize == 0 || bufferSize % FlashStorage::PAGE_SIZE != 0 ||
+        storage->size() < bufferSize + FlashStorage::SECTOR_SIZE || storage->size() % FlashStorage::SECTOR_SIZE != 0) {
+        return false;
+    }
+    this->storage = storage;
+    this->capacity = storage->size();
+    this->buffer = writeBuffer;
+    this->bufferSize = bufferSize;
+    this->epoch = epoch;
+    clear();
+    resetStats();
+    return true;
+}
+
+size_t BlockSpool::recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + 3) & ~(size_t)3;
+}
+
+uint64_t BlockSpool::roundUp(uint64_t value, uint64_t unit) {
+    return (value + unit - 1) / unit * unit;
+}
+
+size_t BlockSpool::getMaxRecordLength() const {
+    size_t limit = bufferSize > sizeof(RecordHeader) ? bufferSize - sizeof(RecordHeader) : 0;
+    return limit < 0xFFFF ? limit : 0xFFFF;
+}
+
+bool BlockSpool::append(const void* data, size_t length) {
+    if (!storage || length == 0 || length > getMaxRecordLength()) {
+        stats.recordsRejected++;
+        return false;
+    }
+    size_t need = recordSize(length);
+
+    if (bufferFill + need > bufferSize) {
+        flush();
+    }
+    // 记录不跨越区域末尾（写出缓冲区的页填充会推后位置，须在其后判断）：
+    // 放不下时写出缓冲区，从下一圈起点继续，中间部分读出时跳过
+    if (physical(bufferStart) + bufferFill + need > capacity) {
+        flush();
+        if (physical(bufferStart) != 0) {
+            bufferStart = roundUp(bufferStart, capacity);
+        }
+        if (erasedEnd < bufferStart) {
+            erasedEnd = bufferStart;
+        }
+    }
+
+    // 写入（含页填充）不能进入仍有未读数据的扇区
+    if (roundUp(writeEnd() + need, FlashStorage::PAGE_SIZE) > sectorFloor(readPos) + capacity) {
+        stats.recordsRejected++;
+        return false;
+    }
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.length = length;
+    header.seq = writeSeq++;
+    header.epoch = epoch;
+    header.crc = FlashStorage::crc32(data, length);
+
+    uint8_t* dest = buffer + bufferFill;
+    memcpy(dest, &header, sizeof(header));
+    memcpy(dest + sizeof(header), data, length);
+    memset(dest + sizeof(header) + length, 0, need - sizeof(header) - length);
+    bufferFill += need;
+
+    pendingRecords++;
+    stats.recordsWritten++;
+    return true;
+}
+
+bool BlockSpool::flush() {
+    if (!storage || bufferFill == 0) {
+        return true;
+    }
+    size_t padded = roundUp(bufferFill, FlashStorage::PAGE_SIZE);
+    memset(buffer + bufferFill, 0xFF, padded - bufferFill);
+
+    uint64_t end = bufferStart + padded;
+    bool ok = true;
+    while (erasedEnd < end) {
+        if (!eraseAt(erasedEnd)) {
+            ok = false;
+        }
+        stats.inlineErases++;
+        erasedEnd += FlashStorage::SECTOR_SIZE;
+    }
+    if (ok && !storage->write(physical(bufferStart), buffer, padded)) {
+        ok = false;
+    }
+    if (!ok) {
+        // 写入失败的记录读出时校验失败，按丢失计入corruptRecords
+        stats.writeErrors++;
+    }
+
+    stats.bytesFlushed += padded;
+    stats.flushes++;
+    bufferStart = end;
+    bufferFill = 0;
+    return ok;
+}
+
+bool BlockSpool::service() {
+    if (!storage) {
+        return false;
+    }
+    // 预擦除范围：覆盖下一次整段写入，且不进入仍有未读数据的扇区
+    uint64_t target = writeEnd() + bufferSize;
+    if (erasedEnd >= target || erasedEnd + FlashStorage::SECTOR_SIZE > sectorFloor(readPos) + capacity) {
+        return false;
+    }
+    // 跨越区域末尾时写入位置会跳到下一圈起点，末尾不足一条记录的扇区无需擦除也不影响正确性
+    eraseAt(erasedEnd);
+    erasedEnd += FlashStorage::SECTOR_SIZE;
+    return true;
+}
+
+bool BlockSpool::eraseAt(uint64_t pos) {
+    stats.sectorsErased++;
+    if (!storage->eraseSector(physical(pos))) {
+        stats.writeErrors++;
+        return false;
+    }
+    return true;
+}
+
+bool BlockSpool::readBytes(uint64_t pos, void* data, size_t length) {
+    // 记录不跨越缓冲区边界：整条记录要么已写入闪存，要么仍在RAM缓冲区中
+    if (pos >= bufferStart) {
+        memcpy(data, buffer + (pos - bufferStart), length);
+        return true;
+    }
+    if (!storage->read(physical(pos), data, length)) {
+        stats.readErrors++;
+        return false;
+    }
+    return true;
+}
+
+size_t BlockSpool::readNext(void* data, size_t maxLength) {
+    if (!storage) {
+        return 0;
+    }
+
+    while (readPos < writeEnd()) {
+        size_t offset = physical(readPos);
+        if (capacity - offset < sizeof(RecordHeader)) {
+            readPos = roundUp(readPos + 1, capacity);
+            continue;
+        }
+
+        // 页填充、区域末尾跳过的部分和旧记录都不匹配：跳到下一页（每次写入都从页边界开始）
+        RecordHeader header;
+        int32_t gap = -1;
+        if (readBytes(readPos, &header, sizeof(header)) &&
+            header.magic == RECORD_MAGIC && header.epoch == epoch &&
+            recordSize(header.length) <= capacity - offset) {
+            gap = (int32_t)(header.seq - readSeq);
+        }
+        if (gap < 0 || (uint32_t)gap >= pendingRecords) {
+            readPos = roundUp(readPos + 1, FlashStorage::PAGE_SIZE);
+            continue;
+        }
+
+        // 序号跳跃说明中间的记录已损坏
+        stats.corruptRecords += gap;
+        pendingRecords -= gap;
+
+        uint64_t payloadPos = readPos + sizeof(RecordHeader);
+        readPos += recordSize(header.length);
+        readSeq = header.seq + 1;
+        pendingRecords--;
+
+        if (header.length > maxLength || !readBytes(payloadPos, data, header.length) ||
+            FlashStorage::crc32(data, header.length) != header.crc) {
+            stats.corruptRecords++;
+            continue;
+        }
+        stats.recordsRead++;
+        return header.length;
+    }
+
+    // 已读到写入位置，剩余计数对应的记录已无法读出
+    if (pendingRecords > 0) {
+        stats.corruptRecords += pendingRecords;
+        pendingRecords = 0;
+    }
+    return 0;
+}
+
+void BlockSpool::clear() {
+    // 从新的一圈起点开始，之前写入的数据按旧序号跳过
+    uint64_t restart = roundUp(writeEnd(), capacity);
+    bufferStart = restart;
+    bufferFill = 0;
+    readPos = restart;
+    if (erasedEnd < restart) {
+        erasedEnd = restart;
+    }
+    readSeq = writeSeq;
+    pendingRecords = 0;
+}
+
+BlockSpool::Stats BlockSpool::getStats() const {
+    Stats currentStats = stats;
+    currentStats.capacityBytes = capacity;
+    currentStats.usedBytes = writeEnd() - readPos;
+    currentStats.pendingRecords = pendingRecords;
+    return currentStats;
+}
+
+void BlockSpool::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
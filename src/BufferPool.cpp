@@ -59,7 +59,7 @@ DataBlock* BufferPool::acquireBlock() {
     }
     
     // 队列为空，尝试创建新块
-    block = createBlock();
+    block = createBlock(true);
     if (block) {
         if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
             stats.totalAcquisitions++;
@@ -149,8 +149,14 @@ void BufferPool::preallocateBlocks() {
     Serial0.printf("[BufferPool] Preallocated %d blocks\n", poolSize);
 }
 
-DataBlock* BufferPool::createBlock() {
-    DataBlock* block = (DataBlock*)malloc(sizeof(DataBlock));
+DataBlock* BufferPool::createBlock(bool preferPsram) {
+    DataBlock* block = nullptr;
+    if (preferPsram && psramFound()) {
+        block = (DataBlock*)ps_malloc(sizeof(DataBlock));
+    }
+    if (!block) {
+        block = (DataBlock*)malloc(sizeof(DataBlock));
+    }
     if (block) {
         memset(block, 0, sizeof(DataBlock));
     }
@@ -0,0 +1,118 @@
+#include "CatchupScheduler.h"
+#include <string.h>
+
+// 差额上限：一路长时间没有块时不积累过多额度，另一路恢复后不会长时间独占
+static const float MAX_BALANCE = 32768.0f;
+
+CatchupScheduler::CatchupScheduler() {
+    baseShare = 0.5f;
+    maxShare = 0.8f;
+    liveMargin = 1.5f;
+    share = baseShare;
+    balance = 0.0f;
+    catchingUp = false;
+    catchupStartTime = 0;
+    lastRateTime = 0;
+    intervalLiveBytes = 0;
+    intervalDemotedBlocks = 0;
+    liveBytesPerBlock = 0.0f;
+    liveRate = 0.0f;
+    resetStats();
+}
+
+void CatchupScheduler::configure(float baseShare, float maxShare, float liveMargin) {
+    this->baseShare = baseShare;
+    this->maxShare = maxShare < baseShare ? baseShare : maxShare;
+    this->liveMargin = liveMargin;
+    share = baseShare;
+}
+
+bool CatchupScheduler::update(uint32_t now, float capacity, bool backlogPending) {
+    // 实时数据量 = 实时流编码的字节 + 转为补传的块折算的字节
+    uint32_t elapsed = now - lastRateTime;
+    if (lastRateTime == 0) {
+        lastRateTime = now;
+    } else if (elapsed >= 1000) {
+        float rate = (intervalLiveBytes + intervalDemotedBlocks * liveBytesPerBlock) * 1000.0f / elapsed;
+        liveRate = (liveRate == 0.0f) ? rate : liveRate * 0.7f + rate * 0.3f;
+        intervalLiveBytes = 0;
+        intervalDemotedBlocks = 0;
+        lastRateTime = now;
+
+        // 容量扣除预留给实时流的部分后剩余的比例即可给补传流，限制在[baseShare, maxShare]
+        share = baseShare;
+        if (capacity > 0.0f) {
+            float spare = 1.0f - liveRate * liveMargin / capacity;
+            if (spare > share) {
+                share = spare < maxShare ? spare : maxShare;
+            }
+        }
+    }
+
+    if (backlogPending == catchingUp) {
+        return false;
+    }
+    catchingUp = backlogPending;
+    if (catchingUp) {
+        catchupStartTime = now;
+        catchupLiveBytes = 0;
+        catchupBacklogBytes = 0;
+        balance = 0.0f;
+    } else {
+        stats.catchups++;
+        stats.lastCatchupMs = now - catchupStartTime;
+        if (stats.lastCatchupMs > stats.maxCatchupMs) {
+            stats.maxCatchupMs = stats.lastCatchupMs;
+        }
+    }
+    return true;
+}
+
+CatchupScheduler::Stream CatchupScheduler::select(bool liveReady, bool backlogReady) const {
+    if (liveReady && backlogReady) {
+        return balance >= 0.0f ? Stream::BACKLOG : Stream::LIVE;
+    }
+    return backlogReady ? Stream::BACKLOG : Stream::LIVE;
+}
+
+void CatchupScheduler::onMessage(Stream stream, uint32_t bytes, uint8_t blockCount) {
+    if (stream == Stream::BACKLOG) {
+        balance -= (1.0f - share) * bytes;
+        stats.backlogMessages++;
+        stats.backlogBytes += bytes;
+        catchupBacklogBytes += bytes;
+    } else {
+        balance += share * bytes;
+        stats.liveMessages++;
+        stats.liveBytes += bytes;
+        intervalLiveBytes += bytes;
+        if (catchingUp) {
+            catchupLiveBytes += bytes;
+        }
+        if (blockCount > 0) {
+            float perBlock = (float)bytes / blockCount;
+            liveBytesPerBlock = (liveBytesPerBlock == 0.0f) ? perBlock : liveBytesPerBlock * 0.875f + perBlock * 0.125f;
+        }
+    }
+    if (balance > MAX_BALANCE) {
+        balance = MAX_BALANCE;
+    } else if (balance < -MAX_BALANCE) {
+        balance = -MAX_BALANCE;
+    }
+}
+
+void CatchupScheduler::onLiveDemoted(uint32_t blocks) {
+    stats.demotedBlocks += blocks;
+    intervalDemotedBlocks += blocks;
+}
+
+float CatchupScheduler::getMeasuredShare() const {
+    uint32_t total = catchupLiveBytes + catchupBacklogBytes;
+    return total > 0 ? (float)catchupBacklogBytes / total : 0.0f;
+}
+
+void CatchupScheduler::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    catchupLiveBytes = 0;
+    catchupBacklogBytes = 0;
+}
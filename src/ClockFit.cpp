@@ -0,0 +1,187 @@
+#include "ClockFit.h"
+#include <math.h>
+
+// 以第一个样本为原点的坐标：x为传感器时间差(ms)，y为ESP32时间差(ms)
+static inline double centredX(const ClockFit::Sample& sample, const ClockFit::Sample& origin) {
+    return (double)(int32_t)(sample.sensorTimeMs - origin.sensorTimeMs);
+}
+
+static inline double centredY(const ClockFit::Sample& sample, const ClockFit::Sample& origin) {
+    return (double)(sample.espTimeUs - origin.espTimeUs) / 1000.0;
+}
+
+// 由居中坐标下的均值和斜率换算截距并统计残差
+static void finishFit(const ClockFit::Sample* samples, uint16_t count, double slope,
+                      double meanX, double meanY, ClockFit::Result& result) {
+    const ClockFit::Sample& origin = samples[0];
+    double sumSquares = 0.0;
+    double maxResidual = 0.0;
+    double minX = 0.0;
+    double maxX = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        double x = centredX(samples[i], origin);
+        double residual = centredY(samples[i], origin) - (meanY + slope * (x - meanX));
+        sumSquares += residual * residual;
+        if (fabs(residual) > maxResidual) {
+            maxResidual = fabs(residual);
+        }
+        if (x < minX) minX = x;
+        if (x > maxX) maxX = x;
+    }
+
+    // 原点处 E0 = meanY - slope * meanX（居中坐标），换回绝对时间
+    double originY = (double)origin.espTimeUs / 1000.0;
+    double originX = (double)origin.sensorTimeMs;
+    result.slope = slope;
+    result.intercept = originY + meanY - slope * (originX + meanX);
+    result.residualRms = sqrt(sumSquares / count);
+    result.residualMax = maxResidual;
+    result.spanMs = (uint32_t)(maxX - minX);
+    result.count = count;
+    result.rejected = 0;
+}
+
+bool ClockFit::fitLeastSquares(const Sample* samples, uint16_t count, Result& result) {
+    if (count < 2) {
+        return false;
+    }
+
+    // 两遍计算：先求均值，再累加离差平方和与离差积和，避免大数相减
+    const Sample& origin = samples[0];
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        meanX += centredX(samples[i], origin);
+        meanY += centredY(samples[i], origin);
+    }
+    meanX /= count;
+    meanY /= count;
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        double dx = centredX(samples[i], origin) - meanX;
+        double dy = centredY(samples[i], origin) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx <= 0.0) {
+        return false;
+    }
+
+    finishFit(samples, count, sxy / sxx, meanX, meanY, result);
+    result.slopeError = count > 2 ? sqrt(result.residualRms * result.residualRms * count / (count - 2) / sxx) : 0.0;
+    return true;
+}
+
+bool ClockFit::fitOffset(const Sample* samples, uint16_t count, double slope, Result& result) {
+    if (count < 1) {
+        return false;
+    }
+
+    const Sample& origin = samples[0];
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        meanX += centredX(samples[i], origin);
+        meanY += centredY(samples[i], origin);
+    }
+    meanX /= count;
+    meanY /= count;
+
+    finishFit(samples, count, slope, meanX, meanY, result);
+    result.slopeError = 0.0;
+    return true;
+}
+
+// 拟合桶最小值，斜率偏差超过maxSkewPpm时固定斜率为1
+static bool fitMinima(const ClockFit::Sample* minima, uint16_t count, double maxSkewPpm, ClockFit::Result& result) {
+    if (!ClockFit::fitLeastSquares(minima, count, result)) {
+        return false;
+    }
+    if (fabs(ClockFit::skewPpm(result.slope)) > maxSkewPpm) {
+        return ClockFit::fitOffset(minima, count, 1.0, result);
+    }
+    return true;
+}
+
+bool ClockFit::fitLowerEnvelope(const Sample* samples, uint16_t count, uint8_t bucketCount, double outlierMs,
+                                double maxSkewPpm, Result& result) {
+    if (count < 2) {
+        return false;
+    }
+    if (bucketCount > MAX_ENVELOPE_BUCKETS) {
+        bucketCount = MAX_ENVELOPE_BUCKETS;
+    }
+    if (bucketCount < 2) {
+        bucketCount = 2;
+    }
+
+    // 样本不要求按时间排列：先求传感器时间范围再分桶
+    const Sample& origin = samples[0];
+    double minX = 0.0;
+    double maxX = 0.0;
+    for (uint16_t i = 0; i < count; i++) {
+        double x = centredX(samples[i], origin);
+        if (x < minX) minX = x;
+        if (x > maxX) maxX = x;
+    }
+    double span = maxX - minX;
+    if (span <= 0.0) {
+        return false;
+    }
+
+    // 每桶延迟（y - x，斜率接近1，桶内的斜率误差可忽略）最小的样本
+    int16_t bucketMin[MAX_ENVELOPE_BUCKETS];
+    double bucketDelay[MAX_ENVELOPE_BUCKETS];
+    for (uint8_t b = 0; b < bucketCount; b++) {
+        bucketMin[b] = -1;
+        bucketDelay[b] = 0.0;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        double x = centredX(samples[i], origin);
+        uint8_t b = (uint8_t)((x - minX) * bucketCount / span);
+        if (b >= bucketCount) {
+            b = bucketCount - 1;
+        }
+        double delay = centredY(samples[i], origin) - x;
+        if (bucketMin[b] < 0 || delay < bucketDelay[b]) {
+            bucketMin[b] = (int16_t)i;
+            bucketDelay[b] = delay;
+        }
+    }
+
+    Sample minima[MAX_ENVELOPE_BUCKETS];
+    uint16_t minimaCount = 0;
+    for (uint8_t b = 0; b < bucketCount; b++) {
+        if (bucketMin[b] >= 0) {
+            minima[minimaCount++] = samples[bucketMin[b]];
+        }
+    }
+    if (!fitMinima(minima, minimaCount, maxSkewPpm, result)) {
+        return false;
+    }
+
+    // 剔除残差超过阈值的桶最小值（传感器时间跳变、异常提前的样本，或整桶都是重传尖峰），剩余至少2个时重新拟合
+    uint16_t rejected = 0;
+    if (result.residualMax > outlierMs) {
+        Sample kept[MAX_ENVELOPE_BUCKETS];
+        uint16_t keptCount = 0;
+        for (uint16_t i = 0; i < minimaCount; i++) {
+            // 以第一个桶最小值为基准展开传感器时间，兼容回绕
+            double x = (double)minima[0].sensorTimeMs + centredX(minima[i], minima[0]);
+            double predicted = result.slope * x + result.intercept;
+            double residual = (double)minima[i].espTimeUs / 1000.0 - predicted;
+            if (fabs(residual) <= outlierMs) {
+                kept[keptCount++] = minima[i];
+            }
+        }
+        Result refit;
+        if (keptCount >= 2 && keptCount < minimaCount && fitMinima(kept, keptCount, maxSkewPpm, refit)) {
+            rejected = minimaCount - keptCount;
+            result = refit;
+        }
+    }
+    result.rejected = rejected;
+    return true;
+}
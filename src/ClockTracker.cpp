@@ -0,0 +1,162 @@
+#include "ClockTracker.h"
+#include <math.h>
+#include <string.h>
+
+// 误差均方根的平滑系数
+static const float ERROR_RMS_ALPHA = 0.01f;
+
+ClockTracker::ClockTracker() {
+    timeConstantMs = 10000.0f;
+    maxSlew = 2000e-6f;
+    maxSkew = 500e-6f;
+    relockThresholdMs = 200.0f;
+    envelopeWindowMs = 0.0f;
+    stop();
+    memset(&stats, 0, sizeof(stats));
+}
+
+void ClockTracker::configure(float timeConstantMs, float maxSlewPpm, float maxSkewPpm, float relockThresholdMs,
+                             float envelopeWindowMs) {
+    this->timeConstantMs = timeConstantMs;
+    this->maxSlew = maxSlewPpm * 1e-6f;
+    this->maxSkew = maxSkewPpm * 1e-6f;
+    this->relockThresholdMs = relockThresholdMs;
+    this->envelopeWindowMs = envelopeWindowMs;
+}
+
+void ClockTracker::start(double slope, double intercept) {
+    active = true;
+    anchored = false;
+    anchorSensor = 0;
+    anchorEsp = 0.0;
+    skew = slope - 1.0;
+    if (skew > maxSkew) skew = maxSkew;
+    if (skew < -maxSkew) skew = -maxSkew;
+    startIntercept = intercept;
+    windowOpen = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void ClockTracker::stop() {
+    active = false;
+    anchored = false;
+    anchorSensor = 0;
+    anchorEsp = 0.0;
+    skew = 0.0;
+    startIntercept = 0.0;
+    windowOpen = false;
+    windowStart = 0;
+    windowMinError = 0.0;
+}
+
+void ClockTracker::relock(uint32_t sensorTimeMs, double espTimeMs) {
+    anchorSensor = sensorTimeMs;
+    anchorEsp = espTimeMs;
+    anchored = true;
+}
+
+ClockTracker::Model ClockTracker::getModel() const {
+    Model model;
+    model.anchored = anchored;
+    model.anchorSensor = anchorSensor;
+    model.anchorEsp = anchorEsp;
+    model.slope = 1.0 + skew;
+    model.intercept = startIntercept;
+    return model;
+}
+
+double ClockTracker::evaluate(const Model& model, uint32_t sensorTimeMs) {
+    if (!model.anchored) {
+        return model.slope * sensorTimeMs + model.intercept;
+    }
+    // 差值按int32计算，兼容传感器时间回绕和锚点之前的时间
+    return model.anchorEsp + model.slope * (double)(int32_t)(sensorTimeMs - model.anchorSensor);
+}
+
+double ClockTracker::interceptOf(const Model& model) {
+    if (!model.anchored) {
+        return model.intercept;
+    }
+    return model.anchorEsp - model.slope * model.anchorSensor;
+}
+
+bool ClockTracker::update(uint32_t sensorTimeMs, int64_t espTimeUs) {
+    if (!active) {
+        return true;
+    }
+
+    double measured = (double)espTimeUs / 1000.0;
+    double predicted = estimate(sensorTimeMs);
+    if (!anchored) {
+        // 第一个时间对：锚点放在拟合直线上，不产生跳变
+        relock(sensorTimeMs, predicted);
+    }
+
+    double error = measured - predicted;
+    stats.updates++;
+
+    if (envelopeWindowMs > 0.0f) {
+        // 下包络：窗口内只记录误差最小值，窗口结束（或传感器时间倒退）时用最小值修正一次
+        if (!windowOpen) {
+            windowOpen = true;
+            windowStart = sensorTimeMs;
+            windowMinError = error;
+        } else if (error < windowMinError) {
+            windowMinError = error;
+        }
+        int32_t windowElapsed = (int32_t)(sensorTimeMs - windowStart);
+        if (windowElapsed >= 0 && windowElapsed < envelopeWindowMs) {
+            return true;
+        }
+        error = windowMinError;
+        windowOpen = false;
+    }
+    stats.corrections++;
+    stats.lastError = (float)error;
+
+    if (fabs(error) > relockThresholdMs) {
+        // 传感器重启或长时间中断后的大误差：不再限速，直接锁定到当前时间对（下包络模式为窗口最小误差）
+        relock(sensorTimeMs, predicted + error);
+        stats.relocks++;
+        stats.maxError = 0.0f;
+        return false;
+    }
+
+    if (fabs(error) > stats.maxError) {
+        stats.maxError = (float)fabs(error);
+    }
+    stats.errorRms = stats.corrections == 1 ? (float)fabs(error)
+        : sqrtf((1.0f - ERROR_RMS_ALPHA) * stats.errorRms * stats.errorRms + ERROR_RMS_ALPHA * (float)(error * error));
+
+    // 距上一个锚点的传感器时间，乱序或重复的时间对不修正相位
+    int32_t elapsed = (int32_t)(sensorTimeMs - anchorSensor);
+    double dt = elapsed > 0 ? (double)elapsed : 0.0;
+    if (dt > timeConstantMs) {
+        dt = timeConstantMs;
+    }
+
+    // 相位修正：误差按时间常数衰减，修正速度不超过maxSlew，保证时间戳不倒退
+    double step = error * dt / timeConstantMs;
+    double maxStep = maxSlew * dt;
+    if (step > maxStep) {
+        step = maxStep;
+        stats.slewLimited++;
+    } else if (step < -maxStep) {
+        step = -maxStep;
+        stats.slewLimited++;
+    }
+
+    // 频率修正：积分时间常数为相位时间常数的2倍（临界阻尼）。
+    // 积分使用限速后的误差，到达延迟尖峰只会偏大，否则限速的不对称会使skew产生偏差
+    double integralTimeMs = 2.0 * timeConstantMs;
+    skew += step * timeConstantMs / (integralTimeMs * integralTimeMs);
+    if (skew > maxSkew) skew = maxSkew;
+    if (skew < -maxSkew) skew = -maxSkew;
+
+    // 锚点移到当前时间对：先沿旧模型前进，再加上相位修正
+    if (elapsed >= 0) {
+        anchorEsp = predicted + step;
+        anchorSensor = sensorTimeMs;
+    }
+    return true;
+}
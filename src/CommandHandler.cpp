@@ -1,6 +1,7 @@
 #include "CommandHandler.h"
 #include "Config.h"
 #include "BluetoothConfig.h"
+#include "SessionRecorder.h"
 
 // 静态变量定义
 bool CommandHandler::realtimeDataEnabled = false;
@@ -22,6 +23,12 @@ const CommandHandler::Command CommandHandler::commands[] = {
     {"device", "设置设备信息", &CommandHandler::setDeviceInfo},
     {"uart", "测试UART接收", &CommandHandler::testUart},
     {"buffer", "显示缓冲区状态", &CommandHandler::showBufferStatus},
+    {"latency", "显示延迟统计 (latency [reset])", &CommandHandler::showLatency},
+    {"udp", "UDP实时流 (udp [on|off|reset])", &CommandHandler::controlUdpStream},
+    {"local", "本地WebSocket服务器 (local [on|off|reset])", &CommandHandler::controlLocalServer},
+    {"power", "省电上传模式 (power [on|off|reset])", &CommandHandler::controlPowerSave},
+    {"spool", "闪存暂存区 (spool [on|off|reset])", &CommandHandler::controlSpool},
+    {"record", "会话记录 (record [on|off|reset|list|query <会话> [起始ms 结束ms] [传感器]])", &CommandHandler::controlRecorder},
     {"sensors", "显示传感器类型", &CommandHandler::showSensorTypes},
     {"config", "显示配置信息", &CommandHandler::showNetworkConfig},
     {"dropped", "切换显示丢弃数据包", &CommandHandler::toggleDroppedPackets},
@@ -38,6 +45,7 @@ CommandHandler::CommandHandler() {
     sensorData = nullptr;
     timeSync = nullptr;
     bluetoothConfig = nullptr;
+    sessionRecorder = nullptr;
     inputBuffer = "";
     
     Serial0.printf("[CommandHandler] Created\n");
@@ -69,6 +77,13 @@ void CommandHandler::setBluetoothConfig(BluetoothConfig* btConfig) {
     }
 }
 
+void CommandHandler::setSessionRecorder(SessionRecorder* recorder) {
+    sessionRecorder = recorder;
+    if (sessionRecorder) {
+        Serial0.printf("[CommandHandler] SessionRecorder module registered\n");
+    }
+}
+
 void CommandHandler::processChar(char c) {
     // 如果在蓝牙配置模式，转发到蓝牙模块
     if (bluetoothConfig && bluetoothConfig->isConfigMode()) {
@@ -151,12 +166,46 @@ void CommandHandler::showStatus(const String& args) {
     // 显示网络状态（减少栈使用）
     if (webSocketClient) {
         Serial0.printf("\n网络连接:\n");
+        Serial0.printf("  WiFi连接: %s\n", webSocketClient->getStats().wifiConnected ? "已连接" : "未连接");
         Serial0.printf("  服务器连接: %s\n", webSocketClient->getStats().serverConnected ? "已连接" : "未连接");
         Serial0.printf("  发送块数: %d\n", webSocketClient->getStats().totalBlocksSent);
         Serial0.printf("  发送字节: %d\n", webSocketClient->getStats().totalBytesSent);
         Serial0.printf("  发送速率: %.2f blocks/s\n", webSocketClient->getStats().avgSendRate);
         Serial0.printf("  连接尝试: %d\n", webSocketClient->getStats().connectionAttempts);
         Serial0.printf("  连接失败: %d\n", webSocketClient->getStats().connectionFailures);
+        Serial0.printf("  重传窗口: %d 块未确认\n", webSocketClient->getStats().windowOccupancy);
+        Serial0.printf("  重传次数: %d\n", webSocketClient->getStats().retransmissions);
+        Serial0.printf("  已确认块数: %d (最近seq: %u)\n", webSocketClient->getStats().ackedBlocks, 
+                      webSocketClient->getStats().lastAckedSeq);
+        Serial0.printf("  无ack_seq的响应: %u (已忽略)\n", webSocketClient->getStats().unsequencedAcks);
+        Serial0.printf("  ACK往返: 平均 %.1f ms, 最大 %u ms\n", webSocketClient->getStats().avgAckRtt, 
+                      webSocketClient->getStats().maxAckRtt);
+        Serial0.printf("  已写入套接字: %u bytes, 网关待写入: %u bytes\n", webSocketClient->getStats().socketBytesQueued, 
+                      webSocketClient->getStats().pendingBytes);
+        Serial0.printf("  套接字不可写暂停: %u 次\n", webSocketClient->getStats().sendStalls);
+        Serial0.printf("  控制通道: 排队 %d (峰值 %d), 已发送 %u, 丢弃 %u\n", webSocketClient->getStats().controlLaneDepth, 
+                      webSocketClient->getStats().controlLanePeak, webSocketClient->getStats().controlSent, 
+                      webSocketClient->getStats().controlDropped);
+        Serial0.printf("  控制消息延迟: 平均 %.1f ms, 最大 %u ms\n", webSocketClient->getStats().avgControlLatency, 
+                      webSocketClient->getStats().maxControlLatency);
+        Serial0.printf("  上传等级: %s (变化 %u 次)\n", 
+                      RateController::getLevelName((UploadLevel)webSocketClient->getStats().uploadLevel), 
+                      webSocketClient->getStats().levelChanges);
+        Serial0.printf("  上行容量估计: %.0f B/s, 数据速率: %.0f B/s\n", webSocketClient->getStats().capacityEstimate, 
+                      webSocketClient->getStats().demandEstimate);
+        Serial0.printf("  编码: 已编码 %u, 失败 %u, 待发送 %d, 等待空闲缓冲区 %u 次\n", 
+                      webSocketClient->getStats().encodedMessages, webSocketClient->getStats().encodeFailures, 
+                      webSocketClient->getStats().encodedReady, webSocketClient->getStats().encoderStalls);
+        Serial0.printf("  阶段利用率: 编码任务 %.1f%%, 发送 %.1f%%\n", webSocketClient->getStats().encoderUtilization, 
+                      webSocketClient->getStats().transmitUtilization);
+        Serial0.printf("  合并消息: %u, 降级未上传帧: %u\n", webSocketClient->getStats().coalescedMessages, 
+                      webSocketClient->getStats().rateOmittedFrames);
+        Serial0.printf("  订阅 (通道掩码/分频):");
+        for (uint8_t id = 1; id <= SENSOR_DATA_SENSOR_COUNT; id++) {
+            WebSocketClient::SensorSubscription subscription = webSocketClient->getSubscription(id);
+            Serial0.printf(" ID%d=0x%X/%d", id, subscription.channelMask, subscription.rateDivisor);
+        }
+        Serial0.printf(", 未订阅帧: %u\n", webSocketClient->getStats().subscriptionOmittedFrames);
     }
     
     // 显示传感器数据状态（减少栈使用）
@@ -274,17 +323,44 @@ void CommandHandler::showTimeSyncStatus(const String& args) {
     if (timeSync) {
         TimeSync::Stats stats = timeSync->getStats();
         
-        Serial0.printf("NTP偏移: %lld ms\n", stats.ntpOffset);
+        if (stats.ntpValid) {
+            Serial0.printf("NTP偏移: %lld us, 漂移 %.2f ppm, 待修正 %lld us\n",
+                         stats.ntpOffsetUs, stats.ntpDriftPpm, stats.ntpSlewRemainingUs);
+            Serial0.printf("NTP同步: %u 次, 跳变 %u, 逐渐修正 %u, 最大修正 %ld us\n",
+                         stats.ntpStats.measurements, stats.ntpStats.steps, stats.ntpStats.slews,
+                         (long)stats.ntpStats.maxErrorUs);
+            Serial0.printf("NTP历史（最新在前）:\n");
+            for (uint8_t i = 0; i < stats.ntpHistoryCount; i++) {
+                const NtpClock::Measurement& m = stats.ntpHistory[i];
+                Serial0.printf("  %lld s前: 偏移 %lld us, 误差 %ld us, 漂移 %.2f ppm%s\n",
+                             (esp_timer_get_time() - m.espUs) / 1000000, m.offsetUs, (long)m.errorUs,
+                             m.driftPpm, m.stepped ? " (跳变)" : "");
+            }
+        } else {
+            Serial0.printf("NTP偏移: 等待第一次NTP同步（时间戳为ESP32开机后的时间，ntp_synced为false）\n");
+        }
         Serial0.printf("总数据对数量: %d/%d\n", stats.validPairs, stats.windowSize);
         Serial0.printf("最后更新: %d ms前\n", millis() - stats.lastUpdateTime);
+        Serial0.printf("参数读取: 并发重读 %u 次；校准队列溢出 %u 个时间对，最多排队 %u/%u 个\n",
+                     stats.paramReadRetries, stats.pairQueueOverflows, stats.pairQueuePeak, TIME_PAIR_QUEUE_SIZE);
         
         Serial0.printf("\n各传感器状态:\n");
         for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
-            Serial0.printf("  传感器%d: %s (a=%.6f, b=%.2f)\n", 
+            Serial0.printf("  传感器%d: %s (a=%.9f, b=%.3f)\n", 
                          i + 1, 
                          stats.syncReady[i] ? "就绪" : "未就绪",
                          stats.linearParamA[i], 
                          stats.linearParamB[i]);
+            Serial0.printf("    最近拟合: 斜率偏差 %.2f ppm, 残差 rms %.3f ms, max %.3f ms, 剔除 %u\n",
+                         stats.fittedSkewPpm[i], stats.residualRms[i], stats.residualMax[i], stats.fitRejected[i]);
+            Serial0.printf("    时间戳: 同步 %u, 未就绪(原始时间) %u\n",
+                         stats.syncedTimestamps[i], stats.unsyncedTimestamps[i]);
+            if (stats.tracking[i]) {
+                const ClockTracker::Stats& track = stats.trackStats[i];
+                Serial0.printf("    漂移跟踪: 斜率偏差 %.2f ppm, 误差 rms %.3f ms, max %.3f ms, 更新 %u, 限速 %u, 重新锁定 %u\n",
+                             stats.trackSkewPpm[i], track.errorRms, track.maxError,
+                             track.updates, track.slewLimited, track.relocks);
+            }
         }
         
         // 检查是否有任何传感器就绪
@@ -298,8 +374,8 @@ void CommandHandler::showTimeSyncStatus(const String& args) {
         
         if (anyReady) {
             Serial0.printf("\n时间戳计算公式: T = a * S + b + N\n");
-            Serial0.printf("其中: S = 传感器时间(ms), T = 全局时间戳(ms), N = NTP偏移(ms)\n");
-            Serial0.printf("每个传感器有独立的参数 a 和 b\n");
+            Serial0.printf("其中: S = 传感器时间(ms), T = 全局时间戳(ms), N = NTP偏移（周期重新同步，逐渐修正）\n");
+            Serial0.printf("每个传感器有独立的参数 a 和 b，校准完成后随每个时间对持续跟踪漂移\n");
         } else {
             Serial0.printf("\n时间同步未就绪，需要更多数据点进行计算\n");
             Serial0.printf("建议每个传感器至少收集10个有效数据对\n");
@@ -453,6 +529,15 @@ void CommandHandler::showBufferStatus(const String& args) {
             float dropRate = (float)dataStats.droppedFrames / (dataStats.totalFrames + dataStats.droppedFrames) * 100.0f;
             Serial0.printf("  丢帧率: %.2f%%\n", dropRate);
         }
+        
+        Serial0.printf("\n待发送队列 (深度 %d, 策略 %s):\n", Config::BLOCK_QUEUE_DEPTH,
+                      sensorData->getDropPolicy() == BlockDropPolicy::DROP_OLDEST ? "丢弃最旧" : "丢弃最新");
+        Serial0.printf("  排队块数: %d (峰值 %d)\n", dataStats.queuedBlocks, dataStats.peakQueuedBlocks);
+        Serial0.printf("  丢弃块数: %d, 非采集清理块数: %d\n", dataStats.droppedBlocks, dataStats.discardedBlocks);
+        for (int i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+            Serial0.printf("    %s (ID%d): 排队 %d 帧, 丢弃 %d 帧\n", SensorData::getSensorType(i + 1), i + 1,
+                          dataStats.queuedFrames[i], dataStats.droppedFramesBySensor[i]);
+        }
     }
     
     if (uartReceiver) {
@@ -471,6 +556,281 @@ void CommandHandler::showBufferStatus(const String& args) {
     Serial0.printf("==================\n\n");
 }
 
+void CommandHandler::showLatency(const String& args) {
+    if (!webSocketClient) {
+        Serial0.printf("WebSocket客户端未初始化\n");
+        return;
+    }
+    
+    if (args == "reset") {
+        webSocketClient->resetLatencyStats();
+        Serial0.printf("延迟统计已重置\n");
+        return;
+    }
+    
+    const WebSocketClient::LatencyStats& latency = webSocketClient->getLatencyStats();
+    WebSocketClient::Stats netStats = webSocketClient->getStats();
+    
+    Serial0.printf("\n=== 延迟统计 (ms) ===\n");
+    Serial0.printf("Ping: 已发送 %u, 收到pong %u, 超时 %u, 最近 %u ms\n", 
+                  netStats.pingsSent, netStats.pongsReceived, netStats.pingTimeouts, netStats.lastPingRtt);
+    printLatencyHistogram("WebSocket往返 (ping->pong)", latency.pingRtt);
+    printLatencyHistogram("块排队 (封装->发送)", latency.blockQueue);
+    printLatencyHistogram("块确认 (发送->确认)", latency.blockAck);
+    printLatencyHistogram("块端到端 (封装->确认)", latency.blockTotal);
+    Serial0.printf("=====================\n\n");
+}
+
+void CommandHandler::controlUdpStream(const String& args) {
+    if (!webSocketClient) {
+        Serial0.printf("WebSocket客户端未初始化\n");
+        return;
+    }
+    
+    UdpStreamer& udpStreamer = webSocketClient->getUdpStreamer();
+    if (args == "on") {
+        udpStreamer.setEnabled(true);
+    } else if (args == "off") {
+        udpStreamer.setEnabled(false);
+    } else if (args == "reset") {
+        udpStreamer.resetStats();
+        Serial0.printf("UDP统计已重置\n");
+        return;
+    } else if (args.length() > 0) {
+        Serial0.printf("用法: udp [on|off|reset]\n");
+        return;
+    }
+    
+    UdpStreamer::Stats udpStats = udpStreamer.getStats();
+    Serial0.printf("\n=== UDP实时流 ===\n");
+    Serial0.printf("状态: %s, 目标: %s:%d (%s)\n", udpStats.enabled ? "开启" : "关闭", 
+                  udpStreamer.getTargetHost(), udpStreamer.getTargetPort(), udpStats.targetResolved ? "已解析" : "未解析");
+    Serial0.printf("已发送消息: %u, 数据报: %u, 字节: %u\n", udpStats.messagesSent, udpStats.datagramsSent, udpStats.bytesSent);
+    Serial0.printf("发送失败: %u, 超长消息: %u, 解析失败: %u\n", udpStats.sendErrors, udpStats.oversizeMessages, 
+                  udpStats.resolveFailures);
+    Serial0.printf("=================\n\n");
+}
+
+void CommandHandler::controlLocalServer(const String& args) {
+    if (!webSocketClient) {
+        Serial0.printf("WebSocket客户端未初始化\n");
+        return;
+    }
+    
+    LocalStreamServer& localServer = webSocketClient->getLocalServer();
+    if (args == "on") {
+        localServer.begin();
+    } else if (args == "off") {
+        localServer.stop();
+    } else if (args == "reset") {
+        localServer.resetStats();
+        Serial0.printf("本地服务器统计已重置\n");
+        return;
+    } else if (args.length() > 0) {
+        Serial0.printf("用法: local [on|off|reset]\n");
+        return;
+    }
+    
+    LocalStreamServer::Stats localStats = localServer.getStats();
+    Serial0.printf("\n=== 本地WebSocket服务器 ===\n");
+    Serial0.printf("状态: %s, 端口: %d, 客户端: %d/%d (峰值 %d, 拒绝 %u)\n", localStats.running ? "运行中" : "已停止", 
+                  Config::LOCAL_SERVER_PORT, localStats.clients, Config::LOCAL_SERVER_MAX_CLIENTS, 
+                  localStats.peakClients, localStats.rejectedClients);
+    Serial0.printf("已转发消息: %u, 客户端写入: %u, 跳过: %u, 分多轮写入: %u, 卡住断开: %u, 失败: %u\n", localStats.messagesBroadcast, 
+                  localStats.clientSends, localStats.clientSkips, localStats.deferredSends, localStats.stalledClients, 
+                  localStats.sendFailures);
+    Serial0.printf("转发耗时: 平均 %.0f us, 最大 %u us\n", localStats.avgFanoutUs, localStats.maxFanoutUs);
+    Serial0.printf("上游断开期间窗口满而暂留: %u 条\n", webSocketClient->getStats().parkedMessages);
+    Serial0.printf("===========================\n\n");
+}
+
+void CommandHandler::controlPowerSave(const String& args) {
+    if (!webSocketClient) {
+        Serial0.printf("WebSocket客户端未初始化\n");
+        return;
+    }
+    
+    if (args == "on" || args == "off") {
+        webSocketClient->setPowerSaveEnabled(args == "on");
+        Serial0.printf("省电上传模式将%s\n", args == "on" ? "开启" : "关闭");
+        return;
+    } else if (args == "reset") {
+        webSocketClient->resetPowerStats();
+        Serial0.printf("省电统计已重置\n");
+        return;
+    } else if (args.length() > 0) {
+        Serial0.printf("用法: power [on|off|reset]\n");
+        return;
+    }
+    
+    const PowerScheduler& scheduler = webSocketClient->getPowerScheduler();
+    WebSocketClient::Stats netStats = webSocketClient->getStats();
+    uint32_t now = millis();
+    Serial0.printf("\n=== 省电上传 ===\n");
+    Serial0.printf("阶段: %s, 窗口: %u ms, 下次上传: %u ms后\n", 
+                  PowerScheduler::getPhaseName(scheduler.getPhase()), Config::POWER_BATCH_WINDOW_MS, 
+                  scheduler.getTimeToNextBurst(now));
+    Serial0.printf("暂存块: %d/%d\n", netStats.heldBlocks, Config::POWER_HOLD_MAX_BLOCKS);
+    Serial0.printf("集中上传: %u 次 (提前 %u, 超时 %u), 最近 %u ms, 最长 %u ms\n", scheduler.getBurstCount(), 
+                  scheduler.getEarlyFlushes(), scheduler.getBurstTimeouts(), scheduler.getLastBurstMs(), 
+                  scheduler.getMaxBurstMs());
+    Serial0.printf("无线电常开占比: %.1f%%, 估计每分钟常开: %.0f ms\n", netStats.radioDutyCycle * 100.0f, 
+                  netStats.radioOnMsPerMinute);
+    Serial0.printf("================\n\n");
+}
+
+void CommandHandler::controlSpool(const String& args) {
+    if (!webSocketClient) {
+        Serial0.printf("WebSocket客户端未初始化\n");
+        return;
+    }
+    
+    if (args == "on" || args == "off") {
+        webSocketClient->setSpoolEnabled(args == "on");
+    } else if (args == "reset") {
+        webSocketClient->resetSpoolStats();
+        Serial0.printf("暂存区统计将在编码任务下一轮重置\n");
+        return;
+    } else if (args.length() > 0) {
+        Serial0.printf("用法: spool [on|off|reset]\n");
+        return;
+    }
+    
+    BlockSpool::Stats spoolStats = webSocketClient->getSpoolStats();
+    WebSocketClient::Stats netStats = webSocketClient->getStats();
+    Serial0.printf("\n=== 闪存暂存区 ===\n");
+    Serial0.printf("状态: %s, 容量: %u KB\n", webSocketClient->isSpoolEnabled() ? "开启" : "关闭", 
+                  spoolStats.capacityBytes / 1024);
+    Serial0.printf("占用: %u KB (%.1f%%), 待上传块: %u\n", spoolStats.usedBytes / 1024, netStats.spoolFill, 
+                  spoolStats.pendingRecords);
+    Serial0.printf("写入速率: %.0f bytes/s, 读回速率: %.1f blocks/s\n", netStats.spoolWriteRate, netStats.spoolDrainRate);
+    Serial0.printf("已暂存块: %u, 已读回块: %u, 丢弃块: %u\n", netStats.spooledBlocks, netStats.unspooledBlocks, 
+                  netStats.spoolDroppedBlocks);
+    Serial0.printf("闪存写入: %u 次 / %u KB, 擦除扇区: %u (写入时擦除 %u)\n", spoolStats.flushes, 
+                  spoolStats.bytesFlushed / 1024, spoolStats.sectorsErased, spoolStats.inlineErases);
+    Serial0.printf("补传: %s, 份额: %.2f (实际 %.2f), 实时/补传消息: %u/%u, 转入补传块: %u, 最近一次补传: %u ms\n",
+                  netStats.catchupActive ? "进行中" : "空闲", netStats.backlogShare, netStats.measuredBacklogShare,
+                  netStats.liveMessages, netStats.backlogMessages, netStats.demotedBlocks, netStats.lastCatchupMs);
+    Serial0.printf("损坏记录: %u, 写入错误: %u, 读取错误: %u\n", spoolStats.corruptRecords, spoolStats.writeErrors, 
+                  spoolStats.readErrors);
+    Serial0.printf("==================\n\n");
+}
+
+// record query的输出状态：只逐条显示前若干个块，其余只计数
+struct RecordQueryOutput {
+    uint32_t blocks;
+    uint32_t frames;
+    static const uint32_t MAX_LINES = 20;
+};
+
+static bool printRecordedBlock(const DataBlock& block, void* context) {
+    RecordQueryOutput* output = (RecordQueryOutput*)context;
+    output->blocks++;
+    output->frames += block.frameCount;
+    if (output->blocks <= RecordQueryOutput::MAX_LINES && block.frameCount > 0) {
+        Serial0.printf("  块 %u: %u 帧, %llu - %llu ms, 各传感器 %u/%u/%u/%u\n", block.blockId, block.frameCount,
+                      block.frames[0].rawTimestamp, block.frames[block.frameCount - 1].rawTimestamp,
+                      block.sensorFrameCounts[0], block.sensorFrameCounts[1], block.sensorFrameCounts[2],
+                      block.sensorFrameCounts[3]);
+    }
+    return true;
+}
+
+void CommandHandler::controlRecorder(const String& args) {
+    if (!sessionRecorder || !sessionRecorder->isReady()) {
+        Serial0.printf("会话记录不可用\n");
+        return;
+    }
+    
+    if (args == "on" || args == "off") {
+        sessionRecorder->setEnabled(args == "on");
+    } else if (args == "reset") {
+        sessionRecorder->resetStats();
+        Serial0.printf("会话记录统计已重置\n");
+        return;
+    } else if (args == "list") {
+        SessionLog::SessionSummary sessions[16];
+        size_t count = sessionRecorder->listSessions(sessions, 16);
+        Serial0.printf("\n=== 已记录会话 (%u) ===\n", count);
+        for (size_t i = 0; i < count; i++) {
+            char sessionId[32];
+            if (!sessionRecorder->getSessionId(sessions[i].sessionNumber, sessionId, sizeof(sessionId))) {
+                sessionId[0] = '\0';
+            }
+            Serial0.printf("会话 %u (session_id '%s'): %u 段, %u 块, %u 帧, %llu - %llu ms%s\n", 
+                          sessions[i].sessionNumber, sessionId, sessions[i].segmentCount, sessions[i].recordCount,
+                          sessions[i].frameCount, sessions[i].recordCount > 0 ? sessions[i].minTimestamp : 0,
+                          sessions[i].maxTimestamp, sessions[i].complete ? "" : " (进行中或未正常结束)");
+        }
+        Serial0.printf("====================\n\n");
+        return;
+    } else if (args.startsWith("query")) {
+        unsigned long sessionNumber = 0;
+        unsigned long long fromTimestamp = 0;
+        unsigned long long toTimestamp = UINT64_MAX;
+        unsigned int sensorId = 0;
+        int fields = sscanf(args.c_str(), "query %lu %llu %llu %u", &sessionNumber, &fromTimestamp, &toTimestamp, &sensorId);
+        if (fields < 1 || fields == 2 || sensorId > SENSOR_DATA_SENSOR_COUNT) {
+            Serial0.printf("用法: record query <会话> [起始ms 结束ms] [传感器1-4]\n");
+            return;
+        }
+        
+        RecordQueryOutput output = {0, 0};
+        SessionLog::QueryStats queryStats;
+        uint32_t startTime = millis();
+        sessionRecorder->query(sessionNumber, fromTimestamp, toTimestamp, sensorId, printRecordedBlock, &output, &queryStats);
+        if (output.blocks > RecordQueryOutput::MAX_LINES) {
+            Serial0.printf("  ... 其余 %u 块未显示\n", output.blocks - RecordQueryOutput::MAX_LINES);
+        }
+        Serial0.printf("匹配: %u 块 / %u 帧, 读取段: %u, 跳过段: %u, 扫描记录: %u, 损坏记录: %u, 耗时: %u ms\n\n",
+                      output.blocks, output.frames, queryStats.segmentsTouched, queryStats.segmentsSkipped,
+                      queryStats.recordsScanned, queryStats.corruptRecords, millis() - startTime);
+        return;
+    } else if (args.length() > 0) {
+        Serial0.printf("用法: record [on|off|reset|list|query <会话> [起始ms 结束ms] [传感器]]\n");
+        return;
+    }
+    
+    SessionRecorder::Stats recorderStats = sessionRecorder->getStats();
+    SessionLog::Stats logStats = sessionRecorder->getLogStats();
+    Serial0.printf("\n=== 会话记录 ===\n");
+    Serial0.printf("状态: %s, 当前会话: %u, 段: %u/%u (每段 %u KB)\n", sessionRecorder->isEnabled() ? "开启" : "关闭",
+                  sessionRecorder->getActiveSession(), logStats.usedSegments, logStats.segmentCount,
+                  Config::RECORDER_SEGMENT_SIZE / 1024);
+    Serial0.printf("提交块: %u, 已记录: %u, 槽位耗尽丢弃: %u, 写入失败: %u, 队列: %u (峰值 %u)\n", 
+                  recorderStats.offeredBlocks, recorderStats.recordedBlocks, recorderStats.droppedBlocks,
+                  recorderStats.failedBlocks, sessionRecorder->getQueuedItems(), recorderStats.peakQueuedItems);
+    Serial0.printf("闪存写入: %u 次 / %u KB, 擦除扇区: %u (写入时擦除 %u)\n", logStats.flushes, 
+                  logStats.bytesFlushed / 1024, logStats.sectorsErased, logStats.inlineErases);
+    Serial0.printf("封闭段: %u, 回收段: %u, 启动恢复段: %u, 写入错误: %u, 读取错误: %u\n", logStats.segmentsSealed,
+                  logStats.segmentsReclaimed, logStats.segmentsRecovered, logStats.writeErrors, logStats.readErrors);
+    Serial0.printf("================\n\n");
+}
+
+void CommandHandler::printLatencyHistogram(const char* name, const LatencyHistogram& histogram) {
+    Serial0.printf("\n%s: 样本 %u\n", name, histogram.getCount());
+    if (histogram.getCount() == 0) {
+        return;
+    }
+    Serial0.printf("  min %u, avg %.1f, p50 %u, p99 %u, max %u\n", histogram.getMin(), histogram.getAvg(),
+                  histogram.getPercentile(50.0f), histogram.getPercentile(99.0f), histogram.getMax());
+    
+    // 只显示非空桶
+    uint32_t lowerBound = 0;
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        uint32_t upperBound = LatencyHistogram::getBucketBound(i);
+        uint32_t bucketCount = histogram.getBucketCount(i);
+        if (bucketCount > 0) {
+            if (upperBound == UINT32_MAX) {
+                Serial0.printf("  >%u: %u\n", lowerBound, bucketCount);
+            } else {
+                Serial0.printf("  %u-%u: %u\n", lowerBound, upperBound, bucketCount);
+            }
+        }
+        lowerBound = upperBound;
+    }
+}
+
 String CommandHandler::parseCommand(const String& input, String& args) {
     String trimmedInput = input;
     trimmedInput.trim();
@@ -517,9 +877,14 @@ void CommandHandler::showNetworkConfig(const String& args) {
     if (webSocketClient) {
         WebSocketClient::Stats netStats = webSocketClient->getStats();
         Serial0.printf("\n连接状态:\n");
+        Serial0.printf("  WiFi连接: %s\n", netStats.wifiConnected ? "已连接" : "未连接");
         Serial0.printf("  服务器连接: %s\n", netStats.serverConnected ? "已连接" : "未连接");
         Serial0.printf("  连接尝试次数: %d\n", netStats.connectionAttempts);
         Serial0.printf("  连接失败次数: %d\n", netStats.connectionFailures);
+        Serial0.printf("  WiFi断开: %u 次, 重连尝试: %u 次\n", netStats.wifiDisconnects, netStats.wifiReconnectAttempts);
+        Serial0.printf("  WiFi恢复耗时: 最近 %u ms, 最大 %u ms\n", netStats.lastWifiReconnectMs, netStats.maxWifiReconnectMs);
+        Serial0.printf("  服务器断开: %u 次\n", netStats.serverDisconnects);
+        Serial0.printf("  服务器恢复耗时: 最近 %u ms, 最大 %u ms\n", netStats.lastServerReconnectMs, netStats.maxServerReconnectMs);
         Serial0.printf("  发送块数: %d\n", netStats.totalBlocksSent);
         Serial0.printf("  发送字节数: %d\n", netStats.totalBytesSent);
         Serial0.printf("  发送速率: %.2f blocks/s\n", netStats.avgSendRate);
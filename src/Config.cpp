@@ -7,6 +7,23 @@ const char* Config::SERVER_URL = "175.178.100.179";
 const uint16_t Config::SERVER_PORT = 8000;
 const char* Config::WEBSOCKET_PATH = "/ws/esp32/";  // 基础路径，device_code会动态添加
 
+// UDP实时流配置
+const bool Config::UDP_STREAM_ENABLED = false;
+const char* Config::UDP_STREAM_HOST = "175.178.100.179";
+const uint16_t Config::UDP_STREAM_PORT = 8001;
+const size_t Config::UDP_DATAGRAM_SIZE = 1400;
+const uint32_t Config::UDP_RESOLVE_RETRY_MS = 5000;
+
+// 本地WebSocket服务器配置
+const bool Config::LOCAL_SERVER_ENABLED = false;
+const uint16_t Config::LOCAL_SERVER_PORT = 81;
+const uint8_t Config::LOCAL_SERVER_MAX_CLIENTS = 4;
+const bool Config::LOCAL_SERVER_SOFTAP = false;
+const char* Config::LOCAL_AP_SSID = "KineTrack-GW";
+const char* Config::LOCAL_AP_PASSWORD = "";  // 每台设备单独设置（WPA2，至少8个字符），未设置时不开启SoftAP
+const size_t Config::LOCAL_FRAGMENT_SIZE = 1436;
+const uint32_t Config::LOCAL_CLIENT_STALL_MS = 2000;
+
 // UART配置
 const uint32_t Config::UART_BAUD_RATE = 115200;
 const int Config::UART_TX_PIN = 17;
@@ -16,6 +33,7 @@ const int Config::UART_RX_PIN = 16;
 const size_t Config::RING_BUFFER_SIZE = 4096;
 const size_t Config::BLOCK_POOL_SIZE = 20;
 const size_t Config::MAX_FRAMES_PER_BLOCK = 30;
+const size_t Config::BLOCK_QUEUE_DEPTH = 10;
 
 // 任务配置
 const uint32_t Config::UART_TASK_STACK_SIZE = 4096;
@@ -28,12 +46,69 @@ const uint32_t Config::NETWORK_TASK_PRIORITY = 2;
 const uint32_t Config::CLI_TASK_PRIORITY = 1;
 const uint32_t Config::MONITOR_TASK_PRIORITY = 1;
 
+const uint32_t Config::ENCODER_TASK_STACK_SIZE = 8192;
+const uint32_t Config::ENCODER_TASK_PRIORITY = 2;       // 低于UART任务，不影响数据接收
+const BaseType_t Config::ENCODER_TASK_CORE = 0;
+const uint8_t Config::ENCODE_BUFFER_COUNT = 3;
+const size_t Config::ENCODE_BUFFER_SIZE = 24576;         // 每帧最坏256字节：1024 + 3块 x 30帧 x 256 = 24064
+
+const uint32_t Config::NETWORK_LOOP_INTERVAL_MS = 10;
+
 // 传感器配置
 const uint8_t Config::SENSOR_COUNT = 4;
 const uint8_t Config::FRAME_SIZE = 43; // 帧头(1) + 时间戳(4) + 加速度(12) + 角速度(12) + 角度(12) + ID(1) + 帧尾(1)
 
+// 上传速率控制配置
+const uint32_t Config::RATE_CONTROL_INTERVAL_MS = 1000;
+const uint32_t Config::RATE_CONTROL_HOLD_MS = 3000;
+const uint8_t Config::RATE_RECOVER_INTERVALS = 5;
+const uint32_t Config::RATE_QUEUE_HIGH_WATERMARK = 5;      // BLOCK_QUEUE_DEPTH的一半
+const uint32_t Config::RATE_QUEUE_LOW_WATERMARK = 1;
+const uint8_t Config::COALESCE_MAX_BLOCKS = 3;
+const uint8_t Config::DECIMATION_FACTOR = 2;
+const uint8_t Config::LOW_PRIORITY_SENSOR_MASK = 0x03;     // 腰部、肩部；保留手腕和球拍
+
+// 省电上传配置
+const bool Config::POWER_SAVE_ENABLED = false;
+const uint32_t Config::POWER_BATCH_WINDOW_MS = 5000;
+const uint32_t Config::POWER_MAX_BURST_MS = 2000;
+const uint16_t Config::POWER_HOLD_MAX_BLOCKS = 128;            // 约256KB，超出块池的部分放在PSRAM
+const uint16_t Config::POWER_FLUSH_THRESHOLD_BLOCKS = 96;
+const uint32_t Config::POWER_IDLE_LOOP_INTERVAL_MS = 100;
+
+// 闪存暂存配置
+const bool Config::SPOOL_ENABLED = true;
+const size_t Config::SPOOL_REGION_OFFSET = 0;
+const size_t Config::SPOOL_REGION_SIZE = 0x300000;           // 3MB，约1800个块（每块约1.7KB），剩余部分留给会话记录
+const size_t Config::SPOOL_WRITE_BUFFER_SIZE = 16384;        // 4个扇区，优先放在PSRAM
+const uint32_t Config::SPOOL_BACKLOG_BLOCKS = 8;             // BLOCK_QUEUE_DEPTH为10，接近丢弃前开始暂存
+const float Config::CATCHUP_BACKLOG_SHARE = 0.5f;
+const float Config::CATCHUP_MAX_BACKLOG_SHARE = 0.85f;
+const float Config::CATCHUP_LIVE_MARGIN = 1.5f;
+const uint32_t Config::CATCHUP_LIVE_QUEUE_BLOCKS = 2;         // 约150ms的数据
+
+// 会话记录配置
+const bool Config::RECORDER_ENABLED = true;
+const size_t Config::RECORDER_REGION_OFFSET = 0x300000;      // 紧接暂存区之后
+const size_t Config::RECORDER_REGION_SIZE = 0x2E0000;        // 46个段，约1500个块；满后回收最旧的段
+const size_t Config::RECORDER_SEGMENT_SIZE = 0x10000;        // 64KB，约33个块（每块约1.9KB）
+const size_t Config::RECORDER_WRITE_BUFFER_SIZE = 8192;
+const uint8_t Config::RECORDER_QUEUE_ITEMS = 16;              // 每个约2KB，优先放在PSRAM
+const uint32_t Config::RECORDER_FLUSH_INTERVAL_MS = 2000;
+const uint32_t Config::RECORDER_TASK_STACK_SIZE = 4096;
+const uint32_t Config::RECORDER_TASK_PRIORITY = 1;           // 最低，闪存写入和擦除不抢占采集与上传
+const BaseType_t Config::RECORDER_TASK_CORE = 1;
+const uint32_t Config::RESEND_PROGRESS_INTERVAL_MS = 1000;
+
+// 重连配置
+const uint32_t Config::WIFI_RECONNECT_BASE_DELAY_MS = 2000;    // WiFi关联通常需要数秒，基础间隔较长
+const uint32_t Config::WIFI_RECONNECT_MAX_DELAY_MS = 60000;
+const uint32_t Config::SERVER_RECONNECT_BASE_DELAY_MS = 1000;
+const uint32_t Config::SERVER_RECONNECT_MAX_DELAY_MS = 30000;
+
 // 时间配置
 const uint32_t Config::HEARTBEAT_INTERVAL = 30000;    // 30秒
+const uint32_t Config::PING_INTERVAL_MS = 5000;       // WebSocket ping间隔，用于测量往返延迟
 const uint32_t Config::STATUS_INTERVAL = 30000;       // 30秒
 const uint32_t Config::HEALTH_CHECK_INTERVAL = 60000; // 60秒
 
@@ -41,6 +116,18 @@ const uint32_t Config::HEALTH_CHECK_INTERVAL = 60000; // 60秒
 const uint32_t Config::TIME_SYNC_INTERVAL_MS = 2000;        // 2秒
 const uint8_t Config::TIME_SYNC_CALC_COUNT = 5;             // 每个传感器计算3次
 const uint32_t Config::TIME_SYNC_CALC_INTERVAL_MS = 2000;   // 2秒计算一次
+const float Config::TIME_SYNC_MAX_SKEW_PPM = 500.0f;        // 晶振偏差一般在±100ppm以内
+const float Config::TIME_SYNC_TRACK_TIME_CONSTANT_MS = 10000.0f; // 10秒，平滑BLE/UART到达抖动
+const float Config::TIME_SYNC_MAX_SLEW_PPM = 2000.0f;       // 每秒最多修正2ms
+const float Config::TIME_SYNC_RELOCK_THRESHOLD_MS = 200.0f;
+const bool Config::TIME_SYNC_LOWER_ENVELOPE = true;
+const uint8_t Config::TIME_SYNC_ENVELOPE_BUCKETS = 10;      // 50个样本每桶约5个
+const float Config::TIME_SYNC_OUTLIER_MS = 5.0f;
+const float Config::TIME_SYNC_TRACK_ENVELOPE_MS = 500.0f;
+const uint32_t Config::NTP_SYNC_INTERVAL_MS = 600000;       // 10分钟（lwIP SNTP最小15秒）
+const float Config::NTP_MAX_SLEW_PPM = 500.0f;              // 每秒最多修正0.5ms
+const float Config::NTP_STEP_THRESHOLD_MS = 1000.0f;
+const float Config::NTP_MAX_DRIFT_PPM = 200.0f;
 
 // 设备配置
 const char* Config::DEVICE_CODE = "2025001";
@@ -62,6 +149,14 @@ void Config::printConfig() {
     Serial0.printf("  服务器地址: %s:%d\n", SERVER_URL, SERVER_PORT);
     Serial0.printf("  WebSocket路径: %s%s/\n", WEBSOCKET_PATH, DEVICE_CODE);
     Serial0.printf("  数据包类型: %s\n", SENSOR_DATA_PACKET_TYPE);
+    Serial0.printf("  UDP实时流: %s, %s:%d, 数据报 %d bytes\n", UDP_STREAM_ENABLED ? "开启" : "关闭", 
+                  UDP_STREAM_HOST, UDP_STREAM_PORT, UDP_DATAGRAM_SIZE);
+    Serial0.printf("  本地服务器: %s, 端口 %d, 最多 %d 客户端, SoftAP: %s\n", LOCAL_SERVER_ENABLED ? "开启" : "关闭", 
+                  LOCAL_SERVER_PORT, LOCAL_SERVER_MAX_CLIENTS, LOCAL_SERVER_SOFTAP ? LOCAL_AP_SSID : "关闭");
+    if (LOCAL_SERVER_SOFTAP && strlen(LOCAL_AP_PASSWORD) < 8) {
+        Serial0.printf("  SoftAP密码未设置（至少8个字符），SoftAP不会开启\n");
+    }
+    Serial0.printf("  本地转发分片: %d bytes, 客户端卡住 %d ms 后断开\n", LOCAL_FRAGMENT_SIZE, LOCAL_CLIENT_STALL_MS);
     Serial0.printf("\nUART配置:\n");
     Serial0.printf("  波特率: %d\n", UART_BAUD_RATE);
     Serial0.printf("  UART1: TX=%d, RX=%d\n", UART_TX_PIN, UART_RX_PIN);
@@ -69,15 +164,52 @@ void Config::printConfig() {
     Serial0.printf("  环形缓冲区大小: %d bytes\n", RING_BUFFER_SIZE);
     Serial0.printf("  块池大小: %d blocks\n", BLOCK_POOL_SIZE);
     Serial0.printf("  每块最大帧数: %d\n", MAX_FRAMES_PER_BLOCK);
+    Serial0.printf("  待发送队列深度: %d blocks\n", BLOCK_QUEUE_DEPTH);
     Serial0.printf("\n任务配置:\n");
     Serial0.printf("  UART任务: 栈大小=%d, 优先级=%d\n", UART_TASK_STACK_SIZE, UART_TASK_PRIORITY);
     Serial0.printf("  网络任务: 栈大小=%d, 优先级=%d\n", NETWORK_TASK_STACK_SIZE, NETWORK_TASK_PRIORITY);
     Serial0.printf("  CLI任务: 栈大小=%d, 优先级=%d\n", CLI_TASK_STACK_SIZE, CLI_TASK_PRIORITY);
     Serial0.printf("  监控任务: 栈大小=%d, 优先级=%d\n", MONITOR_TASK_STACK_SIZE, MONITOR_TASK_PRIORITY);
+    Serial0.printf("  网络任务最长等待: %d ms\n", NETWORK_LOOP_INTERVAL_MS);
+    Serial0.printf("  编码任务: 栈大小=%d, 优先级=%d, Core %d\n", ENCODER_TASK_STACK_SIZE, ENCODER_TASK_PRIORITY, ENCODER_TASK_CORE);
+    Serial0.printf("  编码输出缓冲区: %d x %d bytes\n", ENCODE_BUFFER_COUNT, ENCODE_BUFFER_SIZE);
+    Serial0.printf("\n上传速率控制:\n");
+    Serial0.printf("  控制周期: %d ms, 保持时间: %d ms, 恢复周期数: %d\n", 
+                  RATE_CONTROL_INTERVAL_MS, RATE_CONTROL_HOLD_MS, RATE_RECOVER_INTERVALS);
+    Serial0.printf("  队列水位: 高 %d, 低 %d\n", RATE_QUEUE_HIGH_WATERMARK, RATE_QUEUE_LOW_WATERMARK);
+    Serial0.printf("  合并块数: %d, 抽帧系数: %d, 低优先级传感器掩码: 0x%02X\n", 
+                  COALESCE_MAX_BLOCKS, DECIMATION_FACTOR, LOW_PRIORITY_SENSOR_MASK);
+    Serial0.printf("\n省电上传:\n");
+    Serial0.printf("  %s, 窗口: %d ms, 最长突发: %d ms\n", POWER_SAVE_ENABLED ? "开启" : "关闭", 
+                  POWER_BATCH_WINDOW_MS, POWER_MAX_BURST_MS);
+    Serial0.printf("  暂存上限: %d blocks, 提前上传: %d blocks, 空闲等待: %d ms\n", 
+                  POWER_HOLD_MAX_BLOCKS, POWER_FLUSH_THRESHOLD_BLOCKS, POWER_IDLE_LOOP_INTERVAL_MS);
+    Serial0.printf("\n闪存暂存:\n");
+    Serial0.printf("  %s, 区域: 0x%x + %d KB, 写缓冲区: %d bytes, 积压阈值: %d blocks\n", SPOOL_ENABLED ? "开启" : "关闭", 
+                  SPOOL_REGION_OFFSET, SPOOL_REGION_SIZE / 1024, SPOOL_WRITE_BUFFER_SIZE, SPOOL_BACKLOG_BLOCKS);
+    Serial0.printf("  补传份额: %.2f - %.2f, 实时流余量倍数: %.1f, 实时流保留: %d blocks\n", CATCHUP_BACKLOG_SHARE,
+                  CATCHUP_MAX_BACKLOG_SHARE, CATCHUP_LIVE_MARGIN, CATCHUP_LIVE_QUEUE_BLOCKS);
+    Serial0.printf("\n会话记录:\n");
+    Serial0.printf("  %s, 区域: 0x%x + %d KB, 段大小: %d KB, 写缓冲区: %d bytes\n", RECORDER_ENABLED ? "开启" : "关闭", 
+                  RECORDER_REGION_OFFSET, RECORDER_REGION_SIZE / 1024, RECORDER_SEGMENT_SIZE / 1024, RECORDER_WRITE_BUFFER_SIZE);
+    Serial0.printf("  槽位: %d, 落盘间隔: %d ms, 任务: 栈大小=%d, 优先级=%d, Core %d\n", RECORDER_QUEUE_ITEMS, 
+                  RECORDER_FLUSH_INTERVAL_MS, RECORDER_TASK_STACK_SIZE, RECORDER_TASK_PRIORITY, RECORDER_TASK_CORE);
+    Serial0.printf("  补发进度间隔: %d ms\n", RESEND_PROGRESS_INTERVAL_MS);
+    Serial0.printf("\n重连配置:\n");
+    Serial0.printf("  WiFi退避: %d - %d ms\n", WIFI_RECONNECT_BASE_DELAY_MS, WIFI_RECONNECT_MAX_DELAY_MS);
+    Serial0.printf("  服务器退避: %d - %d ms\n", SERVER_RECONNECT_BASE_DELAY_MS, SERVER_RECONNECT_MAX_DELAY_MS);
     Serial0.printf("\n时间配置:\n");
     Serial0.printf("  心跳间隔: %d ms\n", HEARTBEAT_INTERVAL);
+    Serial0.printf("  Ping间隔: %d ms\n", PING_INTERVAL_MS);
     Serial0.printf("  状态间隔: %d ms\n", STATUS_INTERVAL);
     Serial0.printf("  健康检查间隔: %d ms\n", HEALTH_CHECK_INTERVAL);
+    Serial0.printf("  时钟拟合斜率偏差上限: %.0f ppm\n", TIME_SYNC_MAX_SKEW_PPM);
+    Serial0.printf("  漂移跟踪: 时间常数 %.0f ms, 修正速度上限 %.0f ppm, 重新锁定阈值 %.0f ms\n",
+                  TIME_SYNC_TRACK_TIME_CONSTANT_MS, TIME_SYNC_MAX_SLEW_PPM, TIME_SYNC_RELOCK_THRESHOLD_MS);
+    Serial0.printf("  下包络: %s, 分桶: %d, 剔除阈值: %.1f ms, 跟踪窗口: %.0f ms\n", TIME_SYNC_LOWER_ENVELOPE ? "开启" : "关闭",
+                  TIME_SYNC_ENVELOPE_BUCKETS, TIME_SYNC_OUTLIER_MS, TIME_SYNC_TRACK_ENVELOPE_MS);
+    Serial0.printf("  NTP同步间隔: %d ms, 修正速度上限 %.0f ppm, 跳变阈值 %.0f ms, 漂移上限 %.0f ppm\n",
+                  NTP_SYNC_INTERVAL_MS, NTP_MAX_SLEW_PPM, NTP_STEP_THRESHOLD_MS, NTP_MAX_DRIFT_PPM);
     Serial0.printf("\n调试配置:\n");
     Serial0.printf("  显示丢弃数据包: %s\n", SHOW_DROPPED_PACKETS ? "开启" : "关闭");
     Serial0.printf("================\n\n");
@@ -0,0 +1,207 @@
+#include "FlashStorage.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+uint32_t FlashStorage::crc32(const void* data, size_t length, uint32_t crc) {
+    // 半字节查表，表只有16项
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+FlashRegion::FlashRegion() {
+    parent = nullptr;
+    base = 0;
+    length = 0;
+}
+
+bool FlashRegion::begin(FlashStorage* parent, size_t offset, size_t length) {
+    if (!parent || offset % SECTOR_SIZE != 0 || length % SECTOR_SIZE != 0 || length == 0 ||
+        offset + length > parent->size()) {
+        return false;
+    }
+    this->parent = parent;
+    this->base = offset;
+    this->length = length;
+    return true;
+}
+
+bool FlashRegion::inRange(size_t offset, size_t length) const {
+    return parent && offset <= this->length && length <= this->length - offset;
+}
+
+bool FlashRegion::read(size_t offset, void* data, size_t length) {
+    return inRange(offset, length) && parent->read(base + offset, data, length);
+}
+
+bool FlashRegion::write(size_t offset, const void* data, size_t length) {
+    return inRange(offset, length) && parent->write(base + offset, data, length);
+}
+
+bool FlashRegion::eraseSector(size_t offset) {
+    return inRange(offset, SECTOR_SIZE) && parent->eraseSector(base + offset);
+}
+
+const uint8_t* FlashRegion::map(size_t offset, size_t length) {
+    return inRange(offset, length) ? parent->map(base + offset, length) : nullptr;
+}
+
+#ifdef ARDUINO
+
+PartitionStorage::PartitionStorage() {
+    partition = nullptr;
+    mapped = nullptr;
+    mapHandle = 0;
+    mapFailed = false;
+}
+
+PartitionStorage::~PartitionStorage() {
+    if (mapped) {
+        esp_partition_munmap(mapHandle);
+    }
+}
+
+bool PartitionStorage::begin(esp_partition_subtype_t subtype, const char* label) {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, subtype, label);
+    if (!partition) {
+        Serial0.printf("[FlashStorage] ERROR: Data partition %s not found\n", label ? label : "(any)");
+        return false;
+    }
+    Serial0.printf("[FlashStorage] Partition %s at 0x%x, %u KB\n",
+                  partition->label, partition->address, partition->size / 1024);
+    return true;
+}
+
+size_t PartitionStorage::size() const {
+    return partition ? partition->size : 0;
+}
+
+bool PartitionStorage::read(size_t offset, void* data, size_t length) {
+    return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionStorage::write(size_t offset, const void* data, size_t length) {
+    return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionStorage::eraseSector(size_t offset) {
+    return partition && esp_partition_erase_range(partition, offset, SECTOR_SIZE) == ESP_OK;
+}
+
+const uint8_t* PartitionStorage::map(size_t offset, size_t length) {
+    if (!partition || offset > partition->size || length > partition->size - offset) {
+        return nullptr;
+    }
+    if (!mapped && !mapFailed) {
+        const void* pointer = nullptr;
+        if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &pointer, &mapHandle) == ESP_OK) {
+            mapped = (const uint8_t*)pointer;
+            Serial0.printf("[FlashStorage] Partition %s mapped at %p\n", partition->label, pointer);
+        } else {
+            // MMU页不足时退回普通读取
+            mapFailed = true;
+            Serial0.printf("[FlashStorage] WARNING: Partition %s mmap failed, using reads\n", partition->label);
+        }
+    }
+    return mapped ? mapped + offset : nullptr;
+}
+
+#else
+
+FileStorage::FileStorage() {
+    file = nullptr;
+    length = 0;
+}
+
+FileStorage::~FileStorage() {
+    close();
+}
+
+bool FileStorage::open(const char* path, size_t size) {
+    close();
+    file = fopen(path, "r+b");
+    if (!file) {
+        file = fopen(path, "w+b");
+    }
+    if (!file) {
+        return false;
+    }
+
+    // 文件长度不足的部分视为已擦除
+    fseek(file, 0, SEEK_END);
+    long existing = ftell(file);
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (size_t pos = existing > 0 ? (size_t)existing : 0; pos < size; pos += sizeof(erased)) {
+        size_t chunk = size - pos < sizeof(erased) ? size - pos : sizeof(erased);
+        fwrite(erased, 1, chunk, file);
+    }
+    fflush(file);
+    length = size;
+    return true;
+}
+
+void FileStorage::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    length = 0;
+}
+
+bool FileStorage::read(size_t offset, void* data, size_t length) {
+    if (!file || offset > this->length || length > this->length - offset) {
+        return false;
+    }
+    return fseek(file, offset, SEEK_SET) == 0 && fread(data, 1, length, file) == length;
+}
+
+bool FileStorage::write(size_t offset, const void* data, size_t length) {
+    if (!file || offset > this->length || length > this->length - offset) {
+        return false;
+    }
+    // 与NOR闪存一致：写入只能把1变为0，未擦除就写入会得到新旧数据按位与的结果
+    const uint8_t* source = (const uint8_t*)data;
+    uint8_t merged[PAGE_SIZE];
+    for (size_t done = 0; done < length; ) {
+        size_t chunk = length - done < sizeof(merged) ? length - done : sizeof(merged);
+        if (!read(offset + done, merged, chunk)) {
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            merged[i] &= source[done + i];
+        }
+        if (fseek(file, offset + done, SEEK_SET) != 0 || fwrite(merged, 1, chunk, file) != chunk) {
+            return false;
+        }
+        done += chunk;
+    }
+    fflush(file);
+    return true;
+}
+
+bool FileStorage::eraseSector(size_t offset) {
+    if (!file || offset % SECTOR_SIZE != 0 || offset + SECTOR_SIZE > length) {
+        return false;
+    }
+    uint8_t erased[SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    if (fseek(file, offset, SEEK_SET) != 0 || fwrite(erased, 1, sizeof(erased), file) != sizeof(erased)) {
+        return false;
+    }
+    fflush(file);
+    return true;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "LatencyHistogram.h"
+#include <string.h>
+#include <math.h>
+
+// 各桶上界(ms)，最后一个桶收纳所有更大的值
+const uint32_t LatencyHistogram::bucketBounds[BUCKET_COUNT] = {
+    2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000, UINT32_MAX
+};
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::record(uint32_t valueMs) {
+    size_t index = 0;
+    while (index < BUCKET_COUNT - 1 && valueMs > bucketBounds[index]) {
+        index++;
+    }
+    buckets[index]++;
+    
+    if (count == 0 || valueMs < minValue) {
+        minValue = valueMs;
+    }
+    if (valueMs > maxValue) {
+        maxValue = valueMs;
+    }
+    sum += valueMs;
+    count++;
+}
+
+void LatencyHistogram::reset() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    minValue = 0;
+    maxValue = 0;
+    sum = 0;
+}
+
+float LatencyHistogram::getAvg() const {
+    return count > 0 ? (float)sum / count : 0.0f;
+}
+
+uint32_t LatencyHistogram::getPercentile(float percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    
+    // 第一个累计计数达到 ceil(count * percentile / 100) 的桶
+    uint32_t target = (uint32_t)ceilf(count * percentile / 100.0f);
+    if (target == 0) {
+        target = 1;
+    }
+    
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        cumulative += buckets[i];
+        if (cumulative >= target) {
+            return bucketBounds[i] < maxValue ? bucketBounds[i] : maxValue;
+        }
+    }
+    return maxValue;
+}
+
+uint32_t LatencyHistogram::getBucketBound(size_t index) {
+    return index < BUCKET_COUNT ? bucketBounds[index] : UINT32_MAX;
+}
+
+uint32_t LatencyHistogram::getBucketCount(size_t index) const {
+    return index < BUCKET_COUNT ? buckets[index] : 0;
+}
@@ -0,0 +1,146 @@
+#include "LocalFanout.h"
+#include <stdlib.h>
+#include <string.h>
+
+LocalFanout::LocalFanout(Sink* sink) {
+    this->sink = sink;
+    fragmentSize = 1436;
+    stallTimeoutMs = 2000;
+    memset(clients, 0, sizeof(clients));
+    memset(&stats, 0, sizeof(stats));
+}
+
+LocalFanout::~LocalFanout() {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        releaseClient(clients[i]);
+    }
+}
+
+void LocalFanout::configure(size_t fragmentSize, uint32_t stallTimeoutMs) {
+    this->fragmentSize = fragmentSize > 0 ? fragmentSize : 1;
+    this->stallTimeoutMs = stallTimeoutMs;
+}
+
+void LocalFanout::addClient(uint8_t client) {
+    if (client >= MAX_CLIENTS) {
+        return;
+    }
+    clients[client].connected = true;
+    clients[client].pending = false;
+}
+
+void LocalFanout::removeClient(uint8_t client) {
+    if (client >= MAX_CLIENTS) {
+        return;
+    }
+    clients[client].connected = false;
+    releaseClient(clients[client]);
+}
+
+void LocalFanout::releaseClient(Client& client) {
+    client.pending = false;
+    free(client.buffer);
+    client.buffer = nullptr;
+    client.bufferSize = 0;
+}
+
+void LocalFanout::dropClient(uint8_t client) {
+    // 先清除状态再断开：断开事件会同步回调removeClient
+    removeClient(client);
+    sink->disconnect(client);
+}
+
+bool LocalFanout::writeFragments(uint8_t client, const char* data, size_t length, size_t& offset, bool continuation, uint32_t now) {
+    while (offset < length) {
+        if (!sink->isWritable(client)) {
+            return true;
+        }
+        size_t chunk = length - offset < fragmentSize ? length - offset : fragmentSize;
+        bool first = offset == 0 && !continuation;
+        bool fin = offset + chunk == length;
+        if (!sink->sendFragment(client, (const uint8_t*)data + offset, chunk, first, fin)) {
+            stats.sendFailures++;
+            dropClient(client);
+            return false;
+        }
+        offset += chunk;
+        clients[client].lastProgress = now;
+    }
+    return true;
+}
+
+void LocalFanout::pump(uint32_t now) {
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        Client& client = clients[i];
+        if (!client.connected || !client.pending) {
+            continue;
+        }
+        if (!writeFragments(i, client.buffer, client.length, client.offset, true, now)) {
+            continue;
+        }
+        if (client.offset == client.length) {
+            client.pending = false;
+            stats.clientSends++;
+        } else if (now - client.lastProgress >= stallTimeoutMs) {
+            // 消息已写了一部分，跳过余下部分会破坏帧序列，只能断开
+            stats.stalledClients++;
+            dropClient(i);
+        }
+    }
+}
+
+bool LocalFanout::broadcast(const char* data, size_t length, uint32_t now) {
+    pump(now);
+    if (length == 0) {
+        return false;
+    }
+
+    bool delivered = false;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        Client& client = clients[i];
+        if (!client.connected) {
+            continue;
+        }
+        if (client.pending) {
+            stats.clientSkips++;
+            continue;
+        }
+        size_t offset = 0;
+        if (!writeFragments(i, data, length, offset, false, now)) {
+            continue;
+        }
+        if (offset == 0) {
+            // 套接字不可写，一片也没写：跳过本条，不留未写完的状态
+            stats.clientSkips++;
+            continue;
+        }
+        delivered = true;
+        if (offset == length) {
+            stats.clientSends++;
+            continue;
+        }
+
+        // 没写完：余下部分复制到客户端的缓冲区，之后继续写
+        size_t remaining = length - offset;
+        if (client.bufferSize < remaining) {
+            free(client.buffer);
+            client.buffer = (char*)malloc(length);
+            client.bufferSize = client.buffer ? length : 0;
+        }
+        if (!client.buffer) {
+            stats.sendFailures++;
+            dropClient(i);
+            continue;
+        }
+        memcpy(client.buffer, data + offset, remaining);
+        client.length = remaining;
+        client.offset = 0;
+        client.pending = true;
+        stats.deferredSends++;
+    }
+    return delivered;
+}
+
+void LocalFanout::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,179 @@
+#include "LocalStreamServer.h"
+#include "Config.h"
+#include <lwip/sockets.h>
+
+// 全局变量，用于静态回调函数访问实例
+static LocalStreamServer* g_localStreamServerInstance = nullptr;
+
+bool LocalWebSocketServer::sendFragment(uint8_t client, const uint8_t* data, size_t length, bool first, bool fin) {
+    if (client >= WEBSOCKETS_SERVER_CLIENT_MAX || !clientIsConnected(&_clients[client])) {
+        return false;
+    }
+    return sendFrame(&_clients[client], first ? WSop_text : WSop_continuation, (uint8_t*)data, length, fin, false);
+}
+
+bool LocalWebSocketServer::isWritable(uint8_t num) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !_clients[num].tcp) {
+        return false;
+    }
+
+    int fd = _clients[num].tcp->fd();
+    if (fd < 0) {
+        return false;
+    }
+
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval timeout = {0, 0};
+    return select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
+}
+
+LocalStreamServer::LocalStreamServer() : server(Config::LOCAL_SERVER_PORT), fanout(&server) {
+    fanout.configure(Config::LOCAL_FRAGMENT_SIZE, Config::LOCAL_CLIENT_STALL_MS);
+    running = false;
+    softApStarted = false;
+    memset(clientConnected, 0, sizeof(clientConnected));
+    clientCount = 0;
+    memset(&stats, 0, sizeof(stats));
+    g_localStreamServerInstance = this;
+}
+
+bool LocalStreamServer::begin() {
+    if (running) {
+        return true;
+    }
+
+    if (Config::LOCAL_SERVER_SOFTAP && !softApStarted && strlen(Config::LOCAL_AP_PASSWORD) < 8) {
+        // 不使用公共默认密码：未设置时只在STA网络上提供服务
+        Serial0.printf("[LocalStreamServer] ERROR: SoftAP password not set (min 8 chars), SoftAP disabled\n");
+    } else if (Config::LOCAL_SERVER_SOFTAP && !softApStarted) {
+        // AP+STA并存：上游连接不受影响，客户端可直连网关
+        if (!WiFi.softAP(Config::LOCAL_AP_SSID, Config::LOCAL_AP_PASSWORD)) {
+            Serial0.printf("[LocalStreamServer] ERROR: Failed to start SoftAP %s\n", Config::LOCAL_AP_SSID);
+            return false;
+        }
+        softApStarted = true;
+        Serial0.printf("[LocalStreamServer] SoftAP %s started, IP: %s\n",
+                      Config::LOCAL_AP_SSID, WiFi.softAPIP().toString().c_str());
+    }
+
+    server.begin();
+    server.onEvent(serverEvent);
+    running = true;
+    Serial0.printf("[LocalStreamServer] Listening on port %d (max %d clients)\n",
+                  Config::LOCAL_SERVER_PORT, Config::LOCAL_SERVER_MAX_CLIENTS);
+    return true;
+}
+
+void LocalStreamServer::stop() {
+    if (!running) {
+        return;
+    }
+    server.close();
+    running = false;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+        fanout.removeClient(num);
+    }
+    memset(clientConnected, 0, sizeof(clientConnected));
+    clientCount = 0;
+    if (softApStarted) {
+        WiFi.softAPdisconnect(true);
+        softApStarted = false;
+    }
+    Serial0.printf("[LocalStreamServer] Stopped\n");
+}
+
+void LocalStreamServer::loop() {
+    if (running) {
+        server.loop();
+        fanout.pump(millis());
+    }
+}
+
+void LocalStreamServer::serverEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+    if (g_localStreamServerInstance) {
+        g_localStreamServerInstance->handleEvent(num, type);
+    }
+}
+
+void LocalStreamServer::handleEvent(uint8_t num, WStype_t type) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+        return;
+    }
+
+    switch (type) {
+        case WStype_CONNECTED:
+            if (clientCount >= Config::LOCAL_SERVER_MAX_CLIENTS) {
+                // 客户端数量有上限，保证转发耗时有界
+                Serial0.printf("[LocalStreamServer] WARNING: Client %d rejected, %d clients connected\n", num, clientCount);
+                stats.rejectedClients++;
+                server.disconnect(num);
+                break;
+            }
+            clientConnected[num] = true;
+            clientCount++;
+            fanout.addClient(num);
+            if (clientCount > stats.peakClients) {
+                stats.peakClients = clientCount;
+            }
+            Serial0.printf("[LocalStreamServer] Client %d connected from %s (%d clients)\n",
+                          num, server.remoteIP(num).toString().c_str(), clientCount);
+            break;
+
+        case WStype_DISCONNECTED:
+            if (clientConnected[num]) {
+                clientConnected[num] = false;
+                clientCount--;
+                fanout.removeClient(num);
+                Serial0.printf("[LocalStreamServer] Client %d disconnected (%d clients)\n", num, clientCount);
+            }
+            break;
+
+        default:
+            // 本地客户端只接收数据，忽略其发来的消息
+            break;
+    }
+}
+
+void LocalStreamServer::broadcast(const char* data, size_t length) {
+    if (!hasClients() || length == 0) {
+        return;
+    }
+
+    uint32_t start = micros();
+    // 慢客户端按分片逐步写入，不阻塞网络任务；上一条未写完的客户端跳过本条
+    bool delivered = fanout.broadcast(data, length, millis());
+
+    uint32_t elapsed = micros() - start;
+    if (delivered) {
+        if (stats.messagesBroadcast == 0) {
+            stats.avgFanoutUs = elapsed;
+        } else {
+            stats.avgFanoutUs = stats.avgFanoutUs * 0.875f + elapsed * 0.125f;
+        }
+        stats.messagesBroadcast++;
+    }
+    if (elapsed > stats.maxFanoutUs) {
+        stats.maxFanoutUs = elapsed;
+    }
+}
+
+LocalStreamServer::Stats LocalStreamServer::getStats() const {
+    Stats currentStats = stats;
+    currentStats.running = running;
+    currentStats.clients = clientCount;
+    const LocalFanout::Stats& fanoutStats = fanout.getStats();
+    currentStats.clientSends = fanoutStats.clientSends;
+    currentStats.clientSkips = fanoutStats.clientSkips;
+    currentStats.deferredSends = fanoutStats.deferredSends;
+    currentStats.stalledClients = fanoutStats.stalledClients;
+    currentStats.sendFailures = fanoutStats.sendFailures;
+    return currentStats;
+}
+
+void LocalStreamServer::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    stats.peakClients = clientCount;
+    fanout.resetStats();
+}
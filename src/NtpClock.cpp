@@ -0,0 +1,144 @@
+#include "NtpClock.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+NtpClock::NtpClock() {
+    maxSlewPpm = 500.0f;
+    stepThresholdUs = 1000000.0f;
+    maxDriftPpm = 200.0f;
+    reset();
+}
+
+void NtpClock::configure(float maxSlewPpm, float stepThresholdMs, float maxDriftPpm) {
+    this->maxSlewPpm = maxSlewPpm;
+    this->stepThresholdUs = stepThresholdMs * 1000.0f;
+    this->maxDriftPpm = maxDriftPpm;
+}
+
+void NtpClock::reset() {
+    memset(&model, 0, sizeof(model));
+    memset(history, 0, sizeof(history));
+    historyHead = 0;
+    historyCount = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+int64_t NtpClock::offsetAt(const Model& model, int64_t espUs) {
+    if (!model.valid) {
+        return 0;
+    }
+    int64_t elapsed = espUs - model.anchorEspUs;
+    if (espUs <= model.slewEndUs) {
+        return model.anchorOffsetUs + (int64_t)llround((double)elapsed * (model.driftPpm + model.slewPpm) * 1e-6);
+    }
+    int64_t slewElapsed = model.slewEndUs - model.anchorEspUs;
+    if (slewElapsed < 0) {
+        slewElapsed = 0;
+    }
+    return model.anchorOffsetUs + (int64_t)llround((double)slewElapsed * model.slewPpm * 1e-6 +
+                                                   (double)elapsed * model.driftPpm * 1e-6);
+}
+
+bool NtpClock::getHistory(uint8_t index, Measurement& measurement) const {
+    if (index >= historyCount) {
+        return false;
+    }
+    measurement = history[(historyHead + HISTORY_SIZE - 1 - index) % HISTORY_SIZE];
+    return true;
+}
+
+bool NtpClock::fitHistory(int64_t espUs, float& driftPpm, int64_t& offsetUs) const {
+    if (historyCount < 2) {
+        return false;
+    }
+
+    // 以最新测量为原点居中，两遍最小二乘
+    const Measurement& origin = history[(historyHead + HISTORY_SIZE - 1) % HISTORY_SIZE];
+    double meanX = 0.0;
+    double meanY = 0.0;
+    for (uint8_t i = 0; i < historyCount; i++) {
+        meanX += (double)(history[i].espUs - origin.espUs);
+        meanY += (double)(history[i].offsetUs - origin.offsetUs);
+    }
+    meanX /= historyCount;
+    meanY /= historyCount;
+
+    double sxx = 0.0;
+    double sxy = 0.0;
+    for (uint8_t i = 0; i < historyCount; i++) {
+        double dx = (double)(history[i].espUs - origin.espUs) - meanX;
+        double dy = (double)(history[i].offsetUs - origin.offsetUs) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx <= 0.0) {
+        return false;
+    }
+
+    double slope = sxy / sxx;
+    double limit = maxDriftPpm * 1e-6;
+    if (slope > limit) slope = limit;
+    if (slope < -limit) slope = -limit;
+    driftPpm = (float)(slope * 1e6);
+    offsetUs = origin.offsetUs + (int64_t)llround(meanY + slope * ((double)(espUs - origin.espUs) - meanX));
+    return true;
+}
+
+void NtpClock::step(int64_t espUs, int64_t offsetUs) {
+    model.valid = true;
+    model.anchorEspUs = espUs;
+    model.anchorOffsetUs = offsetUs;
+    model.slewEndUs = espUs;
+    model.slewPpm = 0.0f;
+    stats.steps++;
+}
+
+const NtpClock::Model& NtpClock::addMeasurement(int64_t espUs, int64_t utcUs) {
+    int64_t measured = utcUs - espUs;
+    bool wasValid = model.valid;
+    int64_t current = offsetAt(model, espUs);
+    int64_t error = measured - current;
+    stats.measurements++;
+
+    bool stepped = !wasValid || fabs((double)error) > stepThresholdUs;
+    if (stepped) {
+        // 首次测量或误差过大（如服务器时间被修正）：清空历史，直接跳变
+        historyHead = 0;
+        historyCount = 0;
+    }
+
+    Measurement& entry = history[historyHead];
+    entry.espUs = espUs;
+    entry.offsetUs = measured;
+    entry.errorUs = stepped ? 0 : (int32_t)error;
+    entry.stepped = stepped;
+    historyHead = (historyHead + 1) % HISTORY_SIZE;
+    if (historyCount < HISTORY_SIZE) {
+        historyCount++;
+    }
+
+    float drift = wasValid && !stepped ? model.driftPpm : 0.0f;
+    int64_t target = measured;
+    fitHistory(espUs, drift, target);
+    entry.driftPpm = drift;
+
+    if (stepped) {
+        step(espUs, measured);
+        model.driftPpm = drift;
+        return model;
+    }
+
+    // 从当前偏移出发（连续），按修正速度上限在有限时间内追上目标直线
+    int64_t correction = target - current;
+    if (llabs(correction) > stats.maxErrorUs) {
+        stats.maxErrorUs = (int32_t)llabs(correction);
+    }
+    model.anchorEspUs = espUs;
+    model.anchorOffsetUs = current;
+    model.driftPpm = drift;
+    model.slewPpm = correction >= 0 ? maxSlewPpm : -maxSlewPpm;
+    model.slewEndUs = espUs + (int64_t)llround(fabs((double)correction) / (maxSlewPpm * 1e-6));
+    stats.slews++;
+    return model;
+}
@@ -0,0 +1,146 @@
+#include "PowerScheduler.h"
+
+PowerScheduler::PowerScheduler() {
+    phase = Phase::ALWAYS_ON;
+    windowMs = 5000;
+    burstLimitMs = 2000;
+    flushThreshold = 0;
+    phaseStartTime = 0;
+    heartbeatDue = false;
+    resetStats(0);
+}
+
+void PowerScheduler::configure(uint32_t windowMs, uint32_t maxBurstMs, uint32_t flushThreshold) {
+    this->windowMs = windowMs;
+    this->burstLimitMs = maxBurstMs;
+    this->flushThreshold = flushThreshold;
+}
+
+void PowerScheduler::setEnabled(bool enabled, uint32_t now) {
+    if (enabled == isEnabled()) {
+        return;
+    }
+    if (enabled) {
+        resetStats(now);
+        enterIdle(now);
+    } else {
+        phase = Phase::ALWAYS_ON;
+        phaseStartTime = now;
+        heartbeatDue = false;
+    }
+}
+
+bool PowerScheduler::update(uint32_t now, uint32_t heldBlocks, bool drained, bool flushRequested) {
+    uint32_t elapsed = now - phaseStartTime;
+
+    switch (phase) {
+        case Phase::IDLE: {
+            bool thresholdReached = flushThreshold > 0 && heldBlocks >= flushThreshold;
+            if (elapsed >= windowMs) {
+                enterBurst(now, false);
+                return true;
+            }
+            if (thresholdReached || flushRequested) {
+                enterBurst(now, true);
+                return true;
+            }
+            return false;
+        }
+
+        case Phase::BURST:
+            // 需要立即上传时保持突发直到上传完成，但仍受最长时间限制，避免断线时无线电一直常开
+            if (drained && !flushRequested) {
+                enterIdle(now);
+                return true;
+            }
+            if (elapsed >= burstLimitMs) {
+                burstTimeouts++;
+                enterIdle(now);
+                return true;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+bool PowerScheduler::consumeHeartbeatDue() {
+    bool due = heartbeatDue;
+    heartbeatDue = false;
+    return due;
+}
+
+uint32_t PowerScheduler::getTimeToNextBurst(uint32_t now) const {
+    if (phase != Phase::IDLE) {
+        return 0;
+    }
+    uint32_t elapsed = now - phaseStartTime;
+    return elapsed >= windowMs ? 0 : windowMs - elapsed;
+}
+
+float PowerScheduler::getDutyCycle(uint32_t now) const {
+    uint32_t total = now - statsStartTime;
+    if (total == 0) {
+        return phase == Phase::IDLE ? 0.0f : 1.0f;
+    }
+    if (phase == Phase::ALWAYS_ON) {
+        return 1.0f;
+    }
+    uint32_t on = radioOnMs;
+    if (phase == Phase::BURST) {
+        on += now - countedBurstStart();
+    }
+    return (float)on / total;
+}
+
+float PowerScheduler::getRadioOnMsPerMinute(uint32_t now) const {
+    return getDutyCycle(now) * 60000.0f;
+}
+
+void PowerScheduler::resetStats(uint32_t now) {
+    statsStartTime = now;
+    radioOnMs = 0;
+    burstCount = 0;
+    burstTimeouts = 0;
+    earlyFlushes = 0;
+    lastBurstMs = 0;
+    maxBurstMs = 0;
+}
+
+const char* PowerScheduler::getPhaseName(Phase phase) {
+    switch (phase) {
+        case Phase::ALWAYS_ON: return "always_on";
+        case Phase::IDLE: return "idle";
+        case Phase::BURST: return "burst";
+        default: return "unknown";
+    }
+}
+
+void PowerScheduler::enterBurst(uint32_t now, bool early) {
+    phase = Phase::BURST;
+    phaseStartTime = now;
+    heartbeatDue = true;
+    burstCount++;
+    if (early) {
+        earlyFlushes++;
+    }
+}
+
+uint32_t PowerScheduler::countedBurstStart() const {
+    // 统计重置发生在突发中途时，只计入重置之后的部分
+    return (int32_t)(phaseStartTime - statsStartTime) > 0 ? phaseStartTime : statsStartTime;
+}
+
+void PowerScheduler::enterIdle(uint32_t now) {
+    if (phase == Phase::BURST) {
+        uint32_t duration = now - phaseStartTime;
+        radioOnMs += now - countedBurstStart();
+        lastBurstMs = duration;
+        if (duration > maxBurstMs) {
+            maxBurstMs = duration;
+        }
+    }
+    phase = Phase::IDLE;
+    phaseStartTime = now;
+}
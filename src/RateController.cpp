@@ -0,0 +1,168 @@
+#include "RateController.h"
+
+RateController::RateController() {
+    intervalMs = 1000;
+    queueHighWatermark = 5;
+    queueLowWatermark = 1;
+    holdMs = 3000;
+    recoverIntervals = 5;
+    level = UploadLevel::NORMAL;
+    previousLevel = UploadLevel::NORMAL;
+    lastUpdateTime = 0;
+    lastLevelChangeTime = 0;
+    intervalBytes = 0;
+    intervalStalls = 0;
+    lastQueuedBlocks = 0;
+    lastDroppedBlocks = 0;
+    calmIntervals = 0;
+    failedProbes = 0;
+    probing = false;
+    capacityEstimate = 0.0f;
+    demandEstimate = 0.0f;
+    bytesPerBlock = 0.0f;
+    levelChanges = 0;
+}
+
+void RateController::configure(uint32_t intervalMs, uint32_t queueHighWatermark, uint32_t queueLowWatermark, 
+                               uint32_t holdMs, uint8_t recoverIntervals) {
+    this->intervalMs = intervalMs;
+    this->queueHighWatermark = queueHighWatermark;
+    this->queueLowWatermark = queueLowWatermark < queueHighWatermark ? queueLowWatermark : queueHighWatermark;
+    this->holdMs = holdMs;
+    this->recoverIntervals = recoverIntervals > 0 ? recoverIntervals : 1;
+}
+
+void RateController::onBytesWritten(size_t bytes) {
+    intervalBytes += bytes;
+}
+
+void RateController::onMessageEncoded(size_t bytes, uint8_t blockCount) {
+    if (blockCount == 0) {
+        return;
+    }
+    float perBlock = (float)bytes / blockCount;
+    bytesPerBlock = (bytesPerBlock == 0.0f) ? perBlock : bytesPerBlock * 0.875f + perBlock * 0.125f;
+}
+
+void RateController::onSendStall() {
+    intervalStalls++;
+}
+
+bool RateController::isUpdateDue(uint32_t now) const {
+    return now - lastUpdateTime >= intervalMs;
+}
+
+bool RateController::update(uint32_t now, uint32_t queuedBlocks, uint32_t droppedBlocks) {
+    uint32_t elapsed = now - lastUpdateTime;
+    if (lastUpdateTime == 0 || elapsed == 0) {
+        // 第一个周期只建立基准
+        lastUpdateTime = now;
+        lastQueuedBlocks = queuedBlocks;
+        lastDroppedBlocks = droppedBlocks;
+        intervalBytes = 0;
+        intervalStalls = 0;
+        return false;
+    }
+    
+    // 吞吐量：本周期实际写入套接字的速率
+    float throughput = (float)intervalBytes * 1000.0f / elapsed;
+    
+    // 需求：写出的数据 + 队列增长和丢弃的块折算的字节数
+    int32_t droppedDelta = (int32_t)(droppedBlocks - lastDroppedBlocks);
+    int32_t growth = (int32_t)queuedBlocks - (int32_t)lastQueuedBlocks + droppedDelta;
+    float demand = throughput + growth * bytesPerBlock * 1000.0f / elapsed;
+    if (demand < 0.0f) {
+        demand = 0.0f;
+    }
+    demandEstimate = (demandEstimate == 0.0f) ? demand : demandEstimate * 0.7f + demand * 0.3f;
+    
+    // 容量：出现发送暂停说明链路已饱和，此时的吞吐量就是容量；否则吞吐量只是容量的下界
+    if (intervalStalls > 0) {
+        capacityEstimate = (capacityEstimate == 0.0f) ? throughput : capacityEstimate * 0.7f + throughput * 0.3f;
+    } else if (throughput > capacityEstimate) {
+        capacityEstimate = throughput;
+    }
+    
+    bool congested = droppedDelta > 0 ||
+                     (queuedBlocks >= queueHighWatermark && growth > 0) ||
+                     (intervalStalls > 0 && queuedBlocks > queueLowWatermark && demand > capacityEstimate);
+    bool calm = queuedBlocks <= queueLowWatermark && intervalStalls == 0 && droppedDelta == 0;
+    bool holding = now - lastLevelChangeTime < holdMs;
+    
+    lastUpdateTime = now;
+    lastQueuedBlocks = queuedBlocks;
+    lastDroppedBlocks = droppedBlocks;
+    intervalBytes = 0;
+    intervalStalls = 0;
+    
+    if (congested) {
+        calmIntervals = 0;
+        if (holding || level == UploadLevel::PRIORITY_DROP) {
+            return false;
+        }
+        // 刚恢复就再次拥塞，说明容量不足以支撑上一等级，加长下次恢复前的观察时间
+        if (probing && now - lastLevelChangeTime < holdMs * 2) {
+            if (failedProbes < 4) {
+                failedProbes++;
+            }
+        }
+        setLevel((UploadLevel)((uint8_t)level + 1), now);
+        probing = false;
+        return true;
+    }
+    
+    if (!calm) {
+        calmIntervals = 0;
+        return false;
+    }
+    
+    if (calmIntervals < 0xFF) {
+        calmIntervals++;
+    }
+    
+    // 容量恢复：连续若干周期无积压后逐级恢复，每次失败的恢复尝试使等待时间加倍
+    uint32_t requiredCalm = (uint32_t)recoverIntervals << failedProbes;
+    if (calmIntervals < requiredCalm || holding) {
+        return false;
+    }
+    if (level == UploadLevel::NORMAL) {
+        failedProbes = 0;  // 在NORMAL稳定运行，容量已恢复
+        return false;
+    }
+    
+    setLevel((UploadLevel)((uint8_t)level - 1), now);
+    probing = true;
+    calmIntervals = 0;
+    return true;
+}
+
+void RateController::setLevel(UploadLevel newLevel, uint32_t now) {
+    previousLevel = level;
+    level = newLevel;
+    lastLevelChangeTime = now;
+    levelChanges++;
+    // 编码方式变化后每块字节数需要重新估计
+    bytesPerBlock *= getLevelRatio(newLevel) / getLevelRatio(previousLevel);
+}
+
+const char* RateController::getLevelName(UploadLevel level) {
+    switch (level) {
+        case UploadLevel::NORMAL: return "normal";
+        case UploadLevel::COALESCE: return "coalesce";
+        case UploadLevel::COMPACT: return "compact";
+        case UploadLevel::DECIMATE: return "decimate";
+        case UploadLevel::PRIORITY_DROP: return "priority_drop";
+        default: return "unknown";
+    }
+}
+
+float RateController::getLevelRatio(UploadLevel level) {
+    switch (level) {
+        case UploadLevel::NORMAL: return 1.0f;
+        case UploadLevel::COALESCE: return 0.95f;
+        case UploadLevel::COMPACT: return 0.45f;
+        case UploadLevel::DECIMATE: return 0.25f;
+        case UploadLevel::PRIORITY_DROP: return 0.125f;
+        default: return 1.0f;
+    }
+}
@@ -0,0 +1,67 @@
+#include "ReconnectBackoff.h"
+
+ReconnectBackoff::ReconnectBackoff() {
+    baseDelayMs = 1000;
+    maxDelayMs = 30000;
+    attempts = 0;
+    nextAttemptTime = 0;
+    currentDelay = 0;
+    downSince = 0;
+    down = false;
+}
+
+void ReconnectBackoff::configure(uint32_t baseDelayMs, uint32_t maxDelayMs) {
+    this->baseDelayMs = baseDelayMs;
+    this->maxDelayMs = maxDelayMs;
+}
+
+void ReconnectBackoff::onLinkDown(uint32_t now) {
+    if (!down) {
+        down = true;
+        downSince = now;
+    }
+    retryNow(now);
+}
+
+uint32_t ReconnectBackoff::onLinkUp(uint32_t now) {
+    attempts = 0;
+    currentDelay = 0;
+    nextAttemptTime = now;
+    if (!down) {
+        return 0;
+    }
+    down = false;
+    return now - downSince;
+}
+
+void ReconnectBackoff::retryNow(uint32_t now) {
+    attempts = 0;
+    nextAttemptTime = now;
+}
+
+bool ReconnectBackoff::poll(uint32_t now, uint32_t random) {
+    if ((int32_t)(now - nextAttemptTime) < 0) {
+        return false;
+    }
+    attempts++;
+    currentDelay = computeDelay(attempts, baseDelayMs, maxDelayMs, random);
+    nextAttemptTime = now + currentDelay;
+    return true;
+}
+
+uint32_t ReconnectBackoff::computeDelay(uint32_t attempts, uint32_t baseDelayMs, uint32_t maxDelayMs, uint32_t random) {
+    uint32_t delayMs = baseDelayMs;
+    for (uint32_t i = 1; i < attempts && delayMs < maxDelayMs; i++) {
+        delayMs *= 2;
+    }
+    if (delayMs > maxDelayMs) {
+        delayMs = maxDelayMs;
+    }
+    
+    // ±25%随机抖动
+    uint32_t jitterRange = delayMs / 2;
+    if (jitterRange > 0) {
+        delayMs = delayMs - delayMs / 4 + random % jitterRange;
+    }
+    return delayMs;
+}
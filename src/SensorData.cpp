@@ -1,10 +1,16 @@
 #include "SensorData.h"
 #include "Config.h"
 #include "BufferPool.h"
+#include "SessionRecorder.h"
+#include "SessionManifest.h"
 
 SensorData::SensorData(BufferPool* bufferPoolInstance) {
     currentBlock = nullptr;
-    blockQueue = xQueueCreate(10, sizeof(DataBlock*));
+    consumerTask = nullptr;
+    sessionRecorder = nullptr;
+    sessionManifest = nullptr;
+    dropPolicy = BlockDropPolicy::DROP_OLDEST;
+    blockQueue = xQueueCreate(Config::BLOCK_QUEUE_DEPTH, sizeof(DataBlock*));
     mutex = xSemaphoreCreateMutex();
     
     // 使用传入的BufferPool实例，如果没有则创建新的
@@ -26,11 +32,15 @@ SensorData::SensorData(BufferPool* bufferPoolInstance) {
     lastStatsTime = millis();
     frameCountSinceLastStats = 0;
     
-    Serial0.printf("[SensorData] Initialized with block queue size: 10\n");
+    Serial0.printf("[SensorData] Initialized with block queue size: %d\n", Config::BLOCK_QUEUE_DEPTH);
 }
 
 SensorData::~SensorData() {
     if (blockQueue) {
+        DataBlock* block = nullptr;
+        while (xQueueReceive(blockQueue, &block, 0) == pdTRUE) {
+            freeBlock(block);
+        }
         vQueueDelete(blockQueue);
     }
     if (mutex) {
@@ -70,50 +80,9 @@ bool SensorData::addFrame(const SensorFrame& frame) {
         
         // 检查块是否已满
         if (currentBlock->frameCount >= DataBlock::MAX_FRAMES) {
-            currentBlock->isFull = true;
-            currentBlock->createTime = millis();
-            
-            // 将完整块加入队列，如果队列满则丢弃最旧的数据
-            if (xQueueSend(blockQueue, &currentBlock, 0) != pdTRUE) {
-                // 队列满，丢弃最旧的数据块（FIFO）
-                DataBlock* oldBlock = nullptr;
-                if (xQueueReceive(blockQueue, &oldBlock, 0) == pdTRUE) {
-                    if (oldBlock) {
-                        if (Config::SHOW_DROPPED_PACKETS) {
-                            Serial0.printf("[SensorData] WARNING: Block queue full, dropped old block with %d frames\n", 
-                                         oldBlock->frameCount);
-                        }
-                        stats.droppedFrames += oldBlock->frameCount;
-                        if (bufferPool) {
-                            bufferPool->releaseBlock(oldBlock);
-                        } else {
-                            free(oldBlock);
-                        }
-                    }
-                }
-                
-                // 再次尝试添加新数据块
-                if (xQueueSend(blockQueue, &currentBlock, 0) != pdTRUE) {
-                    if (Config::SHOW_DROPPED_PACKETS) {
-                        Serial0.printf("[SensorData] ERROR: Failed to add block to queue after dropping old data\n");
-                    }
-                    if (bufferPool) {
-                        bufferPool->releaseBlock(currentBlock);
-                    } else {
-                        free(currentBlock);
-                    }
-                    stats.droppedFrames += currentBlock->frameCount;
-                    currentBlock = nullptr;
-                } else {
-                    stats.blocksCreated++;
-                    stats.totalFrames += currentBlock->frameCount;
-                    currentBlock = nullptr;
-                }
-            } else {
-                stats.blocksCreated++;
-                stats.totalFrames += currentBlock->frameCount;
-                currentBlock = nullptr;
-            }
+            sealBlock(currentBlock);
+            enqueueSealedBlock(currentBlock);
+            currentBlock = nullptr;
         }
         
         frameCountSinceLastStats++;
@@ -128,6 +97,11 @@ bool SensorData::addFrame(const SensorFrame& frame) {
 DataBlock* SensorData::getNextBlock() {
     DataBlock* block = nullptr;
     if (xQueueReceive(blockQueue, &block, 0) == pdTRUE) {
+        // 所有权转移给调用者
+        if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+            accountQueued(block, false);
+            xSemaphoreGive(mutex);
+        }
         return block;
     }
     return nullptr;
@@ -135,14 +109,182 @@ DataBlock* SensorData::getNextBlock() {
 
 void SensorData::releaseBlock(DataBlock* block) {
     if (block) {
-        if (bufferPool) {
-            // 使用BufferPool释放块
-            bufferPool->releaseBlock(block);
+        freeBlock(block);
+        stats.blocksSent++;
+    }
+}
+
+DataBlock* SensorData::allocateBlock() {
+    if (bufferPool) {
+        return bufferPool->acquireBlock();
+    }
+    return (DataBlock*)malloc(sizeof(DataBlock));
+}
+
+void SensorData::recycleBlock(DataBlock* block) {
+    if (block) {
+        freeBlock(block);
+    }
+}
+
+uint32_t SensorData::discardQueuedBlocks() {
+    uint32_t discarded = 0;
+    if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+        DataBlock* block = nullptr;
+        while (xQueueReceive(blockQueue, &block, 0) == pdTRUE) {
+            accountQueued(block, false);
+            if (sessionManifest) {
+                sessionManifest->onBlockDropped(block->blockId, block->sensorFrameCounts);
+            }
+            freeBlock(block);
+            discarded++;
+        }
+        stats.discardedBlocks += discarded;
+        xSemaphoreGive(mutex);
+    }
+    return discarded;
+}
+
+void SensorData::setDropPolicy(BlockDropPolicy policy) {
+    dropPolicy = policy;
+    Serial0.printf("[SensorData] Drop policy set to %s\n", 
+                  policy == BlockDropPolicy::DROP_OLDEST ? "drop-oldest" : "drop-newest");
+}
+
+BlockDropPolicy SensorData::getDropPolicy() const {
+    return dropPolicy;
+}
+
+void SensorData::setConsumerTask(TaskHandle_t task) {
+    consumerTask = task;
+}
+
+void SensorData::setSessionRecorder(SessionRecorder* recorder) {
+    sessionRecorder = recorder;
+}
+
+void SensorData::setSessionManifest(SessionManifest* manifest) {
+    sessionManifest = manifest;
+}
+
+void SensorData::notifyConsumer() {
+    // 唤醒网络任务，使其立即取走已封装的数据块
+    if (consumerTask) {
+        xTaskNotifyGive(consumerTask);
+    }
+}
+
+void SensorData::sealBlock(DataBlock* block) {
+    block->isFull = true;
+    block->createTime = millis();
+    
+    // 统计块内各传感器帧数，用于按传感器计算队列深度
+    for (uint8_t i = 0; i < block->frameCount; i++) {
+        uint8_t sensorId = block->frames[i].sensorId;
+        if (sensorId >= 1 && sensorId <= SENSOR_DATA_SENSOR_COUNT) {
+            block->sensorFrameCounts[sensorId - 1]++;
+        }
+    }
+}
+
+void SensorData::enqueueSealedBlock(DataBlock* block) {
+    // 调用者需持有mutex。会话记录在丢弃之前复制，上传丢弃的块在本地仍有完整记录
+    if (sessionRecorder) {
+        sessionRecorder->offer(block);
+    }
+    if (sessionManifest && sessionManifest->isCapturing()) {
+        // 先在本地汇总各传感器的时间范围，清单每个块只加锁一次
+        uint64_t firstTimestamps[SENSOR_DATA_SENSOR_COUNT];
+        uint64_t lastTimestamps[SENSOR_DATA_SENSOR_COUNT] = {0};
+        for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+            firstTimestamps[i] = UINT64_MAX;
+        }
+        for (uint8_t i = 0; i < block->frameCount; i++) {
+            uint8_t sensorId = block->frames[i].sensorId;
+            if (sensorId < 1 || sensorId > SENSOR_DATA_SENSOR_COUNT) {
+                continue;
+            }
+            uint64_t rawTimestamp = block->frames[i].rawTimestamp;
+            firstTimestamps[sensorId - 1] = min(firstTimestamps[sensorId - 1], rawTimestamp);
+            lastTimestamps[sensorId - 1] = max(lastTimestamps[sensorId - 1], rawTimestamp);
+        }
+        sessionManifest->onBlockSealed(block->blockId, block->sensorFrameCounts, firstTimestamps, lastTimestamps);
+    }
+    
+    // 这里是数据块唯一的丢弃点，按丢弃策略处理队列满的情况
+    if (uxQueueSpacesAvailable(blockQueue) == 0) {
+        if (dropPolicy == BlockDropPolicy::DROP_NEWEST) {
+            dropBlock(block);
+            return;
+        }
+        
+        // 丢弃最旧的数据块（FIFO）
+        DataBlock* oldBlock = nullptr;
+        if (xQueueReceive(blockQueue, &oldBlock, 0) == pdTRUE && oldBlock) {
+            accountQueued(oldBlock, false);
+            dropBlock(oldBlock);
+        }
+    }
+    
+    if (xQueueSend(blockQueue, &block, 0) != pdTRUE) {
+        // 传输层在此期间未取块且队列仍满（不应发生），丢弃新块
+        dropBlock(block);
+        return;
+    }
+    
+    accountQueued(block, true);
+    stats.blocksCreated++;
+    stats.totalFrames += block->frameCount;
+    notifyConsumer();
+}
+
+void SensorData::accountQueued(const DataBlock* block, bool added) {
+    if (!block) {
+        return;
+    }
+    
+    if (added) {
+        stats.queuedBlocks++;
+        if (stats.queuedBlocks > stats.peakQueuedBlocks) {
+            stats.peakQueuedBlocks = stats.queuedBlocks;
+        }
+    } else if (stats.queuedBlocks > 0) {
+        stats.queuedBlocks--;
+    }
+    
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        if (added) {
+            stats.queuedFrames[i] += block->sensorFrameCounts[i];
         } else {
-            // 回退到直接释放
-            free(block);
+            stats.queuedFrames[i] -= min(stats.queuedFrames[i], (uint32_t)block->sensorFrameCounts[i]);
         }
-        stats.blocksSent++;
+    }
+}
+
+void SensorData::dropBlock(DataBlock* block) {
+    if (Config::SHOW_DROPPED_PACKETS) {
+        Serial0.printf("[SensorData] WARNING: Block queue full (%s), dropped block %u with %d frames\n", 
+                     dropPolicy == BlockDropPolicy::DROP_OLDEST ? "drop-oldest" : "drop-newest",
+                     block->blockId, block->frameCount);
+    }
+    stats.droppedFrames += block->frameCount;
+    stats.droppedBlocks++;
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        stats.droppedFramesBySensor[i] += block->sensorFrameCounts[i];
+    }
+    if (sessionManifest) {
+        sessionManifest->onBlockDropped(block->blockId, block->sensorFrameCounts);
+    }
+    freeBlock(block);
+}
+
+void SensorData::freeBlock(DataBlock* block) {
+    if (bufferPool) {
+        // 使用BufferPool释放块
+        bufferPool->releaseBlock(block);
+    } else {
+        // 回退到直接释放
+        free(block);
     }
 }
 
@@ -152,13 +294,59 @@ SensorData::Stats SensorData::getStats() const {
 
 void SensorData::resetStats() {
     if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+        // 队列深度反映当前状态，不随统计重置
+        uint32_t queuedBlocks = stats.queuedBlocks;
+        uint32_t queuedFrames[SENSOR_DATA_SENSOR_COUNT];
+        memcpy(queuedFrames, stats.queuedFrames, sizeof(queuedFrames));
+        
         memset(&stats, 0, sizeof(stats));
+        stats.queuedBlocks = queuedBlocks;
+        stats.peakQueuedBlocks = queuedBlocks;
+        memcpy(stats.queuedFrames, queuedFrames, sizeof(queuedFrames));
         lastStatsTime = millis();
         frameCountSinceLastStats = 0;
         xSemaphoreGive(mutex);
     }
 }
 
+size_t SensorData::serializeBlock(const DataBlock* block, uint8_t* output) {
+    uint8_t* cursor = output;
+    memcpy(cursor, &block->blockId, sizeof(block->blockId));
+    cursor += sizeof(block->blockId);
+    memcpy(cursor, &block->createTime, sizeof(block->createTime));
+    cursor += sizeof(block->createTime);
+    *cursor++ = block->frameCount;
+    memcpy(cursor, block->sensorFrameCounts, sizeof(block->sensorFrameCounts));
+    cursor += sizeof(block->sensorFrameCounts);
+    
+    size_t frameBytes = block->frameCount * sizeof(SensorFrame);
+    memcpy(cursor, block->frames, frameBytes);
+    return cursor - output + frameBytes;
+}
+
+bool SensorData::deserializeBlock(const uint8_t* data, size_t length, DataBlock* block) {
+    const size_t headerSize = sizeof(block->blockId) + sizeof(block->createTime) + 1 + sizeof(block->sensorFrameCounts);
+    if (length < headerSize) {
+        return false;
+    }
+    uint8_t frameCount = data[sizeof(block->blockId) + sizeof(block->createTime)];
+    if (frameCount > DataBlock::MAX_FRAMES || length != headerSize + frameCount * sizeof(SensorFrame)) {
+        return false;
+    }
+    
+    const uint8_t* cursor = data;
+    memcpy(&block->blockId, cursor, sizeof(block->blockId));
+    cursor += sizeof(block->blockId);
+    memcpy(&block->createTime, cursor, sizeof(block->createTime));
+    cursor += sizeof(block->createTime) + 1;
+    memcpy(block->sensorFrameCounts, cursor, sizeof(block->sensorFrameCounts));
+    cursor += sizeof(block->sensorFrameCounts);
+    memcpy(block->frames, cursor, frameCount * sizeof(SensorFrame));
+    block->frameCount = frameCount;
+    block->isFull = true;
+    return true;
+}
+
 const char* SensorData::getSensorType(uint8_t sensorId) {
     switch (sensorId) {
         case 1: return "waist";
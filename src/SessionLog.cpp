@@ -0,0 +1,620 @@
+#include "SessionLog.h"
+#include <string.h>
+
+SessionLog::SessionLog() {
+    storage = nullptr;
+    segmentSize = 0;
+    segmentCount = 0;
+    buffer = nullptr;
+    bufferSize = 0;
+    memset(segments, 0, sizeof(segments));
+    sessionOpen = false;
+    sessionNumber = 0;
+    sessionStartTime = 0;
+    sessionId[0] = '\0';
+    activeSlot = -1;
+    nextSlot = 0;
+    nextSegmentSeq = 1;
+    nextSessionNumber = 1;
+    bufferStart = 0;
+    bufferFill = 0;
+    erasedSectors = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool SessionLog::begin(FlashStorage* storage, size_t segmentSize, uint8_t* writeBuffer, size_t bufferSize) {
+    if (!storage || !writeBuffer || segmentSize == 0 || segmentSize % FlashStorage::SECTOR_SIZE != 0 ||
+        bufferSize == 0 || bufferSize % FlashStorage::PAGE_SIZE != 0 ||
+        bufferSize > segmentSize - FlashStorage::PAGE_SIZE || storage->size() / segmentSize < 2) {
+        return false;
+    }
+    this->storage = storage;
+    this->segmentSize = segmentSize;
+    this->segmentCount = storage->size() / segmentSize;
+    if (segmentCount > MAX_SEGMENTS) {
+        segmentCount = MAX_SEGMENTS;
+    }
+    this->buffer = writeBuffer;
+    this->bufferSize = bufferSize;
+    loadIndex();
+    return true;
+}
+
+size_t SessionLog::recordSize(size_t length) {
+    return (sizeof(RecordHeader) + length + 3) & ~(size_t)3;
+}
+
+size_t SessionLog::firstRecordOffset() {
+    return (sizeof(SegmentHeader) + 3) & ~(size_t)3;
+}
+
+static size_t roundUpToPage(size_t value) {
+    return (value + FlashStorage::PAGE_SIZE - 1) / FlashStorage::PAGE_SIZE * FlashStorage::PAGE_SIZE;
+}
+
+void SessionLog::loadIndex() {
+    bool found = false;
+    uint32_t maxSeq = 0;
+    uint32_t maxSession = 0;
+    size_t newestSlot = 0;
+
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        if (!loadSegment(slot)) {
+            continue;
+        }
+        const SegmentInfo& info = segments[slot];
+        if (!found || (int32_t)(info.segmentSeq - maxSeq) > 0) {
+            maxSeq = info.segmentSeq;
+            newestSlot = slot;
+        }
+        if (!found || (int32_t)(info.sessionNumber - maxSession) > 0) {
+            maxSession = info.sessionNumber;
+        }
+        found = true;
+    }
+
+    // 从最新段之后继续使用，会话号和段序号在重启后继续递增
+    nextSlot = found ? (newestSlot + 1) % segmentCount : 0;
+    nextSegmentSeq = found ? maxSeq + 1 : 1;
+    nextSessionNumber = found ? maxSession + 1 : 1;
+    erasedSectors = 0;
+}
+
+bool SessionLog::loadSegment(size_t slot) {
+    SegmentInfo& info = segments[slot];
+    memset(&info, 0, sizeof(info));
+
+    SegmentHeader header;
+    if (!storage->read(slotAddress(slot), &header, sizeof(header))) {
+        stats.readErrors++;
+        return false;
+    }
+    if (header.magic != SEGMENT_MAGIC ||
+        FlashStorage::crc32(&header, offsetof(SegmentHeader, crc)) != header.crc) {
+        return false;  // 已擦除或未写完的段
+    }
+    info.valid = true;
+    info.segmentSeq = header.segmentSeq;
+    info.sessionNumber = header.sessionNumber;
+    info.startTime = header.startTime;
+
+    SegmentSummary summary;
+    if (storage->read(slotAddress(slot) + summaryOffset(), &summary, sizeof(summary)) &&
+        summary.magic == SUMMARY_MAGIC && summary.segmentSeq == header.segmentSeq &&
+        FlashStorage::crc32(&summary, offsetof(SegmentSummary, crc)) == summary.crc) {
+        info.sealed = true;
+        info.sessionEnd = summary.sessionEnd != 0;
+        info.minTimestamp = summary.minTimestamp;
+        info.maxTimestamp = summary.maxTimestamp;
+        info.recordCount = summary.recordCount;
+        info.dataEnd = summary.dataEnd;
+        memcpy(info.sensorOffset, summary.sensorOffset, sizeof(info.sensorOffset));
+        memcpy(info.sensorFrames, summary.sensorFrames, sizeof(info.sensorFrames));
+        return true;
+    }
+
+    // 写入中途断电的段：扫描一次记录重建摘要并写回，下次启动无需再扫描
+    recoverSegment(slot);
+    writeSummary(slot);
+    stats.segmentsRecovered++;
+    return true;
+}
+
+void SessionLog::recoverSegment(size_t slot) {
+    SegmentInfo& info = segments[slot];
+    info.sealed = true;
+    info.sessionEnd = true;     // 会话随重启结束
+    info.minTimestamp = UINT64_MAX;
+    info.maxTimestamp = 0;
+    info.recordCount = 0;
+    memset(info.sensorOffset, 0, sizeof(info.sensorOffset));
+    memset(info.sensorFrames, 0, sizeof(info.sensorFrames));
+
+    size_t pos = firstRecordOffset();
+    info.dataEnd = pos;
+    while (pos + sizeof(RecordHeader) <= summaryOffset()) {
+        RecordHeader header;
+        if (!readRecordHeader(slot, pos, header) || header.magic != RECORD_MAGIC ||
+            pos + recordSize(header.length) > summaryOffset()) {
+            // 每次写入都从页边界开始：页内无效说明是页填充，页首无效说明已到记录末尾
+            if (pos % FlashStorage::PAGE_SIZE == 0) {
+                break;
+            }
+            pos = roundUpToPage(pos);
+            continue;
+        }
+        if (header.minTimestamp < info.minTimestamp) {
+            info.minTimestamp = header.minTimestamp;
+        }
+        if (header.maxTimestamp > info.maxTimestamp) {
+            info.maxTimestamp = header.maxTimestamp;
+        }
+        for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+            if ((header.sensorMask & (1 << i)) && info.sensorOffset[i] == 0) {
+                info.sensorOffset[i] = pos;
+            }
+        }
+        info.recordCount++;
+        pos += recordSize(header.length);
+        info.dataEnd = pos;
+    }
+    // 逐记录的帧数不在记录头中，恢复的段不统计sensorFrames
+}
+
+bool SessionLog::writeSummary(size_t slot) {
+    const SegmentInfo& info = segments[slot];
+    SegmentSummary summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.magic = SUMMARY_MAGIC;
+    summary.segmentSeq = info.segmentSeq;
+    summary.minTimestamp = info.minTimestamp;
+    summary.maxTimestamp = info.maxTimestamp;
+    summary.recordCount = info.recordCount;
+    summary.dataEnd = info.dataEnd;
+    memcpy(summary.sensorOffset, info.sensorOffset, sizeof(summary.sensorOffset));
+    memcpy(summary.sensorFrames, info.sensorFrames, sizeof(summary.sensorFrames));
+    summary.sessionEnd = info.sessionEnd ? 1 : 0;
+    summary.crc = FlashStorage::crc32(&summary, offsetof(SegmentSummary, crc));
+
+    if (!storage->write(slotAddress(slot) + summaryOffset(), &summary, sizeof(summary))) {
+        stats.writeErrors++;
+        return false;
+    }
+    return true;
+}
+
+uint32_t SessionLog::beginSession(const char* sessionId, uint32_t startTime) {
+    if (!storage) {
+        return 0;
+    }
+    if (sessionOpen) {
+        endSession();
+    }
+    sessionOpen = true;
+    sessionNumber = nextSessionNumber++;
+    sessionStartTime = startTime;
+    strncpy(this->sessionId, sessionId ? sessionId : "", sizeof(this->sessionId) - 1);
+    this->sessionId[sizeof(this->sessionId) - 1] = '\0';
+    return sessionNumber;
+}
+
+void SessionLog::endSession() {
+    if (activeSlot >= 0) {
+        sealSegment(true);
+    }
+    sessionOpen = false;
+}
+
+bool SessionLog::eraseNextSector() {
+    SegmentInfo& info = segments[nextSlot];
+    if (erasedSectors == 0 && info.valid) {
+        // 开始擦除即从索引中移除最旧的段
+        info.valid = false;
+        stats.segmentsReclaimed++;
+    }
+    stats.sectorsErased++;
+    bool ok = storage->eraseSector(slotAddress(nextSlot) + erasedSectors * FlashStorage::SECTOR_SIZE);
+    if (!ok) {
+        stats.writeErrors++;
+    }
+    erasedSectors++;
+    return ok;
+}
+
+bool SessionLog::openSegment() {
+    size_t sectorsPerSegment = segmentSize / FlashStorage::SECTOR_SIZE;
+    while (erasedSectors < sectorsPerSegment) {
+        stats.inlineErases++;
+        if (!eraseNextSector()) {
+            return false;
+        }
+    }
+
+    size_t slot = nextSlot;
+    SegmentInfo& info = segments[slot];
+    memset(&info, 0, sizeof(info));
+    info.valid = true;
+    info.segmentSeq = nextSegmentSeq++;
+    info.sessionNumber = sessionNumber;
+    info.startTime = sessionStartTime;
+    info.minTimestamp = UINT64_MAX;
+    info.dataEnd = firstRecordOffset();
+
+    // 段头随第一次写入落盘
+    SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SEGMENT_MAGIC;
+    header.segmentSeq = info.segmentSeq;
+    header.sessionNumber = sessionNumber;
+    header.startTime = sessionStartTime;
+    memcpy(header.sessionId, sessionId, sizeof(header.sessionId));
+    header.crc = FlashStorage::crc32(&header, offsetof(SegmentHeader, crc));
+    memset(buffer, 0, firstRecordOffset());
+    memcpy(buffer, &header, sizeof(header));
+    bufferStart = 0;
+    bufferFill = firstRecordOffset();
+
+    activeSlot = slot;
+    nextSlot = (slot + 1) % segmentCount;
+    erasedSectors = 0;
+    return true;
+}
+
+void SessionLog::sealSegment(bool sessionEnd) {
+    flush();
+    segments[activeSlot].sessionEnd = sessionEnd;
+    segments[activeSlot].sealed = true;
+    writeSummary(activeSlot);
+    stats.segmentsSealed++;
+    activeSlot = -1;
+}
+
+bool SessionLog::append(const void* data, size_t length, const RecordInfo& info) {
+    size_t need = recordSize(length);
+    if (!storage || !sessionOpen || length == 0 || length > 0xFFFF || need + firstRecordOffset() > bufferSize) {
+        stats.recordsRejected++;
+        return false;
+    }
+
+    if (activeSlot >= 0 && bufferFill + need > bufferSize) {
+        flush();
+    }
+    // 段写满（页填充之后判断）时封闭当前段，同一会话继续写入新段
+    if (activeSlot >= 0 && bufferStart + bufferFill + need > summaryOffset()) {
+        sealSegment(false);
+    }
+    if (activeSlot < 0 && !openSegment()) {
+        stats.recordsRejected++;
+        return false;
+    }
+
+    SegmentInfo& segment = segments[activeSlot];
+    uint32_t offset = bufferStart + bufferFill;
+
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORD_MAGIC;
+    header.length = length;
+    header.crc = FlashStorage::crc32(data, length);
+    header.minTimestamp = info.minTimestamp;
+    header.maxTimestamp = info.maxTimestamp;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (info.sensorFrames[i] > 0) {
+            header.sensorMask |= 1 << i;
+            if (segment.sensorOffset[i] == 0) {
+                segment.sensorOffset[i] = offset;
+            }
+            segment.sensorFrames[i] += info.sensorFrames[i];
+        }
+    }
+
+    uint8_t* dest = buffer + bufferFill;
+    memcpy(dest, &header, sizeof(header));
+    memcpy(dest + sizeof(header), data, length);
+    memset(dest + sizeof(header) + length, 0, need - sizeof(header) - length);
+    bufferFill += need;
+
+    if (info.minTimestamp < segment.minTimestamp) {
+        segment.minTimestamp = info.minTimestamp;
+    }
+    if (info.maxTimestamp > segment.maxTimestamp) {
+        segment.maxTimestamp = info.maxTimestamp;
+    }
+    segment.recordCount++;
+    segment.dataEnd = offset + need;
+    stats.recordsWritten++;
+    return true;
+}
+
+bool SessionLog::flush() {
+    if (activeSlot < 0 || bufferFill == 0) {
+        return true;
+    }
+    size_t padded = roundUpToPage(bufferFill);
+    memset(buffer + bufferFill, 0xFF, padded - bufferFill);
+
+    bool ok = storage->write(slotAddress(activeSlot) + bufferStart, buffer, padded);
+    if (!ok) {
+        stats.writeErrors++;
+    }
+    stats.bytesFlushed += padded;
+    stats.flushes++;
+    bufferStart += padded;
+    bufferFill = 0;
+    return ok;
+}
+
+bool SessionLog::service() {
+    // 只在会话进行中预擦除，空闲时不提前回收最旧的段
+    if (!storage || !sessionOpen || erasedSectors >= segmentSize / FlashStorage::SECTOR_SIZE) {
+        return false;
+    }
+    eraseNextSector();
+    return true;
+}
+
+bool SessionLog::readRecordHeader(size_t slot, size_t offset, RecordHeader& header) {
+    if (!storage->read(slotAddress(slot) + offset, &header, sizeof(header))) {
+        stats.readErrors++;
+        return false;
+    }
+    return true;
+}
+
+void SessionLog::openCursor(Cursor& cursor, uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp,
+                            uint8_t sensorId) const {
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.sessionNumber = sessionNumber;
+    cursor.fromTimestamp = fromTimestamp;
+    cursor.toTimestamp = toTimestamp;
+    cursor.sensorId = sensorId;
+    cursor.finished = !storage || sensorId > SENSOR_COUNT;
+
+    // 从该会话最早的段开始
+    bool found = false;
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        const SegmentInfo& info = segments[slot];
+        if (info.valid && info.sessionNumber == sessionNumber &&
+            (!found || (int32_t)(info.segmentSeq - cursor.segmentSeq) < 0)) {
+            cursor.segmentSeq = info.segmentSeq;
+            found = true;
+        }
+    }
+    if (!found) {
+        cursor.finished = true;
+    }
+}
+
+bool SessionLog::next(Cursor& cursor, RecordView& record, uint8_t* scratch, size_t scratchSize) {
+    while (!cursor.finished) {
+        // 当前段：序号不小于游标的该会话最早的段（两次读取之间段被回收时跳到后面的段）
+        int slot = -1;
+        for (size_t i = 0; i < segmentCount; i++) {
+            const SegmentInfo& info = segments[i];
+            if (info.valid && info.sessionNumber == cursor.sessionNumber &&
+                (int32_t)(info.segmentSeq - cursor.segmentSeq) >= 0 &&
+                (slot < 0 || (int32_t)(info.segmentSeq - segments[slot].segmentSeq) < 0)) {
+                slot = i;
+            }
+        }
+        if (slot < 0) {
+            cursor.finished = true;
+            break;
+        }
+        const SegmentInfo& info = segments[slot];
+
+        if (info.segmentSeq != cursor.segmentSeq || cursor.offset == 0) {
+            // 进入新段：按索引中的时间范围和传感器偏移跳过整段，不读闪存
+            cursor.segmentSeq = info.segmentSeq;
+            uint32_t start = firstRecordOffset();
+            if (cursor.sensorId > 0) {
+                start = info.sensorOffset[cursor.sensorId - 1];
+            }
+            if (info.recordCount == 0 || start == 0 ||
+                info.maxTimestamp < cursor.fromTimestamp || info.minTimestamp > cursor.toTimestamp) {
+                cursor.stats.segmentsSkipped++;
+                cursor.segmentSeq++;
+                cursor.offset = 0;
+                continue;
+            }
+            cursor.stats.segmentsTouched++;
+            cursor.offset = start;
+        }
+
+        while (cursor.offset + sizeof(RecordHeader) <= info.dataEnd) {
+            size_t pos = cursor.offset;
+            // 读到RAM缓冲区中尚未写入闪存的记录时先落盘
+            if (slot == activeSlot && pos + sizeof(RecordHeader) > bufferStart) {
+                flush();
+            }
+            RecordHeader header;
+            if (!readRecordHeader(slot, pos, header) || header.magic != RECORD_MAGIC ||
+                pos + recordSize(header.length) > info.dataEnd) {
+                cursor.offset = roundUpToPage(pos + 1);
+                continue;
+            }
+            cursor.stats.recordsScanned++;
+            cursor.offset = pos + recordSize(header.length);
+
+            if (header.maxTimestamp < cursor.fromTimestamp || header.minTimestamp > cursor.toTimestamp ||
+                (cursor.sensorId > 0 && !(header.sensorMask & (1 << (cursor.sensorId - 1))))) {
+                continue;
+            }
+
+            // 可映射时直接在映射的闪存上校验和返回载荷，否则读入scratch
+            size_t payloadOffset = slotAddress(slot) + pos + sizeof(RecordHeader);
+            const uint8_t* payload = storage->map(payloadOffset, header.length);
+            if (!payload) {
+                if (header.length > scratchSize || !storage->read(payloadOffset, scratch, header.length)) {
+                    cursor.stats.corruptRecords++;
+                    continue;
+                }
+                payload = scratch;
+            }
+            if (FlashStorage::crc32(payload, header.length) != header.crc) {
+                cursor.stats.corruptRecords++;
+                continue;
+            }
+
+            cursor.stats.recordsMatched++;
+            record.sessionNumber = info.sessionNumber;
+            record.segmentSeq = info.segmentSeq;
+            record.offset = pos;
+            record.minTimestamp = header.minTimestamp;
+            record.maxTimestamp = header.maxTimestamp;
+            record.sensorMask = header.sensorMask;
+            record.payload = payload;
+            record.length = header.length;
+            return true;
+        }
+
+        // 本段读完。会话仍在写入的最后一段保留位置，之后追加的记录下次还能读到
+        if (slot == activeSlot) {
+            bool later = false;
+            for (size_t i = 0; i < segmentCount; i++) {
+                if (segments[i].valid && segments[i].sessionNumber == cursor.sessionNumber &&
+                    (int32_t)(segments[i].segmentSeq - info.segmentSeq) > 0) {
+                    later = true;
+                }
+            }
+            if (!later) {
+                break;
+            }
+        }
+        cursor.segmentSeq = info.segmentSeq + 1;
+        cursor.offset = 0;
+    }
+    return false;
+}
+
+uint32_t SessionLog::query(uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp, uint8_t sensorId,
+                           uint8_t* scratch, size_t scratchSize, RecordCallback callback, void* context,
+                           QueryStats* queryStats) {
+    Cursor cursor;
+    openCursor(cursor, sessionNumber, fromTimestamp, toTimestamp, sensorId);
+    RecordView view;
+    while (next(cursor, view, scratch, scratchSize)) {
+        if (callback && !callback(view, context)) {
+            break;
+        }
+    }
+    if (queryStats) {
+        *queryStats = cursor.stats;
+    }
+    return cursor.stats.recordsMatched;
+}
+
+size_t SessionLog::listSessions(SessionSummary* output, size_t maxSessions) const {
+    size_t count = 0;
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        const SegmentInfo& info = segments[slot];
+        if (!info.valid) {
+            continue;
+        }
+
+        // 按会话号升序插入或合并
+        size_t i = 0;
+        while (i < count && (int32_t)(output[i].sessionNumber - info.sessionNumber) < 0) {
+            i++;
+        }
+        if (i == count || output[i].sessionNumber != info.sessionNumber) {
+            if (count == maxSessions) {
+                if (i == count) {
+                    continue;  // 输出已满，只保留较早的会话
+                }
+                count--;
+            }
+            memmove(&output[i + 1], &output[i], (count - i) * sizeof(SessionSummary));
+            memset(&output[i], 0, sizeof(SessionSummary));
+            output[i].sessionNumber = info.sessionNumber;
+            output[i].startTime = info.startTime;
+            output[i].minTimestamp = UINT64_MAX;
+            count++;
+        }
+
+        SessionSummary& session = output[i];
+        session.segmentCount++;
+        session.recordCount += info.recordCount;
+        for (uint8_t s = 0; s < SENSOR_COUNT; s++) {
+            session.frameCount += info.sensorFrames[s];
+        }
+        if (info.recordCount > 0) {
+            if (info.minTimestamp < session.minTimestamp) {
+                session.minTimestamp = info.minTimestamp;
+            }
+            if (info.maxTimestamp > session.maxTimestamp) {
+                session.maxTimestamp = info.maxTimestamp;
+            }
+        }
+        if (info.sessionEnd) {
+            session.complete = true;
+        }
+    }
+    return count;
+}
+
+uint32_t SessionLog::findSession(const char* sessionId) {
+    if (sessionOpen && strncmp(sessionId, this->sessionId, sizeof(this->sessionId)) == 0) {
+        return sessionNumber;
+    }
+    uint32_t found = 0;
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        const SegmentInfo& info = segments[slot];
+        if (!info.valid || (found != 0 && (int32_t)(info.sessionNumber - found) <= 0)) {
+            continue;
+        }
+        SegmentHeader header;
+        if (!storage->read(slotAddress(slot), &header, sizeof(header))) {
+            stats.readErrors++;
+            continue;
+        }
+        header.sessionId[sizeof(header.sessionId) - 1] = '\0';
+        if (strcmp(header.sessionId, sessionId) == 0) {
+            found = info.sessionNumber;
+        }
+    }
+    return found;
+}
+
+bool SessionLog::getSessionId(uint32_t sessionNumber, char* output, size_t outputSize) {
+    if (outputSize == 0) {
+        return false;
+    }
+    if (sessionOpen && sessionNumber == this->sessionNumber) {
+        strncpy(output, sessionId, outputSize - 1);
+        output[outputSize - 1] = '\0';
+        return true;
+    }
+
+    int oldest = -1;
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        if (segments[slot].valid && segments[slot].sessionNumber == sessionNumber &&
+            (oldest < 0 || (int32_t)(segments[slot].segmentSeq - segments[oldest].segmentSeq) < 0)) {
+            oldest = slot;
+        }
+    }
+    SegmentHeader header;
+    if (oldest < 0 || !storage->read(slotAddress(oldest), &header, sizeof(header))) {
+        return false;
+    }
+    header.sessionId[sizeof(header.sessionId) - 1] = '\0';
+    strncpy(output, header.sessionId, outputSize - 1);
+    output[outputSize - 1] = '\0';
+    return true;
+}
+
+SessionLog::Stats SessionLog::getStats() const {
+    Stats currentStats = stats;
+    currentStats.segmentCount = segmentCount;
+    currentStats.usedSegments = 0;
+    for (size_t slot = 0; slot < segmentCount; slot++) {
+        if (segments[slot].valid) {
+            currentStats.usedSegments++;
+        }
+    }
+    return currentStats;
+}
+
+void SessionLog::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
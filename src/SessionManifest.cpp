@@ -0,0 +1,145 @@
+#include "SessionManifest.h"
+#include "FlashStorage.h"
+#include <string.h>
+
+SessionManifest::SessionManifest() {
+    capturing = false;
+    mutex = nullptr;
+    clear();
+}
+
+void SessionManifest::clear() {
+    memset(&state, 0, sizeof(state));
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        state.sensors[i].firstTimestamp = UINT64_MAX;
+    }
+}
+
+void SessionManifest::begin() {
+    Guard guard(mutex);
+    clear();
+    capturing = true;
+}
+
+void SessionManifest::end() {
+    capturing = false;
+}
+
+void SessionManifest::onBlockSealed(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT],
+                                    const uint64_t firstTimestamps[SENSOR_COUNT], const uint64_t lastTimestamps[SENSOR_COUNT]) {
+    Guard guard(mutex);
+    if (!capturing) {
+        return;
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (sensorFrames[i] == 0) {
+            continue;
+        }
+        SensorEntry& sensor = state.sensors[i];
+        sensor.capturedFrames += sensorFrames[i];
+        if (firstTimestamps[i] < sensor.firstTimestamp) {
+            sensor.firstTimestamp = firstTimestamps[i];
+        }
+        if (lastTimestamps[i] > sensor.lastTimestamp) {
+            sensor.lastTimestamp = lastTimestamps[i];
+        }
+    }
+    if (state.blockCount == 0) {
+        state.firstBlockId = blockId;
+    }
+    state.lastBlockId = blockId;
+    state.blockCount++;
+}
+
+bool SessionManifest::inSession(uint32_t blockId) const {
+    // 块号递增，差值比较兼容回绕
+    return state.blockCount > 0 && (int32_t)(blockId - state.firstBlockId) >= 0 && 
+           (int32_t)(state.lastBlockId - blockId) >= 0;
+}
+
+void SessionManifest::onBlockDropped(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT]) {
+    Guard guard(mutex);
+    if (!inSession(blockId)) {
+        return;
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        state.sensors[i].queueDroppedFrames += sensorFrames[i];
+    }
+}
+
+void SessionManifest::onBlockEncoded(uint32_t blockId, const uint8_t uploadedFrames[SENSOR_COUNT],
+                                     const uint32_t checksums[SENSOR_COUNT], const uint8_t skippedFrames[SENSOR_COUNT]) {
+    Guard guard(mutex);
+    if (!inSession(blockId)) {
+        return;
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        state.sensors[i].uploadedFrames += uploadedFrames[i];
+        state.sensors[i].checksum += checksums[i];
+        state.sensors[i].skippedFrames += skippedFrames[i];
+    }
+}
+
+void SessionManifest::onBlockSkipped(uint32_t blockId, const uint8_t sensorFrames[SENSOR_COUNT]) {
+    Guard guard(mutex);
+    if (!inSession(blockId)) {
+        return;
+    }
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        state.sensors[i].skippedFrames += sensorFrames[i];
+    }
+}
+
+SessionManifest::Snapshot SessionManifest::snapshot() const {
+    Guard guard(mutex);
+    return state;
+}
+
+uint32_t SessionManifest::frameChecksum(uint8_t sensorId, uint32_t timestamp, const int32_t values[CHANNEL_VALUES]) {
+    // 显式按小端序排列，与平台字节序无关
+    uint8_t record[1 + 4 + CHANNEL_VALUES * 4];
+    size_t pos = 0;
+    record[pos++] = sensorId;
+    for (uint8_t b = 0; b < 4; b++) {
+        record[pos++] = (uint8_t)(timestamp >> (8 * b));
+    }
+    for (uint8_t i = 0; i < CHANNEL_VALUES; i++) {
+        uint32_t value = (uint32_t)values[i];
+        for (uint8_t b = 0; b < 4; b++) {
+            record[pos++] = (uint8_t)(value >> (8 * b));
+        }
+    }
+    return FlashStorage::crc32(record, sizeof(record));
+}
+
+uint32_t SessionManifest::Snapshot::getCapturedFrames() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        total += sensors[i].capturedFrames;
+    }
+    return total;
+}
+
+uint32_t SessionManifest::Snapshot::getUploadedFrames() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        total += sensors[i].uploadedFrames;
+    }
+    return total;
+}
+
+uint32_t SessionManifest::Snapshot::getDroppedFrames() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        total += sensors[i].queueDroppedFrames + sensors[i].skippedFrames;
+    }
+    return total;
+}
+
+uint32_t SessionManifest::Snapshot::getChecksum() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        total += sensors[i].checksum;
+    }
+    return total;
+}
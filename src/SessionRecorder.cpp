@@ -0,0 +1,376 @@
+#include "SessionRecorder.h"
+#include "Config.h"
+
+SessionRecorder::SessionRecorder() {
+    logMutex = xSemaphoreCreateMutex();
+    freeItemQueue = nullptr;
+    readyItemQueue = nullptr;
+    items = nullptr;
+    writeBuffer = nullptr;
+    queryBuffer = nullptr;
+    queryBlock = nullptr;
+    ready = false;
+    enabled = Config::RECORDER_ENABLED;
+    recording = false;
+    lastFlushTime = 0;
+    memset(&stats, 0, sizeof(stats));
+    memset(&resendCursor, 0, sizeof(resendCursor));
+    memset(&resendRange, 0, sizeof(resendRange));
+    resendActive = false;
+    resendBlocks = 0;
+}
+
+SessionRecorder::~SessionRecorder() {
+    if (freeItemQueue) vQueueDelete(freeItemQueue);
+    if (readyItemQueue) vQueueDelete(readyItemQueue);
+    if (logMutex) vSemaphoreDelete(logMutex);
+    free(items);
+    free(writeBuffer);
+    free(queryBuffer);
+    free(queryBlock);
+}
+
+bool SessionRecorder::initialize(FlashStorage* storage) {
+    // 槽位和写缓冲区较大，优先放在PSRAM
+    size_t itemBytes = Config::RECORDER_QUEUE_ITEMS * sizeof(Item);
+    items = (Item*)(psramFound() ? ps_malloc(itemBytes) : malloc(itemBytes));
+    writeBuffer = (uint8_t*)(psramFound() ? ps_malloc(Config::RECORDER_WRITE_BUFFER_SIZE)
+                                          : malloc(Config::RECORDER_WRITE_BUFFER_SIZE));
+    queryBuffer = (uint8_t*)malloc(sizeof(DataBlock));
+    queryBlock = (DataBlock*)malloc(sizeof(DataBlock));
+    freeItemQueue = xQueueCreate(Config::RECORDER_QUEUE_ITEMS, sizeof(uint8_t));
+    readyItemQueue = xQueueCreate(Config::RECORDER_QUEUE_ITEMS, sizeof(uint8_t));
+    if (!items || !writeBuffer || !queryBuffer || !queryBlock || !freeItemQueue || !readyItemQueue || !logMutex) {
+        Serial0.printf("[SessionRecorder] ERROR: Failed to allocate recorder buffers\n");
+        return false;
+    }
+    for (uint8_t i = 0; i < Config::RECORDER_QUEUE_ITEMS; i++) {
+        xQueueSend(freeItemQueue, &i, 0);
+    }
+
+    if (!sessionLog.begin(storage, Config::RECORDER_SEGMENT_SIZE, writeBuffer, Config::RECORDER_WRITE_BUFFER_SIZE)) {
+        Serial0.printf("[SessionRecorder] ERROR: Failed to initialize session log\n");
+        return false;
+    }
+    ready = true;
+
+    SessionLog::Stats logStats = sessionLog.getStats();
+    Serial0.printf("[SessionRecorder] Initialized: %u/%u segments in use, %u recovered\n",
+                  logStats.usedSegments, logStats.segmentCount, logStats.segmentsRecovered);
+    return true;
+}
+
+void SessionRecorder::setEnabled(bool enabled) {
+    this->enabled = enabled;
+    Serial0.printf("[SessionRecorder] Recording %s\n", enabled ? "enabled" : "disabled");
+}
+
+int SessionRecorder::takeItem(TickType_t timeout) {
+    uint8_t index;
+    if (!ready || xQueueReceive(freeItemQueue, &index, timeout) != pdTRUE) {
+        return -1;
+    }
+    return index;
+}
+
+void SessionRecorder::startSession(const char* sessionId) {
+    if (!enabled) {
+        return;
+    }
+    // 会话事件不能丢失，允许短暂等待记录任务归还槽位
+    int index = takeItem(pdMS_TO_TICKS(100));
+    if (index < 0) {
+        Serial0.printf("[SessionRecorder] ERROR: Recorder queue full, session not recorded\n");
+        return;
+    }
+    Item& item = items[index];
+    item.kind = ITEM_START;
+    strlcpy(item.sessionId, sessionId ? sessionId : "", sizeof(item.sessionId));
+    item.startTime = millis();
+    uint8_t slot = index;
+    xQueueSend(readyItemQueue, &slot, 0);
+    recording = true;
+}
+
+void SessionRecorder::stopSession() {
+    if (!recording) {
+        return;
+    }
+    recording = false;
+    int index = takeItem(pdMS_TO_TICKS(100));
+    if (index < 0) {
+        // 会话在下一次开始时结束
+        Serial0.printf("[SessionRecorder] WARNING: Recorder queue full, session end deferred\n");
+        return;
+    }
+    items[index].kind = ITEM_STOP;
+    uint8_t slot = index;
+    xQueueSend(readyItemQueue, &slot, 0);
+}
+
+void SessionRecorder::offer(const DataBlock* block) {
+    if (!recording || !block) {
+        return;
+    }
+    stats.offeredBlocks++;
+    int index = takeItem(0);
+    if (index < 0) {
+        stats.droppedBlocks++;
+        return;
+    }
+
+    Item& item = items[index];
+    item.kind = ITEM_BLOCK;
+    item.length = SensorData::serializeBlock(block, item.data);
+    item.info.minTimestamp = UINT64_MAX;
+    item.info.maxTimestamp = 0;
+    for (uint8_t i = 0; i < block->frameCount; i++) {
+        uint64_t timestamp = block->frames[i].rawTimestamp;
+        item.info.minTimestamp = min(item.info.minTimestamp, timestamp);
+        item.info.maxTimestamp = max(item.info.maxTimestamp, timestamp);
+    }
+    memcpy(item.info.sensorFrames, block->sensorFrameCounts, sizeof(item.info.sensorFrames));
+
+    uint8_t slot = index;
+    xQueueSend(readyItemQueue, &slot, 0);
+    uint32_t queued = uxQueueMessagesWaiting(readyItemQueue);
+    if (queued > stats.peakQueuedItems) {
+        stats.peakQueuedItems = queued;
+    }
+}
+
+void SessionRecorder::handleItem(Item& item) {
+    switch (item.kind) {
+        case ITEM_START: {
+            uint32_t sessionNumber = sessionLog.beginSession(item.sessionId, item.startTime);
+            Serial0.printf("[SessionRecorder] Session %u started (session_id '%s')\n", sessionNumber, item.sessionId);
+            break;
+        }
+        case ITEM_STOP: {
+            uint32_t sessionNumber = sessionLog.getActiveSession();
+            sessionLog.endSession();
+            Serial0.printf("[SessionRecorder] Session %u stopped\n", sessionNumber);
+            break;
+        }
+        case ITEM_BLOCK:
+            if (sessionLog.append(item.data, item.length, item.info)) {
+                stats.recordedBlocks++;
+            } else {
+                stats.failedBlocks++;
+            }
+            break;
+    }
+}
+
+void SessionRecorder::process() {
+    if (!ready) {
+        vTaskDelay(pdMS_TO_TICKS(Config::RECORDER_FLUSH_INTERVAL_MS));
+        return;
+    }
+
+    uint8_t index;
+    if (xQueueReceive(readyItemQueue, &index, pdMS_TO_TICKS(Config::RECORDER_FLUSH_INTERVAL_MS)) == pdTRUE) {
+        if (xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+            handleItem(items[index]);
+            xSemaphoreGive(logMutex);
+        }
+        xQueueSend(freeItemQueue, &index, 0);
+        if (uxQueueMessagesWaiting(readyItemQueue) > 0) {
+            return;
+        }
+    }
+
+    // 队列已空：定期把缓冲区落盘（断电最多丢失一个周期的记录），每轮预擦除一个扇区
+    if (xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        uint32_t now = millis();
+        if (now - lastFlushTime >= Config::RECORDER_FLUSH_INTERVAL_MS) {
+            sessionLog.flush();
+            lastFlushTime = now;
+        }
+        sessionLog.service();
+        xSemaphoreGive(logMutex);
+    }
+}
+
+size_t SessionRecorder::listSessions(SessionLog::SessionSummary* output, size_t maxSessions) {
+    size_t count = 0;
+    if (ready && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        count = sessionLog.listSessions(output, maxSessions);
+        xSemaphoreGive(logMutex);
+    }
+    return count;
+}
+
+bool SessionRecorder::getSessionId(uint32_t sessionNumber, char* output, size_t outputSize) {
+    bool found = false;
+    if (ready && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        found = sessionLog.getSessionId(sessionNumber, output, outputSize);
+        xSemaphoreGive(logMutex);
+    }
+    return found;
+}
+
+uint32_t SessionRecorder::query(uint32_t sessionNumber, uint64_t fromTimestamp, uint64_t toTimestamp, uint8_t sensorId,
+                                BlockCallback callback, void* context, SessionLog::QueryStats* queryStats) {
+    uint32_t matched = 0;
+    if (!ready || xSemaphoreTake(logMutex, portMAX_DELAY) != pdTRUE) {
+        return 0;
+    }
+    SessionLog::Cursor cursor;
+    sessionLog.openCursor(cursor, sessionNumber, fromTimestamp, toTimestamp, sensorId);
+    xSemaphoreGive(logMutex);
+    
+    // 每次持锁只读出一条匹配的记录，回调（如串口输出）在释放锁后执行，记录任务最多等待一条记录的读取
+    SessionLog::RecordView record;
+    while (xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        bool found = sessionLog.next(cursor, record, queryBuffer, sizeof(DataBlock));
+        bool decoded = found && SensorData::deserializeBlock(record.payload, record.length, queryBlock);
+        xSemaphoreGive(logMutex);
+        if (!found) {
+            break;
+        }
+        if (!decoded) {
+            continue;
+        }
+        matched++;
+        if (callback && !callback(*queryBlock, context)) {
+            break;
+        }
+    }
+    if (queryStats) {
+        *queryStats = cursor.stats;
+    }
+    return matched;
+}
+
+uint32_t SessionRecorder::findSession(const char* sessionId) {
+    uint32_t sessionNumber = 0;
+    if (ready && sessionId && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        sessionNumber = sessionLog.findSession(sessionId);
+        xSemaphoreGive(logMutex);
+    }
+    return sessionNumber;
+}
+
+bool SessionRecorder::startResend(const ResendRange& range) {
+    if (!ready || xSemaphoreTake(logMutex, portMAX_DELAY) != pdTRUE) {
+        return false;
+    }
+    resendRange = range;
+    // 进行中的会话只补发已记录的部分，避免补发一直追赶新写入的记录
+    if (range.sessionNumber == sessionLog.getActiveSession()) {
+        uint64_t recordedUntil = 0;
+        for (size_t slot = 0; slot < sessionLog.getSegmentCount(); slot++) {
+            const SessionLog::SegmentInfo& info = sessionLog.getSegment(slot);
+            if (info.valid && info.sessionNumber == range.sessionNumber && info.recordCount > 0) {
+                recordedUntil = max(recordedUntil, info.maxTimestamp);
+            }
+        }
+        resendRange.toTimestamp = min(resendRange.toTimestamp, recordedUntil);
+    }
+    sessionLog.openCursor(resendCursor, resendRange.sessionNumber, resendRange.fromTimestamp,
+                          resendRange.toTimestamp, resendRange.sensorId);
+    bool found = !resendCursor.finished;
+    resendBlocks = 0;
+    resendActive = found;
+    xSemaphoreGive(logMutex);
+    return found;
+}
+
+void SessionRecorder::cancelResend() {
+    if (ready && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        resendActive = false;
+        resendCursor.finished = true;
+        xSemaphoreGive(logMutex);
+    }
+}
+
+uint8_t SessionRecorder::filterResendFrames(DataBlock* block) const {
+    uint8_t kept = 0;
+    memset(block->sensorFrameCounts, 0, sizeof(block->sensorFrameCounts));
+    for (uint8_t i = 0; i < block->frameCount; i++) {
+        const SensorFrame& frame = block->frames[i];
+        if ((resendRange.sensorId > 0 && frame.sensorId != resendRange.sensorId) ||
+            frame.rawTimestamp < resendRange.fromTimestamp || frame.rawTimestamp > resendRange.toTimestamp) {
+            continue;
+        }
+        if (frame.sensorId >= 1 && frame.sensorId <= SENSOR_DATA_SENSOR_COUNT) {
+            block->sensorFrameCounts[frame.sensorId - 1]++;
+        }
+        if (kept != i) {
+            block->frames[kept] = frame;
+        }
+        kept++;
+    }
+    block->frameCount = kept;
+    return kept;
+}
+
+SessionRecorder::ResendRead SessionRecorder::readResend(DataBlock* block) {
+    if (!resendActive) {
+        return ResendRead::DONE;
+    }
+    // 记录任务正在写闪存时不等待，实时数据的编码优先
+    if (xSemaphoreTake(logMutex, 0) != pdTRUE) {
+        return ResendRead::PENDING;
+    }
+
+    ResendRead result = ResendRead::PENDING;
+    SessionLog::RecordView record;
+    // 每轮最多检查几条记录，块号范围靠后时不会长时间占用编码任务
+    for (uint8_t scanned = 0; scanned < 8; scanned++) {
+        if (!resendActive) {
+            result = ResendRead::DONE;
+            break;
+        }
+        // 载荷可映射时直接从闪存映射反序列化到块中，不经过queryBuffer
+        if (!sessionLog.next(resendCursor, record, queryBuffer, sizeof(DataBlock))) {
+            resendActive = false;
+            result = ResendRead::DONE;
+            break;
+        }
+        if (!SensorData::deserializeBlock(record.payload, record.length, block)) {
+            continue;
+        }
+        if (block->blockId > resendRange.toBlockId) {
+            // 会话内块号递增，之后的记录都在范围之外
+            resendActive = false;
+            result = ResendRead::DONE;
+            break;
+        }
+        if (block->blockId < resendRange.fromBlockId || filterResendFrames(block) == 0) {
+            continue;
+        }
+        resendBlocks++;
+        result = ResendRead::BLOCK;
+        break;
+    }
+    xSemaphoreGive(logMutex);
+    return result;
+}
+
+SessionLog::Stats SessionRecorder::getLogStats() {
+    SessionLog::Stats logStats;
+    memset(&logStats, 0, sizeof(logStats));
+    if (ready && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        logStats = sessionLog.getStats();
+        xSemaphoreGive(logMutex);
+    }
+    return logStats;
+}
+
+uint32_t SessionRecorder::getActiveSession() {
+    return sessionLog.getActiveSession();
+}
+
+uint32_t SessionRecorder::getQueuedItems() const {
+    return readyItemQueue ? uxQueueMessagesWaiting(readyItemQueue) : 0;
+}
+
+void SessionRecorder::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    if (ready && xSemaphoreTake(logMutex, portMAX_DELAY) == pdTRUE) {
+        sessionLog.resetStats();
+        xSemaphoreGive(logMutex);
+    }
+}
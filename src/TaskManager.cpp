@@ -9,9 +9,15 @@ TaskManager::TaskManager() {
     bufferPool = nullptr;
     sensorData = nullptr;
     bluetoothConfig = nullptr;
+    dataPartition = nullptr;
+    spoolRegion = nullptr;
+    recorderRegion = nullptr;
+    sessionRecorder = nullptr;
     
     uartTaskHandle = nullptr;
     networkTaskHandle = nullptr;
+    encoderTaskHandle = nullptr;
+    recorderTaskHandle = nullptr;
     cliTaskHandle = nullptr;
     monitorTaskHandle = nullptr;
     timeSyncTaskHandle = nullptr;
@@ -31,7 +37,11 @@ TaskManager::~TaskManager() {
     if (timeSync) delete timeSync;
     if (bufferPool) delete bufferPool;
     if (sensorData) delete sensorData;
+    if (sessionRecorder) delete sessionRecorder;
     if (bluetoothConfig) delete bluetoothConfig;
+    if (spoolRegion) delete spoolRegion;
+    if (recorderRegion) delete recorderRegion;
+    if (dataPartition) delete dataPartition;
     
     Serial0.printf("[TaskManager] Destroyed\n");
 }
@@ -76,9 +86,43 @@ bool TaskManager::initialize() {
         return false;
     }
     
-    // 设置WebSocketClient的BufferPool实例用于正确释放数据块
-    if (webSocketClient && bufferPool) {
-        webSocketClient->setBufferPool(bufferPool);
+    // WebSocketClient直接从SensorData取块，发送确认后归还给SensorData
+    if (webSocketClient && sensorData) {
+        webSocketClient->setSensorData(sensorData);
+    }
+    
+    // 心跳和状态响应报告NTP是否已同步
+    if (webSocketClient && timeSync) {
+        webSocketClient->setTimeSync(timeSync);
+    }
+    
+    // 闪存暂存区和会话记录：直接使用spiffs分区的前后两部分，分区不可用时只是不暂存/不记录
+    dataPartition = new PartitionStorage();
+    bool partitionReady = dataPartition && dataPartition->begin(ESP_PARTITION_SUBTYPE_DATA_SPIFFS);
+    spoolRegion = new FlashRegion();
+    if (webSocketClient && partitionReady && spoolRegion &&
+        spoolRegion->begin(dataPartition, Config::SPOOL_REGION_OFFSET, Config::SPOOL_REGION_SIZE)) {
+        webSocketClient->setSpoolStorage(spoolRegion);
+    } else {
+        Serial0.printf("[TaskManager] WARNING: Spool storage unavailable, blocks will not be spooled\n");
+    }
+    
+    recorderRegion = new FlashRegion();
+    sessionRecorder = new SessionRecorder();
+    if (partitionReady && recorderRegion && sessionRecorder &&
+        recorderRegion->begin(dataPartition, Config::RECORDER_REGION_OFFSET, Config::RECORDER_REGION_SIZE) &&
+        sessionRecorder->initialize(recorderRegion)) {
+        if (sensorData) {
+            sensorData->setSessionRecorder(sessionRecorder);
+        }
+        if (webSocketClient) {
+            webSocketClient->setSessionRecorder(sessionRecorder);
+        }
+        if (commandHandler) {
+            commandHandler->setSessionRecorder(sessionRecorder);
+        }
+    } else {
+        Serial0.printf("[TaskManager] WARNING: Session recorder unavailable, sessions will not be recorded\n");
     }
     
     // 设置WebSocketClient的CommandHandler实例用于处理服务器命令
@@ -130,6 +174,24 @@ bool TaskManager::startTasks() {
         return false;
     }
     
+    if (!createEncoderTask()) {
+        Serial0.printf("[TaskManager] ERROR: Failed to create encoder task\n");
+        return false;
+    }
+    
+    // 数据块封装完成后通知编码任务，编码完成后由WebSocketClient通知网络任务
+    if (webSocketClient) {
+        webSocketClient->setTaskHandles(networkTaskHandle, encoderTaskHandle);
+    }
+    if (sensorData) {
+        sensorData->setConsumerTask(encoderTaskHandle);
+    }
+    
+    if (!createRecorderTask()) {
+        Serial0.printf("[TaskManager] ERROR: Failed to create recorder task\n");
+        return false;
+    }
+    
     if (!createCliTask()) {
         Serial0.printf("[TaskManager] ERROR: Failed to create CLI task\n");
         return false;
@@ -169,11 +231,28 @@ void TaskManager::stopTasks() {
         uartTaskHandle = nullptr;
     }
     
+    if (sensorData) {
+        sensorData->setConsumerTask(nullptr);
+    }
+    if (webSocketClient) {
+        webSocketClient->setTaskHandles(nullptr, nullptr);
+    }
+    
+    if (encoderTaskHandle) {
+        vTaskDelete(encoderTaskHandle);
+        encoderTaskHandle = nullptr;
+    }
+    
     if (networkTaskHandle) {
         vTaskDelete(networkTaskHandle);
         networkTaskHandle = nullptr;
     }
     
+    if (recorderTaskHandle) {
+        vTaskDelete(recorderTaskHandle);
+        recorderTaskHandle = nullptr;
+    }
+    
     if (cliTaskHandle) {
         vTaskDelete(cliTaskHandle);
         cliTaskHandle = nullptr;
@@ -203,6 +282,8 @@ void TaskManager::getSystemStatus() {
     Serial0.printf("任务状态: %s\n", tasksRunning ? "运行中" : "已停止");
     Serial0.printf("UART任务: %s\n", uartTaskHandle ? "运行中" : "未运行");
     Serial0.printf("网络任务: %s\n", networkTaskHandle ? "运行中" : "未运行");
+    Serial0.printf("编码任务: %s\n", encoderTaskHandle ? "运行中" : "未运行");
+    Serial0.printf("会话记录任务: %s\n", recorderTaskHandle ? "运行中" : "未运行");
     Serial0.printf("CLI任务: %s\n", cliTaskHandle ? "运行中" : "未运行");
     Serial0.printf("监控任务: %s\n", monitorTaskHandle ? "运行中" : "未运行");
     Serial0.printf("时间同步任务: %s\n", timeSyncTaskHandle ? "运行中" : "未运行");
@@ -224,6 +305,16 @@ void TaskManager::networkTask(void* parameter) {
     manager->networkTaskLoop();
 }
 
+void TaskManager::encoderTask(void* parameter) {
+    TaskManager* manager = (TaskManager*)parameter;
+    manager->encoderTaskLoop();
+}
+
+void TaskManager::recorderTask(void* parameter) {
+    TaskManager* manager = (TaskManager*)parameter;
+    manager->recorderTaskLoop();
+}
+
 void TaskManager::cliTask(void* parameter) {
     TaskManager* manager = (TaskManager*)parameter;
     manager->cliTaskLoop();
@@ -274,6 +365,46 @@ bool TaskManager::createNetworkTask() {
     return true;
 }
 
+bool TaskManager::createEncoderTask() {
+    BaseType_t result = xTaskCreatePinnedToCore(
+        encoderTask,
+        "Encoder_Task",
+        Config::ENCODER_TASK_STACK_SIZE,
+        this,
+        Config::ENCODER_TASK_PRIORITY,
+        &encoderTaskHandle,
+        Config::ENCODER_TASK_CORE
+    );
+    
+    if (result != pdPASS) {
+        Serial0.printf("[TaskManager] ERROR: Failed to create encoder task\n");
+        return false;
+    }
+    
+    Serial0.printf("[TaskManager] Encoder task created on Core %d\n", Config::ENCODER_TASK_CORE);
+    return true;
+}
+
+bool TaskManager::createRecorderTask() {
+    BaseType_t result = xTaskCreatePinnedToCore(
+        recorderTask,
+        "Recorder_Task",
+        Config::RECORDER_TASK_STACK_SIZE,
+        this,
+        Config::RECORDER_TASK_PRIORITY,
+        &recorderTaskHandle,
+        Config::RECORDER_TASK_CORE
+    );
+    
+    if (result != pdPASS) {
+        Serial0.printf("[TaskManager] ERROR: Failed to create recorder task\n");
+        return false;
+    }
+    
+    Serial0.printf("[TaskManager] Recorder task created on Core %d\n", Config::RECORDER_TASK_CORE);
+    return true;
+}
+
 bool TaskManager::createCliTask() {
     BaseType_t result = xTaskCreatePinnedToCore(
         cliTask,
@@ -335,6 +466,30 @@ void TaskManager::uartTaskLoop() {
     }
 }
 
+void TaskManager::encoderTaskLoop() {
+    Serial0.printf("[Encoder_Task] Started on Core %d\n", xPortGetCoreID());
+    
+    while (true) {
+        // 有块且有空闲输出缓冲区时连续编码；否则等待块封装或缓冲区归还的通知
+        if (!webSocketClient || !webSocketClient->encodeNext()) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(Config::NETWORK_LOOP_INTERVAL_MS));
+        }
+    }
+}
+
+void TaskManager::recorderTaskLoop() {
+    Serial0.printf("[Recorder_Task] Started on Core %d\n", xPortGetCoreID());
+    
+    while (true) {
+        // 等待队列中的块，无块时定期落盘；记录器不可用时只是空转等待
+        if (sessionRecorder) {
+            sessionRecorder->process();
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(Config::RECORDER_FLUSH_INTERVAL_MS));
+        }
+    }
+}
+
 void TaskManager::networkTaskLoop() {
     Serial0.printf("[Network_Task] Started on Core %d\n", xPortGetCoreID());
     
@@ -344,7 +499,6 @@ void TaskManager::networkTaskLoop() {
         webSocketClient->initialize(Config::WIFI_SSID, Config::WIFI_PASSWORD, 
                                    Config::SERVER_URL, Config::SERVER_PORT, 
                                    Config::DEVICE_CODE);
-        webSocketClient->connect();
     }
     
     // 用于跟踪WiFi连接状态和延迟启动时间同步
@@ -413,30 +567,21 @@ void TaskManager::networkTaskLoop() {
             // 处理WebSocket事件
             webSocketClient->loop();
             
-            // 处理发送队列
+            // 发送所有已就绪的消息，单次处理耗时超过时间片时让出，保证webSocket.loop()的调用频率
             webSocketClient->processSendQueue();
             
             // 处理连接重试
             webSocketClient->handleConnectionRetry();
-            
-            // 获取数据块并发送
-            if (sensorData) {
-                DataBlock* block = sensorData->getNextBlock();
-                if (block) {
-                    bool sendResult = webSocketClient->sendDataBlock(block);
-                    if (!sendResult) {
-                        // 如果发送失败（队列满或连接问题），需要立即释放数据块避免内存泄漏
-                        sensorData->releaseBlock(block);
-                        if(Config::SHOW_DROPPED_PACKETS){
-                        Serial0.printf("[TaskManager] WARNING: Failed to send data block, released to avoid memory leak\n");
-                        }
-                    }
-                    // 注意：成功发送的数据块将在WebSocketClient::processSendQueue()中发送完成后释放
-                }
-            }
         }
         
-        vTaskDelay(pdMS_TO_TICKS(10)); // 10ms延迟
+        // 等待数据块通知，最长等待NETWORK_LOOP_INTERVAL_MS（省电空闲阶段为POWER_IDLE_LOOP_INTERVAL_MS）以按时处理WebSocket事件
+        // 若上轮因时间片用尽而提前退出，等待间隔为0，只让出不等待直接进入下一轮
+        uint32_t waitMs = webSocketClient ? webSocketClient->getLoopIntervalMs() : Config::NETWORK_LOOP_INTERVAL_MS;
+        if (waitMs == 0) {
+            taskYIELD();
+        } else {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+        }
     }
 }
 
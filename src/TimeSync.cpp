@@ -1,34 +1,47 @@
 #include "TimeSync.h"
 
 // 静态成员初始化
-bool TimeSync::ntpCallbackCalled = false;
+ClockLatch<TimeSync::NtpSample> TimeSync::ntpSamples;
 
 TimeSync::TimeSync() {
     // 初始化所有传感器的滑动窗口
     memset(slidingWindows, 0, sizeof(slidingWindows));
+    memset(lastFit, 0, sizeof(lastFit));
     for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
         windowIndex[i] = 0;
         windowCount[i] = 0;
         syncReady[i] = false;
-        paramA[i] = 1.0f;
-        paramB[i] = 0.0f;
+        paramA[i] = 1.0;
+        paramB[i] = 0.0;
         paramsValid[i] = false;
         calcCount[i] = 0;
-        paramASum[i] = 0.0f;
-        paramBSum[i] = 0.0f;
+        paramASum[i] = 0.0;
+        paramBSum[i] = 0.0;
         calcCompleted[i] = false;
         lastCalcTime[i] = 0;
         sensorCalibrating[i] = false;
         autoCalibrationRounds[i] = 0;
-    }
+        trackers[i].configure(Config::TIME_SYNC_TRACK_TIME_CONSTANT_MS, Config::TIME_SYNC_MAX_SLEW_PPM,
+                              Config::TIME_SYNC_MAX_SKEW_PPM, Config::TIME_SYNC_RELOCK_THRESHOLD_MS,
+                              Config::TIME_SYNC_LOWER_ENVELOPE ? Config::TIME_SYNC_TRACK_ENVELOPE_MS : 0.0f);
+        trackerCommand[i].store(TRACKER_NONE);
+        clockEpoch[i].store(0);
+        publishEpoch[i] = 0;
+        commandSlope[i] = 1.0;
+        commandIntercept[i] = 0.0;
+        syncedTimestamps[i] = 0;
+        unsyncedTimestamps[i] = 0;
+    }
+    pairQueuePeak = 0;
     
     syncActive = false;
     fittingActive = false;
     autoCalibrationActive = false;
     
     // 初始化NTP相关
-    ntpOffsetMs = 0;
-    ntpInitialized = false;
+    ntpSampleVersion = ntpSamples.getVersion();
+    ntpClock.configure(Config::NTP_MAX_SLEW_PPM, Config::NTP_STEP_THRESHOLD_MS, Config::NTP_MAX_DRIFT_PPM);
+    publishedNtp.publish(ntpClock.getModel());
     
     // 创建互斥锁
     mutex = xSemaphoreCreateMutex();
@@ -45,6 +58,10 @@ TimeSync::~TimeSync() {
 }
 
 bool TimeSync::initialize() {
+    // 设置时区为北京时间 (UTC+8)，在任务启动前设置，格式化缓存的本地日零点不会因时区变化失效
+    setenv("TZ", "CST-8", 1);
+    tzset();
+    
     if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
         // 初始化时间同步系统
         reset();
@@ -70,13 +87,7 @@ bool TimeSync::startTimeSync() {
         return false;
     }
     
-    // 在锁外进行NTP时间同步（这可能需要几秒钟）
-    // 如果NTP已经初始化，直接返回成功
-    if (ntpInitialized) {
-        Serial0.printf("[TimeSync] NTP already initialized, using existing offset\n");
-        return true;
-    }
-    
+    // 在锁外启动SNTP，不等待同步结果；已有的NTP偏移模型保留，isNtpInitialized在第一次同步后变为true
     if (syncNtpTime()) {
         Serial0.printf("[TimeSync] Started time synchronization\n");
         return true;
@@ -127,13 +138,12 @@ void TimeSync::startSingleSensorCalibration(uint8_t sensorId) {
     uint8_t sensorIndex = sensorId - 1;
     
     if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-        // 清空该传感器的窗口
-        windowIndex[sensorIndex] = 0;
-        windowCount[sensorIndex] = 0;
+        // 清空该传感器的窗口和之前排队的时间对
+        clearWindow(sensorIndex);
         
         // 重置累加器（用于自动校准模式）
-        paramASum[sensorIndex] = 0.0f;
-        paramBSum[sensorIndex] = 0.0f;
+        paramASum[sensorIndex] = 0.0;
+        paramBSum[sensorIndex] = 0.0;
         autoCalibrationRounds[sensorIndex] = 0;
         
         // 标记该传感器正在校准
@@ -167,10 +177,9 @@ void TimeSync::startAutoCalibration() {
         
         // 为所有传感器清空窗口和重置状态
         for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
-            windowIndex[i] = 0;
-            windowCount[i] = 0;
-            paramASum[i] = 0.0f;
-            paramBSum[i] = 0.0f;
+            clearWindow(i);
+            paramASum[i] = 0.0;
+            paramBSum[i] = 0.0;
             autoCalibrationRounds[i] = 0;
             sensorCalibrating[i] = true;  // 所有传感器都开始校准
         }
@@ -202,64 +211,79 @@ void TimeSync::addTimePair(uint8_t sensorId, uint32_t sensorTimeMs, int64_t espT
     
     uint8_t sensorIndex = sensorId - 1;
     
-    // 检查是否需要收集该传感器的时间对
+    // 先读取epoch再执行其他任务的开始/停止跟踪请求：reset()先写停止请求再递增epoch，
+    // 读到新epoch时一定也能取到停止请求，读到旧epoch时发布的快照已失效
+    publishEpoch[sensorIndex] = clockEpoch[sensorIndex].load(std::memory_order_acquire);
+    applyTrackerCommand(sensorIndex);
+    
+    // 检查是否需要处理该传感器的时间对
     // 1. 全局校准模式（fittingActive=true）
     // 2. 单个传感器校准模式（sensorCalibrating[sensorIndex]=true）
-    if (!fittingActive && !sensorCalibrating[sensorIndex]) {
-        return; // 该传感器未在校准中，直接返回
+    // 3. 校准完成后的持续跟踪（trackers[sensorIndex]激活）
+    bool collecting = fittingActive || sensorCalibrating[sensorIndex];
+    if (!collecting && !trackers[sensorIndex].isActive()) {
+        return; // 该传感器未在校准或跟踪中，直接返回
     }
 
-    // 尝试获取互斥锁（快速获取，失败直接返回）
-    if (xSemaphoreTake(mutex, 0) != pdTRUE) {
-        return; // 无法获取锁，直接返回（避免阻塞数据接收）
+    if (!isValidTimePair(sensorId, sensorTimeMs, espTimeUs)) {
+        return;
     }
     
-    // 验证时间对的有效性并快速添加到窗口
-    if (isValidTimePair(sensorId, sensorTimeMs, espTimeUs)) {
-        updateSlidingWindow(sensorId, sensorTimeMs, espTimeUs);
-        // 注意：不在这里进行计算，在后台任务中处理
+    // 跟踪器只由本任务更新，不需要锁，每个时间对O(1)更新后发布
+    if (trackers[sensorIndex].isActive()) {
+        if (!trackers[sensorIndex].update(sensorTimeMs, espTimeUs)) {
+            Serial0.printf("[TimeSync] Sensor %d tracking error %.1f ms over threshold, relocked\n",
+                          sensorId, trackers[sensorIndex].getStats().lastError);
+        }
+        publishClock(sensorIndex);
     }
     
-    xSemaphoreGive(mutex);
+    if (collecting) {
+        // 校准窗口与后台拟合共用：放入队列，不取锁，后台任务取出后加入窗口并拟合；
+        // 队列满（后台任务连续约600ms未取出）时丢弃并计入溢出数
+        QueuedPair pair = {sensorTimeMs, espTimeUs};
+        pairQueues[sensorIndex].push(pair);
+    }
 }
 
-uint64_t TimeSync::calculateTimestamp(uint8_t sensorId, uint32_t sensorTimeMs) {
-    if (!isValidSensorId(sensorId) || xSemaphoreTake(mutex, 0) != pdTRUE) {
+uint64_t TimeSync::calculateTimestamp(uint8_t sensorId, uint32_t sensorTimeMs, bool* ntpSynced) {
+    if (ntpSynced) {
+        *ntpSynced = false;
+    }
+    if (!isValidSensorId(sensorId)) {
         return sensorTimeMs; // 返回原始时间戳
     }
     
     uint8_t sensorIndex = sensorId - 1; // 转换为数组索引 (1-4 -> 0-3)
     
+    // 读取发布的参数快照，不等待后台任务
+    SensorClock clock;
+    readClock(sensorIndex, clock);
+    
     // 如果该传感器的时间同步未就绪，返回原始时间戳
-    if (!syncReady[sensorIndex]) {
-        xSemaphoreGive(mutex);
+    if (!clock.ready) {
+        unsyncedTimestamps[sensorIndex]++;
         return sensorTimeMs;
     }
     
     // 计算：T = a*S + b + N
-    // 注意：现在paramB已经是毫秒单位了
-    float espTimeMs = paramA[sensorIndex] * sensorTimeMs + paramB[sensorIndex];
-    uint64_t globalTimeMs = (uint64_t)espTimeMs + ntpOffsetMs;
-    
-    xSemaphoreGive(mutex);
-    return globalTimeMs;
+    // 注意：现在paramB已经是毫秒单位了；运行时间达到数百万毫秒时float的精度不足1ms，用double计算
+    // N是ESP32时间的函数，在微秒上计算后再取整到毫秒，N逐渐修正时T单调不减
+    double espTimeMs = ClockTracker::evaluate(clock.model, sensorTimeMs);
+    int64_t espTimeUs = (int64_t)(espTimeMs * 1000.0);
+    NtpClock::Model ntp;
+    publishedNtp.read(ntp);
+    int64_t globalTimeUs = espTimeUs + NtpClock::offsetAt(ntp, espTimeUs);
+    syncedTimestamps[sensorIndex]++;
+    if (ntpSynced) {
+        *ntpSynced = ntp.valid;
+    }
+    
+    return (uint64_t)(globalTimeUs / 1000);
 }
 
 uint32_t TimeSync::formatTimestamp(uint64_t timestampMs) {
-    time_t timestamp = timestampMs / 1000;
-    struct tm* timeinfo = localtime(&timestamp);
-    if (!timeinfo) return 0;
-
-    uint32_t ms = timestampMs % 1000;
-
-    // 拼成十进制数：HHMMSSmmm
-    uint32_t formatted = 
-        timeinfo->tm_hour * 10000000 +
-        timeinfo->tm_min  * 100000 +
-        timeinfo->tm_sec  * 1000 +
-        ms;
-
-    return formatted;
+    return formatter.format(timestampMs);
 }
 
 
@@ -269,39 +293,49 @@ void TimeSync::performBackgroundFitting() {
         return; // 无法获取锁，下次再处理
     }
     
+    processNtpSample();
+    
     // 检查每个传感器的窗口状态
     for (uint8_t sensorIndex = 0; sensorIndex < TIME_SYNC_SENSOR_COUNT; sensorIndex++) {
         uint8_t sensorId = sensorIndex + 1;
         
         // 检查该传感器是否正在校准
         if (!fittingActive && !sensorCalibrating[sensorIndex]) {
+            pairQueues[sensorIndex].clear(); // 校准刚结束时仍在排队的时间对直接丢弃
             continue; // 该传感器未在校准中，跳过
         }
         
+        drainPairQueue(sensorIndex);
+        
         // 检查窗口是否已满（50个点）
         if (windowCount[sensorIndex] >= SLIDING_WINDOW_SIZE) {
             // 窗口已满，进行计算
-            float tempA, tempB;
-            if (calculateLinearRegression(sensorId, tempA, tempB)) {
+            ClockFit::Result fit;
+            if (calculateLinearRegression(sensorId, fit)) {
+                double tempA = fit.slope;
+                double tempB = fit.intercept;
+                lastFit[sensorIndex] = fit;
+
                 // 自动校准模式：累加参数并计数
                 if (autoCalibrationActive && sensorCalibrating[sensorIndex]) {
                     paramASum[sensorIndex] += tempA;
                     paramBSum[sensorIndex] += tempB;
                     autoCalibrationRounds[sensorIndex]++;
                     
-                    Serial0.printf("[TimeSync] Sensor %d auto-calibration round %d: a=%.6f, b=%.2f\n", 
+                    Serial0.printf("[TimeSync] Sensor %d auto-calibration round %d: a=%.9f, b=%.3f\n", 
                                  sensorId, autoCalibrationRounds[sensorIndex], tempA, tempB);
                     
                     // 检查是否完成3轮
                     if (autoCalibrationRounds[sensorIndex] >= 3) {
                         // 计算平均值
-                        paramA[sensorIndex] = paramASum[sensorIndex] / 3.0f;
-                        paramB[sensorIndex] = paramBSum[sensorIndex] / 3.0f;
+                        paramA[sensorIndex] = paramASum[sensorIndex] / 3.0;
+                        paramB[sensorIndex] = paramBSum[sensorIndex] / 3.0;
                         paramsValid[sensorIndex] = true;
                         syncReady[sensorIndex] = true;
                         sensorCalibrating[sensorIndex] = false;
+                        requestTracker(sensorIndex, TRACKER_START, paramA[sensorIndex], paramB[sensorIndex]);
                         
-                        Serial0.printf("[TimeSync] Sensor %d auto-calibration completed: avg_a=%.6f, avg_b=%.2f\n", 
+                        Serial0.printf("[TimeSync] Sensor %d auto-calibration completed: avg_a=%.9f, avg_b=%.3f\n", 
                                      sensorId, paramA[sensorIndex], paramB[sensorIndex]);
                     }
                 }
@@ -312,8 +346,9 @@ void TimeSync::performBackgroundFitting() {
                     paramsValid[sensorIndex] = true;
                     syncReady[sensorIndex] = true;
                     sensorCalibrating[sensorIndex] = false;
+                    requestTracker(sensorIndex, TRACKER_START, paramA[sensorIndex], paramB[sensorIndex]);
                     
-                    Serial0.printf("[TimeSync] Sensor %d single calibration completed: a=%.6f, b=%.2f\n", 
+                    Serial0.printf("[TimeSync] Sensor %d single calibration completed: a=%.9f, b=%.3f\n", 
                                  sensorId, paramA[sensorIndex], paramB[sensorIndex]);
                 }
                 
@@ -340,7 +375,7 @@ void TimeSync::performBackgroundFitting() {
             Serial0.printf("[TimeSync] ========================================\n");
             Serial0.printf("[TimeSync] Auto-calibration completed for all sensors!\n");
             for (uint8_t i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
-                Serial0.printf("[TimeSync] Sensor %d: a=%.6f, b=%.2f\n", 
+                Serial0.printf("[TimeSync] Sensor %d: a=%.9f, b=%.3f\n", 
                              i + 1, paramA[i], paramB[i]);
             }
             Serial0.printf("[TimeSync] ========================================\n");
@@ -351,10 +386,12 @@ void TimeSync::performBackgroundFitting() {
 }
 
 int64_t TimeSync::getNtpOffset() const {
-    return ntpOffsetMs;
+    NtpClock::Model ntp;
+    publishedNtp.read(ntp);
+    return NtpClock::offsetAt(ntp, esp_timer_get_time()) / 1000;
 }
 
-bool TimeSync::getLinearParams(uint8_t sensorId, float& a, float& b) const {
+bool TimeSync::getLinearParams(uint8_t sensorId, double& a, double& b) const {
     if (!isValidSensorId(sensorId) || xSemaphoreTake(mutex, 0) != pdTRUE) {
         return false;
     }
@@ -362,8 +399,11 @@ bool TimeSync::getLinearParams(uint8_t sensorId, float& a, float& b) const {
     uint8_t sensorIndex = sensorId - 1; // 转换为数组索引 (1-4 -> 0-3)
     
     if (paramsValid[sensorIndex]) {
-        a = paramA[sensorIndex];
-        b = paramB[sensorIndex];
+        // 跟踪中返回跟踪器当前的等价参数
+        SensorClock clock;
+        readClock(sensorIndex, clock);
+        a = clock.ready ? clock.model.slope : paramA[sensorIndex];
+        b = clock.ready ? ClockTracker::interceptOf(clock.model) : paramB[sensorIndex];
         xSemaphoreGive(mutex);
         return true;
     }
@@ -409,25 +449,31 @@ bool TimeSync::isTimeSyncActive() const {
 }
 
 bool TimeSync::isNtpInitialized() const {
-    // ntpInitialized 不需要mutex保护，因为它只在初始化时设置一次
-    return ntpInitialized;
+    // 读取发布的偏移模型，不需要mutex
+    NtpClock::Model ntp;
+    publishedNtp.read(ntp);
+    return ntp.valid;
 }
 
 void TimeSync::reset() {
     // 重置所有传感器的滑动窗口
     memset(slidingWindows, 0, sizeof(slidingWindows));
+    memset(lastFit, 0, sizeof(lastFit));
     for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
-        windowIndex[i] = 0;
-        windowCount[i] = 0;
-        paramA[i] = 1.0f;
-        paramB[i] = 0.0f;
+        clearWindow(i);
+        paramA[i] = 1.0;
+        paramB[i] = 0.0;
         paramsValid[i] = false;
         syncReady[i] = false;
         calcCount[i] = 0;
-        paramASum[i] = 0.0f;
-        paramBSum[i] = 0.0f;
+        paramASum[i] = 0.0;
+        paramBSum[i] = 0.0;
         calcCompleted[i] = false;
         lastCalcTime[i] = 0;
+        // 停止请求由UART任务在下一个时间对执行，递增epoch使已发布的模型立即失效，
+        // 返回后calculateTimestamp不再使用重置前的参数
+        requestTracker(i, TRACKER_STOP);
+        clockEpoch[i].fetch_add(1, std::memory_order_release);
     }
     
     fittingActive = false;
@@ -440,8 +486,8 @@ void TimeSync::resetCalculationState() {
         // 重置所有传感器的计算状态，但保留滑动窗口数据
         for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
             calcCount[i] = 0;
-            paramASum[i] = 0.0f;
-            paramBSum[i] = 0.0f;
+            paramASum[i] = 0.0;
+            paramBSum[i] = 0.0;
             calcCompleted[i] = false;
             lastCalcTime[i] = 0;
             // 不重置syncReady和paramsValid，保持已完成的传感器状态
@@ -462,12 +508,38 @@ TimeSync::Stats TimeSync::getStats() const {
             stats.validPairs += windowCount[i]; // 简化处理，假设所有数据都有效
         }
         
-        stats.ntpOffset = ntpOffsetMs;
+        NtpClock::Model ntp = ntpClock.getModel();
+        int64_t nowUs = esp_timer_get_time();
+        stats.ntpValid = ntp.valid;
+        stats.ntpOffsetUs = NtpClock::offsetAt(ntp, nowUs);
+        stats.ntpDriftPpm = ntp.driftPpm;
+        stats.ntpSlewRemainingUs = nowUs < ntp.slewEndUs ? (int64_t)((double)(ntp.slewEndUs - nowUs) * ntp.slewPpm * 1e-6) : 0;
+        stats.ntpStats = ntpClock.getStats();
+        stats.ntpHistoryCount = ntpClock.getHistoryCount();
+        for (uint8_t i = 0; i < stats.ntpHistoryCount; i++) {
+            ntpClock.getHistory(i, stats.ntpHistory[i]);
+        }
+        stats.paramReadRetries = 0;
+        stats.pairQueueOverflows = 0;
+        stats.pairQueuePeak = pairQueuePeak;
         
         // 复制所有传感器的参数
         for (int i = 0; i < TIME_SYNC_SENSOR_COUNT; i++) {
-            stats.linearParamA[i] = paramA[i];
-            stats.linearParamB[i] = paramB[i];
+            SensorClock clock;
+            readClock(i, clock);
+            stats.tracking[i] = clock.ready;
+            stats.linearParamA[i] = clock.ready ? clock.model.slope : paramA[i];
+            stats.linearParamB[i] = clock.ready ? ClockTracker::interceptOf(clock.model) : paramB[i];
+            stats.trackSkewPpm[i] = clock.skewPpm;
+            stats.trackStats[i] = clock.stats;
+            stats.syncedTimestamps[i] = syncedTimestamps[i];
+            stats.unsyncedTimestamps[i] = unsyncedTimestamps[i];
+            stats.paramReadRetries += publishedClocks[i].getRetries();
+            stats.pairQueueOverflows += pairQueues[i].getOverflows();
+            stats.residualRms[i] = (float)lastFit[i].residualRms;
+            stats.residualMax[i] = (float)lastFit[i].residualMax;
+            stats.fittedSkewPpm[i] = (float)ClockFit::skewPpm(lastFit[i].slope);
+            stats.fitRejected[i] = lastFit[i].rejected;
             stats.syncReady[i] = syncReady[i];
         }
         
@@ -479,9 +551,9 @@ TimeSync::Stats TimeSync::getStats() const {
 }
 
 bool TimeSync::syncNtpTime() {
-    // 如果NTP已经初始化，直接返回成功
-    if (ntpInitialized) {
-        Serial0.printf("[TimeSync] NTP already initialized\n");
+    // SNTP已在运行，直接返回成功
+    if (sntp_enabled()) {
+        Serial0.printf("[TimeSync] SNTP already running\n");
         return true;
     }
     
@@ -491,59 +563,57 @@ bool TimeSync::syncNtpTime() {
     sntp_setservername(1, "ntp1.aliyun.com");
     sntp_setservername(2, "time.windows.com");
     
-    // 设置时区为北京时间 (UTC+8)
-    setenv("TZ", "CST-8", 1);
-    tzset();
+    // 周期重新同步；系统时间直接设置，时间戳使用的偏移由ntpClock逐渐修正
+    sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
+    sntp_set_sync_interval(Config::NTP_SYNC_INTERVAL_MS);
     
     // 设置NTP回调
     sntp_set_time_sync_notification_cb(ntpCallback);
     
-    // 启动SNTP
+    // 启动SNTP，同步结果在回调中异步到达
     sntp_init();
-    
-    // 等待NTP同步完成
-    uint32_t timeout = 0;
-    while (!ntpCallbackCalled && timeout < 10000) { // 10秒超时
-        delay(100);
-        timeout += 100;
+    Serial0.printf("[TimeSync] SNTP started, re-sync every %d s\n", Config::NTP_SYNC_INTERVAL_MS / 1000);
+    return true;
+}
+
+void TimeSync::ntpCallback(struct timeval* tv) {
+    // 在lwIP任务中调用：只记录测量，不打印、不取锁
+    NtpSample sample;
+    sample.espUs = esp_timer_get_time();
+    sample.utcUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    ntpSamples.publish(sample);
+}
+
+void TimeSync::processNtpSample() {
+    uint32_t version = ntpSamples.getVersion();
+    if (version == ntpSampleVersion) {
+        return;
     }
+    ntpSampleVersion = version;
     
-    if (ntpCallbackCalled) {
-        // 计算NTP时间差
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        int64_t ntpTimeMs = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
-        
-        // 获取系统启动时间（毫秒）
-        int64_t systemUptimeMs = millis();
-        
-        // 计算NTP时间与系统启动时间的差值
-        // 这个差值表示系统启动时对应的NTP时间
-        ntpOffsetMs = ntpTimeMs - systemUptimeMs;
-        ntpInitialized = true;
-
+    NtpSample sample;
+    ntpSamples.read(sample);
+    bool wasValid = ntpClock.getModel().valid;
+    const NtpClock::Model& model = ntpClock.addMeasurement(sample.espUs, sample.utcUs);
+    publishedNtp.publish(model);
+    
+    NtpClock::Measurement last;
+    ntpClock.getHistory(0, last);
+    if (!wasValid) {
         time_t now = time(NULL);
-        struct tm *timeinfo = localtime(&now);
-        Serial0.printf("[TimeSync] localtime: %02d:%02d:%02d\n",
-                    timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
-
-        Serial0.printf("[TimeSync] NTP synchronized, offset: %lld ms\n", ntpOffsetMs);
-        Serial0.printf("[TimeSync] NTP time: %lld ms, System uptime: %lld ms\n", ntpTimeMs, systemUptimeMs);
-        return true;
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        Serial0.printf("[TimeSync] localtime: %02d:%02d:%02d\n", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    }
+    if (last.stepped) {
+        Serial0.printf("[TimeSync] NTP synchronized, offset stepped to %lld us\n", last.offsetUs);
     } else {
-        Serial0.printf("[TimeSync] ERROR: NTP synchronization timeout\n");
-        return false;
+        Serial0.printf("[TimeSync] NTP re-sync: offset %lld us, error %ld us, drift %.2f ppm, slewing until +%lld ms\n",
+                     last.offsetUs, (long)last.errorUs, last.driftPpm, (model.slewEndUs - sample.espUs) / 1000);
     }
 }
 
-void TimeSync::ntpCallback(struct timeval* tv) {
-    ntpCallbackCalled = true;
-    Serial0.printf("[TimeSync] NTP callback called\n");
-    // 注意：这里不能直接设置ntpInitialized，因为这是静态回调函数
-    // ntpInitialized会在syncNtpTime中设置
-}
-
-bool TimeSync::calculateLinearRegression(uint8_t sensorId, float& a, float& b) {
+bool TimeSync::calculateLinearRegression(uint8_t sensorId, ClockFit::Result& fit) {
     if (!isValidSensorId(sensorId)) {
         return false;
     }
@@ -555,42 +625,40 @@ bool TimeSync::calculateLinearRegression(uint8_t sensorId, float& a, float& b) {
     }
     
     // 最小二乘法计算线性回归参数
-    // y = ax + b，其中 x = sensorTimeMs, y = espTimeUs
-    // 注意：传感器时间是毫秒，ESP32时间是微秒，需要统一单位
-    float sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
-    uint8_t validCount = 0;
-    
+    // y = ax + b，其中 x = sensorTimeMs, y = espTimeUs / 1000（统一为毫秒）
+    ClockFit::Sample samples[SLIDING_WINDOW_SIZE];
+    uint16_t validCount = 0;
     for (uint8_t i = 0; i < windowCount[sensorIndex]; i++) {
         if (slidingWindows[sensorIndex][i].valid) {
-            float x = (float)slidingWindows[sensorIndex][i].sensorTimeMs;  // 传感器时间(ms)
-            float y = (float)slidingWindows[sensorIndex][i].espTimeUs / 1000.0f;  // ESP32时间转换为ms
-            
-            sumX += x;
-            sumY += y;
-            sumXY += x * y;
-            sumXX += x * x;
+            samples[validCount].sensorTimeMs = slidingWindows[sensorIndex][i].sensorTimeMs;
+            samples[validCount].espTimeUs = slidingWindows[sensorIndex][i].espTimeUs;
             validCount++;
         }
     }
     
-    if (validCount < 2) {
-        return false;
+    // 下包络模式：拟合最小到达延迟，斜率不可信时内部固定a=1
+    if (Config::TIME_SYNC_LOWER_ENVELOPE) {
+        if (ClockFit::fitLowerEnvelope(samples, validCount, Config::TIME_SYNC_ENVELOPE_BUCKETS,
+                                       Config::TIME_SYNC_OUTLIER_MS, Config::TIME_SYNC_MAX_SKEW_PPM, fit)) {
+            Serial0.printf("[TimeSync] Sensor %d lower envelope: a=%.9f, b=%.3f, residual rms=%.3f ms max=%.3f ms (buckets: %d, rejected: %d)\n",
+                          sensorId, fit.slope, fit.intercept, fit.residualRms, fit.residualMax, fit.count, fit.rejected);
+            return true;
+        }
     }
     
-    // 计算斜率 a 和截距 b
-    float n = (float)validCount;
-    float denominator = n * sumXX - sumX * sumX;
-    
-    if (abs(denominator) < 1e-6) {
-        return false; // 避免除零
+    if (!ClockFit::fitLeastSquares(samples, validCount, fit)) {
+        return false;
     }
     
-    // a = (n * sumXY - sumX * sumY) / denominator;
-    a = 1;
-    b = (sumY - a * sumX) / n;
+    // 窗口跨度短时到达抖动会放大斜率误差，晶振偏差不可能超过上限，此时固定a=1只拟合截距
+    if (fabs(ClockFit::skewPpm(fit.slope)) > Config::TIME_SYNC_MAX_SKEW_PPM) {
+        Serial0.printf("[TimeSync] Sensor %d fitted skew %.1f ppm out of range (span %u ms), using a=1\n",
+                      sensorId, ClockFit::skewPpm(fit.slope), fit.spanMs);
+        ClockFit::fitOffset(samples, validCount, 1.0, fit);
+    }
     
-    Serial0.printf("[TimeSync] Sensor %d linear regression: a=%.6f, b=%.2f (valid pairs: %d)\n", 
-                  sensorId, a, b, validCount);
+    Serial0.printf("[TimeSync] Sensor %d linear regression: a=%.9f, b=%.3f, residual rms=%.3f ms max=%.3f ms (valid pairs: %d)\n", 
+                  sensorId, fit.slope, fit.intercept, fit.residualRms, fit.residualMax, validCount);
     
     return true;
 }
@@ -642,6 +710,61 @@ void TimeSync::updateSlidingWindow(uint8_t sensorId, uint32_t sensorTimeMs, int6
     }
 }
 
+void TimeSync::drainPairQueue(uint8_t sensorIndex) {
+    uint32_t queued = pairQueues[sensorIndex].size();
+    if (queued > pairQueuePeak) {
+        pairQueuePeak = queued;
+    }
+    
+    // 取到窗口满为止，剩余的留在队列中，拟合后清空窗口、下一轮继续取出，不覆盖还未拟合的时间对；
+    // 窗口已满说明上一次拟合失败，此时覆盖最旧的时间对，下一次用新数据重新拟合
+    bool overwrite = windowCount[sensorIndex] >= SLIDING_WINDOW_SIZE;
+    QueuedPair pair;
+    while ((overwrite || windowCount[sensorIndex] < SLIDING_WINDOW_SIZE) && pairQueues[sensorIndex].pop(pair)) {
+        updateSlidingWindow(sensorIndex + 1, pair.sensorTimeMs, pair.espTimeUs);
+    }
+}
+
+void TimeSync::clearWindow(uint8_t sensorIndex) {
+    windowIndex[sensorIndex] = 0;
+    windowCount[sensorIndex] = 0;
+    pairQueues[sensorIndex].clear();
+}
+
 bool TimeSync::isValidSensorId(uint8_t sensorId) const {
     return (sensorId >= 1 && sensorId <= TIME_SYNC_SENSOR_COUNT);
 }
+
+void TimeSync::requestTracker(uint8_t sensorIndex, TrackerCommand command, double slope, double intercept) {
+    commandSlope[sensorIndex] = slope;
+    commandIntercept[sensorIndex] = intercept;
+    trackerCommand[sensorIndex].store(command, std::memory_order_release);
+}
+
+void TimeSync::applyTrackerCommand(uint8_t sensorIndex) {
+    uint8_t command = trackerCommand[sensorIndex].exchange(TRACKER_NONE, std::memory_order_acquire);
+    if (command == TRACKER_START) {
+        trackers[sensorIndex].start(commandSlope[sensorIndex], commandIntercept[sensorIndex]);
+        publishClock(sensorIndex);
+    } else if (command == TRACKER_STOP) {
+        trackers[sensorIndex].stop();
+        publishClock(sensorIndex);
+    }
+}
+
+void TimeSync::publishClock(uint8_t sensorIndex) {
+    SensorClock clock;
+    clock.ready = trackers[sensorIndex].isActive();
+    clock.epoch = publishEpoch[sensorIndex];
+    clock.model = trackers[sensorIndex].getModel();
+    clock.stats = trackers[sensorIndex].getStats();
+    clock.skewPpm = (float)trackers[sensorIndex].getSkewPpm();
+    publishedClocks[sensorIndex].publish(clock);
+}
+
+void TimeSync::readClock(uint8_t sensorIndex, SensorClock& clock) const {
+    publishedClocks[sensorIndex].read(clock);
+    if (clock.epoch != clockEpoch[sensorIndex].load(std::memory_order_acquire)) {
+        clock.ready = false;
+    }
+}
@@ -0,0 +1,47 @@
+#include "TimestampFormatter.h"
+#include <time.h>
+
+static const uint32_t MS_PER_DAY = 86400000;
+
+TimestampFormatter::TimestampFormatter() {
+    refreshes = 0;
+    invalidate();
+}
+
+void TimestampFormatter::invalidate() {
+    dayStartMs = 0;
+    dayEndMs = 0;
+}
+
+bool TimestampFormatter::refresh(uint64_t timestampMs) {
+    time_t seconds = (time_t)(timestampMs / 1000);
+    struct tm timeinfo;
+    if (!localtime_r(&seconds, &timeinfo)) {
+        return false;
+    }
+
+    // 当天已经过的毫秒数，倒推本地零点
+    uint64_t msOfDay = (uint64_t)(timeinfo.tm_hour * 3600 + timeinfo.tm_min * 60 + timeinfo.tm_sec) * 1000 +
+                       timestampMs % 1000;
+    dayStartMs = timestampMs - msOfDay;
+    dayEndMs = dayStartMs + MS_PER_DAY;
+    refreshes++;
+    return true;
+}
+
+uint32_t TimestampFormatter::format(uint64_t timestampMs) {
+    if (timestampMs < dayStartMs || timestampMs >= dayEndMs) {
+        if (!refresh(timestampMs)) {
+            return 0;
+        }
+    }
+
+    uint32_t msOfDay = (uint32_t)(timestampMs - dayStartMs);
+    uint32_t hour = msOfDay / 3600000;
+    uint32_t minute = msOfDay / 60000 % 60;
+    uint32_t second = msOfDay / 1000 % 60;
+    uint32_t ms = msOfDay % 1000;
+
+    // 拼成十进制数：HHMMSSmmm
+    return hour * 10000000 + minute * 100000 + second * 1000 + ms;
+}
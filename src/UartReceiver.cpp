@@ -190,7 +190,7 @@ SensorFrame UartReceiver::createSensorFrame(const uint8_t* frameData) {
         timeSync->addTimePair(frame.sensorId, frame.timestamp, espTimeUs);
         
         // 计算同步后的时间戳（快速操作，不进行拟合计算）
-        uint64_t syncedTimestamp = timeSync->calculateTimestamp(frame.sensorId, frame.timestamp);
+        uint64_t syncedTimestamp = timeSync->calculateTimestamp(frame.sensorId, frame.timestamp, &frame.ntpSynced);
         
         // 保存原始时间戳
         frame.rawTimestamp = syncedTimestamp;
@@ -198,6 +198,7 @@ SensorFrame UartReceiver::createSensorFrame(const uint8_t* frameData) {
         // 格式化时间戳为时/分/秒/毫秒格式
         frame.timestamp = timeSync->formatTimestamp(syncedTimestamp);
     } else {
+        frame.ntpSynced = false;
         Serial0.printf("[UartReceiver] WARNING: timeSync is null!\n");
     }
     
@@ -0,0 +1,182 @@
+#include "UdpDatagram.h"
+#include <stdlib.h>
+#include <string.h>
+
+size_t UdpDatagram::fragmentCount(size_t length, size_t datagramSize) {
+    if (datagramSize <= HEADER_SIZE || length == 0 || length > 0xFFFF) {
+        return 0;
+    }
+    size_t maxPayload = datagramSize - HEADER_SIZE;
+    size_t count = (length + maxPayload - 1) / maxPayload;
+    return count > 255 ? 0 : count;
+}
+
+size_t UdpDatagram::buildFragment(uint8_t* output, size_t datagramSize, uint32_t seq, uint32_t sendTime,
+                                  const char* data, size_t length, uint8_t index) {
+    size_t count = fragmentCount(length, datagramSize);
+    if (index >= count) {
+        return 0;
+    }
+    size_t maxPayload = datagramSize - HEADER_SIZE;
+    size_t offset = index * maxPayload;
+    size_t chunk = length - offset < maxPayload ? length - offset : maxPayload;
+
+    UdpDatagramHeader header;
+    header.magic[0] = 'G';
+    header.magic[1] = 'W';
+    header.version = PROTOCOL_VERSION;
+    header.fragmentIndex = index;
+    header.fragmentCount = count;
+    header.reserved = 0;
+    header.messageLength = length;
+    header.seq = seq;
+    header.sendTime = sendTime;
+    memcpy(output, &header, HEADER_SIZE);
+    memcpy(output + HEADER_SIZE, data + offset, chunk);
+    return HEADER_SIZE + chunk;
+}
+
+const uint8_t* UdpDatagram::parse(const uint8_t* datagram, size_t length, size_t datagramSize, UdpDatagramHeader& header) {
+    if (length <= HEADER_SIZE || length > datagramSize) {
+        return nullptr;
+    }
+    memcpy(&header, datagram, HEADER_SIZE);
+    if (header.magic[0] != 'G' || header.magic[1] != 'W' || header.version != PROTOCOL_VERSION) {
+        return nullptr;
+    }
+    // 分片数和本片长度须与消息长度一致：非末片为满载荷，末片为余下的字节
+    size_t count = fragmentCount(header.messageLength, datagramSize);
+    if (count == 0 || header.fragmentCount != count || header.fragmentIndex >= count) {
+        return nullptr;
+    }
+    size_t maxPayload = datagramSize - HEADER_SIZE;
+    size_t offset = header.fragmentIndex * maxPayload;
+    size_t expected = header.messageLength - offset < maxPayload ? header.messageLength - offset : maxPayload;
+    if (length - HEADER_SIZE != expected) {
+        return nullptr;
+    }
+    return datagram + HEADER_SIZE;
+}
+
+UdpReassembler::UdpReassembler(size_t datagramSize, size_t maxMessage, uint32_t timeoutMs) {
+    this->datagramSize = datagramSize;
+    this->maxMessage = maxMessage;
+    this->timeoutMs = timeoutMs;
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        memset(&slots[i], 0, sizeof(Slot));
+        slots[i].buffer = (char*)malloc(maxMessage);
+    }
+    delivered = false;
+    lastSeq = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+UdpReassembler::~UdpReassembler() {
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        free(slots[i].buffer);
+    }
+}
+
+void UdpReassembler::expire(uint32_t now) {
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        if (slots[i].active && now - slots[i].firstTime >= timeoutMs) {
+            slots[i].active = false;
+            stats.incomplete++;
+        }
+    }
+}
+
+UdpReassembler::Slot* UdpReassembler::findSlot(const UdpDatagramHeader& header, uint32_t now) {
+    Slot* oldest = nullptr;
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        Slot& slot = slots[i];
+        if (!slot.active) {
+            continue;
+        }
+        if (slot.seq == header.seq) {
+            // 同一seq的分片须描述同一条消息
+            if (slot.messageLength != header.messageLength) {
+                stats.malformed++;
+                return nullptr;
+            }
+            return &slot;
+        }
+        if (!oldest || (int32_t)(slot.seq - oldest->seq) < 0) {
+            oldest = &slot;
+        }
+    }
+
+    Slot* target = nullptr;
+    for (uint8_t i = 0; i < SLOT_COUNT && !target; i++) {
+        if (!slots[i].active && slots[i].buffer) {
+            target = &slots[i];
+        }
+    }
+    if (!target) {
+        // 重组中的消息已满：新消息比最旧的还旧时丢弃新消息，否则挤出最旧的
+        if (!oldest || (int32_t)(header.seq - oldest->seq) < 0) {
+            stats.incomplete++;
+            return nullptr;
+        }
+        target = oldest;
+        stats.incomplete++;
+    }
+    target->active = true;
+    target->seq = header.seq;
+    target->firstTime = now;
+    target->messageLength = header.messageLength;
+    target->fragmentCount = header.fragmentCount;
+    target->receivedCount = 0;
+    memset(target->received, 0, sizeof(target->received));
+    return target;
+}
+
+const char* UdpReassembler::receive(const uint8_t* datagram, size_t length, uint32_t now, uint32_t& seq, size_t& messageLength) {
+    stats.datagrams++;
+    expire(now);
+
+    UdpDatagramHeader header;
+    const uint8_t* payload = UdpDatagram::parse(datagram, length, datagramSize, header);
+    if (!payload || header.messageLength > maxMessage) {
+        stats.malformed++;
+        return nullptr;
+    }
+    if (delivered && (int32_t)(header.seq - lastSeq) <= 0) {
+        stats.stale++;
+        return nullptr;
+    }
+
+    Slot* slot = findSlot(header, now);
+    if (!slot) {
+        return nullptr;
+    }
+    uint8_t index = header.fragmentIndex;
+    if (slot->received[index / 8] & (1 << (index % 8))) {
+        stats.duplicates++;
+        return nullptr;
+    }
+    slot->received[index / 8] |= 1 << (index % 8);
+    slot->receivedCount++;
+    memcpy(slot->buffer + index * (datagramSize - UdpDatagram::HEADER_SIZE), payload, length - UdpDatagram::HEADER_SIZE);
+    if (slot->receivedCount < slot->fragmentCount) {
+        return nullptr;
+    }
+
+    // 收齐后交付；比它旧的未完成消息已不会再交付，一并放弃
+    slot->active = false;
+    if (delivered) {
+        stats.skipped += slot->seq - lastSeq - 1;
+    }
+    delivered = true;
+    lastSeq = slot->seq;
+    for (uint8_t i = 0; i < SLOT_COUNT; i++) {
+        if (slots[i].active && (int32_t)(slots[i].seq - lastSeq) < 0) {
+            slots[i].active = false;
+            stats.incomplete++;
+        }
+    }
+    stats.delivered++;
+    seq = slot->seq;
+    messageLength = slot->messageLength;
+    return slot->buffer;
+}
@@ -0,0 +1,93 @@
+#include "UdpStreamer.h"
+#include "Config.h"
+
+UdpStreamer::UdpStreamer() {
+    targetHost[0] = '\0';
+    targetPort = 0;
+    enabled = false;
+    targetResolved = false;
+    lastResolveAttempt = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void UdpStreamer::setTarget(const char* host, uint16_t port) {
+    targetResolved = false;
+    strlcpy(targetHost, host, sizeof(targetHost));
+    targetPort = port;
+    lastResolveAttempt = 0;
+
+    // IP地址字面量直接使用，主机名留给maintain()在WiFi连接后解析
+    IPAddress ip;
+    if (ip.fromString(targetHost)) {
+        targetIp = ip;
+        targetResolved = true;
+    }
+}
+
+void UdpStreamer::setEnabled(bool enabled) {
+    this->enabled = enabled;
+    Serial0.printf("[UdpStreamer] UDP streaming %s (target %s:%d)\n",
+                  enabled ? "enabled" : "disabled", targetHost, targetPort);
+}
+
+void UdpStreamer::maintain(bool wifiConnected) {
+    if (!enabled || targetResolved || !wifiConnected || targetHost[0] == '\0') {
+        return;
+    }
+
+    uint32_t now = millis();
+    if (lastResolveAttempt != 0 && now - lastResolveAttempt < Config::UDP_RESOLVE_RETRY_MS) {
+        return;
+    }
+    lastResolveAttempt = now;
+
+    IPAddress ip;
+    if (WiFi.hostByName(targetHost, ip) == 1) {
+        targetIp = ip;
+        targetResolved = true;
+        Serial0.printf("[UdpStreamer] Target %s resolved to %s\n", targetHost, ip.toString().c_str());
+    } else {
+        stats.resolveFailures++;
+        Serial0.printf("[UdpStreamer] WARNING: Failed to resolve %s\n", targetHost);
+    }
+}
+
+bool UdpStreamer::sendMessage(uint32_t seq, const char* data, size_t length) {
+    if (!isReady() || length == 0) {
+        return false;
+    }
+
+    const size_t datagramSize = min(Config::UDP_DATAGRAM_SIZE, sizeof(datagramBuffer));
+    size_t fragmentCount = UdpDatagram::fragmentCount(length, datagramSize);
+    if (fragmentCount == 0) {
+        stats.oversizeMessages++;
+        return false;
+    }
+
+    uint32_t sendTime = millis();
+    for (size_t i = 0; i < fragmentCount; i++) {
+        size_t datagramLength = UdpDatagram::buildFragment(datagramBuffer, datagramSize, seq, sendTime, data, length, i);
+        if (!udp.beginPacket(targetIp, targetPort) ||
+            udp.write(datagramBuffer, datagramLength) != datagramLength ||
+            !udp.endPacket()) {
+            // 协议栈缓冲区不足时放弃本消息剩余分片，接收端会丢弃不完整的消息
+            stats.sendErrors++;
+            return false;
+        }
+        stats.datagramsSent++;
+        stats.bytesSent += datagramLength;
+    }
+    stats.messagesSent++;
+    return true;
+}
+
+UdpStreamer::Stats UdpStreamer::getStats() const {
+    Stats currentStats = stats;
+    currentStats.enabled = enabled;
+    currentStats.targetResolved = targetResolved;
+    return currentStats;
+}
+
+void UdpStreamer::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
@@ -1,8 +1,10 @@
 #include "WebSocketClient.h"
 #include <ArduinoJson.h>
-#include "BufferPool.h"
 #include "Config.h"
 #include "CommandHandler.h"
+#include "SessionRecorder.h"
+#include "TimeSync.h"
+#include <lwip/sockets.h>
 
 // 全局变量，用于静态回调函数访问实例
 static WebSocketClient* g_webSocketClientInstance = nullptr;
@@ -14,13 +16,104 @@ WebSocketClient::WebSocketClient() {
     uploadCompletePending = false;
     wifiConnected = false;
     serverConnected = false;
-    lastConnectionAttempt = 0;
-    connectionRetryInterval = 5000; // 5秒重试间隔
+    wifiBackoff.configure(Config::WIFI_RECONNECT_BASE_DELAY_MS, Config::WIFI_RECONNECT_MAX_DELAY_MS);
+    serverBackoff.configure(Config::SERVER_RECONNECT_BASE_DELAY_MS, Config::SERVER_RECONNECT_MAX_DELAY_MS);
+    deviceCode[0] = '\0';
+    strlcpy(sessionId, "041025", sizeof(sessionId));
     
     mutex = xSemaphoreCreateMutex();
-    sendQueue = xQueueCreate(MAX_QUEUE_SIZE, sizeof(DataBlock*));
-    bufferPool = nullptr;
+    manifestLock.handle = xSemaphoreCreateMutex();
+    sessionManifest.setLock(&manifestLock);
+    sensorData = nullptr;
     commandHandler = nullptr;
+    sessionRecorder = nullptr;
+    timeSync = nullptr;
+    memset(&resendJob, 0, sizeof(resendJob));
+    
+    // 重传窗口由RetransmitWindow构造时清零
+    nextSeq = 1;
+    parkedHead = 0;
+    parkedCount = 0;
+    sendPacer.setSlice(Config::NETWORK_LOOP_INTERVAL_MS);
+    
+    // 初始化非阻塞发送状态
+    txData = nullptr;
+    txLength = 0;
+    txOffset = 0;
+    txSeq = 0;
+    txActive = false;
+    txSlot = -1;
+    retransmitBuffer = (char*)malloc(Config::ENCODE_BUFFER_SIZE);
+    if (!retransmitBuffer) {
+        Serial0.printf("[WebSocketClient] ERROR: Failed to allocate retransmit buffer\n");
+    }
+    size_t docCapacity = encodedSizeBound(Config::COALESCE_MAX_BLOCKS * DataBlock::MAX_FRAMES, false);
+    encodeDoc = new DynamicJsonDocument(docCapacity);
+    retransmitDoc = new DynamicJsonDocument(docCapacity);
+    if (encodeDoc->capacity() == 0 || retransmitDoc->capacity() == 0) {
+        Serial0.printf("[WebSocketClient] ERROR: Failed to allocate JSON documents (%d bytes each)\n", docCapacity);
+    }
+    
+    // 初始化编码阶段：预分配输出缓冲区，全部放入空闲队列
+    encodeSlotCount = 0;
+    encodeSlots = new EncodedMessage[Config::ENCODE_BUFFER_COUNT];
+    freeSlotQueue = xQueueCreate(Config::ENCODE_BUFFER_COUNT, sizeof(uint8_t));
+    readySlotQueue = xQueueCreate(Config::ENCODE_BUFFER_COUNT, sizeof(uint8_t));
+    if (encodeSlots && freeSlotQueue && readySlotQueue) {
+        for (uint8_t i = 0; i < Config::ENCODE_BUFFER_COUNT; i++) {
+            memset(&encodeSlots[i], 0, sizeof(EncodedMessage));
+            encodeSlots[i].buffer = (char*)malloc(Config::ENCODE_BUFFER_SIZE);
+            if (!encodeSlots[i].buffer) {
+                Serial0.printf("[WebSocketClient] ERROR: Failed to allocate encode buffer %d\n", i);
+                break;
+            }
+            xQueueSend(freeSlotQueue, &i, 0);
+            encodeSlotCount++;
+        }
+    } else {
+        Serial0.printf("[WebSocketClient] ERROR: Failed to create encode stage\n");
+    }
+    encoderWaitingForSlot = false;
+    networkTaskHandle = nullptr;
+    encoderTaskHandle = nullptr;
+    memset(&encoderCounters, 0, sizeof(encoderCounters));
+    encoderResetRequested = false;
+    encoderDrained = true;
+    transmitBusyUs = 0;
+    lastEncoderBusyUs = 0;
+    lastTransmitBusyUs = 0;
+    lastUtilizationTime = micros();
+    lastPingTime = 0;
+    pingOutstanding = false;
+    
+    heldBlocks = (DataBlock**)malloc(Config::POWER_HOLD_MAX_BLOCKS * sizeof(DataBlock*));
+    heldHead = 0;
+    heldCount = 0;
+    holdBlocks = false;
+    powerSaveRequested = Config::POWER_SAVE_ENABLED && heldBlocks;
+    powerResetRequested = false;
+    powerScheduler.configure(Config::POWER_BATCH_WINDOW_MS, Config::POWER_MAX_BURST_MS, 
+                             Config::POWER_FLUSH_THRESHOLD_BLOCKS);
+    
+    // 闪存暂存区在setSpoolStorage()中初始化
+    spoolWriteBuffer = nullptr;
+    spoolRecordBuffer = nullptr;
+    spoolEnabled = Config::SPOOL_ENABLED;
+    spoolResetRequested = false;
+    lastSpoolBytesFlushed = 0;
+    lastSpoolRecordsRead = 0;
+    catchupScheduler.configure(Config::CATCHUP_BACKLOG_SHARE, Config::CATCHUP_MAX_BACKLOG_SHARE, Config::CATCHUP_LIVE_MARGIN);
+    rateController.configure(Config::RATE_CONTROL_INTERVAL_MS, Config::RATE_QUEUE_HIGH_WATERMARK, 
+                             Config::RATE_QUEUE_LOW_WATERMARK, Config::RATE_CONTROL_HOLD_MS, Config::RATE_RECOVER_INTERVALS);
+    
+    // 默认订阅：全部通道、不分频
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        subscriptions[i].channelMask = CHANNEL_ALL;
+        subscriptions[i].rateDivisor = 1;
+    }
+    controlHead = 0;
+    controlCount = 0;
+    publishEncodeContext();
     
     memset(&stats, 0, sizeof(stats));
     lastStatsTime = millis();
@@ -43,49 +136,108 @@ WebSocketClient::~WebSocketClient() {
     if (mutex) {
         vSemaphoreDelete(mutex);
     }
+    sessionManifest.setLock(nullptr);
+    if (manifestLock.handle) {
+        vSemaphoreDelete(manifestLock.handle);
+    }
+    
+    // 释放已编码未发送的数据块和输出缓冲区
+    uint8_t slotIndex;
+    while (readySlotQueue && xQueueReceive(readySlotQueue, &slotIndex, 0) == pdTRUE) {
+        if (encodeSlots[slotIndex].localOnly) {
+            releaseLocalOnly(slotIndex);
+            continue;
+        }
+        for (uint8_t i = 0; i < encodeSlots[slotIndex].entry.blockCount; i++) {
+            releaseBlock(encodeSlots[slotIndex].entry.blocks[i]);
+        }
+    }
+    if (encodeSlots) {
+        for (uint8_t i = 0; i < encodeSlotCount; i++) {
+            free(encodeSlots[i].buffer);
+        }
+        delete[] encodeSlots;
+    }
+    if (freeSlotQueue) {
+        vQueueDelete(freeSlotQueue);
+    }
+    if (readySlotQueue) {
+        vQueueDelete(readySlotQueue);
+    }
+    free(retransmitBuffer);
+    delete encodeDoc;
+    delete retransmitDoc;
+    
+    // 释放暂存的数据块
+    while (heldCount > 0) {
+        releaseBlock(heldBlocks[heldHead]);
+        heldHead = (heldHead + 1) % Config::POWER_HOLD_MAX_BLOCKS;
+        heldCount--;
+    }
+    free(heldBlocks);
+    free(spoolWriteBuffer);
+    free(spoolRecordBuffer);
     
-    if (sendQueue) {
-        vQueueDelete(sendQueue);
+    // 释放重传窗口中未确认的数据块
+    while (!retransmitWindow.isEmpty()) {
+        InFlightBlock& entry = retransmitWindow.front();
+        for (uint8_t i = 0; i < entry.blockCount; i++) {
+            releaseBlock(entry.blocks[i]);
+        }
+        entry.blockCount = 0;
+        retransmitWindow.popFront();
+    }
+    while (parkedCount > 0) {
+        InFlightBlock& entry = parkedEntries[parkedHead];
+        for (uint8_t i = 0; i < entry.blockCount; i++) {
+            releaseBlock(entry.blocks[i]);
+        }
+        entry.blockCount = 0;
+        parkedHead = (parkedHead + 1) % PARKED_ENTRY_COUNT;
+        parkedCount--;
     }
 }
 
 bool WebSocketClient::initialize(const char* ssid, const char* password, const char* url, uint16_t port, const char* deviceCode) {
     serverUrl = String(url);
     serverPort = port;
-    this->deviceCode = String(deviceCode);
+    strlcpy(this->deviceCode, deviceCode, sizeof(this->deviceCode));
+    publishEncodeContext();
+    
+    udpStreamer.setTarget(Config::UDP_STREAM_HOST, Config::UDP_STREAM_PORT);
+    if (Config::UDP_STREAM_ENABLED) {
+        udpStreamer.setEnabled(true);
+    }
     
     // 构建WebSocket路径: /ws/esp32/{device_code}/
     String wsPath = "/ws/esp32/";
     wsPath += deviceCode;
     wsPath += "/";
     
-    // 初始化WiFi
+    // 初始化WiFi：由事件回调跟踪链路状态，重连由handleConnectionRetry按退避策略发起，不在此等待
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) {
+        onWiFiEvent(event, info);
+    });
     WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
     WiFi.begin(ssid, password);
     
-    Serial0.printf("[WebSocketClient] Connecting to WiFi: %s\n", ssid);
-    
-    // 等待WiFi连接
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-        delay(500);
-        attempts++;
-        Serial0.printf("[WebSocketClient] WiFi connection attempt %d\n", attempts);
+    if (Config::LOCAL_SERVER_ENABLED) {
+        localServer.begin();
     }
     
-    if (WiFi.status() == WL_CONNECTED) {
-        wifiConnected = true;
-        Serial0.printf("[WebSocketClient] WiFi connected. IP: %s\n", WiFi.localIP().toString().c_str());
-    } else {
-        wifiConnected = false;
-        Serial0.printf("[WebSocketClient] ERROR: WiFi connection failed\n");
-        return false;
-    }
+    // WiFi.begin()计为第一次尝试
+    uint32_t now = millis();
+    wifiBackoff.onLinkDown(now);
+    wifiBackoff.poll(now, esp_random());
+    stats.wifiReconnectAttempts++;
     
-    // 初始化WebSocket
+    Serial0.printf("[WebSocketClient] Connecting to WiFi: %s\n", ssid);
+    
+    // 初始化WebSocket（实际连接在WiFi就绪后由webSocket.loop()发起）
     webSocket.begin(serverUrl.c_str(), serverPort, wsPath.c_str());
     webSocket.onEvent(webSocketEvent);
-    webSocket.setReconnectInterval(5000);
+    webSocket.setReconnectInterval(Config::SERVER_RECONNECT_BASE_DELAY_MS);
     
     Serial0.printf("[WebSocketClient] Initialized. Server: %s:%d%s\n", serverUrl.c_str(), serverPort, wsPath.c_str());
     return true;
@@ -98,9 +250,12 @@ bool WebSocketClient::connect() {
     }
     
     if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-        lastConnectionAttempt = millis();
         stats.connectionAttempts++;
         
+        // 手动连接时重置退避，立即尝试
+        serverBackoff.retryNow(millis());
+        webSocket.setReconnectInterval(Config::SERVER_RECONNECT_BASE_DELAY_MS);
+        
         // 构建WebSocket路径: /ws/esp32/{device_code}/
         String wsPath = "/ws/esp32/";
         wsPath += deviceCode;
@@ -126,45 +281,8 @@ void WebSocketClient::disconnect() {
     Serial0.printf("[WebSocketClient] Stop connected\n");
 }
 
-bool WebSocketClient::sendDataBlock(DataBlock* block) {
-    // 详细的状态检查
-    if (!block) {
-        
-        Serial0.printf("[WebSocketClient] Error: sendDataBlock failed - block is null\n");
-        return false;
-    }
-    
-    // 检查连接状态
-    if (!serverConnected) {
-        if(Config::DEBUG_PPRINT)
-        Serial0.printf("[WebSocketClient] DEBUG: sendDataBlock failed - serverConnected=%d\n", 
-                     serverConnected);
-        return false;
-    }
-    
-    if (!collectionActive) {
-        if(Config::DEBUG_PPRINT)
-        Serial0.printf("[WebSocketClient] DEBUG: sendDataBlock failed - collection not active (collectionActive=%d)\n", 
-                     collectionActive);
-        return false;
-    }
-    
-    // 将数据块加入发送队列
-    if (xQueueSend(sendQueue, &block, 0) != pdTRUE) {
-        Serial0.printf("[WebSocketClient] WARNING: Send queue full, dropping block\n");
-        return false;
-    }
-    
-    // 成功添加到队列
-    if(Config::DEBUG_PPRINT){
-        Serial0.printf("[WebSocketClient] Data block added to send queue successfully\n");
-    }
-
-    return true;
-}
-
-void WebSocketClient::handleServerCommand(const String& command) {
-    parseServerCommand(command);
+void WebSocketClient::handleServerCommand(char* payload, size_t length) {
+    parseServerCommand(payload, length);
 }
 
 bool WebSocketClient::isConnected() const {
@@ -174,6 +292,45 @@ bool WebSocketClient::isConnected() const {
 WebSocketClient::Stats WebSocketClient::getStats() const {
     Stats currentStats = stats;
     currentStats.serverConnected = serverConnected;  // 更新当前连接状态
+    currentStats.wifiConnected = wifiConnected;
+    currentStats.windowOccupancy = retransmitWindow.size();
+    
+    // 网关侧待写入字节：当前消息剩余部分 + 暂存的控制消息
+    currentStats.pendingBytes = txActive ? (txLength - txOffset) : 0;
+    currentStats.controlLaneDepth = controlCount;
+    currentStats.encodedReady = readySlotQueue ? uxQueueMessagesWaiting(readySlotQueue) : 0;
+    currentStats.uploadLevel = (uint8_t)rateController.getLevel();
+    currentStats.levelChanges = rateController.getLevelChanges();
+    currentStats.capacityEstimate = rateController.getCapacityEstimate();
+    currentStats.demandEstimate = rateController.getDemandEstimate();
+    uint32_t now = millis();
+    currentStats.powerPhase = (uint8_t)powerScheduler.getPhase();
+    currentStats.heldBlocks = heldCount;
+    currentStats.powerBursts = powerScheduler.getBurstCount();
+    currentStats.radioDutyCycle = powerScheduler.getDutyCycle(now);
+    currentStats.radioOnMsPerMinute = powerScheduler.getRadioOnMsPerMinute(now);
+    
+    // 编码任务的计数取其发布的快照（重传时的编码失败由网络任务计入stats）
+    EncoderSnapshot encoder = readEncoderSnapshot();
+    currentStats.encodedMessages = encoder.encodedMessages;
+    currentStats.encodeFailures += encoder.encodeFailures;
+    currentStats.encoderStalls = encoder.encoderStalls;
+    currentStats.coalescedMessages = encoder.coalescedMessages;
+    currentStats.spooledBlocks = encoder.spooledBlocks;
+    currentStats.unspooledBlocks = encoder.unspooledBlocks;
+    currentStats.spoolDroppedBlocks = encoder.spoolDroppedBlocks;
+    currentStats.spoolPendingBlocks = encoder.spool.pendingRecords;
+    currentStats.spoolFill = encoder.spool.capacityBytes > 0 ? encoder.spool.usedBytes * 100.0f / encoder.spool.capacityBytes : 0.0f;
+    currentStats.catchupActive = encoder.catchingUp;
+    currentStats.backlogShare = encoder.backlogShare;
+    currentStats.measuredBacklogShare = encoder.measuredBacklogShare;
+    currentStats.liveMessages = encoder.catchup.liveMessages;
+    currentStats.backlogMessages = encoder.catchup.backlogMessages;
+    currentStats.demotedBlocks = encoder.catchup.demotedBlocks;
+    currentStats.lastCatchupMs = encoder.catchup.lastCatchupMs;
+    for (uint8_t i = 0; i < controlCount; i++) {
+        currentStats.pendingBytes += controlLane[(controlHead + i) % CONTROL_LANE_DEPTH].length;
+    }
     return currentStats;
 }
 
@@ -182,24 +339,44 @@ void WebSocketClient::resetStats() {
         memset(&stats, 0, sizeof(stats));
         lastStatsTime = millis();
         blocksSentSinceLastStats = 0;
+        // 注意：序列号和重传窗口不随统计重置，保证序列号单调递增
         xSemaphoreGive(mutex);
     }
+    // 编码任务的计数由编码任务在下一轮自己清零
+    encoderResetRequested = true;
+    resetLatencyStats();
+}
+
+void WebSocketClient::resetLatencyStats() {
+    latency.pingRtt.reset();
+    latency.blockQueue.reset();
+    latency.blockAck.reset();
+    latency.blockTotal.reset();
 }
 
 void WebSocketClient::setDeviceInfo(const String& deviceCode, const String& sessionId) {
-    this->deviceCode = deviceCode;
-    this->sessionId = sessionId;
+    strlcpy(this->deviceCode, deviceCode.c_str(), sizeof(this->deviceCode));
+    strlcpy(this->sessionId, sessionId.c_str(), sizeof(this->sessionId));
+    publishEncodeContext();
     Serial0.printf("[WebSocketClient] Device info set: %s, Session: %s\n", 
                   deviceCode.c_str(), sessionId.c_str());
 }
 
 void WebSocketClient::startCollection() {
+    if (sessionRecorder) {
+        sessionRecorder->startSession(sessionId);
+    }
+    sessionManifest.begin();
     collectionActive = true;
     Serial0.printf("[WebSocketClient] Data collection started\n");
 }
 
 void WebSocketClient::stopCollection() {
     collectionActive = false;
+    sessionManifest.end();
+    if (sessionRecorder) {
+        sessionRecorder->stopSession();
+    }
     uploadCompletePending = true;  // 标记需要发送upload_complete消息
     Serial0.printf("[WebSocketClient] Data collection stopped, upload_complete pending\n");
 }
@@ -213,190 +390,429 @@ void WebSocketClient::sendHeartbeat() {
     doc["type"] = "heartbeat";
     doc["device_code"] = deviceCode;
     doc["timestamp"] = millis();
+    doc["ntp_synced"] = timeSync && timeSync->isNtpInitialized();
     
-    String message;
-    serializeJson(doc, message);
-    
-    webSocket.sendTXT(message);
+    sendControlMessage(doc);
     stats.lastHeartbeat = millis();
 }
 
+void WebSocketClient::sendPingIfDue() {
+    // 省电空闲阶段不发ping，避免唤醒无线电
+    if (!serverConnected || !powerScheduler.isRadioNeeded()) {
+        return;
+    }
+    
+    uint32_t now = millis();
+    if (now - lastPingTime < Config::PING_INTERVAL_MS) {
+        return;
+    }
+    
+    if (pingOutstanding) {
+        stats.pingTimeouts++;
+        pingOutstanding = false;
+    }
+    
+    // ping是控制帧，可以插在数据消息的分片之间；套接字不可写时推迟到下一轮
+    if (!webSocket.isWritable()) {
+        return;
+    }
+    
+    uint8_t payload[sizeof(uint32_t)];
+    memcpy(payload, &now, sizeof(now));
+    if (webSocket.sendPing(payload, sizeof(payload))) {
+        stats.pingsSent++;
+        pingOutstanding = true;
+    }
+    lastPingTime = now;
+}
+
+void WebSocketClient::handlePong(const uint8_t* payload, size_t length) {
+    if (length != sizeof(uint32_t) || !pingOutstanding) {
+        return;  // 非本端ping的回应
+    }
+    
+    uint32_t sentTime;
+    memcpy(&sentTime, payload, sizeof(sentTime));
+    uint32_t rtt = millis() - sentTime;
+    
+    latency.pingRtt.record(rtt);
+    stats.lastPingRtt = rtt;
+    stats.pongsReceived++;
+    pingOutstanding = false;
+}
+
 void WebSocketClient::loop() {
-    webSocket.loop();
+    // WiFi断开时不驱动WebSocket，避免在失效链路上反复发起连接
+    if (wifiConnected) {
+        webSocket.loop();
+    }
+    
+    sendPingIfDue();
+    udpStreamer.maintain(wifiConnected);
+    localServer.loop();
     
     // 定期输出连接状态（每10秒一次，用于调试）
     static uint32_t lastStatusTime = 0;
     uint32_t now = millis();
     if (now - lastStatusTime > 10000) {
         Serial0.printf("[WebSocketClient] Status check - serverConnected: %d, wifiConnected: %d, collectionActive: %d\n", 
-                     serverConnected, wifiConnected, collectionActive);
+                     serverConnected.load(), wifiConnected.load(), collectionActive.load());
         lastStatusTime = now;
     }
 }
 
-String WebSocketClient::createDataPacket(DataBlock* block) {
-    // 安全检查
-    if (!block) {
-        Serial0.printf("[WebSocketClient] ERROR: Block is null\n");
-        return "";
+bool WebSocketClient::shouldEncodeFrame(UploadLevel level, uint8_t sensorId, uint32_t indexInSensor) {
+    // 优先丢弃：低优先级传感器的帧全部不上传
+    if (level >= UploadLevel::PRIORITY_DROP && sensorId >= 1 && sensorId <= 8 &&
+        (Config::LOW_PRIORITY_SENSOR_MASK & (1 << (sensorId - 1)))) {
+        return false;
     }
-    
-    if (block->frameCount == 0) {
-        Serial0.printf("[WebSocketClient] ERROR: Block has no frames\n");
-        return "";
+    // 抽帧：每个传感器每DECIMATION_FACTOR帧保留第一帧（按消息内序号，重传时结果一致）
+    if (level >= UploadLevel::DECIMATE && Config::DECIMATION_FACTOR > 1) {
+        return indexInSensor % Config::DECIMATION_FACTOR == 0;
+    }
+    return true;
+}
+
+void WebSocketClient::quantizeFrame(const SensorFrame& frame, uint8_t channels, bool validAcc, 
+                                    int32_t values[SessionManifest::CHANNEL_VALUES]) {
+    for (int j = 0; j < 3; j++) {
+        values[j] = (channels & CHANNEL_ACC) && validAcc ? (int32_t)lroundf(frame.acc[j] * 1000.0f) : 0;
+        values[3 + j] = (channels & CHANNEL_GYRO) ? (int32_t)lroundf(frame.gyro[j] * 100.0f) : 0;
+        values[6 + j] = (channels & CHANNEL_ANGLE) ? (int32_t)lroundf(frame.angle[j] * 100.0f) : 0;
     }
+}
+
+size_t WebSocketClient::createDataPacket(const InFlightBlock& entry, const EncodeContext& context, JsonDocument& doc, char* output, size_t outputSize,
+                                         uint32_t& omittedFrames, uint32_t& unsubscribedFrames, SessionManifest* manifest) {
+    omittedFrames = 0;
+    unsubscribedFrames = 0;
     
-    if (block->frameCount > DataBlock::MAX_FRAMES) {
-        Serial0.printf("[WebSocketClient] ERROR: Block has too many frames: %d\n", block->frameCount);
-        return "";
+    // 安全检查
+    size_t totalFrames = 0;
+    for (uint8_t b = 0; b < entry.blockCount; b++) {
+        DataBlock* block = entry.blocks[b];
+        if (!block) {
+            Serial0.printf("[WebSocketClient] ERROR: Block is null\n");
+            return 0;
+        }
+        
+        if (block->frameCount == 0) {
+            Serial0.printf("[WebSocketClient] ERROR: Block has no frames\n");
+            return 0;
+        }
+        
+        if (block->frameCount > DataBlock::MAX_FRAMES) {
+            Serial0.printf("[WebSocketClient] ERROR: Block has too many frames: %d\n", block->frameCount);
+            return 0;
+        }
+        
+        if (block->frameCount < 30 && !entry.resend) {
+            Serial0.printf("[WebSocketClient] WARNING: Data block has only %d frames, expected 30!\n", block->frameCount);
+        }
+        totalFrames += block->frameCount;
+    }
+    if (totalFrames == 0) {
+        Serial0.printf("[WebSocketClient] ERROR: Data message has no blocks\n");
+        return 0;
     }
     
-    // 使用动态分配避免栈溢出，减小大小以提高稳定性
-    DynamicJsonDocument doc(8192);  // 从8192减小到6144
+    UploadLevel level = context.level;
+    bool compact = level >= UploadLevel::COMPACT;
+    
+    // 文档按最大消息预分配（完整格式每帧约240字节，紧凑格式约200字节），复用前清空
+    if (doc.capacity() < encodedSizeBound(totalFrames, compact)) {
+        Serial0.printf("[WebSocketClient] ERROR: JSON document too small for %d frames (capacity %d)\n", totalFrames, doc.capacity());
+        return 0;
+    }
+    doc.clear();
     
     // 按照新格式组织数据包
     doc["type"] = Config::SENSOR_DATA_PACKET_TYPE;
-    doc["device_code"] = deviceCode;
-    doc["sensor_type"] = SensorData::getSensorType(block->frames[0].sensorId);
+    doc["device_code"] = context.deviceCode;
+    doc["sensor_type"] = SensorData::getSensorType(entry.blocks[0]->frames[0].sensorId);
     doc["timestamp"] = millis(); // 使用当前时间戳
-    
-    // 创建数据数组
-    JsonArray data = doc.createNestedArray("data");
-    if(Config::DEBUG_PPRINT){
-        Serial0.printf("[WebSocketClient]  Creating data packet with %d frames (expected: 30)\n", block->frameCount);
+    doc["seq"] = entry.seq;      // 数据消息序列号，服务器按此累计确认
+    if (entry.backlog) {
+        doc["backlog"] = true;   // 补传的块，早于同时收到的实时消息，服务器按块时间戳合并
     }
-    
-    
-    if (block->frameCount < 30) {
-        Serial0.printf("[WebSocketClient] WARNING: Data block has only %d frames, expected 30!\n", block->frameCount);
+    if (entry.resend) {
+        doc["resend"] = true;    // resend命令从会话记录补发的块，服务器按块号去重
+    }
+    JsonArray blockIds = doc.createNestedArray("block_ids");
+    for (uint8_t b = 0; b < entry.blockCount; b++) {
+        blockIds.add(entry.blocks[b]->blockId);
     }
     
-    int successfulFrames = 0;
-    int framesToProcess = block->frameCount;  // 现在直接使用所有帧，因为MAX_FRAMES已经是30
-    for (int i = 0; i < framesToProcess; i++) {
-        // 检查数组边界
-        if (i >= DataBlock::MAX_FRAMES) {
-            Serial0.printf("[WebSocketClient] ERROR: Frame index %d exceeds MAX_FRAMES %d\n", i, DataBlock::MAX_FRAMES);
-            break;
-        }
-        
-        JsonObject frame = data.createNestedObject();
-        if (frame.isNull()) {
-            Serial0.printf("[WebSocketClient] ERROR: Failed to create JSON object for frame %d, skipping this frame\n", i);
-            continue;  // 跳过这一帧，继续处理下一帧
+    // 非默认订阅时注明各传感器的通道掩码和分频
+    bool subscribed = false;
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        if (context.subscriptions[i].channelMask != CHANNEL_ALL || context.subscriptions[i].rateDivisor != 1) {
+            subscribed = true;
         }
-        
-        // 检查数据有效性
-        bool validData = true;
-        for (int j = 0; j < 3; j++) {
-            if (isnan(block->frames[i].acc[j]) || isinf(block->frames[i].acc[j])) {
-                validData = false;
-                Serial0.printf("[WebSocketClient] WARNING: Invalid acc[%d] data at frame %d: %f\n", j, i, block->frames[i].acc[j]);
-            }
+    }
+    if (subscribed) {
+        JsonArray channelMasks = doc.createNestedArray("channel_masks");
+        JsonArray rateDivisors = doc.createNestedArray("rate_divisors");
+        for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+            channelMasks.add(context.subscriptions[i].channelMask);
+            rateDivisors.add(context.subscriptions[i].rateDivisor);
         }
-        
-        // 加速度数据
-        JsonArray acc = frame.createNestedArray("acc");
-        if (acc.isNull()) {
-            Serial0.printf("[WebSocketClient] ERROR: Failed to create acc array for frame %d, skipping this frame\n", i);
-            continue;
+    }
+    
+    // 降级时注明等级和编码方式，使服务器能正确解释数据
+    if (level != UploadLevel::NORMAL) {
+        doc["level"] = RateController::getLevelName(level);
+        if (entry.blockCount > 1) {
+            doc["block_count"] = entry.blockCount;
         }
-        
-        if (validData) {
-            acc.add(block->frames[i].acc[0]);
-            acc.add(block->frames[i].acc[1]);
-            acc.add(block->frames[i].acc[2]);
-        } else {
-            // 如果数据无效，使用默认值
-            acc.add(0.0);
-            acc.add(0.0);
-            acc.add(0.0);
-            Serial0.printf("[WebSocketClient] WARNING: Using default acc values for frame %d\n", i);
+        if (compact) {
+            doc["encoding"] = "compact";
+            // 订阅了部分通道时，每帧只包含该传感器已订阅的通道（按acc、gyro、angle顺序）
+            doc["fields"] = "sensor_id,timestamp,ax,ay,az,gx,gy,gz,rx,ry,rz";
+            doc["scale"]["acc"] = 1000;
+            doc["scale"]["gyro"] = 100;
+            doc["scale"]["angle"] = 100;
         }
-        
-        // 角速度数据
-        JsonArray gyro = frame.createNestedArray("gyro");
-        if (gyro.isNull()) {
-            Serial0.printf("[WebSocketClient] ERROR: Failed to create gyro array for frame %d, skipping this frame\n", i);
-            continue;
+        if (level >= UploadLevel::DECIMATE) {
+            doc["decimation"] = Config::DECIMATION_FACTOR;
         }
-        gyro.add(block->frames[i].gyro[0]);
-        gyro.add(block->frames[i].gyro[1]);
-        gyro.add(block->frames[i].gyro[2]);
-        
-        // 角度数据
-        JsonArray angle = frame.createNestedArray("angle");
-        if (angle.isNull()) {
-            Serial0.printf("[WebSocketClient] ERROR: Failed to create angle array for frame %d, skipping this frame\n", i);
-            continue;
+        if (level >= UploadLevel::PRIORITY_DROP) {
+            JsonArray droppedSensors = doc.createNestedArray("dropped_sensors");
+            for (uint8_t id = 1; id <= SENSOR_DATA_SENSOR_COUNT; id++) {
+                if (Config::LOW_PRIORITY_SENSOR_MASK & (1 << (id - 1))) {
+                    droppedSensors.add(id);
+                }
+            }
         }
-        angle.add(block->frames[i].angle[0]);
-        angle.add(block->frames[i].angle[1]);
-        angle.add(block->frames[i].angle[2]);
-        
-        // 传感器ID
-        frame["sensor_id"] = block->frames[i].sensorId;
-        
-        // 时间戳（使用原始时间戳，避免精度丢失）
-        frame["timestamp"] = block->frames[i].timestamp;
-        
-        // 成功处理了一帧
-        successfulFrames++;
-        
-        // 调试信息：检查最后一个帧
-        if (i == block->frameCount - 1) {
-            if(Config::DEBUG_PPRINT){
-                Serial0.printf("[WebSocketClient] DEBUG: Last frame %d - acc: [%f, %f, %f], gyro: [%f, %f, %f]\n", 
-                            i, block->frames[i].acc[0], block->frames[i].acc[1], block->frames[i].acc[2],
-                            block->frames[i].gyro[0], block->frames[i].gyro[1], block->frames[i].gyro[2]);
+    }
+    
+    // 创建数据数组
+    JsonArray data = doc.createNestedArray("data");
+    if(Config::DEBUG_PPRINT){
+        Serial0.printf("[WebSocketClient]  Creating data packet with %d frames in %d blocks, level %s\n", 
+                     totalFrames, entry.blockCount, RateController::getLevelName(level));
+    }
+    
+    int successfulFrames = 0;
+    bool ntpSynced = true;
+    uint32_t sensorFrameIndex[SENSOR_DATA_SENSOR_COUNT + 1] = {0};
+    // 清单统计先记在本地，序列化成功后才提交，编码失败改发跳过标记时不会重复计入
+    uint8_t uploadedFrames[MAX_COALESCED_BLOCKS][SessionManifest::SENSOR_COUNT] = {};
+    uint32_t checksums[MAX_COALESCED_BLOCKS][SessionManifest::SENSOR_COUNT] = {};
+    uint8_t skippedFrames[MAX_COALESCED_BLOCKS][SessionManifest::SENSOR_COUNT] = {};
+    for (uint8_t b = 0; b < entry.blockCount; b++) {
+        const DataBlock* block = entry.blocks[b];
+        for (int i = 0; i < block->frameCount; i++) {
+            const SensorFrame& sensorFrame = block->frames[i];
+            
+            uint8_t sensorSlot = (sensorFrame.sensorId >= 1 && sensorFrame.sensorId <= SENSOR_DATA_SENSOR_COUNT) ? 
+                                 sensorFrame.sensorId : 0;
+            uint32_t indexInSensor = sensorFrameIndex[sensorSlot]++;
+            
+            // 先按订阅过滤（通道和分频），再对订阅后的帧序列应用降级等级
+            SensorSubscription subscription = {CHANNEL_ALL, 1};
+            if (sensorSlot > 0) {
+                subscription = context.subscriptions[sensorSlot - 1];
+            }
+            if (subscription.channelMask == 0 || indexInSensor % subscription.rateDivisor != 0) {
+                unsubscribedFrames++;
+                if (sensorSlot > 0) {
+                    skippedFrames[b][sensorSlot - 1]++;
+                }
+                continue;
+            }
+            if (!shouldEncodeFrame(level, sensorFrame.sensorId, indexInSensor / subscription.rateDivisor)) {
+                omittedFrames++;
+                if (sensorSlot > 0) {
+                    skippedFrames[b][sensorSlot - 1]++;
+                }
+                continue;
+            }
+            uint8_t channels = subscription.channelMask;
+            
+            // 检查数据有效性
+            bool validData = true;
+            for (int j = 0; j < 3; j++) {
+                if (isnan(sensorFrame.acc[j]) || isinf(sensorFrame.acc[j])) {
+                    validData = false;
+                    Serial0.printf("[WebSocketClient] WARNING: Invalid acc[%d] data at frame %d: %f\n", j, i, sensorFrame.acc[j]);
+                }
             }
+            
+            int32_t values[SessionManifest::CHANNEL_VALUES];
+            quantizeFrame(sensorFrame, channels, validData, values);
+            ntpSynced = ntpSynced && sensorFrame.ntpSynced;
+            if (manifest && sensorSlot > 0) {
+                uploadedFrames[b][sensorSlot - 1]++;
+                checksums[b][sensorSlot - 1] += SessionManifest::frameChecksum(sensorFrame.sensorId, sensorFrame.timestamp, values);
+            }
+            
+            if (compact) {
+                // 紧凑格式：[sensor_id, timestamp, acc*1000 x3, gyro*100 x3, angle*100 x3]
+                JsonArray frame = data.createNestedArray();
+                if (frame.isNull()) {
+                    Serial0.printf("[WebSocketClient] ERROR: Failed to create JSON array for frame %d, skipping this frame\n", i);
+                    continue;
+                }
+                frame.add(sensorFrame.sensorId);
+                frame.add(sensorFrame.timestamp);
+                for (uint8_t group = 0; group < 3; group++) {
+                    if (channels & (1 << group)) {
+                        for (int j = 0; j < 3; j++) {
+                            frame.add(values[group * 3 + j]);
+                        }
+                    }
+                }
+                successfulFrames++;
+                continue;
+            }
+            
+            JsonObject frame = data.createNestedObject();
+            if (frame.isNull()) {
+                Serial0.printf("[WebSocketClient] ERROR: Failed to create JSON object for frame %d, skipping this frame\n", i);
+                continue;  // 跳过这一帧，继续处理下一帧
+            }
+            
+            // 加速度数据
+            if (channels & CHANNEL_ACC) {
+                JsonArray acc = frame.createNestedArray("acc");
+                if (acc.isNull()) {
+                    Serial0.printf("[WebSocketClient] ERROR: Failed to create acc array for frame %d, skipping this frame\n", i);
+                    continue;
+                }
+                
+                if (validData) {
+                    acc.add(sensorFrame.acc[0]);
+                    acc.add(sensorFrame.acc[1]);
+                    acc.add(sensorFrame.acc[2]);
+                } else {
+                    // 如果数据无效，使用默认值
+                    acc.add(0.0);
+                    acc.add(0.0);
+                    acc.add(0.0);
+                    Serial0.printf("[WebSocketClient] WARNING: Using default acc values for frame %d\n", i);
+                }
+            }
+            
+            // 角速度数据
+            if (channels & CHANNEL_GYRO) {
+                JsonArray gyro = frame.createNestedArray("gyro");
+                if (gyro.isNull()) {
+                    Serial0.printf("[WebSocketClient] ERROR: Failed to create gyro array for frame %d, skipping this frame\n", i);
+                    continue;
+                }
+                gyro.add(sensorFrame.gyro[0]);
+                gyro.add(sensorFrame.gyro[1]);
+                gyro.add(sensorFrame.gyro[2]);
+            }
+            
+            // 角度数据
+            if (channels & CHANNEL_ANGLE) {
+                JsonArray angle = frame.createNestedArray("angle");
+                if (angle.isNull()) {
+                    Serial0.printf("[WebSocketClient] ERROR: Failed to create angle array for frame %d, skipping this frame\n", i);
+                    continue;
+                }
+                angle.add(sensorFrame.angle[0]);
+                angle.add(sensorFrame.angle[1]);
+                angle.add(sensorFrame.angle[2]);
+            }
+            
+            // 传感器ID
+            frame["sensor_id"] = sensorFrame.sensorId;
+            
+            // 时间戳（使用原始时间戳，避免精度丢失）
+            frame["timestamp"] = sensorFrame.timestamp;
+            
+            // 成功处理了一帧
+            successfulFrames++;
         }
     }
     
     if(Config::DEBUG_PPRINT){
-        Serial0.printf("[WebSocketClient] DEBUG: Successfully processed %d out of %d frames\n", successfulFrames, block->frameCount);
+        Serial0.printf("[WebSocketClient] DEBUG: Successfully processed %d out of %d frames (%u omitted by level, %u by subscription)\n", 
+                     successfulFrames, totalFrames, omittedFrames, unsubscribedFrames);
     }
    
     
+    // 帧时间戳是否都是UTC时间：第一次NTP同步前是ESP32开机后的时间，传感器未校准时是传感器原始时间
+    doc["ntp_synced"] = ntpSynced && successfulFrames > 0;
+    
     // 添加会话ID（如果存在）
-    if (sessionId.length() > 0) {
-        doc["session_id"] = sessionId;
+    if (context.sessionId[0] != '\0') {
+        doc["session_id"] = context.sessionId;
     }
 
+    // 检查JSON文档容量
+    if (doc.overflowed()) {
+        Serial0.printf("[WebSocketClient] ERROR: JSON document too large! Capacity: %d\n", doc.capacity());
+        return 0;
+    }
+    
     size_t docSize = measureJson(doc);
-    // 检查JSON文档大小
     if(Config::DEBUG_PPRINT){
-     
-        Serial0.printf("[WebSocketClient] DEBUG: JSON document size: %d bytes, max capacity: %d bytes\n", 
-                    docSize, doc.capacity());
+        Serial0.printf("[WebSocketClient] DEBUG: JSON document size: %d bytes, memory usage: %d/%d bytes\n", 
+                    docSize, doc.memoryUsage(), doc.capacity());
     }
-
     
-    if (docSize >= doc.capacity()) {
-        Serial0.printf("[WebSocketClient] ERROR: JSON document too large! Size: %d, Capacity: %d\n", 
-                     docSize, doc.capacity());
-        return "";
+    if (docSize >= outputSize) {
+        Serial0.printf("[WebSocketClient] ERROR: Encoded message too large! Size: %d, Buffer: %d\n", docSize, outputSize);
+        return 0;
     }
     
-     String result;
-     size_t bytesWritten = serializeJson(doc, result);
+    size_t bytesWritten = serializeJson(doc, output, outputSize);
     
     if (bytesWritten == 0) {
         Serial0.printf("[WebSocketClient] ERROR: Failed to Serial0ize JSON document\n");
-        return "";
+        return 0;
     }
     if(Config::DEBUG_PPRINT){
         Serial0.printf("[WebSocketClient] DEBUG: JSON Serial0ized size: %d bytes\n", bytesWritten);
     }
     
-    
     // 验证序列化结果
     if (bytesWritten != docSize) {
         Serial0.printf("[WebSocketClient] WARNING: Serial0ized size (%d) != measured size (%d)\n", 
                      bytesWritten, docSize);
     }
     
-    return result;
+    if (manifest) {
+        for (uint8_t b = 0; b < entry.blockCount; b++) {
+            manifest->onBlockEncoded(entry.blocks[b]->blockId, uploadedFrames[b], checksums[b], skippedFrames[b]);
+        }
+    }
+    
+    return bytesWritten;
+}
+
+size_t WebSocketClient::createSkipPacket(const InFlightBlock& entry, const EncodeContext& context, char* output, size_t outputSize) {
+    StaticJsonDocument<512> doc;
+    doc["type"] = Config::SENSOR_DATA_PACKET_TYPE;
+    doc["device_code"] = context.deviceCode;
+    doc["timestamp"] = millis();
+    doc["seq"] = entry.seq;
+    doc["skipped"] = true;       // 块无法编码，服务器照常确认该序列号，块按丢弃处理
+    if (entry.backlog) {
+        doc["backlog"] = true;
+    }
+    if (entry.resend) {
+        doc["resend"] = true;
+    }
+    JsonArray blockIds = doc.createNestedArray("block_ids");
+    for (uint8_t b = 0; b < entry.blockCount; b++) {
+        if (entry.blocks[b]) {
+            blockIds.add(entry.blocks[b]->blockId);
+        }
+    }
+    if (context.sessionId[0] != '\0') {
+        doc["session_id"] = context.sessionId;
+    }
+
+    if (doc.overflowed() || measureJson(doc) >= outputSize) {
+        return 0;
+    }
+    return serializeJson(doc, output, outputSize);
 }
 
 void WebSocketClient::webSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
@@ -410,7 +826,14 @@ void WebSocketClient::webSocketEvent(WStype_t type, uint8_t* payload, size_t len
         case WStype_DISCONNECTED:
             Serial0.printf("[WebSocketClient] Disconnected from server\n");
             if (g_webSocketClientInstance) {
+                if (g_webSocketClientInstance->serverConnected) {
+                    g_webSocketClientInstance->stats.serverDisconnects++;
+                    g_webSocketClientInstance->serverBackoff.onLinkDown(millis());
+                }
                 g_webSocketClientInstance->serverConnected = false;
+                // 连接断开后，窗口内所有未确认块需在重连后重新发送
+                g_webSocketClientInstance->abortTransmit();
+                g_webSocketClientInstance->retransmitWindow.rewind();
                 Serial0.printf("[WebSocketClient] serverConnected set to false\n");
             }
             break;
@@ -419,7 +842,28 @@ void WebSocketClient::webSocketEvent(WStype_t type, uint8_t* payload, size_t len
             Serial0.printf("[WebSocketClient] Connected to server successfully\n");
             if (g_webSocketClientInstance) {
                 g_webSocketClientInstance->serverConnected = true;
+                g_webSocketClientInstance->abortTransmit();
+                g_webSocketClientInstance->retransmitWindow.rewind();
+                
+                // 记录断线到恢复的耗时，并重置退避
+                if (g_webSocketClientInstance->serverBackoff.isDown()) {
+                    uint32_t reconnectMs = g_webSocketClientInstance->serverBackoff.onLinkUp(millis());
+                    g_webSocketClientInstance->stats.lastServerReconnectMs = reconnectMs;
+                    if (reconnectMs > g_webSocketClientInstance->stats.maxServerReconnectMs) {
+                        g_webSocketClientInstance->stats.maxServerReconnectMs = reconnectMs;
+                    }
+                    Serial0.printf("[WebSocketClient] Server reconnected after %u ms\n", reconnectMs);
+                } else {
+                    g_webSocketClientInstance->serverBackoff.onLinkUp(millis());
+                }
+                g_webSocketClientInstance->pingOutstanding = false;
+                g_webSocketClientInstance->lastPingTime = millis();
+                g_webSocketClientInstance->webSocket.setReconnectInterval(Config::SERVER_RECONNECT_BASE_DELAY_MS);
                 Serial0.printf("[WebSocketClient] serverConnected set to true\n");
+                if (!g_webSocketClientInstance->retransmitWindow.isEmpty()) {
+                    Serial0.printf("[WebSocketClient] %d unacknowledged blocks will be resent first\n", 
+                                 g_webSocketClientInstance->retransmitWindow.size());
+                }
             }
             break;
             
@@ -433,15 +877,26 @@ void WebSocketClient::webSocketEvent(WStype_t type, uint8_t* payload, size_t len
             
             // 处理服务器命令
             if (g_webSocketClientInstance) {
-                String command = String((char*)payload);
-                g_webSocketClientInstance->handleServerCommand(command);
+                g_webSocketClientInstance->handleServerCommand((char*)payload, length);
+            }
+            break;
+            
+        case WStype_PONG:
+            if (g_webSocketClientInstance) {
+                g_webSocketClientInstance->handlePong(payload, length);
             }
             break;
             
         case WStype_ERROR:
             Serial0.printf("[WebSocketClient] WebSocket error occurred\n");
             if (g_webSocketClientInstance) {
+                if (g_webSocketClientInstance->serverConnected) {
+                    g_webSocketClientInstance->stats.serverDisconnects++;
+                    g_webSocketClientInstance->serverBackoff.onLinkDown(millis());
+                }
                 g_webSocketClientInstance->serverConnected = false;
+                g_webSocketClientInstance->abortTransmit();
+                g_webSocketClientInstance->retransmitWindow.rewind();
                 Serial0.printf("[WebSocketClient] serverConnected set to false due to error\n");
             }
             break;
@@ -452,260 +907,1619 @@ void WebSocketClient::webSocketEvent(WStype_t type, uint8_t* payload, size_t len
     }
 }
 
-void WebSocketClient::parseServerCommand(const String& jsonCommand) {
-    StaticJsonDocument<512> doc;
-    DeserializationError error = deserializeJson(doc, jsonCommand);
+// 服务器命令表（大写别名兼容旧版服务器），最频繁的数据确认放在表首
+const WebSocketClient::ServerCommand WebSocketClient::SERVER_COMMANDS[] = {
+    {hashCommandName("batch_sensor_data_response"), "batch_sensor_data_response", &WebSocketClient::onDataAckCommand, false},
+    {hashCommandName("start_collection"), "start_collection", &WebSocketClient::onStartCollectionCommand, false},
+    {hashCommandName("stop_collection"), "stop_collection", &WebSocketClient::onStopCollectionCommand, false},
+    {hashCommandName("sync"), "sync", &WebSocketClient::onSyncCommand, false},
+    {hashCommandName("SYNC"), "SYNC", &WebSocketClient::onSyncCommand, false},
+    {hashCommandName("set_batch"), "set_batch", &WebSocketClient::onSetBatchCommand, false},
+    {hashCommandName("SET_BATCH"), "SET_BATCH", &WebSocketClient::onSetBatchCommand, false},
+    {hashCommandName("get_status"), "get_status", &WebSocketClient::onGetStatusCommand, false},
+    {hashCommandName("GET_STATUS"), "GET_STATUS", &WebSocketClient::onGetStatusCommand, false},
+    {hashCommandName("heartbeat"), "heartbeat", &WebSocketClient::onHeartbeatCommand, false},
+    {hashCommandName("HEARTBEAT"), "HEARTBEAT", &WebSocketClient::onHeartbeatCommand, false},
+    {hashCommandName("subscribe"), "subscribe", &WebSocketClient::onSubscribeCommand, true},
+    {hashCommandName("SUBSCRIBE"), "SUBSCRIBE", &WebSocketClient::onSubscribeCommand, true},
+    {hashCommandName("resend"), "resend", &WebSocketClient::onResendCommand, true},
+    {hashCommandName("cancel_resend"), "cancel_resend", &WebSocketClient::onCancelResendCommand, false},
+};
+const size_t WebSocketClient::SERVER_COMMAND_COUNT = sizeof(SERVER_COMMANDS) / sizeof(SERVER_COMMANDS[0]);
+
+const WebSocketClient::ServerCommand* WebSocketClient::findServerCommand(const char* name) {
+    return findCommand(SERVER_COMMANDS, SERVER_COMMAND_COUNT, name);
+}
+
+void WebSocketClient::parseServerCommand(char* payload, size_t length) {
+    // 可写输入使ArduinoJson零拷贝解析：字符串就地反转义，文档中只保存指向payload的指针
+    StaticJsonDocument<1024> doc;  // subscribe命令包含每个传感器的通道列表
+    DeserializationError error = deserializeJson(doc, payload, length);
     
     if (error) {
         Serial0.printf("[WebSocketClient] ERROR: Failed to parse server command: %s\n", error.c_str());
         return;
     }
     
-    String commandType = doc["type"] | doc["command"] | "";
-    String commandId = doc["command_id"] | doc["id"] | "";
-    bool success = false;
+    const char* commandType = doc["type"] | doc["command"] | "";
+    const char* commandId = doc["command_id"] | doc["id"] | "";
     if(Config::DEBUG_PPRINT){
-        Serial0.printf("[WebSocketClient] DEBUG: Parsed command type: %s, command ID: %s\n", commandType.c_str(), commandId.c_str());
-    }
-  
-    
-    if (commandType == "start_collection") {
-        deviceCode = doc["device_code"] | "";
-        // 支持数字和字符串类型的session_id
-        if (doc.containsKey("session_id")) {
-            if (doc["session_id"].is<int>()) {
-                sessionId = String(doc["session_id"].as<int>());
-            } else if (doc["session_id"].is<String>()) {
-                sessionId = doc["session_id"].as<String>();
-            } else {
-                sessionId = "";
-            }
-        }
-        startCollection();
-        success = true;
-        Serial0.printf("[WebSocketClient] Start collection command executed successfully\n");
-        
-    } else if (commandType == "stop_collection") {
-        // 保存sessionId和deviceCode（如果命令中包含的话）
-        if (doc.containsKey("session_id")) {
-            // 支持数字和字符串类型的session_id
-            if (doc["session_id"].is<int>()) {
-                sessionId = String(doc["session_id"].as<int>());
-            } else if (doc["session_id"].is<String>()) {
-                sessionId = doc["session_id"].as<String>();
-            } else {
-                sessionId = "";
-            }
-            Serial0.printf("[WebSocketClient] DEBUG: Saved sessionId: '%s'\n", sessionId.c_str());
-        }
-        if (doc.containsKey("device_code")) {
-            deviceCode = doc["device_code"] | "";
-            Serial0.printf("[WebSocketClient] DEBUG: Saved deviceCode: '%s'\n", deviceCode.c_str());
-        }
-        stopCollection();
-        success = true;
-        Serial0.printf("[WebSocketClient] Stop collection command executed successfully\n");
-        
-    } else if (commandType == "sync" || commandType == "SYNC") {
-        // 处理时间同步命令
-        Serial0.printf("[WebSocketClient] Time sync command received from server\n");
-        if (commandHandler) {
-            // 调用CommandHandler的sync命令
-            commandHandler->processCommand("sync");
-            success = true;
-            Serial0.printf("[WebSocketClient] Time sync command executed successfully\n");
-        } else {
-            Serial0.printf("[WebSocketClient] ERROR: CommandHandler not available\n");
-            success = false;
-        }
-        
-    } else if (commandType == "set_batch" || commandType == "SET_BATCH") {
-        // 处理批量大小设置命令
-        if (doc.containsKey("batch_size")) {
-            uint32_t batchSize = doc["batch_size"];
-            // 这里可以调用配置模块来设置批量大小
-            Serial0.printf("[WebSocketClient] Set batch size command received: %u\n", batchSize);
-            success = true;
-        } else {
-            Serial0.printf("[WebSocketClient] ERROR: Set batch command missing batch_size\n");
-        }
-        
-    } else if (commandType == "get_status" || commandType == "GET_STATUS") {
-        // 处理状态查询命令
-        sendStatusResponse(commandId);
-        success = true;
-        Serial0.printf("[WebSocketClient] Status query command processed\n");
-        
-    } else if (commandType == "heartbeat" || commandType == "HEARTBEAT") {
-        // 处理心跳命令
-        sendHeartbeat();
-        success = true;
-        Serial0.printf("[WebSocketClient] Heartbeat command processed\n");
-        
-    } else if (commandType == "batch_sensor_data_response" ) {
-       
-        if(Config::DEBUG_PPRINT){
-            Serial0.printf("[WebSocketClient] DEBUG: Received batch_sensor_data_response: %s\n", jsonCommand.c_str());
+        Serial0.printf("[WebSocketClient] DEBUG: Parsed command type: %s, command ID: %s\n", commandType, commandId);
+    }
+    
+    const ServerCommand* command = findServerCommand(commandType);
+    bool success = false;
+    if (command) {
+        success = (this->*(command->handler))(doc, commandId);
+        if (command->repliesItself) {
+            return;
         }
-        success = true;
-    }else {
-        Serial0.printf("[WebSocketClient] Unknown command: %s\n", commandType.c_str());
-        success = false;
+    } else {
+        Serial0.printf("[WebSocketClient] Unknown command: %s\n", commandType);
     }
     
     // 发送ACK响应（如果有command_id）
-    if (commandId.length() > 0) {
+    if (commandId[0] != '\0') {
         sendAckResponse(commandId, success);
     }
 }
 
-void WebSocketClient::sendAckResponse(const String& commandId, bool success) {
-    StaticJsonDocument<200> doc;
-    doc["type"] = "ack";
-    doc["command_id"] = commandId;
-    doc["success"] = success;
-    doc["timestamp"] = millis();
-    
-    String message;
-    serializeJson(doc, message);
-    
-    webSocket.sendTXT(message);
+void WebSocketClient::storeSessionId(JsonVariant value) {
+    copySessionId(value, sessionId, sizeof(sessionId));
 }
 
-void WebSocketClient::sendStatusResponse(const String& commandId) {
-    StaticJsonDocument<512> doc;
-    doc["type"] = "status_response";
-    doc["command_id"] = commandId;
-    doc["timestamp"] = millis();
-    
-    // 连接状态
-    doc["connection"]["wifi_connected"] = wifiConnected;
-    doc["connection"]["server_connected"] = serverConnected;
-    doc["connection"]["collection_active"] = collectionActive;
-    
-    // 设备信息
-    doc["device"]["device_code"] = deviceCode;
-    doc["device"]["session_id"] = sessionId;
-    doc["device"]["firmware_version"] = "V3.3";
-    
-    // 统计信息
-    doc["stats"]["total_blocks_sent"] = stats.totalBlocksSent;
-    doc["stats"]["total_bytes_sent"] = stats.totalBytesSent;
-    doc["stats"]["send_failures"] = stats.sendFailures;
+void WebSocketClient::copySessionId(JsonVariant value, char* output, size_t outputSize) {
+    // 支持数字和字符串类型的session_id
+    if (value.is<int>()) {
+        snprintf(output, outputSize, "%d", value.as<int>());
+    } else if (value.is<const char*>()) {
+        strlcpy(output, value.as<const char*>(), outputSize);
+    } else {
+        output[0] = '\0';
+    }
+}
+
+bool WebSocketClient::onStartCollectionCommand(JsonDocument& doc, const char* commandId) {
+    strlcpy(deviceCode, doc["device_code"] | "", sizeof(deviceCode));
+    if (doc.containsKey("session_id")) {
+        storeSessionId(doc["session_id"]);
+    }
+    publishEncodeContext();
+    startCollection();
+    Serial0.printf("[WebSocketClient] Start collection command executed successfully\n");
+    return true;
+}
+
+bool WebSocketClient::onStopCollectionCommand(JsonDocument& doc, const char* commandId) {
+    // 保存sessionId和deviceCode（如果命令中包含的话）
+    if (doc.containsKey("session_id")) {
+        storeSessionId(doc["session_id"]);
+        Serial0.printf("[WebSocketClient] DEBUG: Saved sessionId: '%s'\n", sessionId);
+    }
+    if (doc.containsKey("device_code")) {
+        strlcpy(deviceCode, doc["device_code"] | "", sizeof(deviceCode));
+        Serial0.printf("[WebSocketClient] DEBUG: Saved deviceCode: '%s'\n", deviceCode);
+    }
+    publishEncodeContext();
+    stopCollection();
+    Serial0.printf("[WebSocketClient] Stop collection command executed successfully\n");
+    return true;
+}
+
+bool WebSocketClient::onSyncCommand(JsonDocument& doc, const char* commandId) {
+    // 处理时间同步命令
+    Serial0.printf("[WebSocketClient] Time sync command received from server\n");
+    if (!commandHandler) {
+        Serial0.printf("[WebSocketClient] ERROR: CommandHandler not available\n");
+        return false;
+    }
+    // 调用CommandHandler的sync命令
+    commandHandler->processCommand("sync");
+    Serial0.printf("[WebSocketClient] Time sync command executed successfully\n");
+    return true;
+}
+
+bool WebSocketClient::onSetBatchCommand(JsonDocument& doc, const char* commandId) {
+    // 处理批量大小设置命令
+    if (!doc.containsKey("batch_size")) {
+        Serial0.printf("[WebSocketClient] ERROR: Set batch command missing batch_size\n");
+        return false;
+    }
+    uint32_t batchSize = doc["batch_size"];
+    // 这里可以调用配置模块来设置批量大小
+    Serial0.printf("[WebSocketClient] Set batch size command received: %u\n", batchSize);
+    return true;
+}
+
+bool WebSocketClient::onGetStatusCommand(JsonDocument& doc, const char* commandId) {
+    // 处理状态查询命令
+    sendStatusResponse(commandId);
+    Serial0.printf("[WebSocketClient] Status query command processed\n");
+    return true;
+}
+
+bool WebSocketClient::onHeartbeatCommand(JsonDocument& doc, const char* commandId) {
+    // 处理心跳命令
+    sendHeartbeat();
+    Serial0.printf("[WebSocketClient] Heartbeat command processed\n");
+    return true;
+}
+
+bool WebSocketClient::onDataAckCommand(JsonDocument& doc, const char* commandId) {
+    // 累计确认：ack_seq（或seq）及之前的所有数据块均已被服务器接收
+    if (doc.containsKey("ack_seq")) {
+        handleDataAck(doc["ack_seq"].as<uint32_t>());
+    } else if (doc.containsKey("seq")) {
+        handleDataAck(doc["seq"].as<uint32_t>());
+    } else {
+        // 不带序列号的响应无法对应到消息（合并发送、重连重传时一条响应可能对应多条或零条消息），
+        // 不确认任何块，未确认的块留在窗口中直到收到累计确认
+        if (stats.unsequencedAcks++ == 0) {
+            Serial0.printf("[WebSocketClient] WARNING: Data response without ack_seq ignored, server must acknowledge by ack_seq\n");
+        }
+        return false;
+    }
+    return true;
+}
+
+bool WebSocketClient::onSubscribeCommand(JsonDocument& doc, const char* commandId) {
+    // 处理订阅命令：ACK中返回生效后的订阅
+    char subscribeError[48] = "";
+    bool success = handleSubscribeCommand(doc, subscribeError, sizeof(subscribeError));
+    if (success) {
+        Serial0.printf("[WebSocketClient] Subscribe command executed successfully\n");
+    } else {
+        Serial0.printf("[WebSocketClient] ERROR: Subscribe command rejected: %s\n", subscribeError);
+    }
+    sendSubscriptionAck(commandId, success, subscribeError);
+    return success;
+}
+
+bool WebSocketClient::onResendCommand(JsonDocument& doc, const char* commandId) {
+    // 格式：{"type":"resend","command_id":"r1","session_id":"1015","sensor_id":2,
+    //        "from_ts":..,"to_ts":..,"from_block":..,"to_block":..}，范围字段均可省略
+    const char* error = nullptr;
+    char requestedSession[32];
+    copySessionId(doc["session_id"], requestedSession, sizeof(requestedSession));
+    int sensorId = doc["sensor_id"] | 0;
+    
+    SessionRecorder::ResendRange range;
+    range.sensorId = sensorId;
+    range.fromTimestamp = doc["from_ts"] | (uint64_t)0;
+    range.toTimestamp = doc["to_ts"] | UINT64_MAX;
+    range.fromBlockId = doc["from_block"] | (uint32_t)0;
+    range.toBlockId = doc["to_block"] | UINT32_MAX;
+    range.sessionNumber = 0;
+    
+    if (!sessionRecorder || !sessionRecorder->isReady()) {
+        error = "recorder unavailable";
+    } else if (commandId[0] == '\0') {
+        error = "missing command_id";
+    } else if (resendJob.active || resendJob.encodedBlocks != resendJob.finishedBlocks) {
+        // 上一次补发的块还在窗口中时不开始新的补发，进度按块归属统计
+        error = "resend in progress";
+    } else if (requestedSession[0] == '\0') {
+        error = "missing session_id";
+    } else if (sensorId < 0 || sensorId > SENSOR_DATA_SENSOR_COUNT) {
+        error = "invalid sensor_id";
+    } else if (range.fromTimestamp > range.toTimestamp || range.fromBlockId > range.toBlockId) {
+        error = "invalid range";
+    } else if ((range.sessionNumber = sessionRecorder->findSession(requestedSession)) == 0) {
+        error = "session not recorded";
+    } else if (!sessionRecorder->startResend(range)) {
+        error = "no recorded data";
+    }
+    
+    if (error) {
+        Serial0.printf("[WebSocketClient] ERROR: Resend rejected: %s\n", error);
+        StaticJsonDocument<256> ack;
+        ack["type"] = "ack";
+        ack["command_id"] = commandId;
+        ack["success"] = false;
+        ack["timestamp"] = millis();
+        ack["error"] = error;
+        sendControlMessage(ack);
+        return false;
+    }
+    
+    strlcpy(resendJob.commandId, commandId, sizeof(resendJob.commandId));
+    resendJob.sessionNumber = range.sessionNumber;
+    resendJob.encodedBlocks = 0;
+    resendJob.finishedBlocks = 0;
+    resendJob.ackedBlocks = 0;
+    resendJob.readDone = false;
+    resendJob.startTime = millis();
+    resendJob.lastProgressTime = resendJob.startTime;
+    resendJob.active = true;
+    Serial0.printf("[WebSocketClient] Resend started: session '%s' (local %u), sensor %d\n", 
+                  requestedSession, range.sessionNumber, sensorId);
+    sendResendProgress("running");
+    if (encoderTaskHandle) {
+        xTaskNotifyGive(encoderTaskHandle);
+    }
+    return true;
+}
+
+bool WebSocketClient::onCancelResendCommand(JsonDocument& doc, const char* commandId) {
+    // 格式：{"type":"cancel_resend","command_id":"c1","resend_id":"r1"}，resend_id省略时取消当前补发
+    const char* resendId = doc["resend_id"] | "";
+    if (!resendJob.active || (resendId[0] != '\0' && strcmp(resendId, resendJob.commandId) != 0)) {
+        Serial0.printf("[WebSocketClient] WARNING: No matching resend to cancel\n");
+        return false;
+    }
+    // 已编码的块照常上传，不再从记录中读取新的块
+    sessionRecorder->cancelResend();
+    resendJob.readDone = true;
+    resendJob.active = false;
+    Serial0.printf("[WebSocketClient] Resend %s cancelled after %u blocks\n", 
+                  resendJob.commandId, resendJob.encodedBlocks);
+    sendResendProgress("cancelled");
+    return true;
+}
+
+void WebSocketClient::sendResendProgress(const char* state) {
+    StaticJsonDocument<384> doc;
+    doc["type"] = "ack";
+    doc["command_id"] = resendJob.commandId;
+    doc["success"] = true;
+    doc["timestamp"] = millis();
+    
+    JsonObject progress = doc.createNestedObject("resend");
+    progress["state"] = state;
+    progress["read_blocks"] = sessionRecorder ? sessionRecorder->getResendBlocks() : 0;
+    progress["sent_blocks"] = resendJob.encodedBlocks;
+    progress["acked_blocks"] = resendJob.ackedBlocks;
+    progress["dropped_blocks"] = resendJob.finishedBlocks - resendJob.ackedBlocks;
+    progress["elapsed_ms"] = millis() - resendJob.startTime;
+    if (sessionRecorder) {
+        SessionLog::QueryStats queryStats = sessionRecorder->getResendStats();
+        progress["segments_read"] = queryStats.segmentsTouched;
+        progress["segments_skipped"] = queryStats.segmentsSkipped;
+    }
+    
+    sendControlMessage(doc);
+}
+
+void WebSocketClient::updateResend() {
+    if (!resendJob.active) {
+        return;
+    }
+    uint32_t now = millis();
+    // 读完且已编码的块全部确认（或丢弃）后结束
+    if (resendJob.readDone && resendJob.encodedBlocks == resendJob.finishedBlocks) {
+        resendJob.active = false;
+        Serial0.printf("[WebSocketClient] Resend %s complete: %u blocks in %u ms\n", 
+                      resendJob.commandId, resendJob.ackedBlocks, now - resendJob.startTime);
+        sendResendProgress("complete");
+        return;
+    }
+    if (serverConnected && now - resendJob.lastProgressTime >= Config::RESEND_PROGRESS_INTERVAL_MS) {
+        resendJob.lastProgressTime = now;
+        sendResendProgress("running");
+    }
+}
+
+void WebSocketClient::sendAckResponse(const char* commandId, bool success) {
+    StaticJsonDocument<200> doc;
+    doc["type"] = "ack";
+    doc["command_id"] = commandId;
+    doc["success"] = success;
+    doc["timestamp"] = millis();
+    
+    sendControlMessage(doc);
+}
+
+WebSocketClient::SensorSubscription WebSocketClient::getSubscription(uint8_t sensorId) const {
+    if (sensorId >= 1 && sensorId <= SENSOR_DATA_SENSOR_COUNT) {
+        return subscriptions[sensorId - 1];
+    }
+    SensorSubscription fullSubscription = {CHANNEL_ALL, 1};
+    return fullSubscription;
+}
+
+bool WebSocketClient::handleSubscribeCommand(JsonDocument& doc, char* error, size_t errorSize) {
+    // 格式：{"type":"subscribe","reset":true,"sensors":[{"sensor_id":1,"channels":["angle"],"divisor":2},...]}
+    // channels也可以是整数掩码（bit0=acc, bit1=gyro, bit2=angle），空数组表示不上传该传感器。
+    // 未列出的传感器保持原设置；reset为true时先恢复默认订阅
+    SensorSubscription updated[SENSOR_DATA_SENSOR_COUNT];
+    memcpy(updated, subscriptions, sizeof(updated));
+    
+    if (doc["reset"] | false) {
+        for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+            updated[i].channelMask = CHANNEL_ALL;
+            updated[i].rateDivisor = 1;
+        }
+    }
+    
+    JsonArray sensors = doc["sensors"];
+    for (JsonObject sensor : sensors) {
+        int sensorId = sensor["sensor_id"] | 0;
+        if (sensorId < 1 || sensorId > SENSOR_DATA_SENSOR_COUNT) {
+            snprintf(error, errorSize, "invalid sensor_id %d", sensorId);
+            return false;
+        }
+        SensorSubscription& target = updated[sensorId - 1];
+        
+        if (sensor.containsKey("channels")) {
+            if (sensor["channels"].is<int>()) {
+                int mask = sensor["channels"].as<int>();
+                if (mask < 0 || mask > CHANNEL_ALL) {
+                    snprintf(error, errorSize, "invalid channel mask %d", mask);
+                    return false;
+                }
+                target.channelMask = mask;
+            } else {
+                uint8_t mask = 0;
+                JsonArray channels = sensor["channels"];
+                for (JsonVariant channel : channels) {
+                    const char* name = channel | "";
+                    if (strcmp(name, "acc") == 0) {
+                        mask |= CHANNEL_ACC;
+                    } else if (strcmp(name, "gyro") == 0) {
+                        mask |= CHANNEL_GYRO;
+                    } else if (strcmp(name, "angle") == 0) {
+                        mask |= CHANNEL_ANGLE;
+                    } else {
+                        snprintf(error, errorSize, "unknown channel %s", name);
+                        return false;
+                    }
+                }
+                target.channelMask = mask;
+            }
+        }
+        
+        if (sensor.containsKey("divisor")) {
+            int divisor = sensor["divisor"] | 0;
+            if (divisor < 1 || divisor > MAX_RATE_DIVISOR) {
+                snprintf(error, errorSize, "invalid divisor %d", divisor);
+                return false;
+            }
+            target.rateDivisor = divisor;
+        }
+    }
+    
+    // 全部条目校验通过后一次性生效，之后编码的数据消息（包括重传）按新订阅过滤
+    memcpy(subscriptions, updated, sizeof(subscriptions));
+    publishEncodeContext();
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        Serial0.printf("[WebSocketClient] Subscription sensor %d: channels 0x%02X, divisor %d\n", 
+                     i + 1, subscriptions[i].channelMask, subscriptions[i].rateDivisor);
+    }
+    return true;
+}
+
+void WebSocketClient::appendSubscriptions(JsonArray array) const {
+    for (uint8_t i = 0; i < SENSOR_DATA_SENSOR_COUNT; i++) {
+        JsonObject sensor = array.createNestedObject();
+        sensor["sensor_id"] = i + 1;
+        sensor["channel_mask"] = subscriptions[i].channelMask;
+        sensor["divisor"] = subscriptions[i].rateDivisor;
+    }
+}
+
+void WebSocketClient::sendSubscriptionAck(const char* commandId, bool success, const char* error) {
+    StaticJsonDocument<512> doc;
+    doc["type"] = "ack";
+    doc["command_id"] = commandId;
+    doc["success"] = success;
+    doc["timestamp"] = millis();
+    if (!success) {
+        doc["error"] = error;
+    }
+    // 无论成功与否都返回当前生效的订阅
+    appendSubscriptions(doc.createNestedArray("subscription"));
+    
+    sendControlMessage(doc);
+}
+
+void WebSocketClient::beginStatusSection(JsonDocument& doc, const char* commandId, const char* section, uint8_t part) {
+    doc.clear();
+    doc["type"] = "status_response";
+    doc["command_id"] = commandId;
+    doc["timestamp"] = millis();
+    doc["section"] = section;
+    doc["part"] = part;
+    doc["parts"] = STATUS_SECTION_COUNT;
+}
+
+void WebSocketClient::sendStatusSection(JsonDocument& doc, const char* section) {
+    // 文档池用尽时ArduinoJson丢弃之后的字段，此时报错而不是静默发送缺字段的响应
+    if (doc.overflowed()) {
+        Serial0.printf("[WebSocketClient] ERROR: Status section %s overflowed its document (%d bytes), fields missing\n",
+                     section, doc.capacity());
+    }
+    sendControlMessage(doc);
+}
+
+void WebSocketClient::sendStatusResponse(const char* commandId) {
+    // 每节与控制通道槽位同样大小；分节后单条消息远小于槽位，新增字段不会使整条响应因超长被丢弃
+    StaticJsonDocument<CONTROL_SLOT_SIZE> doc;
+    
+    // 第1节：连接状态、设备和系统信息
+    beginStatusSection(doc, commandId, "connection", 1);
+    doc["connection"]["wifi_connected"] = wifiConnected.load();
+    doc["connection"]["server_connected"] = serverConnected.load();
+    doc["connection"]["collection_active"] = collectionActive.load();
+    doc["connection"]["ntp_synced"] = timeSync && timeSync->isNtpInitialized();
+    doc["device"]["device_code"] = deviceCode;
+    doc["device"]["session_id"] = sessionId;
+    doc["device"]["firmware_version"] = "V3.3";
+    doc["system"]["free_heap"] = ESP.getFreeHeap();
+    doc["system"]["uptime"] = millis();
+    sendStatusSection(doc, "connection");
+    
+    // 第2节：发送统计
+    beginStatusSection(doc, commandId, "stats", 2);
+    doc["stats"]["total_blocks_sent"] = stats.totalBlocksSent;
+    doc["stats"]["total_bytes_sent"] = stats.totalBytesSent;
+    doc["stats"]["send_failures"] = stats.sendFailures;
     doc["stats"]["avg_send_rate"] = stats.avgSendRate;
     doc["stats"]["connection_attempts"] = stats.connectionAttempts;
+    doc["stats"]["wifi_disconnects"] = stats.wifiDisconnects;
+    doc["stats"]["last_wifi_reconnect_ms"] = stats.lastWifiReconnectMs;
+    doc["stats"]["server_disconnects"] = stats.serverDisconnects;
+    doc["stats"]["last_server_reconnect_ms"] = stats.lastServerReconnectMs;
+    doc["stats"]["window_occupancy"] = retransmitWindow.size();
+    doc["stats"]["retransmissions"] = stats.retransmissions;
+    doc["stats"]["last_acked_seq"] = stats.lastAckedSeq;
+    doc["stats"]["avg_ack_rtt_ms"] = stats.avgAckRtt;
+    doc["stats"]["socket_bytes_queued"] = stats.socketBytesQueued;
+    doc["stats"]["pending_bytes"] = getStats().pendingBytes;
+    doc["stats"]["send_stalls"] = stats.sendStalls;
+    doc["stats"]["control_dropped"] = stats.controlDropped;
+    doc["stats"]["avg_control_latency_ms"] = stats.avgControlLatency;
+    doc["stats"]["max_control_latency_ms"] = stats.maxControlLatency;
+    doc["stats"]["unsubscribed_frames"] = stats.subscriptionOmittedFrames;
+    sendStatusSection(doc, "stats");
+    
+    // 第3节：延迟、编码/发送流水线和上传速率控制
+    beginStatusSection(doc, commandId, "latency", 3);
+    // 延迟统计(ms)：ping往返区分WiFi/网络延迟，块各阶段区分网关排队与服务器确认
+    doc["latency"]["ping_rtt_min"] = latency.pingRtt.getMin();
+    doc["latency"]["ping_rtt_avg"] = latency.pingRtt.getAvg();
+    doc["latency"]["ping_rtt_p99"] = latency.pingRtt.getPercentile(99.0f);
+    doc["latency"]["block_queue_avg"] = latency.blockQueue.getAvg();
+    doc["latency"]["block_queue_p99"] = latency.blockQueue.getPercentile(99.0f);
+    doc["latency"]["block_ack_avg"] = latency.blockAck.getAvg();
+    doc["latency"]["block_ack_p99"] = latency.blockAck.getPercentile(99.0f);
+    doc["latency"]["block_total_p99"] = latency.blockTotal.getPercentile(99.0f);
+    
+    // 编码/发送流水线
+    EncoderSnapshot encoder = readEncoderSnapshot();
+    doc["pipeline"]["encoded_messages"] = encoder.encodedMessages;
+    doc["pipeline"]["encoded_ready"] = readySlotQueue ? uxQueueMessagesWaiting(readySlotQueue) : 0;
+    doc["pipeline"]["encoder_stalls"] = encoder.encoderStalls;
+    doc["pipeline"]["encoder_utilization"] = stats.encoderUtilization;
+    doc["pipeline"]["transmit_utilization"] = stats.transmitUtilization;
+    
+    // 上传速率控制
+    doc["rate"]["level"] = RateController::getLevelName(rateController.getLevel());
+    doc["rate"]["level_changes"] = rateController.getLevelChanges();
+    doc["rate"]["capacity_bps"] = (uint32_t)rateController.getCapacityEstimate();
+    doc["rate"]["demand_bps"] = (uint32_t)rateController.getDemandEstimate();
+    doc["rate"]["omitted_frames"] = stats.rateOmittedFrames;
+    sendStatusSection(doc, "latency");
+    
+    // 第4节：服务器订阅、省电上传和闪存暂存
+    beginStatusSection(doc, commandId, "upload", 4);
+    appendSubscriptions(doc.createNestedArray("subscription"));
+    
+    // 省电上传
+    doc["power"]["phase"] = PowerScheduler::getPhaseName(powerScheduler.getPhase());
+    doc["power"]["held_blocks"] = heldCount.load();
+    doc["power"]["bursts"] = powerScheduler.getBurstCount();
+    doc["power"]["radio_on_ms_per_min"] = (uint32_t)powerScheduler.getRadioOnMsPerMinute(millis());
+    
+    // 闪存暂存
+    doc["spool"]["enabled"] = spoolEnabled && blockSpool.isReady();
+    doc["spool"]["pending_blocks"] = encoder.spool.pendingRecords;
+    doc["spool"]["fill"] = encoder.spool.capacityBytes > 0 ? encoder.spool.usedBytes * 100.0f / encoder.spool.capacityBytes : 0.0f;
+    doc["spool"]["write_bps"] = (uint32_t)stats.spoolWriteRate;
+    doc["spool"]["drain_blocks_per_s"] = stats.spoolDrainRate;
+    doc["spool"]["dropped_blocks"] = encoder.spoolDroppedBlocks;
+    doc["spool"]["catching_up"] = encoder.catchingUp;
+    doc["spool"]["backlog_share"] = encoder.backlogShare;
+    doc["spool"]["demoted_blocks"] = encoder.catchup.demotedBlocks;
+    doc["spool"]["last_catchup_ms"] = encoder.catchup.lastCatchupMs;
+    sendStatusSection(doc, "upload");
+    
+    Serial0.printf("[WebSocketClient] Status response sent (%d sections)\n", STATUS_SECTION_COUNT);
+}
+
+void WebSocketClient::updateStats() {
+    uint32_t now = millis();
+    if (now - lastStatsTime >= 1000) { // 每秒更新一次
+        uint32_t elapsedMs = now - lastStatsTime;
+        stats.avgSendRate = (float)blocksSentSinceLastStats * 1000.0f / elapsedMs;
+        lastStatsTime = now;
+        blocksSentSinceLastStats = 0;
+        
+        // 各阶段利用率：统计周期内忙碌时间占比
+        uint32_t nowUs = micros();
+        uint32_t elapsedUs = nowUs - lastUtilizationTime;
+        EncoderSnapshot encoder = readEncoderSnapshot();
+        uint32_t encoderUs = encoder.busyUs;
+        if (elapsedUs > 0) {
+            stats.encoderUtilization = (float)(encoderUs - lastEncoderBusyUs) * 100.0f / elapsedUs;
+            stats.transmitUtilization = (float)(transmitBusyUs - lastTransmitBusyUs) * 100.0f / elapsedUs;
+        }
+        lastEncoderBusyUs = encoderUs;
+        lastTransmitBusyUs = transmitBusyUs;
+        lastUtilizationTime = nowUs;
+        
+        // 暂存区写入和读回速率（暂存区统计由编码任务维护，重置后从0重新计算）
+        const BlockSpool::Stats& spoolStats = encoder.spool;
+        if (spoolStats.bytesFlushed < lastSpoolBytesFlushed || spoolStats.recordsRead < lastSpoolRecordsRead) {
+            lastSpoolBytesFlushed = 0;
+            lastSpoolRecordsRead = 0;
+        }
+        stats.spoolWriteRate = (spoolStats.bytesFlushed - lastSpoolBytesFlushed) * 1000.0f / elapsedMs;
+        stats.spoolDrainRate = (spoolStats.recordsRead - lastSpoolRecordsRead) * 1000.0f / elapsedMs;
+        lastSpoolBytesFlushed = spoolStats.bytesFlushed;
+        lastSpoolRecordsRead = spoolStats.recordsRead;
+    }
+}
+
+void WebSocketClient::setTaskHandles(TaskHandle_t networkTask, TaskHandle_t encoderTask) {
+    networkTaskHandle = networkTask;
+    encoderTaskHandle = encoderTask;
+}
+
+void WebSocketClient::publishEncodeContext() {
+    EncodeContext context;
+    memcpy(context.subscriptions, subscriptions, sizeof(context.subscriptions));
+    memcpy(context.deviceCode, deviceCode, sizeof(context.deviceCode));
+    memcpy(context.sessionId, sessionId, sizeof(context.sessionId));
+    
+    if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+        memcpy(publishedContext.subscriptions, context.subscriptions, sizeof(publishedContext.subscriptions));
+        memcpy(publishedContext.deviceCode, context.deviceCode, sizeof(publishedContext.deviceCode));
+        memcpy(publishedContext.sessionId, context.sessionId, sizeof(publishedContext.sessionId));
+        xSemaphoreGive(mutex);
+    }
+}
+
+void WebSocketClient::snapshotEncodeContext(EncodeContext& context) {
+    if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
+        memcpy(&context, &publishedContext, sizeof(context));
+        xSemaphoreGive(mutex);
+    }
+    context.level = rateController.getLevel();
+}
+
+void WebSocketClient::handleConnectionRetry() {
+    uint32_t now = millis();
+    
+    // WiFi层：链路断开时关闭WebSocket，并按退避间隔重新关联
+    if (!wifiConnected) {
+        if (serverConnected) {
+            Serial0.printf("[WebSocketClient] WiFi link down, closing WebSocket\n");
+            webSocket.disconnect();
+            if (serverConnected) {
+                // 断开事件未触发时手动更新状态
+                serverConnected = false;
+                stats.serverDisconnects++;
+                serverBackoff.onLinkDown(now);
+                abortTransmit();
+                retransmitWindow.rewind();
+            }
+        }
+        
+        if (wifiBackoff.poll(now, esp_random())) {
+            stats.wifiReconnectAttempts++;
+            Serial0.printf("[WebSocketClient] WiFi reconnect attempt %u, next retry in %u ms\n", 
+                         wifiBackoff.getAttempts(), wifiBackoff.getCurrentDelay());
+            WiFi.reconnect();
+        }
+        return;
+    }
+    
+    // WebSocket层：webSocket.loop()按重连间隔自动发起连接，这里在每个间隔到期时计为一次尝试并加大间隔
+    if (!serverConnected && serverBackoff.poll(now, esp_random())) {
+        if (serverBackoff.getAttempts() > 1) {
+            stats.connectionFailures++;
+        }
+        stats.connectionAttempts++;
+        webSocket.setReconnectInterval(serverBackoff.getCurrentDelay());
+        if (serverBackoff.getAttempts() > 1) {
+            Serial0.printf("[WebSocketClient] Server connect attempt %u, next retry in %u ms\n", 
+                         serverBackoff.getAttempts(), serverBackoff.getCurrentDelay());
+        }
+    }
+}
+
+void WebSocketClient::onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+    uint32_t now = millis();
+    
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            if (!wifiConnected) {
+                wifiConnected = true;
+                if (wifiBackoff.isDown()) {
+                    uint32_t reconnectMs = wifiBackoff.onLinkUp(now);
+                    stats.lastWifiReconnectMs = reconnectMs;
+                    if (reconnectMs > stats.maxWifiReconnectMs) {
+                        stats.maxWifiReconnectMs = reconnectMs;
+                    }
+                    Serial0.printf("[WebSocketClient] WiFi connected after %u ms. IP: %s\n", 
+                                 reconnectMs, WiFi.localIP().toString().c_str());
+                } else {
+                    wifiBackoff.onLinkUp(now);
+                }
+                // 链路恢复后WebSocket立即重试
+                serverBackoff.retryNow(now);
+            }
+            break;
+            
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+        case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+            if (wifiConnected) {
+                wifiConnected = false;
+                stats.wifiDisconnects++;
+                wifiBackoff.onLinkDown(now);
+                if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+                    Serial0.printf("[WebSocketClient] WiFi disconnected, reason: %d\n", 
+                                 info.wifi_sta_disconnected.reason);
+                } else {
+                    Serial0.printf("[WebSocketClient] WiFi lost IP\n");
+                }
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+void WebSocketClient::setSensorData(SensorData* sensorDataInstance) {
+    sensorData = sensorDataInstance;
+    if (sensorData) {
+        sensorData->setSessionManifest(&sessionManifest);
+    }
+    Serial0.printf("[WebSocketClient] SensorData set\n");
+}
+
+void WebSocketClient::setCommandHandler(CommandHandler* commandHandlerInstance) {
+    commandHandler = commandHandlerInstance;
+    Serial0.printf("[WebSocketClient] CommandHandler set\n");
+}
+
+void WebSocketClient::setSessionRecorder(SessionRecorder* recorder) {
+    sessionRecorder = recorder;
+    Serial0.printf("[WebSocketClient] SessionRecorder set\n");
+}
+
+void WebSocketClient::setTimeSync(TimeSync* ts) {
+    timeSync = ts;
+    Serial0.printf("[WebSocketClient] TimeSync set\n");
+}
+
+void WebSocketClient::setConnectionStatus(bool connected) {
+    if (serverConnected != connected) {
+        bool oldState = serverConnected;
+        serverConnected = connected;
+        Serial0.printf("[WebSocketClient] Connection status manually set: %d -> %d\n", oldState, connected);
+    }
+}
+
+void WebSocketClient::updateRateControl() {
+    uint32_t now = millis();
+    
+    // 仅在采集中且已连接时评估链路；断线期间队列增长不代表带宽不足，省电空闲阶段不上传
+    if (!collectionActive || !serverConnected || !sensorData || !powerScheduler.isRadioNeeded()) {
+        rateController.restartMeasurement();
+        return;
+    }
+    if (!rateController.isUpdateDue(now)) {
+        return;
+    }
+    
+    SensorData::Stats dataStats = sensorData->getStats();
+    if (!rateController.update(now, dataStats.queuedBlocks, dataStats.droppedBlocks)) {
+        return;
+    }
+    
+    Serial0.printf("[WebSocketClient] Upload level changed: %s -> %s (capacity %.0f B/s, demand %.0f B/s, queued %u)\n",
+                 RateController::getLevelName(rateController.getPreviousLevel()),
+                 RateController::getLevelName(rateController.getLevel()),
+                 rateController.getCapacityEstimate(), rateController.getDemandEstimate(), dataStats.queuedBlocks);
+    sendUploadLevel();
+}
+
+void WebSocketClient::sendUploadLevel() {
+    UploadLevel level = rateController.getLevel();
+    
+    StaticJsonDocument<384> doc;
+    doc["type"] = "upload_level";
+    doc["device_code"] = deviceCode;
+    doc["session_id"] = sessionId;
+    doc["timestamp"] = millis();
+    doc["level"] = RateController::getLevelName(level);
+    doc["previous_level"] = RateController::getLevelName(rateController.getPreviousLevel());
+    doc["next_seq"] = nextSeq;   // 从该序列号起的数据消息按新等级编码（重传消息以包内level字段为准）
+    doc["capacity_bps"] = (uint32_t)rateController.getCapacityEstimate();
+    doc["demand_bps"] = (uint32_t)rateController.getDemandEstimate();
+    doc["encoding"] = level >= UploadLevel::COMPACT ? "compact" : "json";
+    doc["max_blocks_per_message"] = level >= UploadLevel::COALESCE ? Config::COALESCE_MAX_BLOCKS : 1;
+    doc["decimation"] = level >= UploadLevel::DECIMATE ? Config::DECIMATION_FACTOR : 1;
+    doc["dropped_sensor_mask"] = level >= UploadLevel::PRIORITY_DROP ? Config::LOW_PRIORITY_SENSOR_MASK : 0;
+    
+    sendControlMessage(doc);
+}
+
+bool WebSocketClient::processSendQueue() {
+    sendPacer.beginRound(millis());
+    
+    // 未采集时不上传，清理排队的数据块避免下次采集时发送过期数据
+    if (!collectionActive && sensorData) {
+        uint32_t discarded = sensorData->discardQueuedBlocks();
+        if (discarded > 0 && Config::DEBUG_PPRINT) {
+            Serial0.printf("[WebSocketClient] DEBUG: Discarded %u queued blocks, collection not active\n", discarded);
+        }
+    }
+    
+    updateRateControl();
+    updatePowerSchedule();
+    updateResend();
+    
+    // 发送顺序：窗口中待重传的消息（重连后先重传未确认消息），窗口追平后再发送编码任务产出的新消息。
+    // 套接字不可写时保留当前消息和写入位置，下一轮继续，不阻塞webSocket.loop()
+    while (serverConnected) {
+        if (!txActive) {
+            // 消息边界：控制通道优先，未清空前不开始下一条数据消息
+            if (!flushControlLane()) {
+                break;
+            }
+            
+            if (retransmitWindow.hasResend()) {
+                if (!beginRetransmit()) {
+                    break;
+                }
+            } else if (!beginNextEncoded()) {
+                break;
+            }
+        }
+        
+        uint32_t writeStart = micros();
+        bool written = pumpTransmit();
+        transmitBusyUs += micros() - writeStart;
+        if (!written) {
+            break;  // 套接字暂不可写或发送失败，下一轮继续
+        }
+        
+        if (sendPacer.shouldYield(millis())) {
+            break;  // 让出时间片，保证webSocket.loop()的调用频率
+        }
+    }
+    
+    if (!txActive) {
+        flushControlLane();
+    }
+    
+    if (!serverConnected && localServer.hasClients()) {
+        fanOutWhileUpstreamDown();
+    }
+    
+    // 检查是否需要发送upload_complete消息（所有数据块均已编码、发送并被确认）。
+    // 编码任务先把消息放入readySlotQueue再发布drained，因此drained须先于readySlotQueue检查
+    if (uploadCompletePending && retransmitWindow.isEmpty() && parkedCount == 0 && !txActive && encoderDrained && 
+        (!readySlotQueue || uxQueueMessagesWaiting(readySlotQueue) == 0)) {
+        Serial0.printf("[WebSocketClient] All blocks acknowledged, sending upload_complete message\n");
+        sendUploadComplete();
+    }
+    
+    updateStats();
+    return sendPacer.hasYielded();
+}
+
+bool WebSocketClient::encodeNext() {
+    // 先清除drained再查看暂存环、暂存区和SensorData：网络任务看到drained时，之前取出的块都已在readySlotQueue中
+    encoderDrained = false;
+    if (encoderResetRequested.exchange(false)) {
+        uint32_t busyUs = encoderCounters.busyUs;
+        memset(&encoderCounters, 0, sizeof(encoderCounters));
+        encoderCounters.busyUs = busyUs;
+    }
+    
+    bool encoded = encodeMessage();
+    publishEncoderState(!encoded && heldCount == 0 && !blockSpool.hasPending());
+    return encoded;
+}
+
+void WebSocketClient::publishEncoderState(bool drained) {
+    encoderCounters.spool = blockSpool.getStats();
+    encoderCounters.catchup = catchupScheduler.getStats();
+    encoderCounters.catchingUp = catchupScheduler.isCatchingUp();
+    encoderCounters.backlogShare = catchupScheduler.getBacklogShare();
+    encoderCounters.measuredBacklogShare = catchupScheduler.getMeasuredShare();
+    encoderLatch.publish(encoderCounters);
+    encoderDrained = drained;
+}
+
+WebSocketClient::EncoderSnapshot WebSocketClient::readEncoderSnapshot() const {
+    EncoderSnapshot snapshot;
+    encoderLatch.read(snapshot);
+    return snapshot;
+}
+
+bool WebSocketClient::encodeMessage() {
+    // 未采集时只编码剩余的暂存块（停止采集后的集中上传和闪存暂存区），排队的块由网络任务清理
+    if (!sensorData || !freeSlotQueue || 
+        (!collectionActive && heldCount == 0 && !blockSpool.hasPending() && !resendJob.active)) {
+        return false;
+    }
+    
+    // 省电空闲阶段：块移入暂存环，等下一次集中上传再编码
+    if (holdBlocks) {
+        holdPendingBlocks();
+        return false;
+    }
+    
+    // 上游断开或积压时块写入闪存暂存区，断开期间不读回
+    if (spoolIncomingBlocks() && !serverConnected) {
+        return false;
+    }
+    
+    // 先确认有空闲输出缓冲区，再从SensorData取块，避免块在编码任务中积压
+    uint8_t slotIndex;
+    if (xQueuePeek(freeSlotQueue, &slotIndex, 0) != pdTRUE) {
+        if (!encoderWaitingForSlot) {
+            encoderWaitingForSlot = true;
+            encoderCounters.encoderStalls++;
+        }
+        return false;
+    }
+    encoderWaitingForSlot = false;
+    
+    // 补传：暂存区有积压时按份额在实时流和补传流之间选择，选中的流无块时改取另一路
+    if (catchupScheduler.update(millis(), rateController.getCapacityEstimate(), blockSpool.hasPending())) {
+        Serial0.printf("[WebSocketClient] Catch-up %s (backlog share %.2f)\n", 
+                      catchupScheduler.isCatchingUp() ? "started" : "finished", catchupScheduler.getBacklogShare());
+    }
+    bool liveReady = heldCount > 0 || (collectionActive && sensorData->getStats().queuedBlocks > 0);
+    CatchupScheduler::Stream stream = catchupScheduler.select(liveReady, blockSpool.hasPending());
+    
+    DataBlock* block = takeNextBlock(stream);
+    if (!block) {
+        stream = stream == CatchupScheduler::Stream::LIVE ? CatchupScheduler::Stream::BACKLOG : CatchupScheduler::Stream::LIVE;
+        block = takeNextBlock(stream);
+    }
+    // 两路都没有块时才补发会话记录；采集中至少留一个空闲输出缓冲区给实时流
+    bool resend = false;
+    if (!block && (!collectionActive || uxQueueMessagesWaiting(freeSlotQueue) > 1)) {
+        block = takeResendBlock();
+        resend = block != nullptr;
+    }
+    if (!block) {
+        return false;
+    }
+    uint32_t encodeStart = micros();
+    xQueueReceive(freeSlotQueue, &slotIndex, 0);
     
-    // 系统信息
-    doc["system"]["free_heap"] = ESP.getFreeHeap();
-    doc["system"]["uptime"] = millis();
+    EncodeContext context;
+    snapshotEncodeContext(context);
+    
+    EncodedMessage& message = encodeSlots[slotIndex];
+    InFlightBlock& entry = message.entry;
+    entry.blocks[0] = block;
+    entry.blockCount = 1;
+    entry.backlog = stream == CatchupScheduler::Stream::BACKLOG || resend;
+    entry.resend = resend;
+    message.localOnly = false;
+    
+    // 合并等级及以上：把同一路已就绪的块合并到同一条消息（不等待新块）
+    // 按满块的完整JSON估算大小，合并后仍须放得下输出缓冲区（重传时可能按NORMAL等级重新编码）
+    if (context.level >= UploadLevel::COALESCE) {
+        size_t maxBlocks = min((size_t)Config::COALESCE_MAX_BLOCKS, MAX_COALESCED_BLOCKS);
+        size_t frames = block->frameCount;
+        while (entry.blockCount < maxBlocks && 
+               encodedSizeBound(frames + DataBlock::MAX_FRAMES, false) < Config::ENCODE_BUFFER_SIZE) {
+            DataBlock* extra = resend ? takeResendBlock() : takeNextBlock(stream);
+            if (!extra) {
+                break;
+            }
+            entry.blocks[entry.blockCount++] = extra;
+            frames += extra->frameCount;
+        }
+        if (entry.blockCount > 1) {
+            encoderCounters.coalescedMessages++;
+        }
+    }
+    if(Config::DEBUG_PPRINT){
+        Serial0.printf("[WebSocketClient] DEBUG: Encoding block %u (+%d) into slot %d\n", 
+                     block->blockId, entry.blockCount - 1, slotIndex);
+    }
+    
+    // 序列号按编码顺序分配，消息按同一顺序进入readySlotQueue
+    entry.seq = nextSeq++;
+    entry.sentTime = 0;
+    entry.transmissions = 0;
+    entry.skipped = false;
+    
+    message.length = createDataPacket(entry, context, *encodeDoc, message.buffer, Config::ENCODE_BUFFER_SIZE, 
+                                      message.omittedFrames, message.unsubscribedFrames, 
+                                      resend ? nullptr : &sessionManifest);
+    if (message.length == 0) {
+        // 序列号已分配，以跳过标记代替数据发送，避免序列号空洞使累计确认停止推进
+        Serial0.printf("[WebSocketClient] ERROR: Failed to encode data block seq %u, sending skip marker\n", entry.seq);
+        encoderCounters.encodeFailures++;
+        entry.skipped = true;
+        message.omittedFrames = 0;
+        message.unsubscribedFrames = 0;
+        message.length = createSkipPacket(entry, context, message.buffer, Config::ENCODE_BUFFER_SIZE);
+        if (!resend) {
+            for (uint8_t b = 0; b < entry.blockCount; b++) {
+                sessionManifest.onBlockSkipped(entry.blocks[b]->blockId, entry.blocks[b]->sensorFrameCounts);
+            }
+        }
+    } else if (resend) {
+        // 补发的消息不计入补传份额，也不走UDP实时流
+        encoderCounters.encodedMessages++;
+    } else {
+        encoderCounters.encodedMessages++;
+        catchupScheduler.onMessage(stream, message.length, entry.blockCount);
+        // UDP实时流在消息进入发送队列前发出，不受WebSocket发送积压影响
+        if (wifiConnected && udpStreamer.isReady()) {
+            udpStreamer.sendMessage(entry.seq, message.buffer, message.length);
+        }
+    }
     
-    String message;
-    serializeJson(doc, message);
+    xQueueSend(readySlotQueue, &slotIndex, 0);
+    encoderCounters.busyUs += micros() - encodeStart;
     
-    webSocket.sendTXT(message);
-    Serial0.printf("[WebSocketClient] Status response sent\n");
+    if (networkTaskHandle) {
+        xTaskNotifyGive(networkTaskHandle);
+    }
+    return true;
 }
 
-void WebSocketClient::updateStats() {
-    uint32_t now = millis();
-    if (now - lastStatsTime >= 1000) { // 每秒更新一次
-        stats.avgSendRate = (float)blocksSentSinceLastStats * 1000.0f / (now - lastStatsTime);
-        lastStatsTime = now;
-        blocksSentSinceLastStats = 0;
+void WebSocketClient::admitParkedEntries() {
+    while (parkedCount > 0 && !retransmitWindow.isFull()) {
+        // 条目尚未写入套接字（transmissions为0），进入窗口后由重传流程按当前上下文编码发送
+        retransmitWindow.push(parkedEntries[parkedHead]);
+        parkedHead = (parkedHead + 1) % PARKED_ENTRY_COUNT;
+        parkedCount--;
     }
 }
 
-void WebSocketClient::handleConnectionRetry() {
-    if (!serverConnected && wifiConnected) {
-        uint32_t now = millis();
-        if (now - lastConnectionAttempt >= connectionRetryInterval) {
-            connect();
-            Serial0.printf("[WebSocketClient] Attempting to connect to server...\n");
+bool WebSocketClient::beginNextEncoded() {
+    admitParkedEntries();
+    if (!readySlotQueue || retransmitWindow.isFull()) {
+        return false;  // 窗口已满时已编码消息留在缓冲区中，编码任务随之因无空闲缓冲区而停止取块
+    }
+    
+    uint8_t slotIndex;
+    if (xQueueReceive(readySlotQueue, &slotIndex, 0) != pdTRUE) {
+        return false;
+    }
+    EncodedMessage& message = encodeSlots[slotIndex];
+    if (message.localOnly) {
+        // 重连前未来得及转发的本地消息：块已在闪存暂存区中，稍后按序上传
+        if (message.length > 0) {
+            localServer.broadcast(message.buffer, message.length);
         }
+        releaseLocalOnly(slotIndex);
+        return beginNextEncoded();
+    }
+    
+    // 放入重传窗口，数据块在被服务器确认前不释放
+    InFlightBlock& entry = retransmitWindow.push(message.entry);
+    
+    stats.rateOmittedFrames += message.omittedFrames;
+    stats.subscriptionOmittedFrames += message.unsubscribedFrames;
+    
+    txSlot = slotIndex;
+    txSeq = entry.seq;
+    
+    rateController.onMessageEncoded(message.length, entry.blockCount);
+    if (!entry.skipped) {
+        localServer.broadcast(message.buffer, message.length);
     }
+    txData = message.buffer;
+    txLength = message.length;
+    txOffset = 0;
+    txActive = true;
+    return true;
 }
 
-void WebSocketClient::setBufferPool(BufferPool* bufferPoolInstance) {
-    bufferPool = bufferPoolInstance;
-    Serial0.printf("[WebSocketClient] BufferPool set\n");
+void WebSocketClient::holdPendingBlocks() {
+    // 暂存环满时块留在SensorData队列中，达到提前上传阈值后网络任务会开始集中上传
+    while (collectionActive && heldCount < Config::POWER_HOLD_MAX_BLOCKS) {
+        DataBlock* block = sensorData->getNextBlock();
+        if (!block) {
+            break;
+        }
+        heldBlocks[(heldHead + heldCount) % Config::POWER_HOLD_MAX_BLOCKS] = block;
+        heldCount++;
+    }
 }
 
-void WebSocketClient::setCommandHandler(CommandHandler* commandHandlerInstance) {
-    commandHandler = commandHandlerInstance;
-    Serial0.printf("[WebSocketClient] CommandHandler set\n");
+DataBlock* WebSocketClient::takeNextBlock(CatchupScheduler::Stream stream) {
+    if (stream == CatchupScheduler::Stream::BACKLOG) {
+        return blockSpool.hasPending() ? unspoolBlock() : nullptr;
+    }
+    // 暂存环中的块早于SensorData中的块
+    if (heldCount > 0) {
+        DataBlock* block = heldBlocks[heldHead];
+        heldHead = (heldHead + 1) % Config::POWER_HOLD_MAX_BLOCKS;
+        heldCount--;
+        return block;
+    }
+    return collectionActive ? sensorData->getNextBlock() : nullptr;
 }
 
-void WebSocketClient::setConnectionStatus(bool connected) {
-    if (serverConnected != connected) {
-        bool oldState = serverConnected;
-        serverConnected = connected;
-        Serial0.printf("[WebSocketClient] Connection status manually set: %d -> %d\n", oldState, serverConnected);
+DataBlock* WebSocketClient::takeResendBlock() {
+    if (!resendJob.active || resendJob.readDone || !sessionRecorder) {
+        return nullptr;
+    }
+    DataBlock* block = sensorData->allocateBlock();
+    if (!block) {
+        return nullptr;
+    }
+    SessionRecorder::ResendRead result = sessionRecorder->readResend(block);
+    if (result == SessionRecorder::ResendRead::BLOCK) {
+        // 取出时即计数（先于readDone），网络任务不会在最后一条消息编码完成前判定补发结束
+        resendJob.encodedBlocks++;
+        return block;
+    }
+    sensorData->recycleBlock(block);
+    if (result == SessionRecorder::ResendRead::DONE) {
+        resendJob.readDone = true;
+    }
+    return nullptr;
+}
+
+bool WebSocketClient::setSpoolStorage(FlashStorage* storage) {
+    if (!spoolWriteBuffer) {
+        // 写缓冲区较大，优先放在PSRAM
+        spoolWriteBuffer = (uint8_t*)(psramFound() ? ps_malloc(Config::SPOOL_WRITE_BUFFER_SIZE) 
+                                                   : malloc(Config::SPOOL_WRITE_BUFFER_SIZE));
+    }
+    if (!spoolRecordBuffer) {
+        spoolRecordBuffer = (uint8_t*)malloc(sizeof(DataBlock));
+    }
+    if (!spoolWriteBuffer || !spoolRecordBuffer) {
+        Serial0.printf("[WebSocketClient] ERROR: Failed to allocate spool buffers\n");
+        return false;
+    }
+    
+    // 每次启动使用不同的epoch，上次运行留在闪存中的记录不会被读回
+    if (!blockSpool.begin(storage, spoolWriteBuffer, Config::SPOOL_WRITE_BUFFER_SIZE, esp_random())) {
+        Serial0.printf("[WebSocketClient] ERROR: Failed to initialize spool\n");
+        return false;
     }
+    Serial0.printf("[WebSocketClient] Spool ready: %u KB (%s)\n", storage->size() / 1024, 
+                  spoolEnabled ? "enabled" : "disabled");
+    return true;
+}
+
+void WebSocketClient::setSpoolEnabled(bool enabled) {
+    if (enabled && !blockSpool.isReady()) {
+        Serial0.printf("[WebSocketClient] ERROR: Spool unavailable, storage not initialized\n");
+        return;
+    }
+    // 关闭后不再写入新块，已暂存的块仍按序上传
+    spoolEnabled = enabled;
+}
+
+void WebSocketClient::resetSpoolStats() {
+    spoolResetRequested = true;
 }
 
-void WebSocketClient::processSendQueue() {
-    DataBlock* block = nullptr;
+bool WebSocketClient::spoolIncomingBlocks() {
+    if (!blockSpool.isReady()) {
+        return false;
+    }
+    if (spoolResetRequested) {
+        spoolResetRequested = false;
+        blockSpool.resetStats();
+        catchupScheduler.resetStats();
+    }
+    
+    // 暂存区非空时继续暂存（补传期间只暂存实时流来不及上传的块）；否则在上游断开，
+    // 或输出缓冲区耗尽且SensorData队列接近丢弃时开始暂存
+    bool spooling = blockSpool.hasPending();
+    if (!spooling && spoolEnabled && collectionActive) {
+        uint8_t slotIndex;
+        spooling = !serverConnected ||
+                   (xQueuePeek(freeSlotQueue, &slotIndex, 0) != pdTRUE &&
+                    sensorData->getStats().queuedBlocks >= Config::SPOOL_BACKLOG_BLOCKS);
+    }
+    if (!spooling) {
+        return false;
+    }
     
-    while (xQueueReceive(sendQueue, &block, 0) == pdTRUE) {
-        if(Config::DEBUG_PPRINT){
-            Serial0.printf("[WebSocketClient] DEBUG: Processing block from queue - block: %p, serverConnected: %d, collectionActive: %d\n", 
-                        block, serverConnected, collectionActive);
+    if (spoolEnabled) {
+        // 暂存环中的块早于SensorData队列中的块
+        while (heldCount > 0) {
+            spoolBlock(heldBlocks[heldHead]);
+            heldHead = (heldHead + 1) % Config::POWER_HOLD_MAX_BLOCKS;
+            heldCount--;
         }
-        if (block && serverConnected && collectionActive) {
-            String dataPacket = createDataPacket(block);
-       
-            bool sendResult = webSocket.sendTXT(dataPacket);
-            if(Config::DEBUG_PPRINT){
-                Serial0.printf("[WebSocketClient] DEBUG: Created data packet, length: %d bytes\n", dataPacket.length());
-                Serial0.printf("[WebSocketClient] DEBUG: sendTXT result: %d\n", sendResult);
+        // 上游在线时只把超出实时流保留数的最旧块转入暂存区，最新的块留给实时流，实时延迟有上界
+        uint32_t keepLive = serverConnected ? Config::CATCHUP_LIVE_QUEUE_BLOCKS : 0;
+        DataBlock* block;
+        while (collectionActive && sensorData->getStats().queuedBlocks > keepLive &&
+               (block = sensorData->getNextBlock()) != nullptr) {
+            spoolBlock(block);
+            if (serverConnected) {
+                catchupScheduler.onLiveDemoted(1);
             }
-            
-            
-            if (sendResult) {
-                stats.totalBlocksSent++;
-                stats.totalBytesSent += dataPacket.length();
-                blocksSentSinceLastStats++;
+        }
+    }
+    
+    // 每轮最多预擦除一个扇区，擦除耗时分散开，整段写入时通常无需再擦除
+    blockSpool.service();
+    return blockSpool.hasPending();
+}
 
-                uint32_t now = millis();
+void WebSocketClient::spoolBlock(DataBlock* block) {
+    size_t length = SensorData::serializeBlock(block, spoolRecordBuffer);
+    if (blockSpool.append(spoolRecordBuffer, length)) {
+        encoderCounters.spooledBlocks++;
+    } else {
+        // 暂存区满时保留已暂存的旧数据，丢弃新块
+        encoderCounters.spoolDroppedBlocks++;
+        sessionManifest.onBlockSkipped(block->blockId, block->sensorFrameCounts);
+        if (Config::DEBUG_PPRINT) {
+            Serial0.printf("[WebSocketClient] DEBUG: Spool full, dropped block %u\n", block->blockId);
+        }
+    }
+    
+    if (!serverConnected && localServer.hasClients() && encodeLocalCopy(block)) {
+        return;  // 块随本地消息转发后归还
+    }
+    sensorData->recycleBlock(block);
+}
 
-                if(now - lastSendPrintTime > 2000){ // 每2秒打印一次
-                    Serial0.printf("[WebSocketClient] Sent block %d, size: %d bytes,sendSinceLastStats: %d,sendQueueSize: %d\n", 
-                                stats.totalBlocksSent, stats.totalBytesSent, blocksSentSinceLastStats++, uxQueueMessagesWaiting(sendQueue));
-                    lastSendPrintTime = now;
-                }
-            } else {
-                stats.sendFailures++;
-                    Serial0.printf("[WebSocketClient] ERROR: Failed to send data block - WebSocket sendTXT returned false\n");
+bool WebSocketClient::encodeLocalCopy(DataBlock* block) {
+    uint8_t slotIndex;
+    if (xQueueReceive(freeSlotQueue, &slotIndex, 0) != pdTRUE) {
+        return false;
+    }
+    
+    EncodeContext context;
+    snapshotEncodeContext(context);
+    
+    EncodedMessage& message = encodeSlots[slotIndex];
+    message.entry.blocks[0] = block;
+    message.entry.blockCount = 1;
+    message.entry.backlog = false;
+    message.entry.resend = false;
+    message.entry.seq = 0;
+    message.entry.sentTime = 0;
+    message.entry.transmissions = 0;
+    message.entry.skipped = false;
+    message.localOnly = true;
+    message.length = createDataPacket(message.entry, context, *encodeDoc, message.buffer, Config::ENCODE_BUFFER_SIZE, 
+                                      message.omittedFrames, message.unsubscribedFrames);
+    
+    xQueueSend(readySlotQueue, &slotIndex, 0);
+    if (networkTaskHandle) {
+        xTaskNotifyGive(networkTaskHandle);
+    }
+    return true;
+}
 
-            }
+void WebSocketClient::releaseLocalOnly(uint8_t slotIndex) {
+    EncodedMessage& message = encodeSlots[slotIndex];
+    for (uint8_t i = 0; i < message.entry.blockCount; i++) {
+        sensorData->recycleBlock(message.entry.blocks[i]);
+    }
+    message.entry.blockCount = 0;
+    message.localOnly = false;
+    xQueueSend(freeSlotQueue, &slotIndex, 0);
+    if (encoderTaskHandle) {
+        xTaskNotifyGive(encoderTaskHandle);
+    }
+}
+
+DataBlock* WebSocketClient::unspoolBlock() {
+    DataBlock* block = sensorData->allocateBlock();
+    if (!block) {
+        return nullptr;
+    }
+    
+    while (blockSpool.hasPending()) {
+        size_t length = blockSpool.readNext(spoolRecordBuffer, sizeof(DataBlock));
+        if (length > 0 && SensorData::deserializeBlock(spoolRecordBuffer, length, block)) {
+            encoderCounters.unspooledBlocks++;
+            return block;
+        }
+    }
+    sensorData->recycleBlock(block);
+    return nullptr;
+}
+
+void WebSocketClient::setPowerSaveEnabled(bool enabled) {
+    if (enabled && !heldBlocks) {
+        Serial0.printf("[WebSocketClient] ERROR: Power save unavailable, hold buffer not allocated\n");
+        return;
+    }
+    powerSaveRequested = enabled;
+}
+
+void WebSocketClient::resetPowerStats() {
+    powerResetRequested = true;
+}
+
+uint32_t WebSocketClient::getLoopIntervalMs() const {
+    return sendPacer.nextWaitMs(powerScheduler.isRadioNeeded() ? Config::NETWORK_LOOP_INTERVAL_MS : Config::POWER_IDLE_LOOP_INTERVAL_MS);
+}
+
+void WebSocketClient::updatePowerSchedule() {
+    uint32_t now = millis();
+    bool phaseChanged = false;
+    
+    if (powerSaveRequested != powerScheduler.isEnabled()) {
+        powerScheduler.setEnabled(powerSaveRequested, now);
+        phaseChanged = true;
+    }
+    if (powerResetRequested) {
+        powerResetRequested = false;
+        powerScheduler.resetStats(now);
+    }
+    
+    if (powerScheduler.isEnabled()) {
+        // 暂存块、已编码消息和未确认消息都已清空才算上传完成（确认到达后再休眠）。
+        // 突发阶段SensorData队列须先于编码任务的drained检查：编码任务先清除drained再取块
+        bool liveQueued = powerScheduler.getPhase() == PowerScheduler::Phase::BURST && sensorData && collectionActive &&
+                          sensorData->getStats().queuedBlocks > 0;
+        bool drained = !liveQueued && !txActive && retransmitWindow.isEmpty() && parkedCount == 0 && controlCount == 0 &&
+                       encoderDrained && (!readySlotQueue || uxQueueMessagesWaiting(readySlotQueue) == 0);
+        if (powerScheduler.update(now, heldCount, drained, uploadCompletePending)) {
+            phaseChanged = true;
+        }
+    }
+    
+    if (!phaseChanged) {
+        return;
+    }
+    
+    PowerScheduler::Phase phase = powerScheduler.getPhase();
+    holdBlocks = powerScheduler.shouldHoldBlocks();
+    if (phase == PowerScheduler::Phase::IDLE) {
+        // 空闲阶段：按DTIM监听间隔休眠，保持关联和TCP连接
+        WiFi.setSleep(WIFI_PS_MAX_MODEM);
+    } else if (phase == PowerScheduler::Phase::BURST) {
+        WiFi.setSleep(WIFI_PS_NONE);
+    } else {
+        WiFi.setSleep(WIFI_PS_MIN_MODEM);  // 恢复Arduino默认
+    }
+    if (Config::DEBUG_PPRINT || phase != PowerScheduler::Phase::BURST) {
+        Serial0.printf("[WebSocketClient] Power phase: %s (held %u blocks, burst %u ms)\n", 
+                     PowerScheduler::getPhaseName(phase), heldCount.load(), powerScheduler.getLastBurstMs());
+    }
+    
+    if (!holdBlocks && encoderTaskHandle) {
+        xTaskNotifyGive(encoderTaskHandle);
+    }
+    // 心跳与集中上传对齐
+    if (powerScheduler.consumeHeartbeatDue()) {
+        sendHeartbeat();
+    }
+}
+
+void WebSocketClient::fanOutWhileUpstreamDown() {
+    uint8_t slotIndex;
+    while (readySlotQueue && xQueuePeek(readySlotQueue, &slotIndex, 0) == pdTRUE) {
+        EncodedMessage& message = encodeSlots[slotIndex];
+        admitParkedEntries();
+        if (!message.localOnly && retransmitWindow.isFull() && parkedCount >= PARKED_ENTRY_COUNT) {
+            // 窗口和暂留区都已满（暂存区关闭时编码任务仍在分配序列号）：消息留在输出缓冲区中，
+            // 编码任务随之因无空闲缓冲区而停止取块，重连后按序上传
+            break;
+        }
+        xQueueReceive(readySlotQueue, &slotIndex, 0);
+        if (message.length > 0 && !message.entry.skipped) {
+            localServer.broadcast(message.buffer, message.length);
+        }
+        if (message.localOnly) {
+            releaseLocalOnly(slotIndex);
+            continue;
+        }
+        stats.rateOmittedFrames += message.omittedFrames;
+        stats.subscriptionOmittedFrames += message.unsubscribedFrames;
+        
+        // 未发送的条目由重连后的重传流程重新编码上传（不会再次转发给本地客户端）
+        if (!retransmitWindow.isFull()) {
+            retransmitWindow.push(message.entry);
         } else {
-            Serial0.printf("[WebSocketClient] WARNING: Block not sent - block: %p, serverConnected: %d, collectionActive: %d\n", 
-                         block, serverConnected, collectionActive);
+            parkedEntries[(parkedHead + parkedCount) % PARKED_ENTRY_COUNT] = message.entry;
+            parkedCount++;
+            stats.parkedMessages++;
+        }
+        
+        xQueueSend(freeSlotQueue, &slotIndex, 0);
+        if (encoderTaskHandle) {
+            xTaskNotifyGive(encoderTaskHandle);
+        }
+    }
+}
+
+bool WebSocketClient::beginRetransmit() {
+    InFlightBlock& entry = retransmitWindow.resendEntry();
+    
+    // 重传在网络任务中按当前上下文重新编码（较少发生，不占用编码任务的输出缓冲区）
+    uint32_t encodeStart = micros();
+    EncodeContext context;
+    snapshotEncodeContext(context);
+    uint32_t omittedFrames = 0;
+    uint32_t unsubscribedFrames = 0;
+    if (!retransmitBuffer) {
+        return false;
+    }
+    size_t length = entry.skipped ? 0 : 
+                    createDataPacket(entry, context, *retransmitDoc, retransmitBuffer, Config::ENCODE_BUFFER_SIZE, omittedFrames, unsubscribedFrames);
+    if (length == 0) {
+        // 重新编码失败（或首次编码已失败）：以跳过标记重传，该序列号仍需服务器确认
+        if (!entry.skipped) {
+            Serial0.printf("[WebSocketClient] ERROR: Failed to re-encode data block seq %u, sending skip marker\n", entry.seq);
+            stats.encodeFailures++;
+            entry.skipped = true;
+        }
+        length = createSkipPacket(entry, context, retransmitBuffer, Config::ENCODE_BUFFER_SIZE);
+    }
+    transmitBusyUs += micros() - encodeStart;
+    
+    rateController.onMessageEncoded(length, entry.blockCount);
+    
+    txSlot = -1;
+    txData = retransmitBuffer;
+    txLength = length;
+    txOffset = 0;
+    txSeq = entry.seq;
+    txActive = true;
+    return true;
+}
+
+bool WebSocketClient::pumpTransmit() {
+    const uint8_t* data = (const uint8_t*)txData;
+    size_t length = txLength;
+    
+    // lwIP仅在发送缓冲区空闲空间不低于TCP_SNDLOWAT（至少2个MSS）时报告可写，
+    // 因此每次可写检测后写入一个MSS大小的分片不会阻塞
+    while (txOffset < length) {
+        if (!webSocket.isWritable()) {
+            stats.sendStalls++;
+            rateController.onSendStall();
+            return false;
+        }
+        
+        size_t chunk = min(SEND_CHUNK_SIZE, length - txOffset);
+        bool first = (txOffset == 0);
+        bool fin = (txOffset + chunk >= length);
+        if (!webSocket.sendFragment(data + txOffset, chunk, first, fin)) {
+            Serial0.printf("[WebSocketClient] ERROR: Failed to send data block seq %u, kept for retransmission\n", txSeq);
+            stats.sendFailures++;
+            abortTransmit();
+            return false;
+        }
+        txOffset += chunk;
+        stats.socketBytesQueued += chunk;
+        rateController.onBytesWritten(chunk);
+    }
+    
+    // 消息已全部写入套接字。重传期间该块可能已被迟到的确认释放，按序列号定位窗口条目
+    stats.totalBytesSent += length;
+    InFlightBlock* written = retransmitWindow.onWritten(txSeq);
+    if (written) {
+        InFlightBlock& entry = *written;
+        if (entry.transmissions > 0) {
+            stats.retransmissions++;
+        } else if (!entry.skipped) {
+            stats.totalBlocksSent += entry.blockCount;
+            blocksSentSinceLastStats += entry.blockCount;
+            if (!entry.backlog) {
+                latency.blockQueue.record(millis() - entry.blocks[0]->createTime);
+            }
+        }
+        if (entry.transmissions < 0xFF) {
+            entry.transmissions++;
+        }
+        entry.sentTime = millis();
+    }
+    
+    if(Config::DEBUG_PPRINT){
+        Serial0.printf("[WebSocketClient] DEBUG: Data packet seq %u written, length: %d bytes\n", txSeq, length);
+    }
+    uint32_t now = millis();
+    if(now - lastSendPrintTime > 2000){ // 每2秒打印一次
+        Serial0.printf("[WebSocketClient] Sent block %d (seq %u), size: %d bytes,sendSinceLastStats: %d,window: %d\n", 
+                    stats.totalBlocksSent, txSeq, stats.totalBytesSent, blocksSentSinceLastStats, retransmitWindow.size());
+        lastSendPrintTime = now;
+    }
+    
+    finishTransmit();
+    return true;
+}
+
+void WebSocketClient::abortTransmit() {
+    if (txActive) {
+        Serial0.printf("[WebSocketClient] Aborted partially sent message seq %u (%d/%d bytes)\n", 
+                     txSeq, txOffset, txLength);
+    }
+    // 消息已在重传窗口中，重连后重新编码发送
+    finishTransmit();
+}
+
+void WebSocketClient::finishTransmit() {
+    if (txSlot >= 0) {
+        uint8_t slotIndex = txSlot;
+        xQueueSend(freeSlotQueue, &slotIndex, 0);
+        if (encoderTaskHandle) {
+            xTaskNotifyGive(encoderTaskHandle);
         }
+    }
+    txSlot = -1;
+    txActive = false;
+    txOffset = 0;
+    txData = nullptr;
+    txLength = 0;
+}
+
+bool WebSocketClient::sendControlMessage(const String& message) {
+    return sendControlMessage(message.c_str(), message.length());
+}
+
+bool WebSocketClient::sendControlMessage(const char* message, size_t length) {
+    stats.controlQueued++;
+    
+    if (length >= CONTROL_SLOT_SIZE) {
+        Serial0.printf("[WebSocketClient] ERROR: Control message too long (%d bytes), dropped\n", length);
+        stats.controlDropped++;
+        return false;
+    }
+    
+    ControlSlot& slot = acquireControlSlot();
+    memcpy(slot.data, message, length);
+    slot.data[length] = '\0';
+    return commitControlSlot(slot, length);
+}
+
+bool WebSocketClient::sendControlMessage(const JsonDocument& doc) {
+    stats.controlQueued++;
+    
+    size_t length = measureJson(doc);
+    if (length >= CONTROL_SLOT_SIZE) {
+        Serial0.printf("[WebSocketClient] ERROR: Control message too long (%d bytes), dropped\n", length);
+        stats.controlDropped++;
+        return false;
+    }
+    
+    ControlSlot& slot = acquireControlSlot();
+    serializeJson(doc, slot.data, CONTROL_SLOT_SIZE);
+    return commitControlSlot(slot, length);
+}
+
+WebSocketClient::ControlSlot& WebSocketClient::acquireControlSlot() {
+    if (controlCount >= CONTROL_LANE_DEPTH) {
+        Serial0.printf("[WebSocketClient] WARNING: Control lane full, dropping oldest message\n");
+        controlHead = (controlHead + 1) % CONTROL_LANE_DEPTH;
+        controlCount--;
+        stats.controlDropped++;
+    }
+    return controlLane[(controlHead + controlCount) % CONTROL_LANE_DEPTH];
+}
+
+bool WebSocketClient::commitControlSlot(ControlSlot& slot, size_t length) {
+    slot.length = length;
+    slot.enqueueTime = millis();
+    controlCount++;
+    if (controlCount > stats.controlLanePeak) {
+        stats.controlLanePeak = controlCount;
+    }
+    
+    // 不在数据消息中间时立即发送，否则等待当前消息写完
+    if (!txActive) {
+        flushControlLane();
+    }
+    return true;
+}
+
+bool WebSocketClient::flushControlLane() {
+    while (controlCount > 0 && !txActive) {
+        ControlSlot& slot = controlLane[controlHead];
         
-        // 无论发送成功与否，都需要释放数据块
-        if (block) {
-            if (bufferPool) {
-                // 使用BufferPool正确释放数据块
-                bufferPool->releaseBlock(block);
-                if(Config::DEBUG_PPRINT){
-                    Serial0.printf("[WebSocketClient] DEBUG: Block released to BufferPool\n");
+        if (!serverConnected) {
+            // 断线期间的控制消息（心跳、旧命令的ACK）在重连后已无意义，直接丢弃
+            stats.controlDropped++;
+        } else {
+            if (!webSocket.isWritable()) {
+                stats.sendStalls++;
+                rateController.onSendStall();
+                return false;
+            }
+            if (webSocket.sendTXT(slot.header, slot.length, true)) {
+                uint32_t latency = millis() - slot.enqueueTime;
+                if (stats.controlSent == 0) {
+                    stats.avgControlLatency = latency;
+                } else {
+                    stats.avgControlLatency = stats.avgControlLatency * 0.875f + latency * 0.125f;
                 }
+                if (latency > stats.maxControlLatency) {
+                    stats.maxControlLatency = latency;
+                }
+                stats.controlSent++;
+                stats.socketBytesQueued += slot.length;
+                rateController.onBytesWritten(slot.length);
             } else {
-                // 如果没有BufferPool，直接释放（不推荐）
-                free(block);
-                Serial0.printf("[WebSocketClient] Warning: Block freed directly\n");
+                Serial0.printf("[WebSocketClient] ERROR: Failed to send control message\n");
+                stats.controlDropped++;
             }
         }
+        
+        controlHead = (controlHead + 1) % CONTROL_LANE_DEPTH;
+        controlCount--;
     }
+    return controlCount == 0;
+}
+
+void WebSocketClient::handleDataAck(uint32_t ackSeq) {
+    uint32_t now = millis();
     
-    // 检查是否需要发送upload_complete消息
-    if (uploadCompletePending && uxQueueMessagesWaiting(sendQueue) == 0) {
-        Serial0.printf("[WebSocketClient] Send queue is empty, sending upload_complete message\n");
-        sendUploadComplete();
+    // 释放窗口头部所有 seq <= ackSeq 且已发送过的块
+    while (retransmitWindow.canRelease(ackSeq)) {
+        InFlightBlock& entry = retransmitWindow.front();
+        
+        uint32_t rtt = now - entry.sentTime;
+        if (stats.ackedBlocks == 0) {
+            stats.avgAckRtt = rtt;
+        } else {
+            stats.avgAckRtt = stats.avgAckRtt * 0.875f + rtt * 0.125f;  // 指数平滑
+        }
+        if (rtt > stats.maxAckRtt) {
+            stats.maxAckRtt = rtt;
+        }
+        stats.lastAckedSeq = entry.seq;
+        latency.blockAck.record(rtt);
+        if (!entry.skipped) {
+            stats.ackedBlocks += entry.blockCount;
+        }
+        
+        for (uint8_t i = 0; i < entry.blockCount; i++) {
+            if (!entry.backlog && !entry.skipped) {
+                latency.blockTotal.record(now - entry.blocks[i]->createTime);
+            }
+        }
+        releaseEntryBlocks(entry, true);
+        retransmitWindow.popFront();
+    }
+}
+
+void WebSocketClient::releaseEntryBlocks(InFlightBlock& entry, bool acked) {
+    if (entry.skipped) {
+        acked = false;  // 跳过标记的确认只说明序列号已收到，块未上传
+    }
+    for (uint8_t i = 0; i < entry.blockCount; i++) {
+        if (entry.resend || entry.skipped) {
+            // 补发的块之前已上传过，跳过的块未上传，归还时都不计入已发送
+            sensorData->recycleBlock(entry.blocks[i]);
+        } else {
+            releaseBlock(entry.blocks[i]);
+        }
+        entry.blocks[i] = nullptr;
+    }
+    if (entry.resend) {
+        resendJob.finishedBlocks += entry.blockCount;
+        if (acked) {
+            resendJob.ackedBlocks += entry.blockCount;
+        }
+    }
+    entry.blockCount = 0;
+}
+
+void WebSocketClient::releaseBlock(DataBlock* block) {
+    if (!block) {
+        return;
+    }
+    if (sensorData) {
+        sensorData->releaseBlock(block);
+    } else {
+        // 如果没有SensorData，直接释放（不推荐）
+        free(block);
+        Serial0.printf("[WebSocketClient] Warning: Block freed directly\n");
     }
-    
-    updateStats();
 }
 
 void WebSocketClient::sendUploadComplete() {
@@ -715,23 +2529,46 @@ void WebSocketClient::sendUploadComplete() {
     }
     if(Config::DEBUG_PPRINT){
         Serial0.printf("[WebSocketClient] DEBUG: sendUploadComplete - sessionId: '%s' (len=%d), deviceCode: '%s' (len=%d)\n", 
-                    sessionId.c_str(), sessionId.length(), deviceCode.c_str(), deviceCode.length());
+                    sessionId, strlen(sessionId), deviceCode, strlen(deviceCode));
     }
-    if (sessionId.length() == 0 || deviceCode.length() == 0) {
+    if (sessionId[0] == '\0' || deviceCode[0] == '\0') {
         Serial0.printf("[WebSocketClient] ERROR:Cannot send upload_complete - missing sessionId or deviceCode\n");
         return;
     }
     
-    StaticJsonDocument<256> doc;
+    StaticJsonDocument<1536> doc;
     doc["type"] = "upload_complete";
     doc["session_id"] = sessionId;
     doc["device_code"] = deviceCode;
     doc["timestamp"] = millis();
     
-    String message;
-    serializeJson(doc, message);
+    // 会话清单：服务器按传感器核对帧数、时间范围和校验和，不一致时再用resend补发
+    SessionManifest::Snapshot snapshot = sessionManifest.snapshot();
+    JsonObject manifest = doc.createNestedObject("manifest");
+    manifest["first_block_id"] = snapshot.firstBlockId;
+    manifest["last_block_id"] = snapshot.lastBlockId;
+    manifest["block_count"] = snapshot.blockCount;
+    manifest["captured_frames"] = snapshot.getCapturedFrames();
+    manifest["uploaded_frames"] = snapshot.getUploadedFrames();
+    manifest["dropped_frames"] = snapshot.getDroppedFrames();
+    manifest["checksum"] = snapshot.getChecksum();
+    JsonArray sensors = manifest.createNestedArray("sensors");
+    for (uint8_t id = 1; id <= SessionManifest::SENSOR_COUNT; id++) {
+        const SessionManifest::SensorEntry& entry = snapshot.getSensor(id);
+        if (entry.capturedFrames == 0 && entry.uploadedFrames == 0) {
+            continue;
+        }
+        JsonObject sensor = sensors.createNestedObject();
+        sensor["sensor_id"] = id;
+        sensor["captured_frames"] = entry.capturedFrames;
+        sensor["uploaded_frames"] = entry.uploadedFrames;
+        sensor["dropped_frames"] = entry.queueDroppedFrames + entry.skippedFrames;
+        sensor["first_ts"] = entry.capturedFrames > 0 ? entry.firstTimestamp : 0;
+        sensor["last_ts"] = entry.lastTimestamp;
+        sensor["checksum"] = entry.checksum;
+    }
     
-    bool sendResult = webSocket.sendTXT(message);
+    bool sendResult = sendControlMessage(doc);
     if (sendResult) {
         Serial0.printf("[WebSocketClient] Upload complete message sent successfully\n");
         uploadCompletePending = false;  // 重置标志
@@ -739,3 +2576,24 @@ void WebSocketClient::sendUploadComplete() {
         Serial0.printf("[WebSocketClient] ERROR: Failed to send upload_complete message\n");
     }
 }
+
+bool GatewayWebSocket::sendFragment(const uint8_t* payload, size_t length, bool first, bool fin) {
+    return sendFrame(&_client, first ? WSop_text : WSop_continuation, (uint8_t*)payload, length, fin, false);
+}
+
+bool GatewayWebSocket::isWritable() {
+    if (!_client.tcp) {
+        return false;
+    }
+    
+    int fd = _client.tcp->fd();
+    if (fd < 0) {
+        return false;
+    }
+    
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval timeout = {0, 0};
+    return select(fd + 1, nullptr, &writeSet, nullptr, &timeout) > 0;
+}
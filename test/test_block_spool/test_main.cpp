@@ -0,0 +1,317 @@
+// 闪存暂存区：用文件模拟分区（FileStorage，写入与NOR闪存一样只能把1变为0），
+// 验证按写入顺序读出（含仍在RAM缓冲区中的记录）、多圈环形写入、暂存区满时保留旧数据、上次运行的残留记录和损坏记录被跳过；
+// 按闪存典型耗时（页编程、扇区擦除、读取）估算60秒断线的暂存写入吞吐和恢复后的读出速率
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "BlockSpool.h"
+
+static const char* SPOOL_PATH = "/tmp/test_block_spool.bin";
+static const size_t BUFFER_SIZE = 16384;            // Config::SPOOL_WRITE_BUFFER_SIZE
+static const size_t RECORD_SIZE = 1700;             // 一个DataBlock约1.7KB
+
+// 闪存典型耗时（W25Q/GD25Q系列数据手册）
+static const uint32_t PAGE_PROGRAM_US = 400;        // 每256字节页
+static const uint32_t SECTOR_ERASE_US = 45000;      // 每4KB扇区
+static const uint32_t READ_BYTES_PER_US = 20;       // 80MHz QIO
+
+// 转发到FileStorage，统计写入对齐情况并按典型耗时累计闪存忙碌时间
+class TimedStorage : public FlashStorage {
+public:
+    FileStorage file;
+    uint64_t busyUs;
+    uint32_t writes;
+    uint32_t unalignedWrites;
+    uint32_t erases;
+    uint64_t bytesWritten;
+
+    TimedStorage() { reset(); }
+    void reset() {
+        busyUs = 0;
+        writes = 0;
+        unalignedWrites = 0;
+        erases = 0;
+        bytesWritten = 0;
+    }
+
+    size_t size() const override { return file.size(); }
+    bool read(size_t offset, void* data, size_t length) override {
+        busyUs += length / READ_BYTES_PER_US + 1;
+        return file.read(offset, data, length);
+    }
+    bool write(size_t offset, const void* data, size_t length) override {
+        writes++;
+        if (offset % PAGE_SIZE != 0 || length % PAGE_SIZE != 0) {
+            unalignedWrites++;
+        }
+        bytesWritten += length;
+        busyUs += (uint64_t)(length + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_PROGRAM_US;
+        return file.write(offset, data, length);
+    }
+    bool eraseSector(size_t offset) override {
+        erases++;
+        busyUs += SECTOR_ERASE_US;
+        return file.eraseSector(offset);
+    }
+};
+
+static TimedStorage storage;
+static uint8_t writeBuffer[BUFFER_SIZE];
+static BlockSpool spool;
+
+// 记录内容由序号决定，长度在RECORD_SIZE附近变化
+static size_t makeRecord(uint32_t index, uint8_t* data) {
+    size_t length = RECORD_SIZE - 200 + (index * 37) % 400;
+    for (size_t i = 0; i < length; i++) {
+        data[i] = (uint8_t)(index * 7 + i * 13);
+    }
+    memcpy(data, &index, sizeof(index));
+    return length;
+}
+
+static bool checkRecord(uint32_t index, const uint8_t* data, size_t length) {
+    uint8_t expected[RECORD_SIZE + 200];
+    size_t expectedLength = makeRecord(index, expected);
+    return length == expectedLength && memcmp(data, expected, length) == 0;
+}
+
+static void openSpool(size_t regionSize, uint32_t epoch) {
+    remove(SPOOL_PATH);
+    TEST_ASSERT_TRUE(storage.file.open(SPOOL_PATH, regionSize));
+    storage.reset();
+    TEST_ASSERT_TRUE(spool.begin(&storage, writeBuffer, BUFFER_SIZE, epoch));
+}
+
+void setUp(void) {
+    spool = BlockSpool();
+}
+
+void tearDown(void) {
+    storage.file.close();
+    remove(SPOOL_PATH);
+}
+
+void test_begin_rejects_bad_parameters(void) {
+    remove(SPOOL_PATH);
+    TEST_ASSERT_TRUE(storage.file.open(SPOOL_PATH, 64 * 1024));
+    TEST_ASSERT_FALSE(spool.begin(nullptr, writeBuffer, BUFFER_SIZE, 1));
+    TEST_ASSERT_FALSE(spool.begin(&storage, writeBuffer, BUFFER_SIZE - 1, 1));
+    TEST_ASSERT_FALSE(spool.begin(&storage, writeBuffer, 64 * 1024, 1));
+    TEST_ASSERT_FALSE(spool.isReady());
+    TEST_ASSERT_FALSE(spool.append("x", 1));
+    TEST_ASSERT_TRUE(spool.begin(&storage, writeBuffer, BUFFER_SIZE, 1));
+    TEST_ASSERT_EQUAL_UINT32(BUFFER_SIZE - 16, spool.getMaxRecordLength());
+}
+
+void test_records_read_back_in_order(void) {
+    openSpool(256 * 1024, 1);
+    uint8_t data[RECORD_SIZE + 200];
+    // 前几十条已写入闪存，最后几条仍在RAM缓冲区中
+    for (uint32_t i = 0; i < 40; i++) {
+        size_t length = makeRecord(i, data);
+        TEST_ASSERT_TRUE(spool.append(data, length));
+    }
+    TEST_ASSERT_EQUAL_UINT32(40, spool.getPendingRecords());
+    TEST_ASSERT_GREATER_THAN(0, spool.getStats().flushes);
+
+    for (uint32_t i = 0; i < 40; i++) {
+        size_t length = spool.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(i, data, length));
+    }
+    TEST_ASSERT_FALSE(spool.hasPending());
+    TEST_ASSERT_EQUAL_UINT32(0, spool.readNext(data, sizeof(data)));
+
+    BlockSpool::Stats stats = spool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(40, stats.recordsRead);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.corruptRecords);
+    TEST_ASSERT_EQUAL_UINT32(0, storage.unalignedWrites);
+}
+
+void test_ring_wraps_many_times_without_loss(void) {
+    // 64KB区域，写入和读出交替进行约20圈；写入方空闲时service()预擦除
+    openSpool(64 * 1024, 7);
+    uint8_t data[RECORD_SIZE + 200];
+    uint32_t written = 0;
+    uint32_t read = 0;
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < 5; i++) {
+            size_t length = makeRecord(written, data);
+            TEST_ASSERT_TRUE(spool.append(data, length));
+            written++;
+            spool.service();
+        }
+        for (int i = 0; i < 5; i++) {
+            size_t length = spool.readNext(data, sizeof(data));
+            TEST_ASSERT_TRUE(checkRecord(read, data, length));
+            read++;
+        }
+    }
+    BlockSpool::Stats stats = spool.getStats();
+    TEST_ASSERT_GREATER_THAN(64 * 1024 * 10, (uint32_t)storage.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.corruptRecords);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.inlineErases);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.writeErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, storage.unalignedWrites);
+}
+
+void test_full_spool_rejects_new_records_and_keeps_old(void) {
+    openSpool(64 * 1024, 3);
+    uint8_t data[RECORD_SIZE + 200];
+    uint32_t accepted = 0;
+    while (true) {
+        size_t length = makeRecord(accepted, data);
+        if (!spool.append(data, length)) {
+            break;
+        }
+        accepted++;
+        TEST_ASSERT_LESS_THAN(100, accepted);
+    }
+    BlockSpool::Stats stats = spool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.recordsRejected);
+    TEST_ASSERT_GREATER_THAN(64 * 1024 * 3 / 4, stats.usedBytes);
+    TEST_ASSERT_LESS_OR_EQUAL(64 * 1024, stats.usedBytes);
+
+    // 读出一部分后腾出扇区，又能继续写入
+    for (uint32_t i = 0; i < 10; i++) {
+        size_t length = spool.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(i, data, length));
+    }
+    size_t length = makeRecord(accepted, data);
+    TEST_ASSERT_TRUE(spool.append(data, length));
+    for (uint32_t i = 10; i <= accepted; i++) {
+        length = spool.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(i, data, length));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, spool.getStats().corruptRecords);
+}
+
+void test_records_from_previous_run_are_ignored(void) {
+    openSpool(64 * 1024, 100);
+    uint8_t data[RECORD_SIZE + 200];
+    for (uint32_t i = 0; i < 20; i++) {
+        size_t length = makeRecord(i, data);
+        spool.append(data, length);
+    }
+    spool.flush();
+
+    // 重启：位置只在RAM中，闪存中上次运行的记录按epoch区分，不会被读出
+    BlockSpool restarted;
+    TEST_ASSERT_TRUE(restarted.begin(&storage, writeBuffer, BUFFER_SIZE, 101));
+    TEST_ASSERT_FALSE(restarted.hasPending());
+    TEST_ASSERT_EQUAL_UINT32(0, restarted.readNext(data, sizeof(data)));
+    for (uint32_t i = 1000; i < 1003; i++) {
+        size_t length = makeRecord(i, data);
+        TEST_ASSERT_TRUE(restarted.append(data, length));
+    }
+    restarted.flush();
+    for (uint32_t i = 1000; i < 1003; i++) {
+        size_t length = restarted.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(i, data, length));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, restarted.getStats().corruptRecords);
+
+    // clear()丢弃待读出的记录
+    for (uint32_t i = 0; i < 5; i++) {
+        size_t length = makeRecord(i, data);
+        restarted.append(data, length);
+    }
+    restarted.clear();
+    TEST_ASSERT_FALSE(restarted.hasPending());
+    TEST_ASSERT_EQUAL_UINT32(0, restarted.readNext(data, sizeof(data)));
+}
+
+void test_corrupt_record_is_skipped(void) {
+    openSpool(64 * 1024, 9);
+    uint8_t data[RECORD_SIZE + 200];
+    for (uint32_t i = 0; i < 6; i++) {
+        size_t length = makeRecord(i, data);
+        spool.append(data, length);
+    }
+    spool.flush();
+
+    // 第2条记录的载荷中清除一位（NOR写入只能把1变为0）
+    uint8_t header[16];
+    size_t second = 0;
+    storage.file.read(0, header, sizeof(header));
+    uint16_t firstLength;
+    memcpy(&firstLength, header + 2, sizeof(firstLength));
+    second = (sizeof(header) + firstLength + 3) & ~(size_t)3;
+    uint8_t byte;
+    storage.file.read(second + sizeof(header) + 100, &byte, 1);
+    byte = byte ? (uint8_t)(byte & (byte - 1)) : 0;
+    storage.file.write(second + sizeof(header) + 100, &byte, 1);
+
+    size_t length = spool.readNext(data, sizeof(data));
+    TEST_ASSERT_TRUE(checkRecord(0, data, length));
+    length = spool.readNext(data, sizeof(data));
+    TEST_ASSERT_TRUE(checkRecord(2, data, length));
+    TEST_ASSERT_EQUAL_UINT32(1, spool.getStats().corruptRecords);
+    for (uint32_t i = 3; i < 6; i++) {
+        length = spool.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(i, data, length));
+    }
+    TEST_ASSERT_FALSE(spool.hasPending());
+}
+
+void test_outage_spool_throughput_and_drain_rate(void) {
+    // 60秒断线：4个传感器x100Hz，每块30帧，约13块/秒写入暂存区；写入方每封装一块调用一次service()
+    const size_t regionSize = 0x300000;          // Config::SPOOL_REGION_SIZE
+    const uint32_t blocksPerSecond = 13;
+    const uint32_t outageSeconds = 60;
+    openSpool(regionSize, 42);
+    uint8_t data[RECORD_SIZE + 200];
+    uint32_t blocks = blocksPerSecond * outageSeconds;
+    uint64_t payloadBytes = 0;
+    for (uint32_t i = 0; i < blocks; i++) {
+        size_t length = makeRecord(i, data);
+        TEST_ASSERT_TRUE(spool.append(data, length));
+        payloadBytes += length;
+        spool.service();
+    }
+    spool.flush();
+    BlockSpool::Stats stats = spool.getStats();
+    uint64_t writeUs = storage.busyUs;
+    uint32_t writes = storage.writes;
+
+    storage.reset();
+    uint32_t drained = 0;
+    while (spool.hasPending()) {
+        size_t length = spool.readNext(data, sizeof(data));
+        TEST_ASSERT_TRUE(checkRecord(drained, data, length));
+        drained++;
+    }
+    uint64_t readUs = storage.busyUs;
+
+    double fill = (double)stats.usedBytes / stats.capacityBytes;
+    double writeKBps = payloadBytes / 1024.0 / (writeUs / 1e6);
+    double drainBlocksPerSecond = drained / (readUs / 1e6);
+    double flashBusy = writeUs / 1e6 / outageSeconds;
+    char message[220];
+    snprintf(message, sizeof(message),
+             "%u blocks (%.0f KB) in %u writes: fill %.1f%%, write %.0f KB/s (flash busy %.1f%% of outage), drain %.0f blocks/s",
+             blocks, payloadBytes / 1024.0, writes, fill * 100.0, writeKBps, flashBusy * 100.0, drainBlocksPerSecond);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(blocks, drained);
+    TEST_ASSERT_EQUAL_UINT32(0, spool.getStats().corruptRecords);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.inlineErases);
+    // 整段顺序写入：每次写入都是页对齐的整缓冲区（最后一次除外）
+    TEST_ASSERT_EQUAL_UINT32(0, storage.unalignedWrites);
+    TEST_ASSERT_LESS_OR_EQUAL(payloadBytes / (BUFFER_SIZE - RECORD_SIZE - 200) + 2, writes);
+    // 写入吞吐（扇区擦除占大部分时间）是数据产生速率（约22KB/s）的数倍，读出速率远高于上传速率
+    TEST_ASSERT_GREATER_THAN(3 * blocksPerSecond * RECORD_SIZE / 1024, (uint32_t)writeKBps);
+    TEST_ASSERT_LESS_THAN(50, (uint32_t)(flashBusy * 100));
+    TEST_ASSERT_GREATER_THAN(1000, (uint32_t)drainBlocksPerSecond);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_rejects_bad_parameters);
+    RUN_TEST(test_records_read_back_in_order);
+    RUN_TEST(test_ring_wraps_many_times_without_loss);
+    RUN_TEST(test_full_spool_rejects_new_records_and_keeps_old);
+    RUN_TEST(test_records_from_previous_run_are_ignored);
+    RUN_TEST(test_corrupt_record_is_skipped);
+    RUN_TEST(test_outage_spool_throughput_and_drain_rate);
+    return UNITY_END();
+}
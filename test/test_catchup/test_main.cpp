@@ -0,0 +1,244 @@
+// 断线补传：按毫秒模拟采集、闪存暂存区（BlockSpool + FileStorage）和逐条发送的上行链路，
+// 60秒断线期间块全部暂存，重连后补传调度（CatchupScheduler）在实时流和补传流之间按字节份额交替取块。
+// 检查积压全部补传（每块恰好上传一次、无丢弃）、补传耗时，以及补传期间实时流延迟有上界
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "BlockSpool.h"
+#include "CatchupScheduler.h"
+
+static const char* SPOOL_PATH = "/tmp/test_catchup_spool.bin";
+static const size_t SPOOL_SIZE = 0x300000;          // Config::SPOOL_REGION_SIZE
+static const size_t SPOOL_BUFFER_SIZE = 16384;      // Config::SPOOL_WRITE_BUFFER_SIZE
+static const uint32_t LIVE_QUEUE_DEPTH = 10;        // Config::BLOCK_QUEUE_DEPTH
+static const uint32_t KEEP_LIVE_BLOCKS = 2;         // Config::CATCHUP_LIVE_QUEUE_BLOCKS
+static const uint32_t BLOCK_INTERVAL_MS = 75;       // 4个传感器x100Hz，每块30帧
+static const uint32_t RECORD_SIZE = 1700;           // 暂存的块记录
+static const uint32_t MESSAGE_BYTES = 1900;         // 一块编码后的数据消息
+static const uint32_t OUTAGE_START_MS = 10000;
+static const uint32_t OUTAGE_MS = 60000;
+static const uint32_t MAX_BLOCKS = 8192;
+
+struct QueuedBlock {
+    uint32_t id;
+    uint32_t sealTime;
+};
+
+struct Result {
+    uint32_t produced;
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t dropped;               // 实时队列满或暂存区满而丢弃
+    uint32_t spooled;
+    uint32_t backlogMessages;
+    uint32_t liveMessages;
+    uint32_t maxLiveLatencyMs;      // 补传期间实时流：块封装到写完
+    uint32_t p99LiveLatencyMs;
+    uint32_t catchupMs;
+    uint32_t catchups;
+    uint32_t demoted;
+    float share;
+    float measuredShare;
+    bool backlogInOrder;
+};
+
+static FileStorage storage;
+static uint8_t spoolBuffer[SPOOL_BUFFER_SIZE];
+static bool delivered[MAX_BLOCKS];
+static uint32_t latencyCounts[2001];
+
+static Result runOutage(uint32_t capacityBytesPerSecond, uint32_t durationMs) {
+    remove(SPOOL_PATH);
+    TEST_ASSERT_TRUE(storage.open(SPOOL_PATH, SPOOL_SIZE));
+    BlockSpool spool;
+    TEST_ASSERT_TRUE(spool.begin(&storage, spoolBuffer, SPOOL_BUFFER_SIZE, 1));
+    CatchupScheduler scheduler;
+    scheduler.configure(0.5f, 0.85f, 1.5f);     // Config::CATCHUP_BACKLOG_SHARE等
+
+    Result result;
+    memset(&result, 0, sizeof(result));
+    result.backlogInOrder = true;
+    memset(delivered, 0, sizeof(delivered));
+    memset(latencyCounts, 0, sizeof(latencyCounts));
+
+    QueuedBlock live[LIVE_QUEUE_DEPTH];
+    uint32_t liveHead = 0;
+    uint32_t liveCount = 0;
+    uint32_t nextSeal = 0;
+    uint32_t linkFreeAt = 0;
+    uint32_t lastBacklogId = 0;
+    bool anyBacklog = false;
+    uint32_t liveSamples = 0;
+    uint8_t record[RECORD_SIZE];
+    memset(record, 0xA5, sizeof(record));
+
+    for (uint32_t now = 0; now < durationMs; now++) {
+        bool connected = now < OUTAGE_START_MS || now >= OUTAGE_START_MS + OUTAGE_MS;
+
+        // 采集：实时队列满时丢弃最旧的块（SensorData的行为）
+        if (now >= nextSeal && result.produced < MAX_BLOCKS) {
+            if (liveCount == LIVE_QUEUE_DEPTH) {
+                liveHead = (liveHead + 1) % LIVE_QUEUE_DEPTH;
+                liveCount--;
+                result.dropped++;
+            }
+            live[(liveHead + liveCount) % LIVE_QUEUE_DEPTH] = {result.produced++, now};
+            liveCount++;
+            nextSeal += BLOCK_INTERVAL_MS;
+        }
+
+        // 断开时全部暂存；补传期间只保留最新的几块给实时流，更旧的转入暂存区
+        if (!connected || spool.hasPending()) {
+            uint32_t keepLive = connected ? KEEP_LIVE_BLOCKS : 0;
+            while (liveCount > keepLive) {
+                QueuedBlock block = live[liveHead];
+                liveHead = (liveHead + 1) % LIVE_QUEUE_DEPTH;
+                liveCount--;
+                memcpy(record, &block, sizeof(block));
+                if (spool.append(record, sizeof(record))) {
+                    result.spooled++;
+                } else {
+                    result.dropped++;
+                }
+                if (connected) {
+                    scheduler.onLiveDemoted(1);
+                }
+            }
+            spool.service();
+        }
+
+        // 编码并发送：上一条消息写完后才取下一块
+        if (!connected || now < linkFreeAt) {
+            continue;
+        }
+        scheduler.update(now, (float)capacityBytesPerSecond, spool.hasPending());
+        CatchupScheduler::Stream stream = scheduler.select(liveCount > 0, spool.hasPending());
+        QueuedBlock block;
+        bool taken = false;
+        for (int attempt = 0; attempt < 2 && !taken; attempt++) {
+            if (stream == CatchupScheduler::Stream::BACKLOG) {
+                if (spool.readNext(record, sizeof(record)) == sizeof(record)) {
+                    memcpy(&block, record, sizeof(block));
+                    taken = true;
+                    break;
+                }
+            } else if (liveCount > 0) {
+                block = live[liveHead];
+                liveHead = (liveHead + 1) % LIVE_QUEUE_DEPTH;
+                liveCount--;
+                taken = true;
+                break;
+            }
+            stream = stream == CatchupScheduler::Stream::LIVE ? CatchupScheduler::Stream::BACKLOG : CatchupScheduler::Stream::LIVE;
+        }
+        if (!taken) {
+            continue;
+        }
+
+        linkFreeAt = now + (MESSAGE_BYTES * 1000 + capacityBytesPerSecond - 1) / capacityBytesPerSecond;
+        scheduler.onMessage(stream, MESSAGE_BYTES, 1);
+        if (delivered[block.id]) {
+            result.duplicates++;
+        }
+        delivered[block.id] = true;
+        result.delivered++;
+
+        if (stream == CatchupScheduler::Stream::BACKLOG) {
+            result.backlogMessages++;
+            // 补传流按暂存顺序（最旧的先上传）
+            if (anyBacklog && block.id <= lastBacklogId) {
+                result.backlogInOrder = false;
+            }
+            lastBacklogId = block.id;
+            anyBacklog = true;
+        } else {
+            result.liveMessages++;
+            if (scheduler.isCatchingUp()) {
+                uint32_t latency = linkFreeAt - block.sealTime;
+                if (latency > result.maxLiveLatencyMs) {
+                    result.maxLiveLatencyMs = latency;
+                }
+                latencyCounts[latency < 2000 ? latency : 2000]++;
+                liveSamples++;
+            }
+        }
+        if (scheduler.isCatchingUp()) {
+            result.share = scheduler.getBacklogShare();
+            result.measuredShare = scheduler.getMeasuredShare();
+        }
+    }
+
+    uint32_t target = liveSamples - liveSamples / 100;
+    uint32_t seen = 0;
+    for (uint32_t ms = 0; ms <= 2000; ms++) {
+        seen += latencyCounts[ms];
+        if (seen >= target && liveSamples > 0) {
+            result.p99LiveLatencyMs = ms;
+            break;
+        }
+    }
+    // 模拟结束时仍在实时队列中的块不计入未上传
+    result.produced -= liveCount;
+    const CatchupScheduler::Stats& stats = scheduler.getStats();
+    result.catchups = stats.catchups;
+    result.catchupMs = stats.lastCatchupMs;
+    result.demoted = stats.demotedBlocks;
+    storage.close();
+    remove(SPOOL_PATH);
+    return result;
+}
+
+static void report(const char* name, const Result& result) {
+    char message[260];
+    snprintf(message, sizeof(message),
+             "%s: %u/%u blocks delivered, %u spooled, catch-up %.1f s (share %.2f, measured %.2f), "
+             "live latency p99 %u ms max %u ms, %u demoted",
+             name, result.delivered, result.produced, result.spooled, result.catchupMs / 1000.0,
+             result.share, result.measuredShare, result.p99LiveLatencyMs, result.maxLiveLatencyMs, result.demoted);
+    TEST_MESSAGE(message);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_outage_recovered_with_headroom(void) {
+    // 实时数据约25KB/s，链路100KB/s：补传份额提高到约0.6，约20秒内补完60秒的积压
+    Result result = runOutage(100000, 150000);
+    report("100 KB/s link", result);
+    TEST_ASSERT_EQUAL_UINT32(result.produced, result.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, result.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, result.dropped);
+    TEST_ASSERT_GREATER_OR_EQUAL(OUTAGE_MS / BLOCK_INTERVAL_MS, result.spooled);
+    TEST_ASSERT_TRUE(result.backlogInOrder);
+    TEST_ASSERT_EQUAL_UINT32(1, result.catchups);
+    TEST_ASSERT_LESS_THAN(OUTAGE_MS / 2, result.catchupMs);
+    // 份额 = 1 - 实时数据量 x 1.5 / 容量；实时流块不够时补传流用掉余下的带宽，实际占比更高
+    float liveRate = MESSAGE_BYTES * 1000.0f / BLOCK_INTERVAL_MS;
+    TEST_ASSERT_FLOAT_WITHIN(0.03f, 1.0f - liveRate * 1.5f / 100000, result.share);
+    TEST_ASSERT_GREATER_OR_EQUAL((uint32_t)(result.share * 100), (uint32_t)(result.measuredShare * 100));
+    // 实时流：保留的最新块加上一条补传消息的写入时间
+    TEST_ASSERT_LESS_THAN(300, result.maxLiveLatencyMs);
+}
+
+void test_outage_recovered_on_tight_link_with_bounded_live_latency(void) {
+    // 链路只有实时数据量的1.5倍：补传份额保持基础值，实时流来不及上传的块转入暂存区，
+    // 实时延迟仍有上界，积压按剩余带宽逐渐补完
+    Result result = runOutage(38000, 400000);
+    report("38 KB/s link", result);
+    TEST_ASSERT_EQUAL_UINT32(result.produced, result.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, result.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, result.dropped);
+    TEST_ASSERT_TRUE(result.backlogInOrder);
+    TEST_ASSERT_EQUAL_UINT32(1, result.catchups);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f, result.share);
+    TEST_ASSERT_GREATER_THAN(0, result.demoted);
+    TEST_ASSERT_LESS_THAN(400, result.maxLiveLatencyMs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_outage_recovered_with_headroom);
+    RUN_TEST(test_outage_recovered_on_tight_link_with_bounded_live_latency);
+    return UNITY_END();
+}
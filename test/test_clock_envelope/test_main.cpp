@@ -0,0 +1,205 @@
+// 下包络：合成的到达延迟（5ms下限、平均3ms的指数排队延迟、按1.25ms连接间隔对齐，可选重传尖峰和提前的异常样本），
+// 比较校准窗口的下包络拟合与最小二乘拟合相对最小延迟直线的偏移误差，
+// 以及跟踪器按下包络窗口修正与逐个时间对修正的误差和时间戳单调性
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include "ClockFit.h"
+#include "ClockTracker.h"
+
+static const double FLOOR_MS = 5.0;
+static const double QUEUE_MEAN_MS = 3.0;
+static const double CONNECTION_INTERVAL_MS = 1.25;
+static const double SPIKE_MS = 30.0;
+static const double ESP_START_MS = 200000.0;
+
+static const uint16_t WINDOW_SAMPLES = 50;              // TimeSync::SLIDING_WINDOW_SIZE
+static const uint32_t WINDOW_STEP_MS = 200;
+static const uint8_t BUCKETS = 10;                      // Config::TIME_SYNC_ENVELOPE_BUCKETS
+static const double OUTLIER_MS = 5.0;                   // Config::TIME_SYNC_OUTLIER_MS
+static const double MAX_SKEW_PPM = 500.0;               // Config::TIME_SYNC_MAX_SKEW_PPM
+static const uint32_t TRIALS = 1000;
+
+static uint32_t randomState;
+
+static double nextUniform() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return ((randomState >> 8) + 0.5) / (double)(1u << 24);
+}
+
+struct LatencyModel {
+    double spikeRate;           // 重传尖峰的比例
+    double glitchRate;          // 比最小延迟提前的异常样本比例
+};
+
+// 真实ESP32时间espTrue发出的时间对的到达时间：排队后在下一个连接事件到达
+static double arrival(double espTrue, const LatencyModel& model) {
+    double ready = espTrue + FLOOR_MS - QUEUE_MEAN_MS * log(nextUniform());
+    if (nextUniform() < model.spikeRate) {
+        ready += SPIKE_MS;
+    }
+    double arrived = ceil(ready / CONNECTION_INTERVAL_MS) * CONNECTION_INTERVAL_MS;
+    if (nextUniform() < model.glitchRate) {
+        arrived = espTrue + FLOOR_MS - 20.0;
+    }
+    return arrived;
+}
+
+struct FitComparison {
+    double envelopeRms;
+    double envelopeMax;
+    double leastSquaresRms;
+    uint32_t rejected;
+};
+
+// 每次试验：随机的时钟偏差和传感器时间原点，比较窗口中点处相对最小延迟直线的偏移
+static FitComparison compareFits(const LatencyModel& model) {
+    FitComparison comparison = {};
+    double envelopeSquares = 0.0;
+    double leastSquares = 0.0;
+    ClockFit::Sample samples[WINDOW_SAMPLES];
+    for (uint32_t trial = 0; trial < TRIALS; trial++) {
+        double skewPpm = (nextUniform() - 0.5) * 100.0;
+        uint32_t sensorOrigin = (uint32_t)(nextUniform() * 4e9);
+        for (uint16_t i = 0; i < WINDOW_SAMPLES; i++) {
+            double elapsed = (double)i * WINDOW_STEP_MS;
+            samples[i].sensorTimeMs = sensorOrigin + i * WINDOW_STEP_MS;
+            double espTrue = ESP_START_MS + elapsed * (1.0 + skewPpm * 1e-6);
+            samples[i].espTimeUs = (int64_t)llround(arrival(espTrue, model) * 1000.0);
+        }
+        uint32_t middleOffset = WINDOW_SAMPLES / 2 * WINDOW_STEP_MS;
+        double middleSensor = (double)sensorOrigin + middleOffset;
+        double floorLine = ESP_START_MS + middleOffset * (1.0 + skewPpm * 1e-6) + FLOOR_MS;
+
+        ClockFit::Result envelope;
+        ClockFit::Result fit;
+        TEST_ASSERT_TRUE(ClockFit::fitLowerEnvelope(samples, WINDOW_SAMPLES, BUCKETS, OUTLIER_MS, MAX_SKEW_PPM, envelope));
+        TEST_ASSERT_TRUE(ClockFit::fitLeastSquares(samples, WINDOW_SAMPLES, fit));
+        double envelopeError = envelope.slope * middleSensor + envelope.intercept - floorLine;
+        double fitError = fit.slope * middleSensor + fit.intercept - floorLine;
+        envelopeSquares += envelopeError * envelopeError;
+        leastSquares += fitError * fitError;
+        if (fabs(envelopeError) > comparison.envelopeMax) {
+            comparison.envelopeMax = fabs(envelopeError);
+        }
+        comparison.rejected += envelope.rejected;
+    }
+    comparison.envelopeRms = sqrt(envelopeSquares / TRIALS);
+    comparison.leastSquaresRms = sqrt(leastSquares / TRIALS);
+    return comparison;
+}
+
+static void reportFits(const char* name, const FitComparison& comparison) {
+    char message[160];
+    snprintf(message, sizeof(message), "%s: envelope offset error %.2f ms rms (max %.2f ms, %u minima rejected), least squares %.2f ms rms",
+             name, comparison.envelopeRms, comparison.envelopeMax, comparison.rejected, comparison.leastSquaresRms);
+    TEST_MESSAGE(message);
+}
+
+void setUp(void) {
+    randomState = 99;
+}
+
+void tearDown(void) {}
+
+void test_envelope_fit_without_spikes(void) {
+    LatencyModel model = {0.0, 0.0};
+    FitComparison comparison = compareFits(model);
+    reportFits("queueing only", comparison);
+    // 最小二乘偏晚平均延迟（约3ms加连接间隔对齐），下包络只偏晚桶最小值的延迟
+    TEST_ASSERT_TRUE(comparison.envelopeRms < comparison.leastSquaresRms / 2);
+    TEST_ASSERT_TRUE(comparison.envelopeRms < 2.5);
+}
+
+void test_envelope_fit_with_retransmission_spikes(void) {
+    LatencyModel model = {0.05, 0.0};
+    FitComparison comparison = compareFits(model);
+    reportFits("5% spikes", comparison);
+    TEST_ASSERT_TRUE(comparison.envelopeRms < comparison.leastSquaresRms / 2);
+    TEST_ASSERT_TRUE(comparison.envelopeRms < 2.5);
+}
+
+void test_early_glitch_is_rejected(void) {
+    // 提前20ms的异常样本成为所在桶的最小值，残差超过阈值后被剔除
+    LatencyModel model = {0.0, 0.01};
+    FitComparison comparison = compareFits(model);
+    reportFits("1% early glitches", comparison);
+    TEST_ASSERT_GREATER_THAN(TRIALS / 4, comparison.rejected);
+    TEST_ASSERT_TRUE(comparison.envelopeRms < 3.0);
+    TEST_ASSERT_TRUE(comparison.envelopeMax < 10.0);
+}
+
+void test_envelope_needs_two_buckets(void) {
+    ClockFit::Sample samples[3] = {{1000, 1000000}, {1000, 1002000}, {1000, 1001000}};
+    ClockFit::Result result;
+    // 传感器时间没有跨度
+    TEST_ASSERT_FALSE(ClockFit::fitLowerEnvelope(samples, 3, BUCKETS, OUTLIER_MS, MAX_SKEW_PPM, result));
+    TEST_ASSERT_FALSE(ClockFit::fitLowerEnvelope(samples, 1, BUCKETS, OUTLIER_MS, MAX_SKEW_PPM, result));
+    // 两个样本各占一个桶
+    samples[1].sensorTimeMs = 2000;
+    TEST_ASSERT_TRUE(ClockFit::fitLowerEnvelope(samples, 2, BUCKETS, OUTLIER_MS, MAX_SKEW_PPM, result));
+    TEST_ASSERT_EQUAL_UINT16(2, result.count);
+}
+
+struct TrackResult {
+    double rms;
+    double max;
+    bool monotonic;
+};
+
+// 30分钟100Hz跟踪（20ppm偏差，3%尖峰），误差相对最小延迟直线
+static TrackResult track(float envelopeWindowMs) {
+    ClockTracker tracker;
+    tracker.configure(10000.0f, 2000.0f, 500.0f, 200.0f, envelopeWindowMs);
+    const double skew = 20e-6;
+    tracker.start(1.0 + skew, ESP_START_MS + FLOOR_MS);
+    LatencyModel model = {0.03, 0.0};
+
+    TrackResult result = {0.0, 0.0, true};
+    double sumSquares = 0.0;
+    uint32_t samples = 0;
+    double previous = 0.0;
+    for (uint32_t sensorTime = 0; sensorTime <= 1800000; sensorTime += 10) {
+        double espTrue = ESP_START_MS + sensorTime * (1.0 + skew);
+        tracker.update(sensorTime, (int64_t)llround(arrival(espTrue, model) * 1000.0));
+        double estimate = tracker.estimate(sensorTime);
+        if (sensorTime > 0 && estimate < previous) {
+            result.monotonic = false;
+        }
+        previous = estimate;
+        if (sensorTime < 120000) {
+            continue;
+        }
+        double error = estimate - (espTrue + FLOOR_MS);
+        sumSquares += error * error;
+        samples++;
+        if (fabs(error) > result.max) {
+            result.max = fabs(error);
+        }
+    }
+    result.rms = sqrt(sumSquares / samples);
+    return result;
+}
+
+void test_tracker_follows_lower_envelope(void) {
+    TrackResult envelope = track(500.0f);       // Config::TIME_SYNC_TRACK_ENVELOPE_MS
+    TrackResult everyPair = track(0.0f);
+    char message[160];
+    snprintf(message, sizeof(message), "30 min tracking, 3%% spikes: envelope %.2f ms rms / %.2f ms max, every pair %.2f ms rms",
+             envelope.rms, envelope.max, everyPair.rms);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(envelope.monotonic);
+    TEST_ASSERT_TRUE(envelope.rms < 1.0);
+    TEST_ASSERT_TRUE(envelope.max < 2.0);
+    TEST_ASSERT_TRUE(everyPair.rms > 3.0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_envelope_fit_without_spikes);
+    RUN_TEST(test_envelope_fit_with_retransmission_spikes);
+    RUN_TEST(test_early_glitch_is_rejected);
+    RUN_TEST(test_envelope_needs_two_buckets);
+    RUN_TEST(test_tracker_follows_lower_envelope);
+    return UNITY_END();
+}
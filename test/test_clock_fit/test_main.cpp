@@ -0,0 +1,145 @@
+// 时钟拟合：合成的传感器时钟（-100~+100ppm漂移，传感器时间原点在0、约5e6ms和32位回绕附近），
+// 检查居中double最小二乘的斜率精度、加入到达抖动后的斜率误差、只拟合截距，
+// 以及与原来按float累加原始毫秒时间戳的回归相比的精度差别
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include "ClockFit.h"
+
+static const uint16_t SAMPLE_COUNT = 600;
+static const uint32_t STEP_MS = 1000;               // 每秒一个时间对，窗口600秒
+static const int64_t ESP_ORIGIN_US = 3600000000LL;  // ESP32已运行1小时
+
+static ClockFit::Sample samples[SAMPLE_COUNT];
+static uint32_t randomState;
+
+// 确定性的均匀分布[-1, 1)
+static double nextRandom() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return (double)(randomState >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// 传感器时钟比ESP32慢ppm：ESP32经过的时间 = 传感器经过的时间 x (1 + ppm)，另加±jitterMs的到达抖动
+static void makeSamples(uint32_t sensorOrigin, double ppm, double jitterMs) {
+    for (uint16_t i = 0; i < SAMPLE_COUNT; i++) {
+        double elapsedMs = (double)i * STEP_MS;
+        samples[i].sensorTimeMs = sensorOrigin + i * STEP_MS;
+        double espMs = elapsedMs * (1.0 + ppm * 1e-6) + jitterMs * nextRandom();
+        samples[i].espTimeUs = ESP_ORIGIN_US + (int64_t)llround(espMs * 1000.0);
+    }
+}
+
+// 原来的做法：原始毫秒时间戳直接按float累加后代入最小二乘公式
+static double floatRegressionSlope(const ClockFit::Sample* input, uint16_t count) {
+    float sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        float x = (float)input[i].sensorTimeMs;
+        float y = (float)(input[i].espTimeUs / 1000);
+        sumX += x;
+        sumY += y;
+        sumXY += x * y;
+        sumXX += x * x;
+    }
+    float denominator = count * sumXX - sumX * sumX;
+    return denominator != 0 ? (count * sumXY - sumX * sumY) / denominator : NAN;
+}
+
+void setUp(void) {
+    randomState = 12345;
+}
+
+void tearDown(void) {}
+
+void test_noise_free_slope_is_exact_at_any_origin(void) {
+    const uint32_t origins[] = {0, 5000000, 0xFFFFFFFFu - 300000};
+    const double skews[] = {-100, -20, 0, 35, 100};
+    double worstPpm = 0;
+    for (uint32_t origin : origins) {
+        for (double ppm : skews) {
+            makeSamples(origin, ppm, 0);
+            ClockFit::Result result;
+            TEST_ASSERT_TRUE(ClockFit::fitLeastSquares(samples, SAMPLE_COUNT, result));
+            double error = fabs(ClockFit::skewPpm(result.slope) - ppm);
+            if (error > worstPpm) {
+                worstPpm = error;
+            }
+            TEST_ASSERT_EQUAL_UINT32((SAMPLE_COUNT - 1) * STEP_MS, result.spanMs);
+            TEST_ASSERT_EQUAL_UINT16(SAMPLE_COUNT, result.count);
+            TEST_ASSERT_DOUBLE_WITHIN(0.002, 0.0, result.residualMax);
+            // 截距对应第一个样本：E(S0) = slope * S0 + intercept
+            double predicted = result.slope * (double)origin + result.intercept;
+            TEST_ASSERT_DOUBLE_WITHIN(0.001, ESP_ORIGIN_US / 1000.0, predicted);
+        }
+    }
+    char message[96];
+    snprintf(message, sizeof(message), "noise-free worst slope error %.5f ppm", worstPpm);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 0.0, worstPpm);
+}
+
+void test_jittered_slope_within_a_fraction_of_ppm(void) {
+    // 0.3ms到达抖动、600秒窗口
+    makeSamples(5000000, 42, 0.3);
+    ClockFit::Result result;
+    TEST_ASSERT_TRUE(ClockFit::fitLeastSquares(samples, SAMPLE_COUNT, result));
+    double error = ClockFit::skewPpm(result.slope) - 42;
+    char message[128];
+    snprintf(message, sizeof(message), "0.3 ms jitter: slope error %.3f ppm (standard error %.3f ppm), residual rms %.3f ms",
+             error, result.slopeError * 1e6, result.residualRms);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_DOUBLE_WITHIN(0.3, 0.0, error);
+    // 均匀分布±0.3ms的均方根约0.17ms
+    TEST_ASSERT_DOUBLE_WITHIN(0.03, 0.3 / sqrt(3.0), result.residualRms);
+    TEST_ASSERT_TRUE(result.residualMax < 0.35);
+    TEST_ASSERT_TRUE(result.slopeError > 0 && result.slopeError < 0.3e-6);
+}
+
+void test_offset_fit_keeps_given_slope(void) {
+    makeSamples(1000, 0, 0.2);
+    ClockFit::Result result;
+    TEST_ASSERT_TRUE(ClockFit::fitOffset(samples, SAMPLE_COUNT, 1.0, result));
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, result.slope);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, result.slopeError);
+    TEST_ASSERT_DOUBLE_WITHIN(0.02, ESP_ORIGIN_US / 1000.0 - 1000.0, result.intercept);
+
+    // 只有一个样本时也能拟合截距
+    TEST_ASSERT_TRUE(ClockFit::fitOffset(samples, 1, 1.0, result));
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, (double)samples[0].espTimeUs / 1000.0 - 1000.0, result.intercept);
+}
+
+void test_degenerate_input_is_rejected(void) {
+    ClockFit::Result result;
+    makeSamples(0, 0, 0);
+    TEST_ASSERT_FALSE(ClockFit::fitLeastSquares(samples, 1, result));
+    TEST_ASSERT_FALSE(ClockFit::fitOffset(samples, 0, 1.0, result));
+    // 传感器时间没有跨度
+    ClockFit::Sample same[3] = {{500, 1000}, {500, 2000}, {500, 3000}};
+    TEST_ASSERT_FALSE(ClockFit::fitLeastSquares(same, 3, result));
+}
+
+void test_double_fit_versus_float_sums(void) {
+    // 传感器已运行约1.4小时：float累加的x*x达到1e16量级，只剩约7位有效数字
+    makeSamples(5000000, 50, 0);
+    ClockFit::Result result;
+    TEST_ASSERT_TRUE(ClockFit::fitLeastSquares(samples, SAMPLE_COUNT, result));
+    double fitError = fabs(ClockFit::skewPpm(result.slope) - 50);
+    double floatSlope = floatRegressionSlope(samples, SAMPLE_COUNT);
+    double floatError = isnan(floatSlope) ? INFINITY : fabs(ClockFit::skewPpm(floatSlope) - 50);
+
+    char message[128];
+    snprintf(message, sizeof(message), "slope error: centred double %.5f ppm, raw float sums %.0f ppm",
+             fitError, floatError);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(fitError < 0.001);
+    TEST_ASSERT_TRUE(floatError > 1000 * fitError + 100);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_noise_free_slope_is_exact_at_any_origin);
+    RUN_TEST(test_jittered_slope_within_a_fraction_of_ppm);
+    RUN_TEST(test_offset_fit_keeps_given_slope);
+    RUN_TEST(test_degenerate_input_is_rejected);
+    RUN_TEST(test_double_fit_versus_float_sums);
+    return UNITY_END();
+}
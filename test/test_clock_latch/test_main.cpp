@@ -0,0 +1,200 @@
+// 时钟参数发布：一个写者线程连续发布、多个读者线程同时读取（std::thread），
+// 检查读者从不读到新旧混合的快照、读到的版本单调不减、重读次数，以及写者停在改写途中时读者不等待
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "ClockLatch.h"
+
+static const uint32_t RUN_MS = 300;
+static const uint8_t READER_COUNT = 3;
+
+// 与TimeSync::SensorClock大小相近（约100字节），所有字段由同一个序号生成，读到混合的快照时可以发现
+struct Snapshot {
+    uint32_t serial;
+    uint32_t words[23];
+    double value;
+};
+
+static void fill(Snapshot& snapshot, uint32_t serial) {
+    snapshot.serial = serial;
+    for (uint32_t i = 0; i < 23; i++) {
+        snapshot.words[i] = serial * 2654435761u + i;
+    }
+    snapshot.value = serial * 0.5;
+}
+
+static bool consistent(const Snapshot& snapshot) {
+    for (uint32_t i = 0; i < 23; i++) {
+        if (snapshot.words[i] != snapshot.serial * 2654435761u + i) {
+            return false;
+        }
+    }
+    return snapshot.value == snapshot.serial * 0.5;
+}
+
+struct ReaderResult {
+    uint64_t reads;
+    uint64_t torn;
+    uint64_t backwards;
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_single_thread_publish_and_read(void) {
+    ClockLatch<Snapshot> latch;
+    Snapshot snapshot;
+    latch.read(snapshot);
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.serial);
+    TEST_ASSERT_EQUAL_UINT32(0, latch.getVersion());
+    for (uint32_t serial = 1; serial <= 5; serial++) {
+        Snapshot published;
+        fill(published, serial);
+        latch.publish(published);
+        latch.read(snapshot);
+        TEST_ASSERT_EQUAL_UINT32(serial, snapshot.serial);
+        TEST_ASSERT_TRUE(consistent(snapshot));
+        TEST_ASSERT_EQUAL_UINT32(serial, latch.getVersion());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, latch.getRetries());
+}
+
+void test_concurrent_readers_never_see_torn_snapshots(void) {
+    static ClockLatch<Snapshot> latch;
+    std::atomic<bool> done(false);
+    std::atomic<uint8_t> started(0);
+    Snapshot snapshot;
+    fill(snapshot, 0);
+    latch.publish(snapshot);
+    ReaderResult results[READER_COUNT];
+    memset(results, 0, sizeof(results));
+
+    std::thread readers[READER_COUNT];
+    for (uint8_t r = 0; r < READER_COUNT; r++) {
+        readers[r] = std::thread([&done, &started, &results, r]() {
+            ReaderResult& result = results[r];
+            uint32_t last = 0;
+            Snapshot snapshot;
+            started.fetch_add(1);
+            while (!done.load(std::memory_order_acquire)) {
+                latch.read(snapshot);
+                result.reads++;
+                if (!consistent(snapshot)) {
+                    result.torn++;
+                }
+                if (snapshot.serial < last) {
+                    result.backwards++;
+                }
+                last = snapshot.serial;
+            }
+        });
+    }
+
+    // 所有读者开始读取后，写者连续发布RUN_MS
+    while (started.load() < READER_COUNT) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::milliseconds(RUN_MS);
+    uint32_t published = 0;
+    while (std::chrono::steady_clock::now() < end) {
+        for (uint32_t i = 0; i < 100; i++) {
+            fill(snapshot, ++published);
+            latch.publish(snapshot);
+        }
+    }
+    done.store(true, std::memory_order_release);
+    for (uint8_t r = 0; r < READER_COUNT; r++) {
+        readers[r].join();
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    for (uint8_t r = 0; r < READER_COUNT; r++) {
+        reads += results[r].reads;
+        torn += results[r].torn;
+        backwards += results[r].backwards;
+    }
+    char message[200];
+    snprintf(message, sizeof(message), "%u publishes, %u readers, %llu reads in %.0f ms, %u retries, %llu torn, %llu backwards",
+             published, READER_COUNT, (unsigned long long)reads, elapsedMs, latch.getRetries(),
+             (unsigned long long)torn, (unsigned long long)backwards);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(published + 1, latch.getVersion());
+    TEST_ASSERT_TRUE(reads > 0);
+    TEST_ASSERT_TRUE(torn == 0);
+    TEST_ASSERT_TRUE(backwards == 0);
+    latch.read(snapshot);
+    TEST_ASSERT_EQUAL_UINT32(published, snapshot.serial);
+    // 多核时读者与写者真正并发，应遇到发布途中的重读
+    if (std::thread::hardware_concurrency() > 1) {
+        TEST_ASSERT_GREATER_THAN(0, latch.getRetries());
+    }
+}
+
+// 写者改写副本时可停住的快照：只在写者线程中、stallWrites > 0时停在第stallWrites次赋值之前
+static std::atomic<int> stallWrites(0);
+static std::atomic<bool> writerStalled(false);
+static thread_local bool isWriter = false;
+
+struct StallableSnapshot {
+    Snapshot data;
+
+    StallableSnapshot& operator=(const StallableSnapshot& other) {
+        if (isWriter && stallWrites.load() > 0 && stallWrites.fetch_sub(1) == 1) {
+            writerStalled.store(true);
+            while (writerStalled.load()) {
+                std::this_thread::yield();
+            }
+        }
+        data = other.data;
+        return *this;
+    }
+};
+
+// 写者在第stallAt次改写副本前停住时，主线程读到的快照序号
+static uint32_t readWhileWriterStalled(int stallAt) {
+    static ClockLatch<StallableSnapshot> stallLatch;
+    StallableSnapshot old;
+    fill(old.data, 7);
+    stallLatch.publish(old);
+
+    stallWrites.store(stallAt);
+    std::thread writer([]() {
+        isWriter = true;
+        StallableSnapshot next;
+        fill(next.data, 8);
+        stallLatch.publish(next);
+    });
+    while (!writerStalled.load()) {
+        std::this_thread::yield();
+    }
+    // 写者停在改写途中，读者不等待
+    StallableSnapshot snapshot;
+    stallLatch.read(snapshot);
+    writerStalled.store(false);
+    writer.join();
+    TEST_ASSERT_TRUE(consistent(snapshot.data));
+    return snapshot.data.serial;
+}
+
+void test_reader_does_not_wait_for_stalled_writer(void) {
+    // 改写副本0时（序号为奇数）读到副本1中完整的旧快照，改写副本1时读到副本0中已完成的新快照
+    TEST_ASSERT_EQUAL_UINT32(7, readWhileWriterStalled(1));
+    TEST_ASSERT_EQUAL_UINT32(8, readWhileWriterStalled(2));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_thread_publish_and_read);
+    RUN_TEST(test_concurrent_readers_never_see_torn_snapshots);
+    RUN_TEST(test_reader_does_not_wait_for_stalled_writer);
+    return UNITY_END();
+}
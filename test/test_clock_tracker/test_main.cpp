@@ -0,0 +1,231 @@
+// 时钟跟踪：按100Hz模拟传感器时间对，真实晶振漂移随时间变化（预热漂移、快速斜坡），
+// 到达延迟为指数分布抖动加1%的30ms重传尖峰。对比跟踪器与校准后固定的拟合直线的误差，
+// 检查skew收敛、时间戳单调不减、传感器时间回绕、相位修正限速，以及传感器重启后重新锁定
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include "ClockTracker.h"
+
+static const uint32_t FRAME_MS = 10;                    // 100Hz
+static const float TIME_CONSTANT_MS = 10000.0f;         // Config::TIME_SYNC_TRACK_TIME_CONSTANT_MS
+static const float MAX_SLEW_PPM = 2000.0f;              // Config::TIME_SYNC_MAX_SLEW_PPM
+static const float MAX_SKEW_PPM = 500.0f;               // Config::TIME_SYNC_MAX_SKEW_PPM
+static const float RELOCK_THRESHOLD_MS = 200.0f;        // Config::TIME_SYNC_RELOCK_THRESHOLD_MS
+static const double ESP_START_MS = 120000.0;
+static const double JITTER_MEAN_MS = 0.5;
+static const double SPIKE_MS = 30.0;
+static const double SPIKE_RATE = 0.01;
+static const uint32_t SETTLE_MS = 60000;                // 之后才统计误差
+
+typedef double (*SkewProfile)(double elapsedMs);        // 真实skew(ppm)
+
+struct Result {
+    double maxError;            // 跟踪器：|估计 - (真实时间 + 平均到达延迟)|
+    double rmsError;
+    double frozenMaxError;      // 固定的校准直线
+    double finalSkewPpm;
+    double trueSkewPpm;
+    bool monotonic;
+    ClockTracker::Stats stats;
+};
+
+static ClockTracker tracker;
+static uint32_t randomState;
+
+static double nextUniform() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return ((randomState >> 8) + 0.5) / (double)(1u << 24);
+}
+
+static double arrivalDelay(bool jitter) {
+    if (!jitter) {
+        return 0.0;
+    }
+    double delay = -JITTER_MEAN_MS * log(nextUniform());
+    if (nextUniform() < SPIKE_RATE) {
+        delay += SPIKE_MS;
+    }
+    return delay;
+}
+
+// 校准得到的直线为 E = (1 + calibratedPpm) * S + b，第一个时间对时与真实时间一致
+static Result simulate(uint32_t sensorOrigin, uint32_t durationMs, SkewProfile profile, double calibratedPpm,
+                       bool jitter) {
+    double slope = 1.0 + calibratedPpm * 1e-6;
+    double intercept = ESP_START_MS - slope * (double)sensorOrigin;
+    tracker.start(slope, intercept);
+    double bias = jitter ? JITTER_MEAN_MS + SPIKE_RATE * SPIKE_MS : 0.0;
+
+    Result result = {};
+    result.monotonic = true;
+    double espTrue = ESP_START_MS;
+    double previous = -1e300;
+    double sumSquares = 0.0;
+    uint32_t samples = 0;
+    for (uint32_t elapsed = 0; elapsed <= durationMs; elapsed += FRAME_MS) {
+        uint32_t sensorTime = sensorOrigin + elapsed;
+        if (elapsed > 0) {
+            espTrue += FRAME_MS * (1.0 + profile(elapsed) * 1e-6);
+        }
+        double arrival = espTrue + arrivalDelay(jitter);
+        tracker.update(sensorTime, (int64_t)llround(arrival * 1000.0));
+
+        double estimate = tracker.estimate(sensorTime);
+        if (estimate < previous) {
+            result.monotonic = false;
+        }
+        previous = estimate;
+        if (elapsed < SETTLE_MS) {
+            continue;
+        }
+        double error = estimate - espTrue - bias;
+        sumSquares += error * error;
+        samples++;
+        if (fabs(error) > result.maxError) {
+            result.maxError = fabs(error);
+        }
+        double frozen = fabs(slope * (double)(int32_t)(sensorTime - sensorOrigin) + ESP_START_MS - espTrue);
+        if (frozen > result.frozenMaxError) {
+            result.frozenMaxError = frozen;
+        }
+    }
+    result.rmsError = samples > 0 ? sqrt(sumSquares / samples) : 0.0;
+    result.finalSkewPpm = tracker.getSkewPpm();
+    result.trueSkewPpm = profile(durationMs);
+    result.stats = tracker.getStats();
+    return result;
+}
+
+static void report(const char* name, const Result& result) {
+    char message[200];
+    snprintf(message, sizeof(message),
+             "%s: tracking error max %.3f ms rms %.3f ms, frozen fit %.1f ms, skew %.2f ppm (true %.2f), %u slew-limited",
+             name, result.maxError, result.rmsError, result.frozenMaxError, result.finalSkewPpm, result.trueSkewPpm,
+             result.stats.slewLimited);
+    TEST_MESSAGE(message);
+}
+
+static double constantSkew(double) {
+    return 35.0;
+}
+
+// 上电预热：+20ppm指数变化到-30ppm（时间常数15分钟）
+static double warmupSkew(double elapsedMs) {
+    return -30.0 + 50.0 * exp(-elapsedMs / 900000.0);
+}
+
+// 5分钟内从-100ppm线性变化到+100ppm，之后保持
+static double rampSkew(double elapsedMs) {
+    double t = elapsedMs / 300000.0;
+    return t >= 1.0 ? 100.0 : -100.0 + 200.0 * t;
+}
+
+// 90分钟一个周期的±50ppm
+static double sineSkew(double elapsedMs) {
+    return 50.0 * sin(2.0 * M_PI * elapsedMs / 5400000.0);
+}
+
+void setUp(void) {
+    randomState = 2024;
+    tracker = ClockTracker();
+    tracker.configure(TIME_CONSTANT_MS, MAX_SLEW_PPM, MAX_SKEW_PPM, RELOCK_THRESHOLD_MS);
+}
+
+void tearDown(void) {}
+
+void test_skew_converges_from_calibration_error(void) {
+    // 校准斜率偏差35ppm，无抖动：数个积分时间常数后skew收敛，相位误差趋于0
+    Result result = simulate(1000, 300000, constantSkew, 0.0, false);
+    report("constant 35 ppm", result);
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, 35.0, result.finalSkewPpm);
+    TEST_ASSERT_TRUE(result.maxError < 0.5);
+    TEST_ASSERT_TRUE(result.frozenMaxError > 8.0);
+    TEST_ASSERT_TRUE(result.monotonic);
+    TEST_ASSERT_EQUAL_UINT32(0, result.stats.relocks);
+    TEST_ASSERT_EQUAL_UINT32(300000 / FRAME_MS + 1, result.stats.updates);
+}
+
+void test_warmup_drift_over_90_minutes(void) {
+    Result result = simulate(5000000, 5400000, warmupSkew, 20.0, true);
+    report("warm-up +20 -> -30 ppm, 90 min", result);
+    TEST_ASSERT_TRUE(result.maxError < 1.0);
+    TEST_ASSERT_TRUE(result.rmsError < 0.3);
+    TEST_ASSERT_TRUE(result.frozenMaxError > 100.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, result.trueSkewPpm, result.finalSkewPpm);
+    TEST_ASSERT_TRUE(result.monotonic);
+    TEST_ASSERT_EQUAL_UINT32(0, result.stats.relocks);
+}
+
+void test_fast_ramp_across_sensor_time_wrap(void) {
+    // 传感器时间在斜坡中途回绕
+    Result result = simulate(0xFFFFFFFFu - 150000, 600000, rampSkew, -100.0, true);
+    report("ramp -100 -> +100 ppm in 5 min", result);
+    TEST_ASSERT_TRUE(result.maxError < 1.0);
+    TEST_ASSERT_TRUE(result.frozenMaxError > 30.0);
+    TEST_ASSERT_DOUBLE_WITHIN(1.0, 100.0, result.finalSkewPpm);
+    TEST_ASSERT_TRUE(result.monotonic);
+    TEST_ASSERT_EQUAL_UINT32(0, result.stats.relocks);
+}
+
+void test_sine_drift_over_90_minutes(void) {
+    Result result = simulate(0, 5400000, sineSkew, 0.0, true);
+    report("+-50 ppm over 90 min", result);
+    TEST_ASSERT_TRUE(result.maxError < 1.0);
+    TEST_ASSERT_TRUE(result.frozenMaxError > 50.0);
+    TEST_ASSERT_TRUE(result.monotonic);
+}
+
+void test_phase_step_is_slew_limited(void) {
+    // 到达时间突然提前50ms（低于重锁阈值）：相位修正限速，时间戳不倒退
+    tracker.start(1.0, 0.0);
+    uint32_t sensorTime = 0;
+    double previous = -1.0;
+    bool monotonic = true;
+    for (; sensorTime <= 300000; sensorTime += FRAME_MS) {
+        double offset = sensorTime < 60000 ? 0.0 : -50.0;
+        tracker.update(sensorTime, (int64_t)llround((sensorTime + offset) * 1000.0));
+        double estimate = tracker.estimate(sensorTime);
+        if (estimate < previous) {
+            monotonic = false;
+        }
+        previous = estimate;
+    }
+    const ClockTracker::Stats& stats = tracker.getStats();
+    TEST_ASSERT_TRUE(monotonic);
+    TEST_ASSERT_GREATER_THAN(0, stats.slewLimited);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.relocks);
+    // 4分钟后已修正到新的偏移
+    TEST_ASSERT_DOUBLE_WITHIN(0.5, 300000.0 - 50.0, tracker.estimate(300000));
+    TEST_ASSERT_TRUE(fabs(stats.maxError) > 40.0f);
+}
+
+void test_sensor_reboot_relocks(void) {
+    tracker.start(1.0, 1000.0);
+    for (uint32_t sensorTime = 0; sensorTime <= 30000; sensorTime += FRAME_MS) {
+        TEST_ASSERT_TRUE(tracker.update(sensorTime, (int64_t)(sensorTime + 1000) * 1000));
+    }
+    // 传感器重启：传感器时间从0重新开始，ESP32时间继续
+    TEST_ASSERT_FALSE(tracker.update(0, (int64_t)31010 * 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, tracker.getStats().relocks);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 31010.0, tracker.estimate(0));
+    for (uint32_t sensorTime = FRAME_MS; sensorTime <= 10000; sensorTime += FRAME_MS) {
+        TEST_ASSERT_TRUE(tracker.update(sensorTime, (int64_t)(sensorTime + 31010) * 1000));
+    }
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 41010.0, tracker.estimate(10000));
+
+    // 停止后不再更新
+    tracker.stop();
+    TEST_ASSERT_FALSE(tracker.isActive());
+    TEST_ASSERT_TRUE(tracker.update(20000, 0));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_skew_converges_from_calibration_error);
+    RUN_TEST(test_warmup_drift_over_90_minutes);
+    RUN_TEST(test_fast_ramp_across_sensor_time_wrap);
+    RUN_TEST(test_sine_drift_over_90_minutes);
+    RUN_TEST(test_phase_step_is_slew_limited);
+    RUN_TEST(test_sensor_reboot_relocks);
+    return UNITY_END();
+}
@@ -0,0 +1,221 @@
+// 服务器命令分发微基准：统计每条命令的堆分配次数，对比旧的做法（整条消息和各字段复制成字符串，
+// 按名称逐个==比较）与当前的做法（字段借用payload中的字符串，按编译期哈希查命令表）。
+// 命令名与WebSocketClient::SERVER_COMMANDS相同。JSON解析本身由ArduinoJson在StaticJsonDocument中
+// 就地完成（可写输入零拷贝），这里用就地提取字段的最小解析代替，只测分发路径
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include "CommandTable.h"
+
+// 计数的全局operator new：分配次数即堆分配次数
+static size_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static uint32_t handled[8];
+
+static bool onDataAck(const char*) { handled[0]++; return true; }
+static bool onStartCollection(const char*) { handled[1]++; return true; }
+static bool onStopCollection(const char*) { handled[2]++; return true; }
+static bool onSync(const char*) { handled[3]++; return true; }
+static bool onGetStatus(const char*) { handled[4]++; return true; }
+static bool onHeartbeat(const char*) { handled[5]++; return true; }
+static bool onSubscribe(const char*) { handled[6]++; return true; }
+static bool onResend(const char*) { handled[7]++; return true; }
+
+struct TestCommand {
+    uint32_t hash;
+    const char* name;
+    bool (*handler)(const char* commandId);
+};
+
+static const TestCommand COMMANDS[] = {
+    {hashCommandName("batch_sensor_data_response"), "batch_sensor_data_response", onDataAck},
+    {hashCommandName("start_collection"), "start_collection", onStartCollection},
+    {hashCommandName("stop_collection"), "stop_collection", onStopCollection},
+    {hashCommandName("sync"), "sync", onSync},
+    {hashCommandName("SYNC"), "SYNC", onSync},
+    {hashCommandName("set_batch"), "set_batch", onSync},
+    {hashCommandName("SET_BATCH"), "SET_BATCH", onSync},
+    {hashCommandName("get_status"), "get_status", onGetStatus},
+    {hashCommandName("GET_STATUS"), "GET_STATUS", onGetStatus},
+    {hashCommandName("heartbeat"), "heartbeat", onHeartbeat},
+    {hashCommandName("HEARTBEAT"), "HEARTBEAT", onHeartbeat},
+    {hashCommandName("subscribe"), "subscribe", onSubscribe},
+    {hashCommandName("SUBSCRIBE"), "SUBSCRIBE", onSubscribe},
+    {hashCommandName("resend"), "resend", onResend},
+    {hashCommandName("cancel_resend"), "cancel_resend", onResend},
+};
+static const size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+// 哈希在编译期计算（FNV-1a 32位的标准测试向量）
+static_assert(hashCommandName("") == 2166136261u, "FNV-1a offset basis");
+static_assert(hashCommandName("a") == 0xe40c292cu, "FNV-1a of \"a\"");
+static_assert(hashCommandName("foobar") == 0xbf9cf968u, "FNV-1a of \"foobar\"");
+
+// 服务器消息样本：数据确认占绝大多数
+static const char* const MESSAGES[] = {
+    "{\"type\":\"batch_sensor_data_response\",\"ack_seq\":1234,\"device_code\":\"GW-0001\",\"session_id\":\"041025\"}",
+    "{\"type\":\"batch_sensor_data_response\",\"ack_seq\":1235,\"device_code\":\"GW-0001\",\"session_id\":\"041025\"}",
+    "{\"type\":\"batch_sensor_data_response\",\"ack_seq\":1236,\"device_code\":\"GW-0001\",\"session_id\":\"041025\"}",
+    "{\"type\":\"heartbeat\",\"command_id\":\"hb-77\",\"device_code\":\"GW-0001\"}",
+    "{\"type\":\"batch_sensor_data_response\",\"ack_seq\":1237,\"device_code\":\"GW-0001\",\"session_id\":\"041025\"}",
+    "{\"type\":\"GET_STATUS\",\"command_id\":\"st-9\",\"device_code\":\"GW-0001\"}",
+    "{\"type\":\"batch_sensor_data_response\",\"ack_seq\":1238,\"device_code\":\"GW-0001\",\"session_id\":\"041025\"}",
+    "{\"type\":\"start_collection\",\"command_id\":\"c-1\",\"device_code\":\"GW-0001\",\"session_id\":\"041026\"}",
+};
+static const size_t MESSAGE_COUNT = sizeof(MESSAGES) / sizeof(MESSAGES[0]);
+static const size_t MAX_MESSAGE = 128;
+
+// 就地借用字符串字段：在可写的payload中找到pattern（"key":"）后的value，把结尾引号改为'\0'并返回value的指针
+static const char* borrowField(char* payload, const char* pattern) {
+    char* start = strstr(payload, pattern);
+    if (!start) {
+        return "";
+    }
+    start += strlen(pattern);
+    char* end = strchr(start, '"');
+    if (end) {
+        *end = '\0';
+    }
+    return start;
+}
+
+// 当前的分发：字段借用payload，按哈希查命令表
+static bool dispatchInPlace(char* payload) {
+    // 先取后面的字段，再取type，避免type结尾的'\0'截断后续查找
+    const char* commandId = borrowField(payload, "\"command_id\":\"");
+    borrowField(payload, "\"device_code\":\"");
+    borrowField(payload, "\"session_id\":\"");
+    const char* type = borrowField(payload, "\"type\":\"");
+    const TestCommand* command = findCommand(COMMANDS, COMMAND_COUNT, type);
+    return command && command->handler(commandId);
+}
+
+// 旧的分发：复制整条消息和各字段为字符串，按名称逐个比较
+static std::string stringField(const std::string& message, const char* key) {
+    std::string pattern = std::string("\"") + key + "\":\"";
+    size_t start = message.find(pattern);
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    start += pattern.size();
+    return message.substr(start, message.find('"', start) - start);
+}
+
+static bool dispatchWithStrings(const char* payload) {
+    std::string message(payload);
+    std::string type = stringField(message, "type");
+    std::string commandId = stringField(message, "command_id");
+    std::string deviceCode = stringField(message, "device_code");
+    std::string sessionId = stringField(message, "session_id");
+    if (type == "batch_sensor_data_response") return onDataAck(commandId.c_str());
+    if (type == "start_collection") return onStartCollection(commandId.c_str());
+    if (type == "stop_collection") return onStopCollection(commandId.c_str());
+    if (type == "sync" || type == "SYNC" || type == "set_batch" || type == "SET_BATCH") return onSync(commandId.c_str());
+    if (type == "get_status" || type == "GET_STATUS") return onGetStatus(commandId.c_str());
+    if (type == "heartbeat" || type == "HEARTBEAT") return onHeartbeat(commandId.c_str());
+    if (type == "subscribe" || type == "SUBSCRIBE") return onSubscribe(commandId.c_str());
+    if (type == "resend" || type == "cancel_resend") return onResend(commandId.c_str());
+    return false;
+}
+
+static const uint32_t ITERATIONS = 200000;
+
+static double nowNs() {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setUp(void) {
+    memset(handled, 0, sizeof(handled));
+}
+
+void tearDown(void) {}
+
+void test_every_table_entry_is_found(void) {
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        const TestCommand* command = findCommand(COMMANDS, COMMAND_COUNT, COMMANDS[i].name);
+        TEST_ASSERT_EQUAL_PTR(&COMMANDS[i], command);
+    }
+    // 大写别名指向同一个处理函数
+    TEST_ASSERT_EQUAL_PTR(findCommand(COMMANDS, COMMAND_COUNT, "sync")->handler,
+                          findCommand(COMMANDS, COMMAND_COUNT, "SYNC")->handler);
+}
+
+void test_unknown_and_prefix_names_are_rejected(void) {
+    TEST_ASSERT_NULL(findCommand(COMMANDS, COMMAND_COUNT, ""));
+    TEST_ASSERT_NULL(findCommand(COMMANDS, COMMAND_COUNT, "syn"));
+    TEST_ASSERT_NULL(findCommand(COMMANDS, COMMAND_COUNT, "sync "));
+    TEST_ASSERT_NULL(findCommand(COMMANDS, COMMAND_COUNT, "Sync"));
+    TEST_ASSERT_NULL(findCommand(COMMANDS, COMMAND_COUNT, "batch_sensor_data"));
+}
+
+void test_table_hashes_are_distinct(void) {
+    // 表内无哈希冲突，查找时strcmp只在命中的条目上执行一次
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        for (size_t j = i + 1; j < COMMAND_COUNT; j++) {
+            TEST_ASSERT_NOT_EQUAL(COMMANDS[i].hash, COMMANDS[j].hash);
+        }
+    }
+}
+
+void test_in_place_dispatch_does_not_allocate(void) {
+    char payload[MAX_MESSAGE];
+    size_t before = allocationCount;
+    double start = nowNs();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        // 网络库每条消息交给回调的接收缓冲区（可写）
+        strncpy(payload, MESSAGES[i % MESSAGE_COUNT], sizeof(payload));
+        TEST_ASSERT_TRUE(dispatchInPlace(payload));
+    }
+    double elapsed = nowNs() - start;
+    size_t allocations = allocationCount - before;
+
+    char message[160];
+    snprintf(message, sizeof(message), "in-place + hashed table: %.1f ns/command, %.2f allocations/command",
+             elapsed / ITERATIONS, (double)allocations / ITERATIONS);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+    TEST_ASSERT_EQUAL_UINT32(ITERATIONS * 5 / 8, handled[0]);
+}
+
+void test_string_dispatch_allocates_per_command(void) {
+    size_t before = allocationCount;
+    double start = nowNs();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        TEST_ASSERT_TRUE(dispatchWithStrings(MESSAGES[i % MESSAGE_COUNT]));
+    }
+    double elapsed = nowNs() - start;
+    size_t allocations = allocationCount - before;
+
+    char message[160];
+    snprintf(message, sizeof(message), "String copies + == chain: %.1f ns/command, %.2f allocations/command",
+             elapsed / ITERATIONS, (double)allocations / ITERATIONS);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_GREATER_OR_EQUAL(ITERATIONS, (uint32_t)allocations);
+    TEST_ASSERT_EQUAL_UINT32(ITERATIONS * 5 / 8, handled[0]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_table_entry_is_found);
+    RUN_TEST(test_unknown_and_prefix_names_are_rejected);
+    RUN_TEST(test_table_hashes_are_distinct);
+    RUN_TEST(test_in_place_dispatch_does_not_allocate);
+    RUN_TEST(test_string_dispatch_allocates_per_command);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+// 延迟直方图：样本落入的桶（含桶上界和最后一个无上界的桶）、min/max/平均值、
+// 百分位取所在桶的上界且不超过最大值、空直方图和清空，以及10万个样本下p99与精确值的关系
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "LatencyHistogram.h"
+
+static LatencyHistogram histogram;
+
+static int compareUint32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+void setUp(void) {
+    histogram.reset();
+}
+
+void tearDown(void) {}
+
+void test_empty_histogram(void) {
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getMin());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getMax());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, histogram.getAvg());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getPercentile(99.0f));
+}
+
+void test_samples_land_in_bucket_by_upper_bound(void) {
+    // 等于上界的样本属于该桶，超过则进入下一个桶
+    histogram.record(0);
+    histogram.record(2);
+    histogram.record(3);
+    histogram.record(30000);
+    histogram.record(30001);
+    histogram.record(UINT32_MAX);
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.getBucketCount(0));
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.getBucketCount(1));
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.getBucketCount(LatencyHistogram::BUCKET_COUNT - 2));
+    TEST_ASSERT_EQUAL_UINT32(2, histogram.getBucketCount(LatencyHistogram::BUCKET_COUNT - 1));
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getBucketCount(LatencyHistogram::BUCKET_COUNT));
+    TEST_ASSERT_EQUAL_UINT32(2, LatencyHistogram::getBucketBound(0));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, LatencyHistogram::getBucketBound(LatencyHistogram::BUCKET_COUNT - 1));
+
+    uint32_t total = 0;
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        total += histogram.getBucketCount(i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(histogram.getCount(), total);
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getMin());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, histogram.getMax());
+}
+
+void test_min_max_and_average(void) {
+    histogram.record(40);
+    histogram.record(7);
+    histogram.record(13);
+    TEST_ASSERT_EQUAL_UINT32(3, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(7, histogram.getMin());
+    TEST_ASSERT_EQUAL_UINT32(40, histogram.getMax());
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, histogram.getAvg());
+    // 总和用64位累加，大样本不溢出
+    histogram.reset();
+    for (uint8_t i = 0; i < 4; i++) {
+        histogram.record(4000000000u);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(4e9f, histogram.getAvg());
+}
+
+void test_percentile_is_bucket_bound_capped_at_max(void) {
+    // 99个3ms、1个120ms：p50在(2,5]桶，p99仍在该桶，p100在(100,200]桶但不超过最大值
+    for (uint8_t i = 0; i < 99; i++) {
+        histogram.record(3);
+    }
+    histogram.record(120);
+    TEST_ASSERT_EQUAL_UINT32(5, histogram.getPercentile(50.0f));
+    TEST_ASSERT_EQUAL_UINT32(5, histogram.getPercentile(99.0f));
+    TEST_ASSERT_EQUAL_UINT32(120, histogram.getPercentile(100.0f));
+    TEST_ASSERT_EQUAL_UINT32(120, histogram.getPercentile(99.5f));
+    // p0至少取第一个样本
+    TEST_ASSERT_EQUAL_UINT32(5, histogram.getPercentile(0.0f));
+    // 全部样本在一个桶时不超过最大值
+    histogram.reset();
+    histogram.record(3);
+    TEST_ASSERT_EQUAL_UINT32(3, histogram.getPercentile(99.0f));
+}
+
+void test_p99_bounds_exact_percentile(void) {
+    // 对数正态形状的延迟：p99估计不小于精确值，且不超过精确值所在桶的上界
+    const uint32_t count = 100000;
+    static uint32_t samples[count];
+    uint32_t state = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        state = state * 1664525u + 1013904223u;
+        double u = ((state >> 8) + 0.5) / (double)(1u << 24);
+        samples[i] = (uint32_t)(20.0 * exp(1.2 * (u - 0.5) * 4.0));
+        histogram.record(samples[i]);
+    }
+    qsort(samples, count, sizeof(uint32_t), compareUint32);
+    uint32_t exact = samples[count * 99 / 100 - 1];
+    uint32_t estimate = histogram.getPercentile(99.0f);
+    uint32_t bound = 0;
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        if (exact <= LatencyHistogram::getBucketBound(i)) {
+            bound = LatencyHistogram::getBucketBound(i);
+            break;
+        }
+    }
+    char message[96];
+    snprintf(message, sizeof(message), "p99 exact %u ms, estimate %u ms (bucket bound %u ms)", exact, estimate, bound);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(estimate >= exact);
+    TEST_ASSERT_TRUE(estimate <= bound);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_histogram);
+    RUN_TEST(test_samples_land_in_bucket_by_upper_bound);
+    RUN_TEST(test_min_max_and_average);
+    RUN_TEST(test_percentile_is_bucket_bound_capped_at_max);
+    RUN_TEST(test_p99_bounds_exact_percentile);
+    return UNITY_END();
+}
@@ -0,0 +1,509 @@
+// 本地转发基准：按虚拟时间（us）模拟各客户端的TCP发送缓冲区（约4个MSS，按各自速率排空），
+// 对比旧的整条写入（套接字可写即sendTXT整条消息，放不下时阻塞到排空）与LocalFanout逐客户端分片写入。
+// 1~4个客户端，最后一个为慢客户端；检查单次转发耗时、快客户端收到全部消息，以及卡住的客户端被断开
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "LocalFanout.h"
+
+static const size_t MSS = 1436;                     // Config::LOCAL_FRAGMENT_SIZE
+static const size_t SEND_BUFFER = 4 * MSS;          // lwIP默认TCP_SND_BUF
+static const size_t WRITABLE_SPACE = 2 * MSS;       // isWritable：可用空间至少2个MSS
+static const uint32_t STALL_TIMEOUT_MS = 2000;      // Config::LOCAL_CLIENT_STALL_MS
+static const uint32_t CALL_COST_US = 30;            // 每次写套接字的固定开销
+static const uint32_t COPY_BYTES_PER_US = 50;       // 复制进发送缓冲区的速度
+static const uint32_t FAST_BYTES_PER_MS = 2000;     // 快客户端约16Mbps
+static const uint32_t SLOW_BYTES_PER_MS = 100;      // 慢客户端约0.8Mbps，跟不上消息速率
+static const size_t MESSAGE_SIZE = 8000;            // 一条合并后的数据消息
+static const uint32_t MESSAGE_INTERVAL_US = 30000;  // 消息产生间隔
+static const uint32_t LOOP_INTERVAL_US = 10000;     // 网络任务循环间隔
+static const uint32_t DURATION_US = 10000000;       // 模拟10秒
+static const uint8_t CLIENTS = 4;
+
+static uint32_t nowUs;
+
+// 客户端：发送缓冲区按速率排空，接收端按帧重组并核对内容
+struct SimClient {
+    bool connected;
+    uint32_t bytesPerMs;
+    uint64_t buffered;          // 发送缓冲区中的字节数 x 1000（按us排空不丢精度）
+    uint32_t lastDrain;
+    bool inMessage;
+    size_t received;
+    uint32_t messageSeq;
+    uint32_t messages;          // 完整且内容正确收到的消息数
+    uint32_t frameErrors;       // 帧序列错误（首片/续片/FIN不成对）或内容不符
+
+    void drain() {
+        uint64_t drained = (uint64_t)(nowUs - lastDrain) * bytesPerMs;
+        buffered = buffered > drained ? buffered - drained : 0;
+        lastDrain = nowUs;
+    }
+    size_t freeSpace() {
+        drain();
+        size_t used = (size_t)((buffered + 999) / 1000);
+        return used < SEND_BUFFER ? SEND_BUFFER - used : 0;
+    }
+};
+
+static SimClient clients[CLIENTS];
+
+// 推进时间（写入耗时或阻塞等待）
+static void advance(uint32_t us) {
+    nowUs += us;
+}
+
+// 消息内容：首4字节为序号，其余字节由序号和位置决定
+static void fillMessage(char* data, size_t length, uint32_t seq) {
+    memcpy(data, &seq, sizeof(seq));
+    for (size_t i = sizeof(seq); i < length; i++) {
+        data[i] = (char)((seq * 31 + i) & 0xFF);
+    }
+}
+
+static void receiveBytes(SimClient& client, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++, client.received++) {
+        if (client.received < sizeof(uint32_t)) {
+            ((uint8_t*)&client.messageSeq)[client.received] = data[i];
+        } else if (data[i] != (uint8_t)((client.messageSeq * 31 + client.received) & 0xFF)) {
+            client.frameErrors++;
+        }
+    }
+}
+
+// 写入length字节：放不下时阻塞到排空出足够空间（sendTXT/lwIP的行为）
+static void writeSocket(SimClient& client, size_t length) {
+    advance(CALL_COST_US + length / COPY_BYTES_PER_US);
+    size_t space = client.freeSpace();
+    if (space < length) {
+        uint32_t waitUs = (uint32_t)(((uint64_t)(length - space) * 1000 + client.bytesPerMs - 1) / client.bytesPerMs);
+        advance(waitUs);
+        client.drain();
+    }
+    client.buffered += (uint64_t)length * 1000;
+}
+
+struct SimSink : public LocalFanout::Sink {
+    LocalFanout* fanout;
+    uint32_t disconnects;
+
+    bool isWritable(uint8_t client) override {
+        return clients[client].connected && clients[client].freeSpace() >= WRITABLE_SPACE;
+    }
+    bool sendFragment(uint8_t num, const uint8_t* data, size_t length, bool first, bool fin) override {
+        SimClient& client = clients[num];
+        if (!client.connected) {
+            return false;
+        }
+        writeSocket(client, length);
+        if (first == client.inMessage) {
+            client.frameErrors++;
+        }
+        if (first) {
+            client.received = 0;
+        }
+        receiveBytes(client, data, length);
+        client.inMessage = !fin;
+        if (fin) {
+            if (client.received == MESSAGE_SIZE) {
+                client.messages++;
+            } else {
+                client.frameErrors++;
+            }
+        }
+        return true;
+    }
+    void disconnect(uint8_t num) override {
+        // WebSocketsServer::disconnect同步触发断开事件
+        clients[num].connected = false;
+        fanout->removeClient(num);
+        disconnects++;
+    }
+};
+
+struct Result {
+    uint32_t produced;
+    uint32_t maxFanoutUs;
+    double avgFanoutUs;
+    uint32_t fastMinMessages;   // 快客户端中收到消息最少的
+    uint32_t slowMessages;
+    uint32_t frameErrors;
+};
+
+static void resetClients(uint8_t count, bool lastSlow) {
+    memset(clients, 0, sizeof(clients));
+    for (uint8_t i = 0; i < count; i++) {
+        clients[i].connected = true;
+        clients[i].bytesPerMs = (lastSlow && i == count - 1) ? SLOW_BYTES_PER_MS : FAST_BYTES_PER_MS;
+    }
+}
+
+static Result collect(uint8_t count, bool lastSlow, uint32_t produced, uint64_t fanoutSum, uint32_t maxFanoutUs) {
+    Result result;
+    memset(&result, 0, sizeof(result));
+    result.produced = produced;
+    result.maxFanoutUs = maxFanoutUs;
+    result.avgFanoutUs = produced ? (double)fanoutSum / produced : 0.0;
+    result.fastMinMessages = 0xFFFFFFFFu;
+    for (uint8_t i = 0; i < count; i++) {
+        result.frameErrors += clients[i].frameErrors;
+        if (lastSlow && i == count - 1) {
+            result.slowMessages = clients[i].messages;
+        } else if (clients[i].messages < result.fastMinMessages) {
+            result.fastMinMessages = clients[i].messages;
+        }
+    }
+    if (result.fastMinMessages == 0xFFFFFFFFu) {
+        result.fastMinMessages = 0;
+    }
+    return result;
+}
+
+// 旧的转发：套接字可写（约2个MSS空间）就sendTXT整条消息，放不下的部分阻塞到排空
+static Result runWholeMessage(uint8_t count, bool lastSlow) {
+    static char message[MESSAGE_SIZE];
+    resetClients(count, lastSlow);
+    nowUs = 0;
+    uint32_t produced = 0;
+    uint64_t fanoutSum = 0;
+    uint32_t maxFanoutUs = 0;
+    uint32_t nextMessage = 0;
+    while (nowUs < DURATION_US) {
+        if (nowUs < nextMessage) {
+            advance(nextMessage - nowUs < LOOP_INTERVAL_US ? nextMessage - nowUs : LOOP_INTERVAL_US);
+            continue;
+        }
+        fillMessage(message, MESSAGE_SIZE, produced);
+        uint32_t start = nowUs;
+        for (uint8_t i = 0; i < count; i++) {
+            SimClient& client = clients[i];
+            if (client.freeSpace() < WRITABLE_SPACE) {
+                continue;
+            }
+            writeSocket(client, MESSAGE_SIZE);
+            client.messageSeq = produced;
+            client.messages++;
+        }
+        uint32_t elapsed = nowUs - start;
+        fanoutSum += elapsed;
+        if (elapsed > maxFanoutUs) {
+            maxFanoutUs = elapsed;
+        }
+        produced++;
+        nextMessage += MESSAGE_INTERVAL_US;
+    }
+    return collect(count, lastSlow, produced, fanoutSum, maxFanoutUs);
+}
+
+// 当前的转发：LocalFanout逐客户端分片写入，网络任务每轮pump()继续写未写完的消息
+static Result runFragmented(uint8_t count, bool lastSlow) {
+    static char message[MESSAGE_SIZE];
+    resetClients(count, lastSlow);
+    nowUs = 0;
+    SimSink sink;
+    sink.disconnects = 0;
+    LocalFanout fanout(&sink);
+    sink.fanout = &fanout;
+    fanout.configure(MSS, STALL_TIMEOUT_MS);
+    for (uint8_t i = 0; i < count; i++) {
+        fanout.addClient(i);
+    }
+
+    uint32_t produced = 0;
+    uint64_t fanoutSum = 0;
+    uint32_t maxFanoutUs = 0;
+    uint32_t nextMessage = 0;
+    while (nowUs < DURATION_US) {
+        uint32_t start = nowUs;
+        if (nowUs >= nextMessage) {
+            fillMessage(message, MESSAGE_SIZE, produced);
+            fanout.broadcast(message, MESSAGE_SIZE, nowUs / 1000);
+            produced++;
+            nextMessage += MESSAGE_INTERVAL_US;
+        } else {
+            fanout.pump(nowUs / 1000);
+        }
+        uint32_t elapsed = nowUs - start;
+        fanoutSum += elapsed;
+        if (elapsed > maxFanoutUs) {
+            maxFanoutUs = elapsed;
+        }
+        uint32_t wait = nextMessage > nowUs ? nextMessage - nowUs : 0;
+        advance(wait < LOOP_INTERVAL_US ? wait : LOOP_INTERVAL_US);
+    }
+    // 模拟结束时最后一条消息可能还在写：再运行几轮写完
+    for (int round = 0; round < 10; round++) {
+        advance(LOOP_INTERVAL_US);
+        fanout.pump(nowUs / 1000);
+    }
+    // 平均值为每条消息的写入总耗时（含之后各轮pump继续写的部分）
+    return collect(count, lastSlow, produced, fanoutSum, maxFanoutUs);
+}
+
+static void report(const char* name, uint8_t count, const Result& result) {
+    char message[200];
+    snprintf(message, sizeof(message), "%s, %u clients: max fan-out %.2f ms, avg %.3f ms per message, fast min %u/%u, slow %u",
+             name, count, result.maxFanoutUs / 1000.0, result.avgFanoutUs / 1000.0,
+             result.fastMinMessages, result.produced, result.slowMessages);
+    TEST_MESSAGE(message);
+}
+
+// 记录每个分片的调用，用于检查首片/FIN标记
+struct RecordingSink : public LocalFanout::Sink {
+    static const int MAX_CALLS = 16;
+    bool writable[LocalFanout::MAX_CLIENTS];
+    bool failWrites;
+    int calls;
+    uint8_t callClient[MAX_CALLS];
+    size_t callLength[MAX_CALLS];
+    bool callFirst[MAX_CALLS];
+    bool callFin[MAX_CALLS];
+    LocalFanout* fanout;
+    int disconnects;
+
+    RecordingSink() : failWrites(false), calls(0), fanout(nullptr), disconnects(0) {
+        for (uint8_t i = 0; i < LocalFanout::MAX_CLIENTS; i++) {
+            writable[i] = true;
+        }
+    }
+    bool isWritable(uint8_t client) override { return writable[client]; }
+    bool sendFragment(uint8_t client, const uint8_t*, size_t length, bool first, bool fin) override {
+        if (failWrites) {
+            return false;
+        }
+        if (calls < MAX_CALLS) {
+            callClient[calls] = client;
+            callLength[calls] = length;
+            callFirst[calls] = first;
+            callFin[calls] = fin;
+        }
+        calls++;
+        return true;
+    }
+    void disconnect(uint8_t client) override {
+        disconnects++;
+        if (fanout) {
+            fanout->removeClient(client);
+        }
+    }
+};
+
+// 客户端0始终可写；客户端1只剩budget次可写，之后卡住
+struct PartialSink : public RecordingSink {
+    int budget;
+    PartialSink() : budget(0) {}
+    bool isWritable(uint8_t client) override { return client == 0 || budget-- > 0; }
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_fragments_carry_first_and_fin_flags(void) {
+    static char message[2500];
+    RecordingSink sink;
+    LocalFanout fanout(&sink);
+    fanout.configure(1000, STALL_TIMEOUT_MS);
+    fanout.addClient(0);
+    TEST_ASSERT_TRUE(fanout.broadcast(message, sizeof(message), 0));
+    TEST_ASSERT_EQUAL_INT(3, sink.calls);
+    TEST_ASSERT_EQUAL_UINT32(1000, sink.callLength[0]);
+    TEST_ASSERT_TRUE(sink.callFirst[0]);
+    TEST_ASSERT_FALSE(sink.callFin[0]);
+    TEST_ASSERT_FALSE(sink.callFirst[1]);
+    TEST_ASSERT_FALSE(sink.callFin[1]);
+    TEST_ASSERT_EQUAL_UINT32(500, sink.callLength[2]);
+    TEST_ASSERT_FALSE(sink.callFirst[2]);
+    TEST_ASSERT_TRUE(sink.callFin[2]);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().clientSends);
+
+    // 短消息只有一片，首片即末片
+    sink.calls = 0;
+    fanout.broadcast(message, 10, 1);
+    TEST_ASSERT_EQUAL_INT(1, sink.calls);
+    TEST_ASSERT_TRUE(sink.callFirst[0]);
+    TEST_ASSERT_TRUE(sink.callFin[0]);
+}
+
+void test_unwritable_client_is_skipped(void) {
+    static char message[2500];
+    RecordingSink sink;
+    LocalFanout fanout(&sink);
+    fanout.configure(1000, STALL_TIMEOUT_MS);
+    fanout.addClient(0);
+    fanout.addClient(1);
+    sink.writable[1] = false;
+    TEST_ASSERT_TRUE(fanout.broadcast(message, sizeof(message), 0));
+    TEST_ASSERT_EQUAL_INT(3, sink.calls);
+    TEST_ASSERT_FALSE(fanout.isPending(1));
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().clientSends);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().clientSkips);
+
+    // 没有客户端可写时返回false
+    sink.writable[0] = false;
+    TEST_ASSERT_FALSE(fanout.broadcast(message, sizeof(message), 1));
+}
+
+void test_unfinished_client_is_continued_and_skips_new_messages(void) {
+    static char message[2500];
+    PartialSink sink;
+    sink.budget = 1;
+    LocalFanout fanout(&sink);
+    fanout.configure(1000, STALL_TIMEOUT_MS);
+    fanout.addClient(0);
+    fanout.addClient(1);
+
+    // 客户端1写完首片后不可写：余下部分复制下来留待之后继续写
+    TEST_ASSERT_TRUE(fanout.broadcast(message, sizeof(message), 0));
+    TEST_ASSERT_TRUE(fanout.isPending(1));
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().deferredSends);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().clientSends);
+
+    // 未写完的客户端跳过新消息，快客户端照常收到
+    fanout.broadcast(message, 100, 5);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().clientSkips);
+    TEST_ASSERT_EQUAL_UINT32(2, fanout.getStats().clientSends);
+
+    // 恢复可写后续片继续写完，不再出现首片
+    sink.calls = 0;
+    sink.budget = 100;
+    fanout.pump(20);
+    TEST_ASSERT_FALSE(fanout.isPending(1));
+    TEST_ASSERT_EQUAL_INT(2, sink.calls);
+    TEST_ASSERT_EQUAL_UINT8(1, sink.callClient[0]);
+    TEST_ASSERT_FALSE(sink.callFirst[0]);
+    TEST_ASSERT_FALSE(sink.callFin[0]);
+    TEST_ASSERT_TRUE(sink.callFin[1]);
+    TEST_ASSERT_EQUAL_UINT32(3, fanout.getStats().clientSends);
+    TEST_ASSERT_EQUAL_INT(0, sink.disconnects);
+}
+
+void test_stalled_client_is_disconnected(void) {
+    static char message[2500];
+    PartialSink sink;
+    sink.budget = 1;
+    LocalFanout fanout(&sink);
+    sink.fanout = &fanout;
+    fanout.configure(1000, STALL_TIMEOUT_MS);
+    fanout.addClient(0);
+    fanout.addClient(1);
+    fanout.broadcast(message, sizeof(message), 100);
+    TEST_ASSERT_TRUE(fanout.isPending(1));
+
+    // 卡住时限之内保持连接，超过后断开（余下分片无法跳过）
+    fanout.pump(100 + STALL_TIMEOUT_MS - 1);
+    TEST_ASSERT_TRUE(fanout.isPending(1));
+    TEST_ASSERT_EQUAL_INT(0, sink.disconnects);
+    fanout.pump(100 + STALL_TIMEOUT_MS);
+    TEST_ASSERT_FALSE(fanout.isPending(1));
+    TEST_ASSERT_EQUAL_INT(1, sink.disconnects);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().stalledClients);
+
+    // 断开后不再计入跳过，其余客户端照常写入
+    sink.calls = 0;
+    TEST_ASSERT_TRUE(fanout.broadcast(message, sizeof(message), 100 + STALL_TIMEOUT_MS + 10));
+    TEST_ASSERT_EQUAL_INT(3, sink.calls);
+    TEST_ASSERT_EQUAL_UINT32(0, fanout.getStats().clientSkips);
+}
+
+void test_write_failure_disconnects_client(void) {
+    static char message[100];
+    RecordingSink sink;
+    LocalFanout fanout(&sink);
+    sink.fanout = &fanout;
+    fanout.addClient(2);
+    sink.failWrites = true;
+    TEST_ASSERT_FALSE(fanout.broadcast(message, sizeof(message), 0));
+    TEST_ASSERT_EQUAL_INT(1, sink.disconnects);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().sendFailures);
+
+    // 已断开的客户端不再写入
+    sink.failWrites = false;
+    TEST_ASSERT_FALSE(fanout.broadcast(message, sizeof(message), 1));
+    TEST_ASSERT_EQUAL_INT(0, sink.calls);
+}
+
+void test_fanout_benchmark_1_to_4_clients(void) {
+    for (uint8_t count = 1; count <= CLIENTS; count++) {
+        bool lastSlow = count > 1;
+        Result whole = runWholeMessage(count, lastSlow);
+        Result fragmented = runFragmented(count, lastSlow);
+        report("sendTXT whole message", count, whole);
+        report("LocalFanout fragments", count, fragmented);
+
+        TEST_ASSERT_EQUAL_UINT32(0, fragmented.frameErrors);
+        // 分片写入从不等待发送缓冲区排空：单次耗时只有写入本身
+        TEST_ASSERT_LESS_THAN(2000, fragmented.maxFanoutUs);
+        // 快客户端收到全部消息
+        TEST_ASSERT_EQUAL_UINT32(fragmented.produced, fragmented.fastMinMessages);
+        if (lastSlow) {
+            // 旧做法中慢客户端使每次转发阻塞数十毫秒，网络任务和上传随之停顿
+            TEST_ASSERT_GREATER_OR_EQUAL(30000, whole.maxFanoutUs);
+            TEST_ASSERT_GREATER_THAN(fragmented.maxFanoutUs * 10, whole.maxFanoutUs);
+            // 慢客户端按自身速率收到部分完整消息，不影响其他客户端
+            TEST_ASSERT_GREATER_THAN(0, fragmented.slowMessages);
+            TEST_ASSERT_LESS_THAN(fragmented.produced, fragmented.slowMessages);
+        }
+    }
+}
+
+void test_stalled_client_in_simulation_is_dropped_without_affecting_others(void) {
+    // 最后一个客户端速率为0（应用不再读取），卡住时限后被断开，其余客户端照常收到全部消息
+    static char message[MESSAGE_SIZE];
+    resetClients(3, false);
+    clients[2].bytesPerMs = 0;
+    nowUs = 0;
+    SimSink sink;
+    sink.disconnects = 0;
+    LocalFanout fanout(&sink);
+    sink.fanout = &fanout;
+    fanout.configure(MSS, STALL_TIMEOUT_MS);
+    for (uint8_t i = 0; i < 3; i++) {
+        fanout.addClient(i);
+    }
+    uint32_t produced = 0;
+    uint32_t disconnectedAt = 0;
+    uint32_t nextMessage = 0;
+    while (nowUs < 5000000) {
+        if (nowUs >= nextMessage) {
+            fillMessage(message, MESSAGE_SIZE, produced);
+            fanout.broadcast(message, MESSAGE_SIZE, nowUs / 1000);
+            produced++;
+            nextMessage += MESSAGE_INTERVAL_US;
+        } else {
+            fanout.pump(nowUs / 1000);
+        }
+        if (!clients[2].connected && disconnectedAt == 0) {
+            disconnectedAt = nowUs;
+        }
+        advance(LOOP_INTERVAL_US);
+    }
+    for (int round = 0; round < 10; round++) {
+        advance(LOOP_INTERVAL_US);
+        fanout.pump(nowUs / 1000);
+    }
+    char report[160];
+    snprintf(report, sizeof(report), "stalled client dropped after %.0f ms, fast clients %u/%u messages",
+             disconnectedAt / 1000.0, clients[0].messages, produced);
+    TEST_MESSAGE(report);
+    TEST_ASSERT_FALSE(clients[2].connected);
+    TEST_ASSERT_EQUAL_UINT32(1, sink.disconnects);
+    TEST_ASSERT_EQUAL_UINT32(1, fanout.getStats().stalledClients);
+    TEST_ASSERT_GREATER_OR_EQUAL(STALL_TIMEOUT_MS * 1000, disconnectedAt);
+    TEST_ASSERT_LESS_THAN(STALL_TIMEOUT_MS * 1000 + 2 * LOOP_INTERVAL_US, disconnectedAt);
+    TEST_ASSERT_EQUAL_UINT32(produced, clients[0].messages);
+    TEST_ASSERT_EQUAL_UINT32(produced, clients[1].messages);
+    TEST_ASSERT_EQUAL_UINT32(0, clients[0].frameErrors + clients[1].frameErrors);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fragments_carry_first_and_fin_flags);
+    RUN_TEST(test_unwritable_client_is_skipped);
+    RUN_TEST(test_unfinished_client_is_continued_and_skips_new_messages);
+    RUN_TEST(test_stalled_client_is_disconnected);
+    RUN_TEST(test_write_failure_disconnects_client);
+    RUN_TEST(test_fanout_benchmark_1_to_4_clients);
+    RUN_TEST(test_stalled_client_in_simulation_is_dropped_without_affecting_others);
+    return UNITY_END();
+}
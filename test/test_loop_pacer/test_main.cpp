@@ -0,0 +1,193 @@
+// LoopPacer单元测试：时间片边界、让出后不等待、millis()回绕，以及按虚拟时间（us）的简化发送循环模型
+// （块封装、通知唤醒、逐条写入）中连续发送到队列为空、按时间片让出、空闲时按间隔醒来。
+// 模型是手写的，不运行WebSocketClient的发送路径，只检验LoopPacer的节拍决策
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "LoopPacer.h"
+
+static const uint32_t LOOP_INTERVAL_MS = 10;    // Config::NETWORK_LOOP_INTERVAL_MS
+static const uint32_t LOOP_COST_US = 100;       // webSocket.loop()和状态更新
+static const uint32_t DURATION_US = 10000000;   // 模拟10秒
+
+struct Workload {
+    uint32_t blockIntervalUs;   // 块封装间隔
+    uint32_t sendCostUs;        // 写入一条消息的耗时（链路容量）
+};
+
+struct Result {
+    uint32_t produced;
+    uint32_t sent;
+    uint32_t maxLoopGapUs;      // 相邻两次webSocket.loop()的最大间隔
+    uint32_t maxQueued;
+    double avgLatencyUs;        // 块封装到写入套接字
+    double blocksPerSecond;
+};
+
+// 块队列：只记录封装时刻，用于统计延迟
+static const uint32_t QUEUE_CAPACITY = 100000;
+static uint32_t sealTimes[QUEUE_CAPACITY];
+
+struct Simulation {
+    const Workload& workload;
+    uint32_t now;
+    uint32_t nextSeal;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t lastLoop;
+    Result result;
+    double latencySum;
+
+    explicit Simulation(const Workload& w) : workload(w), now(0), nextSeal(0), head(0), tail(0), lastLoop(0), latencySum(0.0) {
+        memset(&result, 0, sizeof(result));
+    }
+
+    // 推进时间，期间封装的块进入队列
+    void advance(uint32_t us) {
+        now += us;
+        while (nextSeal <= now && tail < QUEUE_CAPACITY) {
+            sealTimes[tail++] = nextSeal;
+            nextSeal += workload.blockIntervalUs;
+            result.produced++;
+        }
+        if (tail - head > result.maxQueued) {
+            result.maxQueued = tail - head;
+        }
+    }
+
+    // 等待通知：有块封装时立即唤醒，否则等到超时
+    void waitForNotify(uint32_t timeoutUs) {
+        if (head < tail) {
+            return;
+        }
+        uint32_t wake = nextSeal - now < timeoutUs ? nextSeal - now : timeoutUs;
+        advance(wake);
+    }
+
+    void serviceLoop() {
+        if (now - lastLoop > result.maxLoopGapUs && lastLoop != 0) {
+            result.maxLoopGapUs = now - lastLoop;
+        }
+        lastLoop = now;
+        advance(LOOP_COST_US);
+    }
+
+    bool sendOne() {
+        if (head == tail) {
+            return false;
+        }
+        advance(workload.sendCostUs);
+        latencySum += now - sealTimes[head++];
+        result.sent++;
+        return true;
+    }
+
+    Result finish() {
+        result.avgLatencyUs = result.sent ? latencySum / result.sent : 0.0;
+        result.blocksPerSecond = result.sent * 1e6 / now;
+        return result;
+    }
+};
+
+// 按LoopPacer节拍的发送循环：被块封装通知唤醒，连续发送到队列为空或时间片用尽，用尽时只让出不等待
+static Result runPaced(const Workload& workload) {
+    Simulation sim(workload);
+    LoopPacer pacer(LOOP_INTERVAL_MS);
+    while (sim.now < DURATION_US) {
+        sim.serviceLoop();
+        pacer.beginRound(sim.now / 1000);
+        while (sim.sendOne()) {
+            if (pacer.shouldYield(sim.now / 1000)) {
+                break;
+            }
+        }
+        uint32_t waitMs = pacer.nextWaitMs(LOOP_INTERVAL_MS);
+        if (waitMs > 0) {
+            sim.waitForNotify(waitMs * 1000);
+        }
+    }
+    return sim.finish();
+}
+
+static void report(const char* name, const Result& result) {
+    char message[200];
+    snprintf(message, sizeof(message), "%s: %.0f blocks/s, avg latency %.2f ms, max loop gap %.2f ms, max queued %u",
+             name, result.blocksPerSecond, result.avgLatencyUs / 1000.0, result.maxLoopGapUs / 1000.0, result.maxQueued);
+    TEST_MESSAGE(message);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_yield_at_slice_boundary(void) {
+    LoopPacer pacer(LOOP_INTERVAL_MS);
+    pacer.beginRound(1000);
+    TEST_ASSERT_FALSE(pacer.shouldYield(1000));
+    TEST_ASSERT_FALSE(pacer.shouldYield(1000 + LOOP_INTERVAL_MS - 1));
+    TEST_ASSERT_EQUAL_UINT32(LOOP_INTERVAL_MS, pacer.nextWaitMs(LOOP_INTERVAL_MS));
+    TEST_ASSERT_TRUE(pacer.shouldYield(1000 + LOOP_INTERVAL_MS));
+    // 让出后本轮不再等待，直到下一轮开始
+    TEST_ASSERT_TRUE(pacer.hasYielded());
+    TEST_ASSERT_EQUAL_UINT32(0, pacer.nextWaitMs(LOOP_INTERVAL_MS));
+    pacer.beginRound(1000 + LOOP_INTERVAL_MS);
+    TEST_ASSERT_FALSE(pacer.hasYielded());
+    TEST_ASSERT_EQUAL_UINT32(LOOP_INTERVAL_MS, pacer.nextWaitMs(LOOP_INTERVAL_MS));
+}
+
+void test_slice_across_millis_wrap(void) {
+    LoopPacer pacer(LOOP_INTERVAL_MS);
+    pacer.beginRound(0xFFFFFFFFu - 3);
+    TEST_ASSERT_FALSE(pacer.shouldYield(2));
+    TEST_ASSERT_TRUE(pacer.shouldYield(LOOP_INTERVAL_MS - 4));
+    pacer.setSlice(50);
+    TEST_ASSERT_EQUAL_UINT32(50, pacer.getSlice());
+}
+
+void test_drains_ready_blocks_each_wakeup(void) {
+    Workload workload = {500, 150};
+    Result result = runPaced(workload);
+    report("notify + drain", result);
+    TEST_ASSERT_GREATER_OR_EQUAL(1990, (uint32_t)result.blocksPerSecond);
+    TEST_ASSERT_LESS_THAN(1000, (uint32_t)result.avgLatencyUs);
+    TEST_ASSERT_LESS_OR_EQUAL(LOOP_INTERVAL_MS * 1000 + LOOP_COST_US, result.maxLoopGapUs);
+}
+
+void test_backlog_yields_every_slice(void) {
+    // 产生速率超过写入速度：每条消息都写满，loop间隔不超过时间片加一条消息
+    Workload workload = {500, 800};
+    Result result = runPaced(workload);
+    report("saturated link", result);
+    double linkCapacity = 1e6 / workload.sendCostUs;
+    TEST_ASSERT_GREATER_OR_EQUAL((uint32_t)(linkCapacity * 0.95), (uint32_t)result.blocksPerSecond);
+    TEST_ASSERT_LESS_OR_EQUAL(LOOP_INTERVAL_MS * 1000 + workload.sendCostUs + LOOP_COST_US, result.maxLoopGapUs);
+}
+
+void test_idle_loop_still_wakes_on_interval(void) {
+    // 没有块时最长等待间隔后仍醒来处理WebSocket事件
+    Workload workload = {DURATION_US * 2, 150};
+    Simulation sim(workload);
+    sim.nextSeal = DURATION_US * 2;
+    LoopPacer pacer(LOOP_INTERVAL_MS);
+    uint32_t loops = 0;
+    while (sim.now < 1000000) {
+        sim.serviceLoop();
+        loops++;
+        pacer.beginRound(sim.now / 1000);
+        TEST_ASSERT_FALSE(sim.sendOne());
+        sim.waitForNotify(pacer.nextWaitMs(LOOP_INTERVAL_MS) * 1000);
+    }
+    Result result = sim.finish();
+    TEST_ASSERT_GREATER_OR_EQUAL(90, loops);
+    TEST_ASSERT_LESS_OR_EQUAL(LOOP_INTERVAL_MS * 1000 + LOOP_COST_US, result.maxLoopGapUs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_yield_at_slice_boundary);
+    RUN_TEST(test_slice_across_millis_wrap);
+    RUN_TEST(test_drains_ready_blocks_each_wakeup);
+    RUN_TEST(test_backlog_yields_every_slice);
+    RUN_TEST(test_idle_loop_still_wakes_on_interval);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+// NTP时钟：每10分钟一次NTP测量共40次，ESP32时钟相对UTC漂移-30ppm，测量带±2ms抖动，第30次时服务器时间跳变3秒。
+// 按1秒分辨率检查漂移估计、逐渐修正的速度上限、修正完成后的偏移误差、esp+N单调不减，以及跳变处理
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include "NtpClock.h"
+
+static const float MAX_SLEW_PPM = 500.0f;               // Config::NTP_MAX_SLEW_PPM
+static const float STEP_THRESHOLD_MS = 1000.0f;         // Config::NTP_STEP_THRESHOLD_MS
+static const float MAX_DRIFT_PPM = 200.0f;              // Config::NTP_MAX_DRIFT_PPM
+static const int64_t SYNC_INTERVAL_US = 600000000LL;    // Config::NTP_SYNC_INTERVAL_MS
+static const uint32_t SYNC_COUNT = 40;
+static const uint32_t JUMP_SYNC = 30;                   // 第30次测量时服务器时间跳变
+static const int64_t JUMP_US = 3000000;
+static const double DRIFT_PPM = -30.0;
+static const double JITTER_US = 2000.0;
+static const int64_t ESP_START_US = 5000000;            // 开机5秒后第一次同步
+static const int64_t UTC_AT_START_US = 1710432000000000LL;
+static const uint32_t SETTLE_SYNCS = 3;
+
+static NtpClock ntpClock;
+static uint32_t randomState;
+
+// 确定性的均匀分布[-1, 1)
+static double nextRandom() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return (double)(randomState >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// 真实偏移 UTC - ESP32时间，jumped表示服务器时间已跳变
+static double trueOffset(int64_t espUs, bool jumped) {
+    return (double)(UTC_AT_START_US - ESP_START_US) + (double)(espUs - ESP_START_US) * DRIFT_PPM * 1e-6 +
+           (jumped ? JUMP_US : 0);
+}
+
+struct Simulation {
+    double driftErrorBeforeJump;    // 跳变前最后一次测量后的漂移估计误差(ppm)
+    double driftErrorAtEnd;
+    double maxSlewPpm;              // 相对漂移直线的修正速度，1秒分辨率
+    double maxSettledErrorMs;       // 下一次测量前（修正已完成）相对真实偏移的误差
+    uint32_t backwards;             // esp+N倒退的次数
+    bool jumpStepped;
+    NtpClock::Stats stats;
+};
+
+static Simulation simulate() {
+    Simulation result = {};
+    int64_t previousGlobal = 0;
+    for (uint32_t sync = 1; sync <= SYNC_COUNT; sync++) {
+        int64_t espUs = ESP_START_US + (int64_t)(sync - 1) * SYNC_INTERVAL_US;
+        bool jumped = sync >= JUMP_SYNC;
+        double utc = (double)espUs + trueOffset(espUs, jumped) + JITTER_US * nextRandom();
+        NtpClock::Model model = ntpClock.addMeasurement(espUs, (int64_t)llround(utc));
+
+        NtpClock::Measurement latest;
+        TEST_ASSERT_TRUE(ntpClock.getHistory(0, latest));
+        if (sync == JUMP_SYNC) {
+            result.jumpStepped = latest.stepped;
+        }
+        if (sync == JUMP_SYNC - 1) {
+            result.driftErrorBeforeJump = fabs(model.driftPpm - DRIFT_PPM);
+        }
+        if (sync == SYNC_COUNT) {
+            result.driftErrorAtEnd = fabs(model.driftPpm - DRIFT_PPM);
+        }
+
+        // 到下一次测量前按1秒分辨率计算偏移
+        int64_t previousOffset = NtpClock::offsetAt(model, espUs);
+        if (sync > 1 && espUs + previousOffset < previousGlobal) {
+            result.backwards++;
+        }
+        previousGlobal = espUs + previousOffset;
+        for (int64_t t = espUs + 1000000; t < espUs + SYNC_INTERVAL_US; t += 1000000) {
+            int64_t offset = NtpClock::offsetAt(model, t);
+            double slewPpm = fabs((double)(offset - previousOffset) - model.driftPpm);
+            if (slewPpm > result.maxSlewPpm) {
+                result.maxSlewPpm = slewPpm;
+            }
+            if (t + offset < previousGlobal) {
+                result.backwards++;
+            }
+            previousOffset = offset;
+            previousGlobal = t + offset;
+        }
+
+        // 跳变后（含首次）前几次测量的漂移估计只基于两三个点，之后才统计修正完成后的误差
+        int64_t settledUs = espUs + SYNC_INTERVAL_US - 1000000;
+        uint32_t sinceStep = sync >= JUMP_SYNC ? sync - JUMP_SYNC : sync - 1;
+        if (sinceStep >= SETTLE_SYNCS) {
+            TEST_ASSERT_TRUE(model.slewEndUs < settledUs);
+            double error = fabs((double)NtpClock::offsetAt(model, settledUs) - trueOffset(settledUs, jumped)) / 1000.0;
+            if (error > result.maxSettledErrorMs) {
+                result.maxSettledErrorMs = error;
+            }
+        }
+    }
+    result.stats = ntpClock.getStats();
+    return result;
+}
+
+void setUp(void) {
+    randomState = 2024;
+    ntpClock = NtpClock();
+    ntpClock.configure(MAX_SLEW_PPM, STEP_THRESHOLD_MS, MAX_DRIFT_PPM);
+}
+
+void tearDown(void) {}
+
+void test_offset_is_zero_before_first_sync(void) {
+    // 第一次同步前N为0，时间戳是ESP32开机后的时间（消息中ntp_synced为false）
+    TEST_ASSERT_FALSE(ntpClock.getModel().valid);
+    TEST_ASSERT_EQUAL_INT64(0, NtpClock::offsetAt(ntpClock.getModel(), 123456789));
+    NtpClock::Measurement measurement;
+    TEST_ASSERT_FALSE(ntpClock.getHistory(0, measurement));
+
+    // 第一次测量直接跳变到测得的偏移
+    const NtpClock::Model& model = ntpClock.addMeasurement(ESP_START_US, UTC_AT_START_US);
+    TEST_ASSERT_TRUE(model.valid);
+    TEST_ASSERT_EQUAL_INT64(UTC_AT_START_US - ESP_START_US, NtpClock::offsetAt(model, ESP_START_US));
+    TEST_ASSERT_EQUAL_UINT32(1, ntpClock.getStats().steps);
+}
+
+void test_forty_syncs_with_drift_jitter_and_server_jump(void) {
+    Simulation result = simulate();
+    char message[200];
+    snprintf(message, sizeof(message),
+             "%u syncs: drift error %.3f ppm before jump, %.3f ppm at end, slew %.1f ppm, settled error %.2f ms, %u steps, %u slews",
+             SYNC_COUNT, result.driftErrorBeforeJump, result.driftErrorAtEnd, result.maxSlewPpm,
+             result.maxSettledErrorMs, result.stats.steps, result.stats.slews);
+    TEST_MESSAGE(message);
+
+    // 8次测量（70分钟）的最小二乘斜率，±2ms抖动下标准误差约0.3ppm
+    TEST_ASSERT_TRUE(result.driftErrorBeforeJump < 1.0);
+    TEST_ASSERT_TRUE(result.driftErrorAtEnd < 1.0);
+    // 1秒分辨率下偏移取整到微秒，最多多出1ppm
+    TEST_ASSERT_TRUE(result.maxSlewPpm <= MAX_SLEW_PPM + 1.0);
+    TEST_ASSERT_TRUE(result.maxSettledErrorMs < 2.5);
+    TEST_ASSERT_EQUAL_UINT32(0, result.backwards);
+    // 首次同步和服务器跳变直接跳变，其余逐渐修正
+    TEST_ASSERT_TRUE(result.jumpStepped);
+    TEST_ASSERT_EQUAL_UINT32(SYNC_COUNT, result.stats.measurements);
+    TEST_ASSERT_EQUAL_UINT32(2, result.stats.steps);
+    TEST_ASSERT_EQUAL_UINT32(SYNC_COUNT - 2, result.stats.slews);
+    TEST_ASSERT_TRUE(result.stats.maxErrorUs < (int32_t)(STEP_THRESHOLD_MS * 1000.0f));
+}
+
+void test_history_keeps_latest_measurements(void) {
+    simulate();
+    TEST_ASSERT_EQUAL_UINT8(NtpClock::HISTORY_SIZE, ntpClock.getHistoryCount());
+    NtpClock::Measurement newest;
+    NtpClock::Measurement oldest;
+    TEST_ASSERT_TRUE(ntpClock.getHistory(0, newest));
+    TEST_ASSERT_TRUE(ntpClock.getHistory(NtpClock::HISTORY_SIZE - 1, oldest));
+    TEST_ASSERT_FALSE(ntpClock.getHistory(NtpClock::HISTORY_SIZE, oldest));
+    TEST_ASSERT_EQUAL_INT64(ESP_START_US + (int64_t)(SYNC_COUNT - 1) * SYNC_INTERVAL_US, newest.espUs);
+    TEST_ASSERT_EQUAL_INT64(newest.espUs - (NtpClock::HISTORY_SIZE - 1) * SYNC_INTERVAL_US, oldest.espUs);
+    TEST_ASSERT_FALSE(newest.stepped);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_offset_is_zero_before_first_sync);
+    RUN_TEST(test_forty_syncs_with_drift_jitter_and_server_jump);
+    RUN_TEST(test_history_keeps_latest_measurements);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+// 省电上传调度：窗口到期和暂存块过多时进入突发、突发上传完成或超时后回到空闲、
+// 每次突发一次心跳，以及模拟一分钟上传下的占空比和每分钟无线电常开时间
+#include <unity.h>
+#include <stdio.h>
+#include "PowerScheduler.h"
+
+static const uint32_t WINDOW_MS = 5000;         // Config::POWER_BATCH_WINDOW_MS
+static const uint32_t MAX_BURST_MS = 2000;      // Config::POWER_MAX_BURST_MS
+static const uint32_t FLUSH_THRESHOLD = 96;     // Config::POWER_FLUSH_THRESHOLD_BLOCKS
+
+static PowerScheduler scheduler;
+
+void setUp(void) {
+    scheduler = PowerScheduler();
+    scheduler.configure(WINDOW_MS, MAX_BURST_MS, FLUSH_THRESHOLD);
+}
+
+void tearDown(void) {}
+
+void test_disabled_scheduler_keeps_radio_on(void) {
+    TEST_ASSERT_FALSE(scheduler.isEnabled());
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::ALWAYS_ON);
+    TEST_ASSERT_TRUE(scheduler.isRadioNeeded());
+    TEST_ASSERT_FALSE(scheduler.shouldHoldBlocks());
+    TEST_ASSERT_FALSE(scheduler.update(100000, 1000, false, true));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, scheduler.getDutyCycle(100000));
+}
+
+void test_window_expiry_starts_burst_and_drain_ends_it(void) {
+    scheduler.setEnabled(true, 1000);
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::IDLE);
+    TEST_ASSERT_TRUE(scheduler.shouldHoldBlocks());
+    TEST_ASSERT_FALSE(scheduler.isRadioNeeded());
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_MS, scheduler.getTimeToNextBurst(1000));
+    TEST_ASSERT_EQUAL_UINT32(2000, scheduler.getTimeToNextBurst(4000));
+
+    TEST_ASSERT_FALSE(scheduler.update(1000 + WINDOW_MS - 1, 10, false, false));
+    TEST_ASSERT_TRUE(scheduler.update(1000 + WINDOW_MS, 10, false, false));
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::BURST);
+    TEST_ASSERT_TRUE(scheduler.isRadioNeeded());
+    TEST_ASSERT_FALSE(scheduler.shouldHoldBlocks());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getTimeToNextBurst(1000 + WINDOW_MS));
+
+    // 上传未完成时保持突发，完成后回到空闲并重新计时
+    TEST_ASSERT_FALSE(scheduler.update(6300, 2, false, false));
+    TEST_ASSERT_TRUE(scheduler.update(6400, 0, true, false));
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::IDLE);
+    TEST_ASSERT_EQUAL_UINT32(400, scheduler.getLastBurstMs());
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getBurstCount());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getEarlyFlushes());
+    TEST_ASSERT_EQUAL_UINT32(WINDOW_MS, scheduler.getTimeToNextBurst(6400));
+}
+
+void test_threshold_and_flush_request_start_early_burst(void) {
+    scheduler.setEnabled(true, 0);
+    TEST_ASSERT_FALSE(scheduler.update(100, FLUSH_THRESHOLD - 1, false, false));
+    TEST_ASSERT_TRUE(scheduler.update(200, FLUSH_THRESHOLD, false, false));
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getEarlyFlushes());
+    TEST_ASSERT_TRUE(scheduler.update(300, 0, true, false));
+
+    // 停止采集等需要立即上传：即使已上传完也保持突发，直到请求撤销
+    TEST_ASSERT_TRUE(scheduler.update(400, 0, false, true));
+    TEST_ASSERT_EQUAL_UINT32(2, scheduler.getEarlyFlushes());
+    TEST_ASSERT_FALSE(scheduler.update(500, 0, true, true));
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::BURST);
+    TEST_ASSERT_TRUE(scheduler.update(600, 0, true, false));
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::IDLE);
+
+    // 阈值为0时不按暂存块数提前突发
+    scheduler.configure(WINDOW_MS, MAX_BURST_MS, 0);
+    TEST_ASSERT_FALSE(scheduler.update(700, 100000, false, false));
+}
+
+void test_burst_is_bounded_when_link_is_down(void) {
+    // 链路异常上传不完：突发达到最长时间后回到空闲，无线电不会一直常开
+    scheduler.setEnabled(true, 0);
+    TEST_ASSERT_TRUE(scheduler.update(WINDOW_MS, 50, false, false));
+    TEST_ASSERT_FALSE(scheduler.update(WINDOW_MS + MAX_BURST_MS - 1, 50, false, true));
+    TEST_ASSERT_TRUE(scheduler.update(WINDOW_MS + MAX_BURST_MS, 50, false, true));
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::IDLE);
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getBurstTimeouts());
+    TEST_ASSERT_EQUAL_UINT32(MAX_BURST_MS, scheduler.getMaxBurstMs());
+}
+
+void test_heartbeat_due_once_per_burst(void) {
+    scheduler.setEnabled(true, 0);
+    TEST_ASSERT_FALSE(scheduler.consumeHeartbeatDue());
+    for (uint32_t burst = 1; burst <= 3; burst++) {
+        uint32_t start = burst * (WINDOW_MS + 100) - 100;
+        scheduler.update(start, 0, false, false);
+        TEST_ASSERT_TRUE(scheduler.consumeHeartbeatDue());
+        TEST_ASSERT_FALSE(scheduler.consumeHeartbeatDue());
+        scheduler.update(start + 100, 0, true, false);
+        TEST_ASSERT_FALSE(scheduler.consumeHeartbeatDue());
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.getBurstCount());
+
+    // 关闭省电模式后不再有待发心跳
+    scheduler.update(4 * (WINDOW_MS + 100), 0, false, false);
+    scheduler.setEnabled(false, 4 * (WINDOW_MS + 100));
+    TEST_ASSERT_FALSE(scheduler.consumeHeartbeatDue());
+    TEST_ASSERT_TRUE(scheduler.isRadioNeeded());
+}
+
+void test_duty_cycle_over_one_minute(void) {
+    // 100Hz x 4个传感器按30帧一块封装，每个窗口约65块；链路约每10ms上传一块（含确认往返）
+    const uint32_t blocksPerSecond = 13;
+    const uint32_t uploadMsPerBlock = 10;
+    scheduler.setEnabled(true, 0);
+    uint32_t held = 0;
+    uint32_t heldAccumulator = 0;
+    uint32_t heldMax = 0;
+    for (uint32_t now = 1; now <= 60000; now++) {
+        if (scheduler.shouldHoldBlocks()) {
+            heldAccumulator += blocksPerSecond;
+            held += heldAccumulator / 1000;
+            heldAccumulator %= 1000;
+        } else if (held > 0 && now % uploadMsPerBlock == 0) {
+            held--;
+        }
+        if (held > heldMax) {
+            heldMax = held;
+        }
+        scheduler.update(now, held, held == 0, false);
+    }
+
+    float duty = scheduler.getDutyCycle(60000);
+    float radioOnPerMinute = scheduler.getRadioOnMsPerMinute(60000);
+    char message[160];
+    snprintf(message, sizeof(message), "%u bursts, last %u ms, duty cycle %.1f%%, radio on %.0f ms/min, max held %u blocks",
+             scheduler.getBurstCount(), scheduler.getLastBurstMs(), duty * 100.0f, radioOnPerMinute, heldMax);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getBurstTimeouts());
+    TEST_ASSERT_GREATER_OR_EQUAL(10, scheduler.getBurstCount());
+    TEST_ASSERT_LESS_THAN(FLUSH_THRESHOLD, heldMax);
+    // 每个窗口约650ms常开，占空比约11%，远低于常开模式
+    TEST_ASSERT_FLOAT_WITHIN(0.03f, 0.115f, duty);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, duty * 60000.0f, radioOnPerMinute);
+}
+
+void test_reset_stats_mid_burst_counts_only_remaining_time(void) {
+    scheduler.setEnabled(true, 0);
+    scheduler.update(WINDOW_MS, 10, false, false);
+    scheduler.resetStats(WINDOW_MS + 500);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getBurstCount());
+    TEST_ASSERT_TRUE(scheduler.getPhase() == PowerScheduler::Phase::BURST);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, scheduler.getDutyCycle(WINDOW_MS + 1000));
+
+    scheduler.update(WINDOW_MS + 1000, 0, true, false);
+    // 重置后1000ms中常开500ms
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, scheduler.getDutyCycle(WINDOW_MS + 1500));
+    TEST_ASSERT_EQUAL_UINT32(1000, scheduler.getLastBurstMs());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_disabled_scheduler_keeps_radio_on);
+    RUN_TEST(test_window_expiry_starts_burst_and_drain_ends_it);
+    RUN_TEST(test_threshold_and_flush_request_start_early_burst);
+    RUN_TEST(test_burst_is_bounded_when_link_is_down);
+    RUN_TEST(test_heartbeat_due_once_per_burst);
+    RUN_TEST(test_duty_cycle_over_one_minute);
+    RUN_TEST(test_reset_stats_mid_burst_counts_only_remaining_time);
+    return UNITY_END();
+}
@@ -0,0 +1,207 @@
+// 上传速率控制：按1秒控制周期喂入队列深度、丢弃数、写入字节和发送暂停，
+// 检查第一个周期只建立基准、队列增长或丢块时降级、保持时间内不再变化、最高等级封顶、
+// 连续无积压后逐级恢复、恢复后很快再次拥塞时下一次恢复前的等待加倍（失败探测退避），以及容量估计
+#include <unity.h>
+#include "RateController.h"
+
+static const uint32_t INTERVAL_MS = 1000;       // Config::RATE_CONTROL_INTERVAL_MS
+static const uint32_t HIGH_WATERMARK = 5;       // Config::RATE_QUEUE_HIGH_WATERMARK
+static const uint32_t LOW_WATERMARK = 1;        // Config::RATE_QUEUE_LOW_WATERMARK
+static const uint32_t HOLD_MS = 3000;           // Config::RATE_CONTROL_HOLD_MS
+static const uint8_t RECOVER_INTERVALS = 5;     // Config::RATE_RECOVER_INTERVALS
+
+static RateController controller;
+static uint32_t now;
+static uint32_t queued;
+static uint32_t dropped;
+
+// 推进一个控制周期，返回等级是否变化
+static bool step(uint32_t queuedBlocks, uint32_t bytes = 20000, bool stall = false) {
+    now += INTERVAL_MS;
+    queued = queuedBlocks;
+    controller.onBytesWritten(bytes);
+    if (stall) {
+        controller.onSendStall();
+    }
+    TEST_ASSERT_TRUE(controller.isUpdateDue(now));
+    return controller.update(now, queued, dropped);
+}
+
+// 队列越过高水位并增长：不在保持时间内时降一级
+static void congest() {
+    TEST_ASSERT_TRUE(step(queued + HIGH_WATERMARK + 1));
+}
+
+// 连续无积压直到等级恢复一级，返回用了多少个周期（上限200）
+static uint32_t calmUntilRecovered() {
+    UploadLevel before = controller.getLevel();
+    for (uint32_t intervals = 1; intervals <= 200; intervals++) {
+        if (step(0)) {
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)before - 1, (uint8_t)controller.getLevel());
+            return intervals;
+        }
+    }
+    return 0;
+}
+
+void setUp(void) {
+    controller = RateController();
+    controller.configure(INTERVAL_MS, HIGH_WATERMARK, LOW_WATERMARK, HOLD_MS, RECOVER_INTERVALS);
+    controller.onMessageEncoded(2000, 1);
+    // 从开机后100秒开始，避开开机时刻的保持时间；第一个周期只建立基准
+    now = 100000;
+    queued = 0;
+    dropped = 0;
+    TEST_ASSERT_FALSE(controller.update(now, queued, dropped));
+}
+
+void tearDown(void) {}
+
+void test_first_update_only_sets_baseline(void) {
+    RateController fresh;
+    fresh.configure(INTERVAL_MS, HIGH_WATERMARK, LOW_WATERMARK, HOLD_MS, RECOVER_INTERVALS);
+    // 第一次就是深队列和丢块，也只记录基准
+    TEST_ASSERT_FALSE(fresh.update(50000, 20, 10));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::NORMAL, (uint8_t)fresh.getLevel());
+    TEST_ASSERT_FALSE(fresh.isUpdateDue(50000 + INTERVAL_MS - 1));
+    TEST_ASSERT_TRUE(fresh.isUpdateDue(50000 + INTERVAL_MS));
+    // 队列没有继续增长、没有新的丢块：不降级
+    TEST_ASSERT_FALSE(fresh.update(50000 + INTERVAL_MS, 20, 10));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::NORMAL, (uint8_t)fresh.getLevel());
+}
+
+void test_degrade_on_queue_growth_and_hold(void) {
+    // 低于高水位的增长不降级
+    TEST_ASSERT_FALSE(step(3));
+    TEST_ASSERT_FALSE(step(HIGH_WATERMARK - 1));
+    // 越过高水位且仍在增长
+    TEST_ASSERT_TRUE(step(HIGH_WATERMARK + 2));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COALESCE, (uint8_t)controller.getLevel());
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::NORMAL, (uint8_t)controller.getPreviousLevel());
+    // 保持时间内继续拥塞也不变
+    TEST_ASSERT_FALSE(step(HIGH_WATERMARK + 4));
+    TEST_ASSERT_FALSE(step(HIGH_WATERMARK + 6));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COALESCE, (uint8_t)controller.getLevel());
+    // 保持时间到期后再降一级
+    TEST_ASSERT_TRUE(step(HIGH_WATERMARK + 8));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COMPACT, (uint8_t)controller.getLevel());
+    TEST_ASSERT_EQUAL_UINT32(2, controller.getLevelChanges());
+}
+
+void test_dropped_blocks_degrade_with_short_queue(void) {
+    dropped = 3;
+    TEST_ASSERT_TRUE(step(0));
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COALESCE, (uint8_t)controller.getLevel());
+}
+
+void test_level_is_capped_at_priority_drop(void) {
+    for (uint8_t i = 0; i < 20; i++) {
+        step(queued + HIGH_WATERMARK + 1);
+    }
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::PRIORITY_DROP, (uint8_t)controller.getLevel());
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)UploadLevel::PRIORITY_DROP, controller.getLevelChanges());
+    TEST_ASSERT_EQUAL_STRING("priority_drop", RateController::getLevelName(controller.getLevel()));
+}
+
+void test_recover_one_level_per_calm_period(void) {
+    congest();
+    now += HOLD_MS;
+    congest();
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COMPACT, (uint8_t)controller.getLevel());
+    // 每次恢复一级，各需要连续RECOVER_INTERVALS个无积压周期
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COALESCE, (uint8_t)controller.getLevel());
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::NORMAL, (uint8_t)controller.getLevel());
+    // NORMAL不再恢复
+    for (uint8_t i = 0; i < 20; i++) {
+        TEST_ASSERT_FALSE(step(0));
+    }
+}
+
+void test_backlog_or_stall_interrupts_calm_period(void) {
+    congest();
+    for (uint8_t i = 0; i < RECOVER_INTERVALS - 1; i++) {
+        TEST_ASSERT_FALSE(step(0));
+    }
+    // 队列高于低水位（未拥塞）时重新计数
+    TEST_ASSERT_FALSE(step(LOW_WATERMARK + 1));
+    for (uint8_t i = 0; i < RECOVER_INTERVALS - 1; i++) {
+        TEST_ASSERT_FALSE(step(0));
+    }
+    // 发送暂停同样重新计数
+    TEST_ASSERT_FALSE(step(0, 20000, true));
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+}
+
+void test_failed_probe_doubles_next_recovery_wait(void) {
+    congest();
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+
+    // 恢复到NORMAL后保持时间一过就再次拥塞：失败的探测，下一次恢复前的等待加倍
+    uint32_t expected = RECOVER_INTERVALS;
+    for (uint8_t failures = 1; failures <= 4; failures++) {
+        while (!step(queued + HIGH_WATERMARK + 1)) {
+        }
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::COALESCE, (uint8_t)controller.getLevel());
+        expected *= 2;
+        TEST_ASSERT_EQUAL_UINT32(expected, calmUntilRecovered());
+        queued = 0;
+    }
+    // 加倍最多4次
+    while (!step(queued + HIGH_WATERMARK + 1)) {
+    }
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS << 4, calmUntilRecovered());
+
+    // 在NORMAL稳定运行满一个等待期后退避清零
+    for (uint32_t i = 0; i < (uint32_t)RECOVER_INTERVALS << 4; i++) {
+        TEST_ASSERT_FALSE(step(0));
+    }
+    congest();
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+}
+
+void test_late_congestion_is_not_a_failed_probe(void) {
+    congest();
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+    // 恢复后超过两倍保持时间才拥塞：不算失败的探测
+    for (uint32_t i = 0; i < 2 * HOLD_MS / INTERVAL_MS; i++) {
+        TEST_ASSERT_FALSE(step(0));
+    }
+    congest();
+    TEST_ASSERT_EQUAL_UINT32(RECOVER_INTERVALS, calmUntilRecovered());
+}
+
+void test_capacity_estimate(void) {
+    // 没有发送暂停时吞吐量只是容量的下界，取最大值
+    step(0, 30000);
+    step(0, 10000);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 30000.0f, controller.getCapacityEstimate());
+    // 发送暂停说明链路饱和，容量向实际吞吐量收敛
+    for (uint8_t i = 0; i < 30; i++) {
+        step(queued, 8000, true);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(50.0f, 8000.0f, controller.getCapacityEstimate());
+    TEST_ASSERT_FLOAT_WITHIN(50.0f, 8000.0f, controller.getDemandEstimate());
+    // 队列增长折算进需求：每周期增长1块、每块2000字节，队列保持在高水位以下
+    for (uint8_t i = 0; i < HIGH_WATERMARK - 1; i++) {
+        TEST_ASSERT_FALSE(step(queued + 1, 8000, false));
+    }
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)UploadLevel::NORMAL, (uint8_t)controller.getLevel());
+    // 平滑系数0.3：4个周期后向10000字节/秒靠近约76%
+    TEST_ASSERT_FLOAT_WITHIN(100.0f, 8000.0f + 2000.0f * (1.0f - 0.7f * 0.7f * 0.7f * 0.7f), controller.getDemandEstimate());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_update_only_sets_baseline);
+    RUN_TEST(test_degrade_on_queue_growth_and_hold);
+    RUN_TEST(test_dropped_blocks_degrade_with_short_queue);
+    RUN_TEST(test_level_is_capped_at_priority_drop);
+    RUN_TEST(test_recover_one_level_per_calm_period);
+    RUN_TEST(test_backlog_or_stall_interrupts_calm_period);
+    RUN_TEST(test_failed_probe_doubles_next_recovery_wait);
+    RUN_TEST(test_late_congestion_is_not_a_failed_probe);
+    RUN_TEST(test_capacity_estimate);
+    return UNITY_END();
+}
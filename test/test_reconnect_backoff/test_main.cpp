@@ -0,0 +1,261 @@
+// 断线重连：退避间隔的增长、上限和抖动，以及按虚拟时间模拟的WiFi链路抖动（AP反复断开/恢复），
+// 与WebSocketClient相同地组合WiFi层和WebSocket层两个ReconnectBackoff，检查恢复耗时、尝试次数和断开时长记录
+#include <unity.h>
+#include <stdio.h>
+#include "ReconnectBackoff.h"
+
+static const uint32_t WIFI_BASE_MS = 2000;     // Config::WIFI_RECONNECT_BASE_DELAY_MS
+static const uint32_t WIFI_MAX_MS = 60000;
+static const uint32_t SERVER_BASE_MS = 1000;   // Config::SERVER_RECONNECT_BASE_DELAY_MS
+static const uint32_t SERVER_MAX_MS = 30000;
+static const uint32_t ASSOCIATE_MS = 1500;     // WiFi关联和DHCP耗时
+static const uint32_t HANDSHAKE_MS = 200;      // TCP+WebSocket握手耗时
+
+static uint32_t rngState;
+static uint32_t nextRandom() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return rngState >> 8;
+}
+
+void setUp(void) {
+    rngState = 2024;
+}
+
+void tearDown(void) {}
+
+void test_delay_doubles_up_to_cap_with_bounded_jitter(void) {
+    for (uint32_t attempts = 1; attempts <= 12; attempts++) {
+        uint32_t nominal = WIFI_BASE_MS;
+        for (uint32_t i = 1; i < attempts && nominal < WIFI_MAX_MS; i++) {
+            nominal *= 2;
+        }
+        if (nominal > WIFI_MAX_MS) {
+            nominal = WIFI_MAX_MS;
+        }
+        uint32_t minSeen = 0xFFFFFFFF;
+        uint32_t maxSeen = 0;
+        for (int i = 0; i < 2000; i++) {
+            uint32_t delayMs = ReconnectBackoff::computeDelay(attempts, WIFI_BASE_MS, WIFI_MAX_MS, nextRandom());
+            if (delayMs < minSeen) minSeen = delayMs;
+            if (delayMs > maxSeen) maxSeen = delayMs;
+        }
+        TEST_ASSERT_GREATER_OR_EQUAL(nominal - nominal / 4, minSeen);
+        TEST_ASSERT_LESS_OR_EQUAL(nominal + nominal / 4, maxSeen);
+        // 抖动确实展开了（不是固定值）
+        TEST_ASSERT_GREATER_THAN(nominal / 4, maxSeen - minSeen);
+    }
+}
+
+void test_poll_schedules_next_attempt(void) {
+    ReconnectBackoff backoff;
+    backoff.configure(SERVER_BASE_MS, SERVER_MAX_MS);
+    backoff.onLinkDown(1000);
+    TEST_ASSERT_TRUE(backoff.isDown());
+    TEST_ASSERT_TRUE(backoff.poll(1000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, backoff.getAttempts());
+    uint32_t next = backoff.getNextAttemptTime();
+    TEST_ASSERT_FALSE(backoff.poll(next - 1, 0));
+    TEST_ASSERT_TRUE(backoff.poll(next, 0));
+    TEST_ASSERT_EQUAL_UINT32(2, backoff.getAttempts());
+
+    // 恢复时返回断开时长，尝试次数清零
+    TEST_ASSERT_EQUAL_UINT32(5000, backoff.onLinkUp(6000));
+    TEST_ASSERT_FALSE(backoff.isDown());
+    TEST_ASSERT_EQUAL_UINT32(0, backoff.getAttempts());
+    TEST_ASSERT_EQUAL_UINT32(0, backoff.onLinkUp(7000));
+}
+
+void test_timer_wraparound(void) {
+    ReconnectBackoff backoff;
+    backoff.configure(SERVER_BASE_MS, SERVER_MAX_MS);
+    uint32_t start = 0xFFFFF000u;
+    backoff.onLinkDown(start);
+    TEST_ASSERT_TRUE(backoff.poll(start, 0));
+    uint32_t next = backoff.getNextAttemptTime();
+    TEST_ASSERT_FALSE(backoff.poll(start + 100, 0));
+    TEST_ASSERT_TRUE(backoff.poll(next, 0));
+    TEST_ASSERT_EQUAL_UINT32(0x2000u, backoff.onLinkUp(start + 0x2000u));
+}
+
+// 链路抖动模拟：AP在给定区间内不可用。WiFi层按退避尝试重新关联，关联成功后WebSocket层立即重试
+struct Outage {
+    uint32_t start;
+    uint32_t end;
+};
+
+struct FlapResult {
+    uint32_t wifiAttempts;
+    uint32_t serverAttempts;
+    uint32_t wifiDisconnects;
+    uint32_t maxRecoveryAfterApUpMs;   // AP恢复到WebSocket重新连接的最长时间
+    uint32_t maxWifiDownRecordedMs;    // onLinkUp记录的最长断开时长
+    uint32_t offlineMs;                // WebSocket断开的总时长
+    bool connectedAtEnd;
+};
+
+static bool apAvailable(const Outage* outages, int count, uint32_t now) {
+    for (int i = 0; i < count; i++) {
+        if (now >= outages[i].start && now < outages[i].end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static FlapResult simulateFlaps(const Outage* outages, int count, uint32_t durationMs) {
+    FlapResult result = {0, 0, 0, 0, 0, 0, false};
+    ReconnectBackoff wifiBackoff;
+    ReconnectBackoff serverBackoff;
+    wifiBackoff.configure(WIFI_BASE_MS, WIFI_MAX_MS);
+    serverBackoff.configure(SERVER_BASE_MS, SERVER_MAX_MS);
+
+    bool wifiConnected = true;
+    bool serverConnected = true;
+    uint32_t associateDoneAt = 0;   // 进行中的关联完成时刻，0表示没有
+    bool associateApUp = false;     // 开始关联时AP可用
+    uint32_t handshakeDoneAt = 0;
+    uint32_t apUpSince = 0;
+
+    for (uint32_t now = 1; now < durationMs; now += 10) {
+        bool apUp = apAvailable(outages, count, now);
+        if (!apUp) {
+            apUpSince = 0;
+        } else if (apUpSince == 0) {
+            apUpSince = now;
+        }
+
+        // WiFi事件：AP消失时断开（ARDUINO_EVENT_WIFI_STA_DISCONNECTED）
+        if (wifiConnected && !apUp) {
+            wifiConnected = false;
+            wifiBackoff.onLinkDown(now);
+            result.wifiDisconnects++;
+            associateDoneAt = 0;
+        }
+        // 关联完成（ARDUINO_EVENT_WIFI_STA_GOT_IP），开始或结束时AP不可用则失败
+        if (associateDoneAt != 0 && now >= associateDoneAt) {
+            associateDoneAt = 0;
+            if (associateApUp && apUp) {
+                wifiConnected = true;
+                uint32_t downMs = wifiBackoff.onLinkUp(now);
+                if (downMs > result.maxWifiDownRecordedMs) {
+                    result.maxWifiDownRecordedMs = downMs;
+                }
+                serverBackoff.retryNow(now);
+            }
+        }
+
+        // handleConnectionRetry
+        if (!wifiConnected) {
+            if (serverConnected) {
+                serverConnected = false;
+                serverBackoff.onLinkDown(now);
+                handshakeDoneAt = 0;
+            }
+            if (wifiBackoff.poll(now, nextRandom())) {
+                result.wifiAttempts++;
+                if (associateDoneAt == 0) {
+                    associateDoneAt = now + ASSOCIATE_MS;
+                    associateApUp = apUp;
+                }
+            }
+        } else if (!serverConnected) {
+            if (handshakeDoneAt != 0 && now >= handshakeDoneAt) {
+                handshakeDoneAt = 0;
+                serverConnected = true;
+                serverBackoff.onLinkUp(now);
+                uint32_t recovery = now - apUpSince;
+                if (recovery > result.maxRecoveryAfterApUpMs) {
+                    result.maxRecoveryAfterApUpMs = recovery;
+                }
+            } else if (serverBackoff.poll(now, nextRandom())) {
+                result.serverAttempts++;
+                handshakeDoneAt = now + HANDSHAKE_MS;
+            }
+        }
+        if (!serverConnected) {
+            result.offlineMs += 10;
+        }
+    }
+    result.connectedAtEnd = serverConnected;
+    return result;
+}
+
+void test_short_flaps_recover_quickly(void) {
+    // 每分钟一次3秒的短暂断开
+    Outage outages[10];
+    for (int i = 0; i < 10; i++) {
+        outages[i].start = 30000 + i * 60000;
+        outages[i].end = outages[i].start + 3000;
+    }
+    FlapResult result = simulateFlaps(outages, 10, 660000);
+    char message[160];
+    snprintf(message, sizeof(message), "short flaps: max recovery %u ms, wifi attempts %u, server attempts %u, offline %u ms",
+             result.maxRecoveryAfterApUpMs, result.wifiAttempts, result.serverAttempts, result.offlineMs);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(result.connectedAtEnd);
+    TEST_ASSERT_EQUAL_UINT32(10, result.wifiDisconnects);
+    // 断开3秒时退避间隔仍在前两级，恢复耗时不超过一次退避间隔加关联和握手
+    TEST_ASSERT_LESS_OR_EQUAL(WIFI_BASE_MS * 2 * 5 / 4 + ASSOCIATE_MS + HANDSHAKE_MS + 20, result.maxRecoveryAfterApUpMs);
+    // 记录的断开时长覆盖整个断开期间
+    TEST_ASSERT_GREATER_OR_EQUAL(3000, result.maxWifiDownRecordedMs);
+    // WiFi恢复后WebSocket立即重试，一次握手即连上
+    TEST_ASSERT_EQUAL_UINT32(10, result.serverAttempts);
+}
+
+void test_long_outage_does_not_storm(void) {
+    // 10分钟断开：尝试间隔增长到上限，尝试次数按对数增长再线性增长
+    Outage outage = {10000, 610000};
+    FlapResult result = simulateFlaps(&outage, 1, 700000);
+    char message[160];
+    snprintf(message, sizeof(message), "10 min outage: wifi attempts %u, recovery %u ms, recorded down %u ms",
+             result.wifiAttempts, result.maxRecoveryAfterApUpMs, result.maxWifiDownRecordedMs);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(result.connectedAtEnd);
+    // 2、4、8、16、32秒后按60秒±25%：600秒内不超过5+600/45次
+    TEST_ASSERT_LESS_OR_EQUAL(5 + 600 / 45 + 1, result.wifiAttempts);
+    TEST_ASSERT_GREATER_OR_EQUAL(8, result.wifiAttempts);
+    // AP恢复后最迟一个最大间隔内重新连接
+    TEST_ASSERT_LESS_OR_EQUAL(WIFI_MAX_MS * 5 / 4 + ASSOCIATE_MS + HANDSHAKE_MS + 20, result.maxRecoveryAfterApUpMs);
+    TEST_ASSERT_GREATER_OR_EQUAL(600000, result.maxWifiDownRecordedMs);
+}
+
+void test_flap_during_association(void) {
+    // AP在关联途中再次消失：关联失败后继续按退避重试，最终恢复
+    Outage outages[4] = {{10000, 12000}, {12800, 20000}, {21000, 21500}, {22500, 30000}};
+    FlapResult result = simulateFlaps(outages, 4, 120000);
+    TEST_ASSERT_TRUE(result.connectedAtEnd);
+    TEST_ASSERT_GREATER_THAN(2, result.wifiAttempts);
+    TEST_ASSERT_LESS_OR_EQUAL(WIFI_MAX_MS, result.maxRecoveryAfterApUpMs);
+}
+
+void test_jitter_spreads_fleet_reconnects(void) {
+    // 50台网关同时断开，第5次尝试的时刻分散开，不会同时冲击服务器
+    const int fleet = 50;
+    uint32_t minTime = 0xFFFFFFFF;
+    uint32_t maxTime = 0;
+    for (int g = 0; g < fleet; g++) {
+        ReconnectBackoff backoff;
+        backoff.configure(SERVER_BASE_MS, SERVER_MAX_MS);
+        backoff.onLinkDown(0);
+        uint32_t now = 0;
+        for (int attempt = 0; attempt < 5; attempt++) {
+            backoff.poll(now, nextRandom());
+            now = backoff.getNextAttemptTime();
+        }
+        if (now < minTime) minTime = now;
+        if (now > maxTime) maxTime = now;
+    }
+    TEST_ASSERT_GREATER_THAN(5000, maxTime - minTime);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_delay_doubles_up_to_cap_with_bounded_jitter);
+    RUN_TEST(test_poll_schedules_next_attempt);
+    RUN_TEST(test_timer_wraparound);
+    RUN_TEST(test_short_flaps_recover_quickly);
+    RUN_TEST(test_long_outage_does_not_storm);
+    RUN_TEST(test_flap_during_association);
+    RUN_TEST(test_jitter_spreads_fleet_reconnects);
+    return UNITY_END();
+}
@@ -0,0 +1,355 @@
+// 补发：按SessionRecorder::readResend的方式用游标分次读回会话记录，验证时间、传感器和块号范围的组合、
+// 块号超过范围后立即结束、取消后不再读出、进行中的会话只补发已记录的部分，
+// 以及存储支持映射时载荷直接指向映射的闪存（经过FlashRegion），不读入中间缓冲区
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "SessionLog.h"
+
+static const char* LOG_PATH = "/tmp/test_resend_range.bin";
+static const size_t SEGMENT_SIZE = 0x10000;         // Config::RECORDER_SEGMENT_SIZE
+static const size_t BUFFER_SIZE = 8192;             // Config::RECORDER_WRITE_BUFFER_SIZE
+static const size_t REGION_OFFSET = SEGMENT_SIZE;   // 会话记录占分区的后一部分
+static const size_t REGION_SIZE = 8 * SEGMENT_SIZE;
+static const size_t RECORD_SIZE = 1900;
+static const uint64_t BLOCK_SPAN_MS = 300;
+static const uint8_t RECORDS_PER_READ = 8;          // readResend每轮最多检查的记录数
+static const uint32_t MAX_BLOCKS = 512;
+
+// 用文件模拟分区，另在RAM中保留一份内容用于映射（相当于esp_partition_mmap），统计读取量
+class MappedStorage : public FlashStorage {
+public:
+    FileStorage file;
+    uint8_t image[REGION_OFFSET + REGION_SIZE];
+    bool mappable;
+    uint64_t bytesRead;
+    uint32_t maps;
+
+    bool open(const char* path) {
+        mappable = false;
+        bytesRead = 0;
+        maps = 0;
+        return file.open(path, sizeof(image)) && file.read(0, image, sizeof(image));
+    }
+    size_t size() const override { return file.size(); }
+    bool read(size_t offset, void* data, size_t length) override {
+        bytesRead += length;
+        return file.read(offset, data, length);
+    }
+    bool write(size_t offset, const void* data, size_t length) override {
+        // 按NOR语义写入后从文件读回，映射看到的内容与闪存一致
+        return file.write(offset, data, length) && file.read(offset, image + offset, length);
+    }
+    bool eraseSector(size_t offset) override {
+        if (!file.eraseSector(offset)) {
+            return false;
+        }
+        memset(image + offset, 0xFF, SECTOR_SIZE);
+        return true;
+    }
+    const uint8_t* map(size_t offset, size_t length) override {
+        if (!mappable || offset + length > sizeof(image)) {
+            return nullptr;
+        }
+        maps++;
+        return image + offset;
+    }
+};
+
+// 与SessionRecorder::ResendRange对应
+struct ResendRange {
+    uint32_t sessionNumber;
+    uint8_t sensorId;
+    uint64_t fromTimestamp;
+    uint64_t toTimestamp;
+    uint32_t fromBlockId;
+    uint32_t toBlockId;
+};
+
+struct Resend {
+    ResendRange range;
+    SessionLog::Cursor cursor;
+    bool active;
+};
+
+enum class ResendRead { BLOCK, PENDING, DONE };
+
+static MappedStorage storage;
+static FlashRegion region;
+static uint8_t writeBuffer[BUFFER_SIZE];
+static uint8_t scratch[RECORD_SIZE];
+static SessionLog sessionLog;
+
+// 第index块：块号index，时间范围[base + index*300, +299]，只含传感器index%4+1的帧
+static SessionLog::RecordInfo makeRecord(uint32_t index, uint64_t base, uint8_t* data) {
+    SessionLog::RecordInfo info;
+    memset(&info, 0, sizeof(info));
+    info.minTimestamp = base + index * BLOCK_SPAN_MS;
+    info.maxTimestamp = info.minTimestamp + BLOCK_SPAN_MS - 1;
+    info.sensorFrames[index % SessionLog::SENSOR_COUNT] = 30;
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        data[i] = (uint8_t)(index * 7 + i);
+    }
+    memcpy(data, &index, sizeof(index));
+    return info;
+}
+
+static void appendRecords(uint32_t from, uint32_t to) {
+    uint8_t data[RECORD_SIZE];
+    for (uint32_t i = from; i < to; i++) {
+        SessionLog::RecordInfo info = makeRecord(i, 0, data);
+        TEST_ASSERT_TRUE(sessionLog.append(data, RECORD_SIZE, info));
+        sessionLog.service();
+    }
+}
+
+static uint32_t recordSession(const char* sessionId, uint32_t records) {
+    uint32_t sessionNumber = sessionLog.beginSession(sessionId, 1000);
+    TEST_ASSERT_NOT_EQUAL(0, sessionNumber);
+    appendRecords(0, records);
+    sessionLog.endSession();
+    return sessionNumber;
+}
+
+// 同SessionRecorder::startResend：进行中的会话把结束时间截止到已记录的数据
+static bool startResend(Resend& resend, const ResendRange& range) {
+    resend.range = range;
+    if (range.sessionNumber == sessionLog.getActiveSession()) {
+        uint64_t recordedUntil = 0;
+        for (size_t slot = 0; slot < sessionLog.getSegmentCount(); slot++) {
+            const SessionLog::SegmentInfo& info = sessionLog.getSegment(slot);
+            if (info.valid && info.sessionNumber == range.sessionNumber && info.recordCount > 0 &&
+                info.maxTimestamp > recordedUntil) {
+                recordedUntil = info.maxTimestamp;
+            }
+        }
+        if (recordedUntil < resend.range.toTimestamp) {
+            resend.range.toTimestamp = recordedUntil;
+        }
+    }
+    sessionLog.openCursor(resend.cursor, resend.range.sessionNumber, resend.range.fromTimestamp,
+                          resend.range.toTimestamp, resend.range.sensorId);
+    resend.active = !resend.cursor.finished;
+    return resend.active;
+}
+
+// 同SessionRecorder::readResend：每轮最多检查几条记录，块号超过范围时结束
+static ResendRead readResend(Resend& resend, uint32_t* blockId, const uint8_t** payload) {
+    SessionLog::RecordView record;
+    for (uint8_t scanned = 0; scanned < RECORDS_PER_READ; scanned++) {
+        if (!resend.active) {
+            return ResendRead::DONE;
+        }
+        if (!sessionLog.next(resend.cursor, record, scratch, sizeof(scratch))) {
+            resend.active = false;
+            return ResendRead::DONE;
+        }
+        uint32_t id;
+        memcpy(&id, record.payload, sizeof(id));
+        if (id > resend.range.toBlockId) {
+            resend.active = false;
+            return ResendRead::DONE;
+        }
+        if (id < resend.range.fromBlockId) {
+            continue;
+        }
+        *blockId = id;
+        *payload = record.payload;
+        return ResendRead::BLOCK;
+    }
+    return ResendRead::PENDING;
+}
+
+static void cancelResend(Resend& resend) {
+    resend.active = false;
+    resend.cursor.finished = true;
+}
+
+struct Result {
+    uint32_t count;
+    uint32_t ids[MAX_BLOCKS];
+    uint32_t calls;
+    uint32_t pendingCalls;
+    bool payloadOk;
+    bool zeroCopy;          // 每个载荷都指向映射的闪存
+};
+
+static Result drain(Resend& resend) {
+    Result result;
+    memset(&result, 0, sizeof(result));
+    result.payloadOk = true;
+    result.zeroCopy = true;
+    uint8_t expected[RECORD_SIZE];
+    while (true) {
+        uint32_t id = 0;
+        const uint8_t* payload = nullptr;
+        ResendRead read = readResend(resend, &id, &payload);
+        result.calls++;
+        if (read == ResendRead::DONE) {
+            break;
+        }
+        if (read == ResendRead::PENDING) {
+            result.pendingCalls++;
+            continue;
+        }
+        makeRecord(id, 0, expected);
+        if (memcmp(payload, expected, RECORD_SIZE) != 0) {
+            result.payloadOk = false;
+        }
+        if (payload < storage.image || payload >= storage.image + sizeof(storage.image)) {
+            result.zeroCopy = false;
+        }
+        if (result.count < MAX_BLOCKS) {
+            result.ids[result.count] = id;
+        }
+        result.count++;
+    }
+    return result;
+}
+
+static ResendRange makeRange(uint32_t sessionNumber, uint8_t sensorId, uint64_t fromTimestamp, uint64_t toTimestamp,
+                             uint32_t fromBlockId, uint32_t toBlockId) {
+    ResendRange range = {sessionNumber, sensorId, fromTimestamp, toTimestamp, fromBlockId, toBlockId};
+    return range;
+}
+
+void setUp(void) {
+    remove(LOG_PATH);
+    TEST_ASSERT_TRUE(storage.open(LOG_PATH));
+    TEST_ASSERT_TRUE(region.begin(&storage, REGION_OFFSET, REGION_SIZE));
+    sessionLog = SessionLog();
+    TEST_ASSERT_TRUE(sessionLog.begin(&region, SEGMENT_SIZE, writeBuffer, BUFFER_SIZE));
+}
+
+void tearDown(void) {
+    storage.file.close();
+    remove(LOG_PATH);
+}
+
+void test_block_range_stops_after_last_block(void) {
+    uint32_t sessionNumber = recordSession("session-a", 200);
+    Resend resend;
+    TEST_ASSERT_TRUE(startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 40, 59)));
+    Result result = drain(resend);
+
+    TEST_ASSERT_EQUAL_UINT32(20, result.count);
+    for (uint32_t i = 0; i < result.count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(40 + i, result.ids[i]);
+    }
+    TEST_ASSERT_TRUE(result.payloadOk);
+    // 块号之前的记录分轮跳过，编码任务每轮只检查8条；读到块60后结束，不继续扫描会话的其余段
+    TEST_ASSERT_EQUAL_UINT32(40 / RECORDS_PER_READ, result.pendingCalls);
+    TEST_ASSERT_EQUAL_UINT32(61, resend.cursor.stats.recordsScanned);
+    TEST_ASSERT_LESS_OR_EQUAL(2, resend.cursor.stats.segmentsTouched);
+    TEST_ASSERT_FALSE(resend.active);
+}
+
+void test_time_sensor_and_block_ranges_combine(void) {
+    uint32_t sessionNumber = recordSession("session-a", 200);
+    // 时间范围覆盖块100~139，块号范围90~129，只要传感器2（块号%4==1）
+    Resend resend;
+    TEST_ASSERT_TRUE(startResend(resend, makeRange(sessionNumber, 2, 100 * BLOCK_SPAN_MS,
+                                                   140 * BLOCK_SPAN_MS - 1, 90, 129)));
+    Result result = drain(resend);
+
+    TEST_ASSERT_EQUAL_UINT32(8, result.count);
+    for (uint32_t i = 0; i < result.count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(101 + 4 * i, result.ids[i]);
+    }
+    TEST_ASSERT_TRUE(result.payloadOk);
+    // 时间范围之前的段按索引整段跳过
+    TEST_ASSERT_GREATER_OR_EQUAL(2, resend.cursor.stats.segmentsSkipped);
+
+    // 空范围和不存在的会话
+    TEST_ASSERT_TRUE(startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 300, 400)));
+    TEST_ASSERT_EQUAL_UINT32(0, drain(resend).count);
+    TEST_ASSERT_FALSE(startResend(resend, makeRange(sessionNumber + 1, 0, 0, UINT64_MAX, 0, UINT32_MAX)));
+    TEST_ASSERT_EQUAL_UINT32(0, drain(resend).count);
+}
+
+void test_cancel_stops_reading(void) {
+    uint32_t sessionNumber = recordSession("session-a", 100);
+    Resend resend;
+    TEST_ASSERT_TRUE(startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 0, UINT32_MAX)));
+    uint32_t id = 0;
+    const uint8_t* payload = nullptr;
+    for (uint32_t i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(readResend(resend, &id, &payload) == ResendRead::BLOCK);
+        TEST_ASSERT_EQUAL_UINT32(i, id);
+    }
+    cancelResend(resend);
+    TEST_ASSERT_TRUE(readResend(resend, &id, &payload) == ResendRead::DONE);
+    SessionLog::RecordView record;
+    TEST_ASSERT_FALSE(sessionLog.next(resend.cursor, record, scratch, sizeof(scratch)));
+    TEST_ASSERT_EQUAL_UINT32(10, resend.cursor.stats.recordsMatched);
+}
+
+void test_active_session_resends_only_recorded_part(void) {
+    uint32_t sessionNumber = sessionLog.beginSession("live", 1000);
+    appendRecords(0, 50);
+    Resend resend;
+    TEST_ASSERT_TRUE(startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 0, UINT32_MAX)));
+    TEST_ASSERT_EQUAL_UINT64(50 * BLOCK_SPAN_MS - 1, resend.range.toTimestamp);
+
+    // 补发期间继续记录：补发在开始时已记录的块处结束，不追赶新写入的记录
+    Result result;
+    memset(&result, 0, sizeof(result));
+    uint32_t id = 0;
+    const uint8_t* payload = nullptr;
+    uint32_t appended = 50;
+    ResendRead read;
+    while ((read = readResend(resend, &id, &payload)) != ResendRead::DONE) {
+        if (read == ResendRead::BLOCK) {
+            result.ids[result.count++] = id;
+        }
+        appendRecords(appended, appended + 2);
+        appended += 2;
+    }
+    sessionLog.endSession();
+
+    TEST_ASSERT_EQUAL_UINT32(50, result.count);
+    TEST_ASSERT_EQUAL_UINT32(0, result.ids[0]);
+    TEST_ASSERT_EQUAL_UINT32(49, result.ids[49]);
+    TEST_ASSERT_GREATER_THAN(100, appended);
+}
+
+void test_mapped_storage_returns_payload_without_copy(void) {
+    uint32_t sessionNumber = recordSession("session-a", 120);
+    Resend resend;
+
+    // 不支持映射：载荷读入scratch
+    startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 0, UINT32_MAX));
+    storage.bytesRead = 0;
+    Result copied = drain(resend);
+    uint64_t copiedBytes = storage.bytesRead;
+
+    // 支持映射：载荷直接指向映射的闪存，只读记录头
+    storage.mappable = true;
+    startResend(resend, makeRange(sessionNumber, 0, 0, UINT64_MAX, 0, UINT32_MAX));
+    storage.bytesRead = 0;
+    Result mapped = drain(resend);
+    uint64_t mappedBytes = storage.bytesRead;
+
+    char message[160];
+    snprintf(message, sizeof(message), "resend of %u blocks: %.1f KB read without mapping, %.1f KB with mapping (%u maps)",
+             mapped.count, copiedBytes / 1024.0, mappedBytes / 1024.0, storage.maps);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(120, copied.count);
+    TEST_ASSERT_EQUAL_UINT32(120, mapped.count);
+    TEST_ASSERT_TRUE(copied.payloadOk && mapped.payloadOk);
+    TEST_ASSERT_FALSE(copied.zeroCopy);
+    TEST_ASSERT_TRUE(mapped.zeroCopy);
+    TEST_ASSERT_EQUAL_UINT32(120, storage.maps);
+    TEST_ASSERT_LESS_THAN(copiedBytes / 10, mappedBytes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_range_stops_after_last_block);
+    RUN_TEST(test_time_sensor_and_block_ranges_combine);
+    RUN_TEST(test_cancel_stops_reading);
+    RUN_TEST(test_active_session_resends_only_recorded_part);
+    RUN_TEST(test_mapped_storage_returns_payload_without_copy);
+    return UNITY_END();
+}
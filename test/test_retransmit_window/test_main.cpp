@@ -0,0 +1,313 @@
+// 重传窗口与本地替身服务器：模拟有损链路（TCP重置丢弃途中的消息和确认），
+// 验证序列号按序无空洞地到达服务器、跳过标记照常被确认、窗口满时停止取新消息而非丢弃
+#include <unity.h>
+#include <string.h>
+#include "RetransmitWindow.h"
+
+struct TestEntry {
+    uint32_t seq;
+    uint32_t sentTime;
+    uint8_t transmissions;
+    bool skipped;
+};
+
+static const uint8_t WINDOW = 8;
+typedef RetransmitWindow<TestEntry, WINDOW> Window;
+
+// 确定性伪随机数（LCG），使丢包场景可复现
+static uint32_t rngState;
+static uint32_t nextRandom() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return rngState >> 8;
+}
+
+// 链路：按发送顺序投递（TCP），延迟固定步数；重置时途中的消息和确认全部丢失
+static const int LINK_CAPACITY = 64;
+struct Packet {
+    uint32_t seq;
+    bool skipped;
+    int deliverAt;
+};
+
+struct Link {
+    Packet items[LINK_CAPACITY];
+    int head;
+    int count;
+
+    void clear() { head = 0; count = 0; }
+    bool push(const Packet& packet) {
+        if (count >= LINK_CAPACITY) {
+            return false;
+        }
+        items[(head + count) % LINK_CAPACITY] = packet;
+        count++;
+        return true;
+    }
+    bool pop(int now, Packet& packet) {
+        if (count == 0 || items[head].deliverAt > now) {
+            return false;
+        }
+        packet = items[head];
+        head = (head + 1) % LINK_CAPACITY;
+        count--;
+        return true;
+    }
+};
+
+// 替身服务器：按序接收，累计确认最后一个连续的序列号。出现空洞即为网关的错误
+struct StandInServer {
+    uint32_t expected;
+    uint32_t delivered;
+    uint32_t skippedDelivered;
+    uint32_t duplicates;
+    uint32_t gaps;
+
+    void reset(uint32_t firstSeq) {
+        expected = firstSeq;
+        delivered = 0;
+        skippedDelivered = 0;
+        duplicates = 0;
+        gaps = 0;
+    }
+    // 返回应回传的ack_seq
+    uint32_t receive(const Packet& packet) {
+        if (packet.seq == expected) {
+            delivered++;
+            if (packet.skipped) {
+                skippedDelivered++;
+            }
+            expected++;
+        } else if ((int32_t)(packet.seq - expected) < 0) {
+            duplicates++;
+        } else {
+            gaps++;
+        }
+        return expected - 1;
+    }
+};
+
+struct Scenario {
+    uint32_t firstSeq;
+    uint32_t messages;
+    uint32_t resetPerMille;     // 每步链路重置的概率
+    uint32_t skipPerMille;      // 编码失败改发跳过标记的概率
+    uint32_t ackLossPerMille;   // 服务器不回传确认的概率（由后续确认覆盖）
+    int latency;                // 单向延迟（步）
+    int reconnectSteps;         // 重置后恢复连接的步数
+};
+
+struct Result {
+    uint32_t steps;
+    uint32_t retransmissions;
+    uint32_t resets;
+    uint32_t acked;
+    uint32_t skippedAcked;
+    uint8_t maxOccupancy;
+    bool finished;
+};
+
+static Result runScenario(const Scenario& scenario, StandInServer& server) {
+    Window window;
+    Link uplink;
+    Link downlink;
+    uplink.clear();
+    downlink.clear();
+    server.reset(scenario.firstSeq);
+
+    Result result;
+    memset(&result, 0, sizeof(result));
+    uint32_t nextSeq = scenario.firstSeq;
+    uint32_t produced = 0;
+    bool connected = true;
+    int reconnectAt = 0;
+
+    for (int now = 0; now < 200000; now++) {
+        // 链路重置：途中数据全部丢失，重连后从最旧的未确认消息开始重传
+        if (connected && nextRandom() % 1000 < scenario.resetPerMille) {
+            connected = false;
+            uplink.clear();
+            downlink.clear();
+            reconnectAt = now + scenario.reconnectSteps;
+            result.resets++;
+        }
+        if (!connected && now >= reconnectAt) {
+            connected = true;
+            window.rewind();
+        }
+
+        // 服务器侧
+        Packet packet;
+        while (uplink.pop(now, packet)) {
+            uint32_t ackSeq = server.receive(packet);
+            if (nextRandom() % 1000 >= scenario.ackLossPerMille) {
+                Packet ack = {ackSeq, false, now + scenario.latency};
+                downlink.push(ack);
+            }
+        }
+
+        // 网关侧：先处理确认，再重传，追平后发送新消息（每步一条消息）
+        Packet ack;
+        while (downlink.pop(now, ack)) {
+            while (window.canRelease(ack.seq)) {
+                result.acked++;
+                if (window.front().skipped) {
+                    result.skippedAcked++;
+                }
+                window.popFront();
+            }
+        }
+        if (!connected) {
+            continue;
+        }
+
+        TestEntry* entry = nullptr;
+        if (window.hasResend()) {
+            entry = &window.resendEntry();
+        } else if (!window.isFull() && produced < scenario.messages) {
+            TestEntry fresh;
+            fresh.seq = nextSeq++;
+            fresh.sentTime = 0;
+            fresh.transmissions = 0;
+            fresh.skipped = nextRandom() % 1000 < scenario.skipPerMille;
+            entry = &window.push(fresh);
+            produced++;
+        }
+        if (window.size() > result.maxOccupancy) {
+            result.maxOccupancy = window.size();
+        }
+        if (!entry) {
+            if (produced == scenario.messages && window.isEmpty()) {
+                result.finished = true;
+                result.steps = now;
+                break;
+            }
+            continue;
+        }
+
+        Packet out = {entry->seq, entry->skipped, now + scenario.latency};
+        if (!uplink.push(out)) {
+            continue;
+        }
+        TestEntry* written = window.onWritten(out.seq);
+        TEST_ASSERT_NOT_NULL(written);
+        if (written->transmissions > 0) {
+            result.retransmissions++;
+        }
+        written->transmissions++;
+        written->sentTime = now;
+    }
+    return result;
+}
+
+void setUp(void) {
+    rngState = 12345;
+}
+
+void tearDown(void) {}
+
+void test_lossless_link_delivers_in_order(void) {
+    Scenario scenario = {1, 2000, 0, 0, 0, 3, 0};
+    StandInServer server;
+    Result result = runScenario(scenario, server);
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_EQUAL_UINT32(2000, server.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, server.gaps);
+    TEST_ASSERT_EQUAL_UINT32(0, server.duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, result.retransmissions);
+    TEST_ASSERT_EQUAL_UINT32(2000, result.acked);
+    TEST_ASSERT_LESS_OR_EQUAL(WINDOW, result.maxOccupancy);
+}
+
+void test_resets_resend_unacked_messages_first(void) {
+    Scenario scenario = {1, 5000, 8, 0, 0, 4, 20};
+    StandInServer server;
+    Result result = runScenario(scenario, server);
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_GREATER_THAN(10, result.resets);
+    TEST_ASSERT_GREATER_THAN(0, result.retransmissions);
+    TEST_ASSERT_EQUAL_UINT32(5000, server.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, server.gaps);
+    TEST_ASSERT_EQUAL_UINT32(5000, result.acked);
+    TEST_ASSERT_LESS_OR_EQUAL(WINDOW, result.maxOccupancy);
+}
+
+void test_skip_markers_keep_cumulative_ack_moving(void) {
+    // 编码失败的消息以跳过标记占用序列号，服务器确认后窗口继续前进，上传不会停止
+    Scenario scenario = {1, 3000, 5, 50, 0, 4, 15};
+    StandInServer server;
+    Result result = runScenario(scenario, server);
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_EQUAL_UINT32(3000, server.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, server.gaps);
+    TEST_ASSERT_GREATER_THAN(0, server.skippedDelivered);
+    TEST_ASSERT_EQUAL_UINT32(server.skippedDelivered, result.skippedAcked);
+}
+
+void test_lost_acks_are_covered_by_later_acks(void) {
+    Scenario scenario = {1, 3000, 2, 0, 500, 4, 15};
+    StandInServer server;
+    Result result = runScenario(scenario, server);
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_EQUAL_UINT32(3000, server.delivered);
+    TEST_ASSERT_EQUAL_UINT32(3000, result.acked);
+    TEST_ASSERT_EQUAL_UINT32(0, server.gaps);
+}
+
+void test_sequence_wraparound(void) {
+    Scenario scenario = {0xFFFFFF00u, 1000, 8, 20, 100, 4, 15};
+    StandInServer server;
+    Result result = runScenario(scenario, server);
+    TEST_ASSERT_TRUE(result.finished);
+    TEST_ASSERT_EQUAL_UINT32(1000, server.delivered);
+    TEST_ASSERT_EQUAL_UINT32(0, server.gaps);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFF00u + 1000u, server.expected);
+}
+
+void test_late_ack_during_retransmit(void) {
+    // 重传途中迟到的确认已释放条目，写完后按序列号定位不到条目，重传位置不变
+    Window window;
+    for (uint32_t seq = 10; seq < 14; seq++) {
+        TestEntry entry = {seq, 0, 1, false};
+        window.push(entry);
+        window.onWritten(seq);
+    }
+    window.rewind();
+    TEST_ASSERT_TRUE(window.hasResend());
+    TEST_ASSERT_EQUAL_UINT32(10, window.resendEntry().seq);
+
+    while (window.canRelease(11)) {
+        window.popFront();
+    }
+    TEST_ASSERT_EQUAL_UINT8(2, window.size());
+    TEST_ASSERT_NULL(window.onWritten(10));
+    TEST_ASSERT_EQUAL_UINT32(12, window.resendEntry().seq);
+
+    TEST_ASSERT_NOT_NULL(window.onWritten(12));
+    TEST_ASSERT_EQUAL_UINT8(1, window.getResendCursor());
+    TEST_ASSERT_EQUAL_UINT32(13, window.resendEntry().seq);
+}
+
+void test_unsent_entries_are_not_released(void) {
+    // 上游断开期间进入窗口、尚未写入套接字的条目不会被确认释放
+    Window window;
+    TestEntry sent = {1, 0, 1, false};
+    TestEntry pending = {2, 0, 0, false};
+    window.push(sent);
+    window.push(pending);
+    TEST_ASSERT_TRUE(window.canRelease(5));
+    window.popFront();
+    TEST_ASSERT_FALSE(window.canRelease(5));
+    TEST_ASSERT_EQUAL_UINT8(1, window.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_lossless_link_delivers_in_order);
+    RUN_TEST(test_resets_resend_unacked_messages_first);
+    RUN_TEST(test_skip_markers_keep_cumulative_ack_moving);
+    RUN_TEST(test_lost_acks_are_covered_by_later_acks);
+    RUN_TEST(test_sequence_wraparound);
+    RUN_TEST(test_late_ack_during_retransmit);
+    RUN_TEST(test_unsent_entries_are_not_released);
+    return UNITY_END();
+}
@@ -0,0 +1,336 @@
+// 会话记录：用文件模拟分区（FileStorage），验证按时间范围和传感器查询只读取相关的段、
+// 重启后由段头和摘要重建索引、断电时未封闭的段扫描恢复、区域满后回收最旧的段，
+// 以及游标在会话写入过程中继续读到新追加的记录
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "SessionLog.h"
+
+static const char* LOG_PATH = "/tmp/test_session_log.bin";
+static const size_t SEGMENT_SIZE = 0x10000;         // Config::RECORDER_SEGMENT_SIZE
+static const size_t BUFFER_SIZE = 8192;             // Config::RECORDER_WRITE_BUFFER_SIZE
+static const size_t REGION_SIZE = 8 * SEGMENT_SIZE;
+static const size_t RECORD_SIZE = 1900;             // 一个DataBlock约1.9KB
+static const uint64_t BLOCK_SPAN_MS = 300;          // 每块30帧，100Hz
+
+// 转发到FileStorage并统计读取量，用于检查查询只读取相关的段
+class CountingStorage : public FlashStorage {
+public:
+    FileStorage file;
+    uint64_t bytesRead;
+    uint32_t reads;
+
+    size_t size() const override { return file.size(); }
+    bool read(size_t offset, void* data, size_t length) override {
+        bytesRead += length;
+        reads++;
+        return file.read(offset, data, length);
+    }
+    bool write(size_t offset, const void* data, size_t length) override { return file.write(offset, data, length); }
+    bool eraseSector(size_t offset) override { return file.eraseSector(offset); }
+};
+
+static CountingStorage storage;
+static uint8_t writeBuffer[BUFFER_SIZE];
+static uint8_t scratch[RECORD_SIZE];
+static SessionLog sessionLog;
+
+// 第index块：时间范围[base + index*300, +299]，只含传感器index%4+1的帧
+static SessionLog::RecordInfo makeRecord(uint32_t index, uint64_t base, uint8_t* data) {
+    SessionLog::RecordInfo info;
+    memset(&info, 0, sizeof(info));
+    info.minTimestamp = base + index * BLOCK_SPAN_MS;
+    info.maxTimestamp = info.minTimestamp + BLOCK_SPAN_MS - 1;
+    info.sensorFrames[index % SessionLog::SENSOR_COUNT] = 30;
+    for (size_t i = 0; i < RECORD_SIZE; i++) {
+        data[i] = (uint8_t)(index * 11 + i);
+    }
+    memcpy(data, &index, sizeof(index));
+    return info;
+}
+
+static uint32_t recordIndex(const SessionLog::RecordView& record) {
+    uint32_t index;
+    memcpy(&index, record.payload, sizeof(index));
+    return index;
+}
+
+static void recordSession(const char* sessionId, uint32_t startTime, uint64_t base, uint32_t records) {
+    uint8_t data[RECORD_SIZE];
+    TEST_ASSERT_NOT_EQUAL(0, sessionLog.beginSession(sessionId, startTime));
+    for (uint32_t i = 0; i < records; i++) {
+        SessionLog::RecordInfo info = makeRecord(i, base, data);
+        TEST_ASSERT_TRUE(sessionLog.append(data, RECORD_SIZE, info));
+        sessionLog.service();
+    }
+    sessionLog.endSession();
+}
+
+// 查询结果：按顺序记录匹配的块号
+struct Collected {
+    uint32_t count;
+    uint32_t indices[512];
+    bool ordered;
+    bool payloadOk;
+};
+
+static bool collect(const SessionLog::RecordView& record, void* context) {
+    Collected* collected = (Collected*)context;
+    uint32_t index = recordIndex(record);
+    if (collected->count > 0 && index <= collected->indices[collected->count - 1]) {
+        collected->ordered = false;
+    }
+    uint8_t expected[RECORD_SIZE];
+    makeRecord(index, record.minTimestamp - index * BLOCK_SPAN_MS, expected);
+    if (record.length != RECORD_SIZE || memcmp(record.payload, expected, RECORD_SIZE) != 0) {
+        collected->payloadOk = false;
+    }
+    if (collected->count < 512) {
+        collected->indices[collected->count] = index;
+    }
+    collected->count++;
+    return true;
+}
+
+static Collected runQuery(uint32_t sessionNumber, uint64_t from, uint64_t to, uint8_t sensorId,
+                          SessionLog::QueryStats* stats = nullptr) {
+    Collected collected;
+    memset(&collected, 0, sizeof(collected));
+    collected.ordered = true;
+    collected.payloadOk = true;
+    sessionLog.query(sessionNumber, from, to, sensorId, scratch, sizeof(scratch), collect, &collected, stats);
+    return collected;
+}
+
+static void openLog(bool fresh) {
+    if (fresh) {
+        remove(LOG_PATH);
+    }
+    TEST_ASSERT_TRUE(storage.file.open(LOG_PATH, REGION_SIZE));
+    sessionLog = SessionLog();
+    TEST_ASSERT_TRUE(sessionLog.begin(&storage, SEGMENT_SIZE, writeBuffer, BUFFER_SIZE));
+}
+
+// 模拟重启：关闭文件后用新的实例重新加载索引
+static void reboot() {
+    storage.file.close();
+    openLog(false);
+}
+
+void setUp(void) {
+    storage.bytesRead = 0;
+    storage.reads = 0;
+}
+
+void tearDown(void) {
+    storage.file.close();
+    remove(LOG_PATH);
+}
+
+void test_full_session_reads_back_in_order(void) {
+    openLog(true);
+    recordSession("session-a", 1000, 100000, 150);
+    SessionLog::SessionSummary sessions[4];
+    TEST_ASSERT_EQUAL_UINT32(1, sessionLog.listSessions(sessions, 4));
+    TEST_ASSERT_EQUAL_UINT32(150, sessions[0].recordCount);
+    TEST_ASSERT_EQUAL_UINT32(150 * 30, sessions[0].frameCount);
+    TEST_ASSERT_TRUE(sessions[0].complete);
+    TEST_ASSERT_GREATER_THAN(1, sessions[0].segmentCount);
+    TEST_ASSERT_EQUAL_UINT32(100000, (uint32_t)sessions[0].minTimestamp);
+
+    Collected all = runQuery(sessions[0].sessionNumber, 0, UINT64_MAX, 0);
+    TEST_ASSERT_EQUAL_UINT32(150, all.count);
+    TEST_ASSERT_TRUE(all.ordered);
+    TEST_ASSERT_TRUE(all.payloadOk);
+    TEST_ASSERT_EQUAL_UINT32(0, all.indices[0]);
+    TEST_ASSERT_EQUAL_UINT32(149, all.indices[149]);
+
+    // 不在会话中时拒绝追加
+    uint8_t data[RECORD_SIZE];
+    SessionLog::RecordInfo info = makeRecord(0, 0, data);
+    TEST_ASSERT_FALSE(sessionLog.append(data, RECORD_SIZE, info));
+    TEST_ASSERT_EQUAL_UINT32(1, sessionLog.getStats().recordsRejected);
+}
+
+void test_time_range_query_touches_only_overlapping_segments(void) {
+    openLog(true);
+    recordSession("session-a", 1000, 100000, 200);
+    uint32_t sessionNumber = sessionLog.findSession("session-a");
+    TEST_ASSERT_NOT_EQUAL(0, sessionNumber);
+
+    Collected all = runQuery(sessionNumber, 0, UINT64_MAX, 0);
+    uint64_t fullReadBytes = storage.bytesRead;
+    storage.bytesRead = 0;
+
+    // 块120~125所在的时间范围
+    SessionLog::QueryStats stats;
+    uint64_t from = 100000 + 120 * BLOCK_SPAN_MS;
+    uint64_t to = 100000 + 125 * BLOCK_SPAN_MS + 10;
+    Collected range = runQuery(sessionNumber, from, to, 0, &stats);
+    char message[160];
+    snprintf(message, sizeof(message), "range query: %u records, %u segments touched, %u skipped, %.1f KB read (full query %.1f KB)",
+             range.count, stats.segmentsTouched, stats.segmentsSkipped, storage.bytesRead / 1024.0, fullReadBytes / 1024.0);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(200, all.count);
+    TEST_ASSERT_EQUAL_UINT32(6, range.count);
+    TEST_ASSERT_EQUAL_UINT32(120, range.indices[0]);
+    TEST_ASSERT_EQUAL_UINT32(125, range.indices[5]);
+    TEST_ASSERT_TRUE(range.payloadOk);
+    TEST_ASSERT_LESS_OR_EQUAL(2, stats.segmentsTouched);
+    TEST_ASSERT_GREATER_OR_EQUAL(4, stats.segmentsSkipped);
+    TEST_ASSERT_LESS_THAN(fullReadBytes / 3, storage.bytesRead);
+}
+
+void test_sensor_query_starts_at_sensor_offset(void) {
+    openLog(true);
+    recordSession("session-a", 1000, 0, 100);
+    uint32_t sessionNumber = sessionLog.findSession("session-a");
+    for (uint8_t sensor = 1; sensor <= SessionLog::SENSOR_COUNT; sensor++) {
+        Collected result = runQuery(sessionNumber, 0, UINT64_MAX, sensor);
+        TEST_ASSERT_EQUAL_UINT32(25, result.count);
+        for (uint32_t i = 0; i < result.count; i++) {
+            TEST_ASSERT_EQUAL_UINT32(sensor - 1, result.indices[i] % SessionLog::SENSOR_COUNT);
+        }
+    }
+    // 传感器号越界时没有结果
+    TEST_ASSERT_EQUAL_UINT32(0, runQuery(sessionNumber, 0, UINT64_MAX, SessionLog::SENSOR_COUNT + 1).count);
+}
+
+void test_index_is_rebuilt_at_boot(void) {
+    openLog(true);
+    recordSession("session-a", 1000, 0, 40);
+    recordSession("session-b", 2000, 50000, 70);
+    reboot();
+
+    SessionLog::Stats stats = sessionLog.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, stats.segmentsRecovered);
+    SessionLog::SessionSummary sessions[4];
+    TEST_ASSERT_EQUAL_UINT32(2, sessionLog.listSessions(sessions, 4));
+    TEST_ASSERT_EQUAL_UINT32(40, sessions[0].recordCount);
+    TEST_ASSERT_EQUAL_UINT32(70, sessions[1].recordCount);
+    TEST_ASSERT_EQUAL_UINT32(2000, sessions[1].startTime);
+    TEST_ASSERT_TRUE(sessions[0].complete && sessions[1].complete);
+
+    char sessionId[32];
+    TEST_ASSERT_TRUE(sessionLog.getSessionId(sessions[1].sessionNumber, sessionId, sizeof(sessionId)));
+    TEST_ASSERT_EQUAL_STRING("session-b", sessionId);
+    TEST_ASSERT_EQUAL_UINT32(sessions[0].sessionNumber, sessionLog.findSession("session-a"));
+    TEST_ASSERT_EQUAL_UINT32(0, sessionLog.findSession("missing"));
+    TEST_ASSERT_EQUAL_UINT32(70, runQuery(sessions[1].sessionNumber, 0, UINT64_MAX, 0).count);
+
+    // 会话号在重启后继续递增
+    uint32_t next = sessionLog.beginSession("session-c", 3000);
+    TEST_ASSERT_EQUAL_UINT32(sessions[1].sessionNumber + 1, next);
+}
+
+void test_unsealed_segment_is_recovered_after_power_loss(void) {
+    openLog(true);
+    uint8_t data[RECORD_SIZE];
+    uint32_t sessionNumber = sessionLog.beginSession("session-a", 1000);
+    for (uint32_t i = 0; i < 10; i++) {
+        SessionLog::RecordInfo info = makeRecord(i, 0, data);
+        sessionLog.append(data, RECORD_SIZE, info);
+    }
+    // 定期落盘后断电：段摘要没有写入
+    sessionLog.flush();
+    reboot();
+
+    TEST_ASSERT_EQUAL_UINT32(1, sessionLog.getStats().segmentsRecovered);
+    SessionLog::SessionSummary sessions[2];
+    TEST_ASSERT_EQUAL_UINT32(1, sessionLog.listSessions(sessions, 2));
+    TEST_ASSERT_EQUAL_UINT32(sessionNumber, sessions[0].sessionNumber);
+    TEST_ASSERT_EQUAL_UINT32(10, sessions[0].recordCount);
+    TEST_ASSERT_TRUE(sessions[0].complete);
+    Collected all = runQuery(sessionNumber, 0, UINT64_MAX, 0);
+    TEST_ASSERT_EQUAL_UINT32(10, all.count);
+    TEST_ASSERT_TRUE(all.payloadOk);
+    TEST_ASSERT_EQUAL_UINT32(2, runQuery(sessionNumber, 0, 2 * BLOCK_SPAN_MS - 1, 0).count);
+
+    // 恢复后写回了摘要，下次启动无需再扫描
+    reboot();
+    TEST_ASSERT_EQUAL_UINT32(0, sessionLog.getStats().segmentsRecovered);
+    TEST_ASSERT_EQUAL_UINT32(10, runQuery(sessionNumber, 0, UINT64_MAX, 0).count);
+}
+
+void test_oldest_segments_are_reclaimed_when_full(void) {
+    openLog(true);
+    // 8个段每段约33块：三个会话各80块（各占3个段），超出区域后回收最旧的段
+    recordSession("session-a", 1000, 0, 80);
+    recordSession("session-b", 2000, 100000, 80);
+    recordSession("session-c", 3000, 200000, 80);
+
+    SessionLog::Stats stats = sessionLog.getStats();
+    TEST_ASSERT_GREATER_THAN(0, stats.segmentsReclaimed);
+    // 会话进行中下一个段已被预擦除，从索引中移除
+    TEST_ASSERT_EQUAL_UINT32(7, stats.usedSegments);
+    // 会话进行中预擦除下一个段，只有每个会话的第一个段可能在打开时擦除
+    TEST_ASSERT_LESS_OR_EQUAL(3 * SEGMENT_SIZE / FlashStorage::SECTOR_SIZE, stats.inlineErases);
+    TEST_ASSERT_GREATER_THAN(stats.inlineErases, stats.sectorsErased - stats.inlineErases);
+
+    SessionLog::SessionSummary sessions[4];
+    size_t count = sessionLog.listSessions(sessions, 4);
+    TEST_ASSERT_EQUAL_UINT32(3, count);
+    TEST_ASSERT_GREATER_THAN(0, sessions[0].recordCount);
+    TEST_ASSERT_LESS_THAN(80, sessions[0].recordCount);
+    TEST_ASSERT_EQUAL_UINT32(80, sessions[1].recordCount);
+    TEST_ASSERT_EQUAL_UINT32(80, sessions[2].recordCount);
+
+    // 被回收的会话只剩最后几段，查询从仍保留的最早记录开始
+    Collected oldest = runQuery(sessions[0].sessionNumber, 0, UINT64_MAX, 0);
+    TEST_ASSERT_EQUAL_UINT32(sessions[0].recordCount, oldest.count);
+    TEST_ASSERT_EQUAL_UINT32(80 - sessions[0].recordCount, oldest.indices[0]);
+    TEST_ASSERT_TRUE(oldest.ordered);
+    char sessionId[32];
+    TEST_ASSERT_TRUE(sessionLog.getSessionId(sessions[0].sessionNumber, sessionId, sizeof(sessionId)));
+    TEST_ASSERT_EQUAL_STRING("session-a", sessionId);
+}
+
+void test_cursor_follows_active_session(void) {
+    openLog(true);
+    uint8_t data[RECORD_SIZE];
+    uint32_t sessionNumber = sessionLog.beginSession("live", 1000);
+    for (uint32_t i = 0; i < 5; i++) {
+        SessionLog::RecordInfo info = makeRecord(i, 0, data);
+        sessionLog.append(data, RECORD_SIZE, info);
+    }
+
+    SessionLog::Cursor cursor;
+    sessionLog.openCursor(cursor, sessionNumber, 0, UINT64_MAX, 0);
+    SessionLog::RecordView record;
+    uint32_t read = 0;
+    // 记录仍在RAM缓冲区中：读取时先落盘
+    while (sessionLog.next(cursor, record, scratch, sizeof(scratch))) {
+        TEST_ASSERT_EQUAL_UINT32(read, recordIndex(record));
+        read++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, read);
+    TEST_ASSERT_FALSE(cursor.finished);
+
+    // 之后追加的记录（跨越到新段）还能继续读到
+    for (uint32_t i = 5; i < 60; i++) {
+        SessionLog::RecordInfo info = makeRecord(i, 0, data);
+        sessionLog.append(data, RECORD_SIZE, info);
+    }
+    while (sessionLog.next(cursor, record, scratch, sizeof(scratch))) {
+        TEST_ASSERT_EQUAL_UINT32(read, recordIndex(record));
+        read++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(60, read);
+
+    sessionLog.endSession();
+    TEST_ASSERT_FALSE(sessionLog.next(cursor, record, scratch, sizeof(scratch)));
+    TEST_ASSERT_TRUE(cursor.finished);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_session_reads_back_in_order);
+    RUN_TEST(test_time_range_query_touches_only_overlapping_segments);
+    RUN_TEST(test_sensor_query_starts_at_sensor_offset);
+    RUN_TEST(test_index_is_rebuilt_at_boot);
+    RUN_TEST(test_unsealed_segment_is_recovered_after_power_loss);
+    RUN_TEST(test_oldest_segments_are_reclaimed_when_full);
+    RUN_TEST(test_cursor_follows_active_session);
+    return UNITY_END();
+}
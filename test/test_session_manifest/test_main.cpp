@@ -0,0 +1,297 @@
+// 会话清单：每个传感器的封装帧数和rawTimestamp范围、块号范围（含回绕）、队列丢弃和未上传帧的合计，
+// 会话开始前遗留和结束后新封装的块不计入；校验和覆盖量化后的帧，与消息合并、顺序和重传无关；
+// begin/snapshot和各次更新都在设置的锁内完成
+#include <unity.h>
+#include <string.h>
+#include "SessionManifest.h"
+#include "FlashStorage.h"
+
+static const uint8_t SENSORS = SessionManifest::SENSOR_COUNT;
+
+static SessionManifest manifest;
+
+// 按块封装：sensorFrames[i]个帧，时间戳从first开始每帧10ms
+static void seal(uint32_t blockId, const uint8_t sensorFrames[SENSORS], uint64_t first) {
+    uint64_t firstTimestamps[SENSORS];
+    uint64_t lastTimestamps[SENSORS];
+    for (uint8_t i = 0; i < SENSORS; i++) {
+        firstTimestamps[i] = first + i;
+        lastTimestamps[i] = first + i + (sensorFrames[i] > 0 ? (sensorFrames[i] - 1) * 10 : 0);
+    }
+    manifest.onBlockSealed(blockId, sensorFrames, firstTimestamps, lastTimestamps);
+}
+
+// 一帧量化后的定点值，由帧号确定
+static void frameValues(uint32_t frame, int32_t values[SessionManifest::CHANNEL_VALUES]) {
+    for (uint8_t i = 0; i < SessionManifest::CHANNEL_VALUES; i++) {
+        values[i] = (int32_t)(frame * 37 + i * 1001) - 5000;
+    }
+}
+
+// 一个块中每个传感器framesPerSensor帧的上传统计和校验和
+struct EncodedBlock {
+    uint32_t blockId;
+    uint8_t uploaded[SENSORS];
+    uint32_t checksums[SENSORS];
+    uint8_t skipped[SENSORS];
+};
+
+static EncodedBlock encodeBlock(uint32_t blockId, uint8_t framesPerSensor) {
+    EncodedBlock block;
+    memset(&block, 0, sizeof(block));
+    block.blockId = blockId;
+    for (uint8_t sensor = 1; sensor <= SENSORS; sensor++) {
+        for (uint8_t f = 0; f < framesPerSensor; f++) {
+            uint32_t frame = blockId * 100 + f;
+            int32_t values[SessionManifest::CHANNEL_VALUES];
+            frameValues(frame, values);
+            block.uploaded[sensor - 1]++;
+            block.checksums[sensor - 1] += SessionManifest::frameChecksum(sensor, frame * 10, values);
+        }
+    }
+    return block;
+}
+
+static void submit(const EncodedBlock& block) {
+    manifest.onBlockEncoded(block.blockId, block.uploaded, block.checksums, block.skipped);
+}
+
+// 记录加锁次数，并检查没有嵌套或不配对的加锁
+struct CountingLock : public SessionManifest::Lock {
+    uint32_t locks;
+    uint32_t unlocks;
+    bool held;
+    bool nested;
+    void lock() override {
+        nested = nested || held;
+        held = true;
+        locks++;
+    }
+    void unlock() override {
+        nested = nested || !held;
+        held = false;
+        unlocks++;
+    }
+};
+
+void setUp(void) {
+    manifest.setLock(nullptr);
+    manifest.begin();
+}
+
+void tearDown(void) {}
+
+void test_counts_and_timestamps_per_sensor(void) {
+    const uint8_t first[SENSORS] = {3, 2, 0, 1};
+    const uint8_t second[SENSORS] = {2, 4, 0, 0};
+    seal(10, first, 1000);
+    seal(11, second, 2000);
+
+    SessionManifest::Snapshot snapshot = manifest.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(5, snapshot.getSensor(1).capturedFrames);
+    TEST_ASSERT_EQUAL_UINT32(6, snapshot.getSensor(2).capturedFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.getSensor(3).capturedFrames);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.getSensor(4).capturedFrames);
+    TEST_ASSERT_EQUAL_UINT32(12, snapshot.getCapturedFrames());
+
+    // 时间范围跨块取最早和最晚的帧
+    TEST_ASSERT_EQUAL_UINT64(1000, snapshot.getSensor(1).firstTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(2010, snapshot.getSensor(1).lastTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(1001, snapshot.getSensor(2).firstTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(2031, snapshot.getSensor(2).lastTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(1003, snapshot.getSensor(4).firstTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(1003, snapshot.getSensor(4).lastTimestamp);
+    // 没有帧的传感器忽略块中的时间戳
+    TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, snapshot.getSensor(3).firstTimestamp);
+    TEST_ASSERT_EQUAL_UINT64(0, snapshot.getSensor(3).lastTimestamp);
+
+    TEST_ASSERT_EQUAL_UINT32(10, snapshot.firstBlockId);
+    TEST_ASSERT_EQUAL_UINT32(11, snapshot.lastBlockId);
+    TEST_ASSERT_EQUAL_UINT32(2, snapshot.blockCount);
+}
+
+void test_block_id_range_across_wrap(void) {
+    const uint8_t frames[SENSORS] = {1, 1, 1, 1};
+    const uint8_t dropped[SENSORS] = {1, 0, 0, 0};
+    seal(UINT32_MAX - 1, frames, 0);
+    seal(UINT32_MAX, frames, 100);
+    seal(0, frames, 200);
+    seal(1, frames, 300);
+
+    SessionManifest::Snapshot snapshot = manifest.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX - 1, snapshot.firstBlockId);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.lastBlockId);
+    TEST_ASSERT_EQUAL_UINT32(4, snapshot.blockCount);
+
+    // 回绕后的块号仍在范围内，范围之外的块不计入
+    manifest.onBlockDropped(0, dropped);
+    manifest.onBlockDropped(UINT32_MAX - 2, dropped);
+    manifest.onBlockDropped(2, dropped);
+    TEST_ASSERT_EQUAL_UINT32(1, manifest.snapshot().getSensor(1).queueDroppedFrames);
+}
+
+void test_dropped_frames_combine_queue_drops_and_skips(void) {
+    const uint8_t frames[SENSORS] = {4, 4, 4, 4};
+    for (uint32_t blockId = 1; blockId <= 4; blockId++) {
+        seal(blockId, frames, blockId * 100);
+    }
+    // 块1：队列满丢弃；块2：无法编码整块跳过；块3：部分帧因降级未上传；块4：全部上传
+    const uint8_t partial[SENSORS] = {1, 0, 3, 0};
+    manifest.onBlockDropped(1, frames);
+    manifest.onBlockSkipped(2, frames);
+    EncodedBlock block3 = encodeBlock(3, 4);
+    for (uint8_t i = 0; i < SENSORS; i++) {
+        block3.uploaded[i] -= partial[i];
+        block3.skipped[i] = partial[i];
+    }
+    submit(block3);
+    submit(encodeBlock(4, 4));
+
+    SessionManifest::Snapshot snapshot = manifest.snapshot();
+    TEST_ASSERT_EQUAL_UINT32(4, snapshot.getSensor(1).queueDroppedFrames);
+    TEST_ASSERT_EQUAL_UINT32(4 + 1, snapshot.getSensor(1).skippedFrames);
+    TEST_ASSERT_EQUAL_UINT32(4 + 3, snapshot.getSensor(3).skippedFrames);
+    TEST_ASSERT_EQUAL_UINT32(3 + 4, snapshot.getSensor(1).uploadedFrames);
+    TEST_ASSERT_EQUAL_UINT32(4 + 4, snapshot.getSensor(2).uploadedFrames);
+    // 每个封装的帧恰好计入上传或丢弃之一
+    TEST_ASSERT_EQUAL_UINT32(16 * 4, snapshot.getCapturedFrames());
+    TEST_ASSERT_EQUAL_UINT32(snapshot.getCapturedFrames(), snapshot.getUploadedFrames() + snapshot.getDroppedFrames());
+}
+
+void test_only_blocks_of_this_session_count(void) {
+    const uint8_t frames[SENSORS] = {2, 2, 2, 2};
+    manifest.end();
+    manifest.begin();
+    seal(20, frames, 0);
+    seal(21, frames, 100);
+    manifest.end();
+
+    // 结束后封装的块不计入，会话内剩余块的上传和丢弃照常统计
+    seal(22, frames, 200);
+    submit(encodeBlock(21, 2));
+    manifest.onBlockDropped(20, frames);
+    // 会话开始前遗留的块
+    submit(encodeBlock(19, 2));
+    manifest.onBlockSkipped(19, frames);
+
+    SessionManifest::Snapshot snapshot = manifest.snapshot();
+    TEST_ASSERT_FALSE(manifest.isCapturing());
+    TEST_ASSERT_EQUAL_UINT32(2, snapshot.blockCount);
+    TEST_ASSERT_EQUAL_UINT32(21, snapshot.lastBlockId);
+    TEST_ASSERT_EQUAL_UINT32(8, snapshot.getUploadedFrames());
+    TEST_ASSERT_EQUAL_UINT32(8, snapshot.getDroppedFrames());
+
+    // 下一次begin清零，上一会话的块不再计入
+    manifest.begin();
+    submit(encodeBlock(21, 2));
+    snapshot = manifest.snapshot();
+    TEST_ASSERT_TRUE(manifest.isCapturing());
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.blockCount);
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.getUploadedFrames());
+    TEST_ASSERT_EQUAL_UINT32(0, snapshot.getChecksum());
+}
+
+void test_frame_checksum_covers_quantized_values(void) {
+    // CRC-32（IEEE）标准校验值
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, FlashStorage::crc32("123456789", 9));
+
+    // 小端序的 {u8 sensor_id, u32 timestamp, i32 values[9]}
+    int32_t values[SessionManifest::CHANNEL_VALUES] = {1000, -2, 981, 150, -150, 0, 4500, -9000, 17999};
+    uint8_t record[1 + 4 + SessionManifest::CHANNEL_VALUES * 4] = {3, 0x78, 0x56, 0x34, 0x12};
+    for (uint8_t i = 0; i < SessionManifest::CHANNEL_VALUES; i++) {
+        uint32_t value = (uint32_t)values[i];
+        for (uint8_t b = 0; b < 4; b++) {
+            record[5 + i * 4 + b] = (uint8_t)(value >> (8 * b));
+        }
+    }
+    TEST_ASSERT_EQUAL_HEX32(FlashStorage::crc32(record, sizeof(record)),
+                            SessionManifest::frameChecksum(3, 0x12345678, values));
+
+    // 任一定点值、时间戳或传感器不同，校验和不同
+    uint32_t checksum = SessionManifest::frameChecksum(3, 0x12345678, values);
+    values[8]++;
+    TEST_ASSERT_NOT_EQUAL(checksum, SessionManifest::frameChecksum(3, 0x12345678, values));
+    values[8]--;
+    TEST_ASSERT_NOT_EQUAL(checksum, SessionManifest::frameChecksum(3, 0x12345679, values));
+    TEST_ASSERT_NOT_EQUAL(checksum, SessionManifest::frameChecksum(2, 0x12345678, values));
+}
+
+void test_checksum_stable_across_retransmit_and_coalescing(void) {
+    const uint8_t frames[SENSORS] = {5, 5, 5, 5};
+    for (uint32_t blockId = 1; blockId <= 6; blockId++) {
+        seal(blockId, frames, blockId * 100);
+    }
+    // 逐块编码、按顺序首次上传
+    for (uint32_t blockId = 1; blockId <= 6; blockId++) {
+        submit(encodeBlock(blockId, 5));
+    }
+    SessionManifest::Snapshot inOrder = manifest.snapshot();
+
+    // 同一会话：合并成多块消息、重连后乱序首次编码；重传从同样的量化值重新编码，不再提交清单
+    manifest.begin();
+    for (uint32_t blockId = 1; blockId <= 6; blockId++) {
+        seal(blockId, frames, blockId * 100);
+    }
+    const uint32_t order[] = {4, 5, 6, 1, 2, 3};
+    for (uint8_t i = 0; i < 6; i++) {
+        EncodedBlock block = encodeBlock(order[i], 5);
+        submit(block);
+        EncodedBlock retransmitted = encodeBlock(order[i], 5);
+        TEST_ASSERT_EQUAL_MEMORY(block.checksums, retransmitted.checksums, sizeof(block.checksums));
+    }
+    SessionManifest::Snapshot reordered = manifest.snapshot();
+
+    TEST_ASSERT_EQUAL_UINT32(inOrder.getUploadedFrames(), reordered.getUploadedFrames());
+    TEST_ASSERT_EQUAL_HEX32(inOrder.getChecksum(), reordered.getChecksum());
+    for (uint8_t sensor = 1; sensor <= SENSORS; sensor++) {
+        TEST_ASSERT_EQUAL_HEX32(inOrder.getSensor(sensor).checksum, reordered.getSensor(sensor).checksum);
+    }
+
+    // 服务器按块号去重后对收到的帧独立求和，结果相同
+    uint32_t serverSum = 0;
+    for (uint32_t blockId = 1; blockId <= 6; blockId++) {
+        for (uint8_t sensor = 1; sensor <= SENSORS; sensor++) {
+            for (uint8_t f = 0; f < 5; f++) {
+                uint32_t frame = blockId * 100 + f;
+                int32_t values[SessionManifest::CHANNEL_VALUES];
+                frameValues(frame, values);
+                serverSum += SessionManifest::frameChecksum(sensor, frame * 10, values);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_HEX32(serverSum, reordered.getChecksum());
+}
+
+void test_every_call_runs_inside_the_lock(void) {
+    CountingLock lock = {};
+    manifest.setLock(&lock);
+    const uint8_t frames[SENSORS] = {1, 2, 3, 4};
+
+    manifest.begin();
+    seal(1, frames, 0);
+    submit(encodeBlock(1, 1));
+    manifest.onBlockDropped(1, frames);
+    manifest.onBlockSkipped(1, frames);
+    SessionManifest::Snapshot snapshot = manifest.snapshot();
+    manifest.setLock(nullptr);
+
+    // 每次调用加锁一次（每个块只加锁一次，不按帧加锁），且成对释放
+    TEST_ASSERT_EQUAL_UINT32(6, lock.locks);
+    TEST_ASSERT_EQUAL_UINT32(6, lock.unlocks);
+    TEST_ASSERT_FALSE(lock.held);
+    TEST_ASSERT_FALSE(lock.nested);
+    TEST_ASSERT_EQUAL_UINT32(1, snapshot.blockCount);
+    TEST_ASSERT_EQUAL_UINT32(10, snapshot.getCapturedFrames());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_counts_and_timestamps_per_sensor);
+    RUN_TEST(test_block_id_range_across_wrap);
+    RUN_TEST(test_dropped_frames_combine_queue_drops_and_skips);
+    RUN_TEST(test_only_blocks_of_this_session_count);
+    RUN_TEST(test_frame_checksum_covers_quantized_values);
+    RUN_TEST(test_checksum_stable_across_retransmit_and_coalescing);
+    RUN_TEST(test_every_call_runs_inside_the_lock);
+    return UNITY_END();
+}
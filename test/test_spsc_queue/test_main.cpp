@@ -0,0 +1,153 @@
+// 校准时间对队列：单线程下先进先出、满时拒绝并计入溢出、下标反复越过数组末尾、清空；
+// 一个生产者线程和一个消费者线程同时运行（std::thread），消费者按写入顺序取出每个被接受的时间对，不丢失、不重复、不读到半写的元素
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "SpscQueue.h"
+
+static const uint32_t CAPACITY = 64;       // TIME_PAIR_QUEUE_SIZE
+static const uint32_t RUN_MS = 300;
+
+// 与TimeSync::QueuedPair相同的布局，两个字段由同一个序号生成，读到半写的元素时可以发现
+struct Pair {
+    uint32_t sensorTimeMs;
+    int64_t espTimeUs;
+};
+
+static Pair makePair(uint32_t serial) {
+    Pair pair = {serial, (int64_t)serial * 1000 + 7};
+    return pair;
+}
+
+static bool consistent(const Pair& pair) {
+    return pair.espTimeUs == (int64_t)pair.sensorTimeMs * 1000 + 7;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_fifo_and_overflow(void) {
+    SpscQueue<Pair, CAPACITY> queue;
+    Pair pair;
+    TEST_ASSERT_FALSE(queue.pop(pair));
+    for (uint32_t i = 1; i <= CAPACITY; i++) {
+        TEST_ASSERT_TRUE(queue.push(makePair(i)));
+    }
+    TEST_ASSERT_EQUAL_UINT32(CAPACITY, queue.size());
+    // 满时拒绝，已排队的元素不被覆盖
+    TEST_ASSERT_FALSE(queue.push(makePair(1000)));
+    TEST_ASSERT_FALSE(queue.push(makePair(1001)));
+    TEST_ASSERT_EQUAL_UINT32(2, queue.getOverflows());
+    for (uint32_t i = 1; i <= CAPACITY; i++) {
+        TEST_ASSERT_TRUE(queue.pop(pair));
+        TEST_ASSERT_EQUAL_UINT32(i, pair.sensorTimeMs);
+    }
+    TEST_ASSERT_FALSE(queue.pop(pair));
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+}
+
+void test_wrap_around_and_clear(void) {
+    // 每次写入和取出的个数不同，下标反复越过数组末尾，顺序不变
+    SpscQueue<Pair, CAPACITY> queue;
+    Pair pair;
+    uint32_t serial = 0;
+    uint32_t expected = 1;
+    for (uint32_t round = 0; round < 1000; round++) {
+        uint32_t writes = 1 + (round * 7) % CAPACITY;
+        for (uint32_t i = 0; i < writes; i++) {
+            if (queue.push(makePair(serial + 1))) {
+                serial++;
+            }
+        }
+        uint32_t reads = 1 + (round * 5) % CAPACITY;
+        for (uint32_t i = 0; i < reads && queue.pop(pair); i++) {
+            TEST_ASSERT_EQUAL_UINT32(expected++, pair.sensorTimeMs);
+        }
+        TEST_ASSERT_EQUAL_UINT32(serial + 1 - expected, queue.size());
+    }
+    TEST_ASSERT_TRUE(serial > 10 * CAPACITY);
+    // 清空丢弃所有排队的元素，之后从新写入的元素开始取出
+    uint32_t queued = queue.size();
+    TEST_ASSERT_EQUAL_UINT32(queued, queue.clear());
+    TEST_ASSERT_FALSE(queue.pop(pair));
+    TEST_ASSERT_TRUE(queue.push(makePair(++serial)));
+    TEST_ASSERT_TRUE(queue.pop(pair));
+    TEST_ASSERT_EQUAL_UINT32(serial, pair.sensorTimeMs);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.clear());
+}
+
+void test_concurrent_producer_and_consumer(void) {
+    static SpscQueue<Pair, CAPACITY> queue;
+    std::atomic<bool> done(false);
+    uint32_t accepted = 0;
+    uint32_t pushed = 0;
+
+    // 生产者模拟UART任务：连续写入，满时计入溢出并让出后继续；消费者模拟后台任务：成批取出
+    std::thread producer([&]() {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(RUN_MS);
+        while (std::chrono::steady_clock::now() < end) {
+            for (uint32_t i = 0; i < 100; i++) {
+                pushed++;
+                if (queue.push(makePair(pushed))) {
+                    accepted++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint32_t popped = 0;
+    uint32_t last = 0;
+    uint32_t torn = 0;
+    uint32_t outOfOrder = 0;
+    uint32_t batches = 0;
+    Pair pair;
+    while (true) {
+        bool finished = done.load(std::memory_order_acquire);
+        uint32_t batch = 0;
+        while (queue.pop(pair)) {
+            if (!consistent(pair)) {
+                torn++;
+            }
+            if (pair.sensorTimeMs <= last) {
+                outOfOrder++;
+            }
+            last = pair.sensorTimeMs;
+            popped++;
+            batch++;
+        }
+        if (batch > 0) {
+            batches++;
+        }
+        if (finished) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    producer.join();
+
+    char message[200];
+    snprintf(message, sizeof(message), "%u pushed, %u accepted, %u overflows, %u popped in %u batches, %u torn, %u out of order",
+             pushed, accepted, queue.getOverflows(), popped, batches, torn, outOfOrder);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_TRUE(popped > 100 * CAPACITY);
+    TEST_ASSERT_EQUAL_UINT32(accepted, popped);
+    TEST_ASSERT_EQUAL_UINT32(pushed - accepted, queue.getOverflows());
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, queue.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_and_overflow);
+    RUN_TEST(test_wrap_around_and_clear);
+    RUN_TEST(test_concurrent_producer_and_consumer);
+    return UNITY_END();
+}
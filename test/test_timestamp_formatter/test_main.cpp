@@ -0,0 +1,133 @@
+// 时间戳格式化：与逐帧调用localtime_r的格式化结果逐一比较（本地零点前后各1小时的每一毫秒、
+// 零点附近乱序到达的帧、跨3天的随机时间戳、传感器原始小时间），以及100Hz帧流下两种方式的耗时对比
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include "TimestampFormatter.h"
+
+// 2024-03-15 00:00:00 CST（UTC+8）
+static const uint64_t LOCAL_MIDNIGHT_MS = 1710432000000ULL;
+static const uint64_t HOUR_MS = 3600000;
+static const uint64_t DAY_MS = 24 * HOUR_MS;
+
+static TimestampFormatter formatter;
+static uint32_t randomState;
+
+static uint32_t nextRandom() {
+    randomState = randomState * 1664525u + 1013904223u;
+    return randomState;
+}
+
+// 原来的做法：每帧调用localtime_r
+static uint32_t formatWithLocaltime(uint64_t timestampMs) {
+    time_t seconds = (time_t)(timestampMs / 1000);
+    struct tm timeinfo;
+    if (!localtime_r(&seconds, &timeinfo)) {
+        return 0;
+    }
+    return timeinfo.tm_hour * 10000000 + timeinfo.tm_min * 100000 + timeinfo.tm_sec * 1000 +
+           (uint32_t)(timestampMs % 1000);
+}
+
+void setUp(void) {
+    // 与TimeSync::initialize()相同的时区
+    setenv("TZ", "CST-8", 1);
+    tzset();
+    formatter = TimestampFormatter();
+    randomState = 7;
+}
+
+void tearDown(void) {}
+
+void test_every_millisecond_around_local_midnight(void) {
+    uint32_t mismatches = 0;
+    for (uint64_t t = LOCAL_MIDNIGHT_MS - HOUR_MS; t < LOCAL_MIDNIGHT_MS + HOUR_MS; t++) {
+        if (formatter.format(t) != formatWithLocaltime(t)) {
+            mismatches++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    // 只在进入新的一天时刷新
+    TEST_ASSERT_EQUAL_UINT32(2, formatter.getRefreshes());
+    TEST_ASSERT_EQUAL_UINT32(235959999, formatter.format(LOCAL_MIDNIGHT_MS - 1));
+    TEST_ASSERT_EQUAL_UINT32(0, formatter.format(LOCAL_MIDNIGHT_MS));
+    TEST_ASSERT_EQUAL_UINT32(123456789, formatter.format(LOCAL_MIDNIGHT_MS + 12 * HOUR_MS + 34 * 60000 + 56789));
+}
+
+void test_random_timestamps_match_localtime(void) {
+    uint32_t mismatches = 0;
+    uint32_t compared = 0;
+    // 零点前后±2秒乱序到达的帧（多个传感器的时间戳交错）
+    for (uint32_t i = 0; i < 500000; i++) {
+        uint64_t t = LOCAL_MIDNIGHT_MS - 2000 + nextRandom() % 4000;
+        mismatches += formatter.format(t) != formatWithLocaltime(t);
+        compared++;
+    }
+    uint32_t nearMidnightRefreshes = formatter.getRefreshes();
+    // 跨3天的随机时间戳
+    for (uint32_t i = 0; i < 500000; i++) {
+        uint64_t t = LOCAL_MIDNIGHT_MS - DAY_MS + (((uint64_t)nextRandom() << 32) | nextRandom()) % (3 * DAY_MS);
+        mismatches += formatter.format(t) != formatWithLocaltime(t);
+        compared++;
+    }
+    // 未同步时的传感器原始时间（开机后的毫秒数，1970-01-01）
+    for (uint32_t i = 0; i < 100000; i++) {
+        uint64_t t = nextRandom() % (2 * DAY_MS);
+        mismatches += formatter.format(t) != formatWithLocaltime(t);
+        compared++;
+    }
+
+    char message[120];
+    snprintf(message, sizeof(message), "%u comparisons, %u mismatches, %u refreshes (%u around midnight)",
+             compared, mismatches, formatter.getRefreshes(), nearMidnightRefreshes);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+}
+
+void test_invalidate_after_timezone_change(void) {
+    uint64_t t = LOCAL_MIDNIGHT_MS + HOUR_MS;
+    TEST_ASSERT_EQUAL_UINT32(10000000, formatter.format(t));
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    // 缓存的零点仍按原时区，丢弃后按新时区重新计算
+    formatter.invalidate();
+    TEST_ASSERT_EQUAL_UINT32(formatWithLocaltime(t), formatter.format(t));
+    TEST_ASSERT_EQUAL_UINT32(170000000, formatter.format(t));
+}
+
+void test_stream_benchmark(void) {
+    // 4个传感器x100Hz连续10分钟的帧流
+    const uint32_t frames = 4 * 100 * 600;
+    const uint64_t start = LOCAL_MIDNIGHT_MS + 9 * HOUR_MS;
+    volatile uint32_t sink = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        sink = sink + formatWithLocaltime(start + i * 10 / 4);
+    }
+    double localtimeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / frames;
+
+    begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        sink = sink + formatter.format(start + i * 10 / 4);
+    }
+    double cachedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / frames;
+
+    char message[120];
+    snprintf(message, sizeof(message), "%u frames: localtime_r %.1f ns/frame, cached midnight %.1f ns/frame (%.0fx)",
+             frames, localtimeNs, cachedNs, localtimeNs / cachedNs);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(1, formatter.getRefreshes());
+    TEST_ASSERT_TRUE(cachedNs * 3 < localtimeNs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_millisecond_around_local_midnight);
+    RUN_TEST(test_random_timestamps_match_localtime);
+    RUN_TEST(test_invalidate_after_timezone_change);
+    RUN_TEST(test_stream_benchmark);
+    return UNITY_END();
+}
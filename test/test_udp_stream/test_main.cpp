@@ -0,0 +1,510 @@
+// UDP实时流：数据报封装与接收端参考实现（UdpReassembler）的丢失、乱序、重复和过期处理；
+// 模拟有损WiFi链路对比UDP与WebSocket（TCP按序交付，丢包后等重传）的延迟分布和画面停顿；
+// 最后在本机回环上实际收发，测量两条通道的延迟分布
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "UdpDatagram.h"
+
+static const size_t DATAGRAM_SIZE = 1400;   // Config::UDP_DATAGRAM_SIZE
+static const size_t MAX_MESSAGE = 24576;    // Config::ENCODE_BUFFER_SIZE
+static const size_t PAYLOAD = DATAGRAM_SIZE - UdpDatagram::HEADER_SIZE;
+
+// 确定性伪随机数（LCG），使丢包场景可复现
+static uint32_t rngState;
+static uint32_t nextRandom() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return rngState >> 8;
+}
+
+static void fillMessage(char* message, size_t length, uint32_t seq) {
+    for (size_t i = 0; i < length; i++) {
+        message[i] = (char)('a' + (seq * 7 + i) % 26);
+    }
+}
+
+struct Datagram {
+    uint8_t bytes[DATAGRAM_SIZE];
+    size_t length;
+};
+
+static size_t buildAll(uint32_t seq, const char* message, size_t length, Datagram* out) {
+    size_t count = UdpDatagram::fragmentCount(length, DATAGRAM_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        out[i].length = UdpDatagram::buildFragment(out[i].bytes, DATAGRAM_SIZE, seq, 0, message, length, i);
+    }
+    return count;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(p / 100.0 * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+void setUp(void) {
+    rngState = 2024;
+}
+
+void tearDown(void) {}
+
+void test_fragment_layout(void) {
+    TEST_ASSERT_EQUAL_UINT32(16, UdpDatagram::HEADER_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(1, UdpDatagram::fragmentCount(1, DATAGRAM_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(1, UdpDatagram::fragmentCount(PAYLOAD, DATAGRAM_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(2, UdpDatagram::fragmentCount(PAYLOAD + 1, DATAGRAM_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(0, UdpDatagram::fragmentCount(0, DATAGRAM_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(0, UdpDatagram::fragmentCount(0x10000, DATAGRAM_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(0, UdpDatagram::fragmentCount(300 * 100, 100 + UdpDatagram::HEADER_SIZE));
+
+    char message[3000];
+    fillMessage(message, sizeof(message), 5);
+    Datagram datagrams[3];
+    TEST_ASSERT_EQUAL_UINT32(3, buildAll(0x01020304, message, sizeof(message), datagrams));
+    TEST_ASSERT_EQUAL_UINT32(DATAGRAM_SIZE, datagrams[0].length);
+    TEST_ASSERT_EQUAL_UINT32(UdpDatagram::HEADER_SIZE + sizeof(message) - 2 * PAYLOAD, datagrams[2].length);
+    // 小端序：magic、版本、分片序号/总数、消息长度、seq
+    const uint8_t expected[] = {'G', 'W', 1, 2, 3, 0, 0xB8, 0x0B, 0x04, 0x03, 0x02, 0x01};
+    TEST_ASSERT_EQUAL_MEMORY(expected, datagrams[2].bytes, sizeof(expected));
+    TEST_ASSERT_EQUAL_MEMORY(message + 2 * PAYLOAD, datagrams[2].bytes + UdpDatagram::HEADER_SIZE, sizeof(message) - 2 * PAYLOAD);
+}
+
+void test_malformed_datagrams_are_rejected(void) {
+    char message[2000];
+    fillMessage(message, sizeof(message), 1);
+    Datagram datagrams[2];
+    buildAll(1, message, sizeof(message), datagrams);
+    UdpDatagramHeader header;
+    TEST_ASSERT_NOT_NULL(UdpDatagram::parse(datagrams[1].bytes, datagrams[1].length, DATAGRAM_SIZE, header));
+
+    Datagram bad = datagrams[0];
+    bad.bytes[0] = 'X';
+    TEST_ASSERT_NULL(UdpDatagram::parse(bad.bytes, bad.length, DATAGRAM_SIZE, header));
+    bad = datagrams[0];
+    bad.bytes[2] = 2;   // 版本
+    TEST_ASSERT_NULL(UdpDatagram::parse(bad.bytes, bad.length, DATAGRAM_SIZE, header));
+    bad = datagrams[0];
+    bad.bytes[4] = 3;   // 分片总数与消息长度不符
+    TEST_ASSERT_NULL(UdpDatagram::parse(bad.bytes, bad.length, DATAGRAM_SIZE, header));
+    // 截断的数据报
+    TEST_ASSERT_NULL(UdpDatagram::parse(datagrams[0].bytes, datagrams[0].length - 1, DATAGRAM_SIZE, header));
+    TEST_ASSERT_NULL(UdpDatagram::parse(datagrams[0].bytes, UdpDatagram::HEADER_SIZE, DATAGRAM_SIZE, header));
+
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE);
+    uint32_t seq;
+    size_t length;
+    bad = datagrams[0];
+    bad.bytes[1] = 0;
+    TEST_ASSERT_NULL(receiver.receive(bad.bytes, bad.length, 0, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().malformed);
+}
+
+void test_reordered_and_duplicated_fragments_are_reassembled(void) {
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE);
+    char first[4000];
+    char second[3000];
+    fillMessage(first, sizeof(first), 1);
+    fillMessage(second, sizeof(second), 2);
+    Datagram a[3];
+    Datagram b[3];
+    buildAll(1, first, sizeof(first), a);
+    buildAll(2, second, sizeof(second), b);
+
+    // 两条消息的分片交错、乱序并有重复到达
+    const Datagram* order[] = {&a[2], &b[1], &a[0], &a[2], &b[0], &a[1], &b[2]};
+    uint32_t seq = 0;
+    size_t length = 0;
+    std::vector<uint32_t> deliveredSeqs;
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        const char* message = receiver.receive(order[i]->bytes, order[i]->length, i, seq, length);
+        if (message) {
+            deliveredSeqs.push_back(seq);
+            TEST_ASSERT_EQUAL_MEMORY(seq == 1 ? first : second, message, length);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, deliveredSeqs.size());
+    TEST_ASSERT_EQUAL_UINT32(1, deliveredSeqs[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, deliveredSeqs[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().duplicates);
+    TEST_ASSERT_EQUAL_UINT32(0, receiver.getStats().skipped);
+}
+
+void test_stale_and_incomplete_messages_are_dropped(void) {
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE, 200);
+    char message[2000];
+    fillMessage(message, sizeof(message), 3);
+    Datagram m5[2];
+    Datagram m6[2];
+    Datagram m7[2];
+    buildAll(5, message, sizeof(message), m5);
+    buildAll(6, message, sizeof(message), m6);
+    buildAll(7, message, sizeof(message), m7);
+    uint32_t seq;
+    size_t length;
+
+    // seq 5只到了一片；seq 6完整到达后，5不会再交付
+    TEST_ASSERT_NULL(receiver.receive(m5[0].bytes, m5[0].length, 0, seq, length));
+    TEST_ASSERT_NULL(receiver.receive(m6[0].bytes, m6[0].length, 1, seq, length));
+    TEST_ASSERT_NOT_NULL(receiver.receive(m6[1].bytes, m6[1].length, 2, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(6, seq);
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().incomplete);
+    TEST_ASSERT_NULL(receiver.receive(m5[1].bytes, m5[1].length, 3, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().stale);
+
+    // seq 7的第二片超时后才到：先到的一片已放弃，后到的一片单独不能交付
+    TEST_ASSERT_NULL(receiver.receive(m7[0].bytes, m7[0].length, 10, seq, length));
+    TEST_ASSERT_NULL(receiver.receive(m7[1].bytes, m7[1].length, 300, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(2, receiver.getStats().incomplete);
+    receiver.expire(600);
+    TEST_ASSERT_EQUAL_UINT32(3, receiver.getStats().incomplete);
+    TEST_ASSERT_EQUAL_UINT32(6, receiver.getLastSeq());
+}
+
+void test_slot_overflow_evicts_oldest_and_seq_wraps(void) {
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE);
+    char message[2000];
+    fillMessage(message, sizeof(message), 4);
+    uint32_t seq;
+    size_t length;
+    // SLOT_COUNT+1条未完成的消息（跨越序列号回绕）：最旧的被挤出
+    Datagram pending[UdpReassembler::SLOT_COUNT + 1][2];
+    for (uint32_t i = 0; i <= UdpReassembler::SLOT_COUNT; i++) {
+        buildAll(0xFFFFFFFEu + i, message, sizeof(message), pending[i]);
+        TEST_ASSERT_NULL(receiver.receive(pending[i][0].bytes, pending[i][0].length, i, seq, length));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().incomplete);
+    // 最旧的消息已被挤出，补齐第二片也只会重新开始重组
+    TEST_ASSERT_NULL(receiver.receive(pending[0][1].bytes, pending[0][1].length, 10, seq, length));
+    // 回绕后的seq 1（i=3）收齐后交付，比它旧的未完成消息全部放弃，更新的seq 2仍可交付
+    TEST_ASSERT_NOT_NULL(receiver.receive(pending[3][1].bytes, pending[3][1].length, 11, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(1, seq);
+    TEST_ASSERT_NULL(receiver.receive(pending[1][1].bytes, pending[1][1].length, 12, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(1, receiver.getStats().stale);
+    TEST_ASSERT_NOT_NULL(receiver.receive(pending[4][1].bytes, pending[4][1].length, 13, seq, length));
+    TEST_ASSERT_EQUAL_UINT32(2, seq);
+    TEST_ASSERT_EQUAL_UINT32(2, receiver.getStats().delivered);
+}
+
+// 模拟有损WiFi链路（虚拟时间，us）：每条消息3个分片，每个分片独立丢失；单向延迟带抖动（UDP会乱序）。
+// WebSocket（TCP）：丢失的段在RTO后重传，按序交付使其后的所有消息一起等待（队头阻塞）
+struct LinkModel {
+    uint32_t messages;
+    uint32_t intervalUs;        // 消息间隔（每块30帧，约33ms）
+    size_t messageLength;
+    uint32_t lossPerMille;
+    uint32_t delayUs;
+    uint32_t jitterUs;
+    uint32_t rtoUs;
+};
+
+struct LinkResult {
+    std::vector<double> latencyMs;
+    double maxFreezeMs;         // 相邻两次画面更新的最大间隔
+    uint32_t delivered;
+};
+
+static void finishFreeze(LinkResult& result, std::vector<double>& updateTimes) {
+    std::sort(updateTimes.begin(), updateTimes.end());
+    result.maxFreezeMs = 0.0;
+    for (size_t i = 1; i < updateTimes.size(); i++) {
+        result.maxFreezeMs = std::max(result.maxFreezeMs, (updateTimes[i] - updateTimes[i - 1]) / 1000.0);
+    }
+}
+
+static LinkResult simulateUdp(const LinkModel& model) {
+    struct InFlight {
+        uint32_t arrival;
+        uint32_t sendTime;
+        Datagram datagram;
+    };
+    std::vector<InFlight> inFlight;
+    std::vector<char> message(model.messageLength);
+    for (uint32_t seq = 1; seq <= model.messages; seq++) {
+        uint32_t sendTime = seq * model.intervalUs;
+        fillMessage(message.data(), model.messageLength, seq);
+        Datagram datagrams[8];
+        size_t count = buildAll(seq, message.data(), model.messageLength, datagrams);
+        for (size_t i = 0; i < count; i++) {
+            if (nextRandom() % 1000 < model.lossPerMille) {
+                continue;
+            }
+            InFlight item;
+            item.arrival = sendTime + i * 100 + model.delayUs + nextRandom() % model.jitterUs;
+            item.sendTime = sendTime;
+            item.datagram = datagrams[i];
+            inFlight.push_back(item);
+        }
+    }
+    std::sort(inFlight.begin(), inFlight.end(), [](const InFlight& a, const InFlight& b) { return a.arrival < b.arrival; });
+
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE);
+    LinkResult result;
+    result.delivered = 0;
+    std::vector<double> updateTimes;
+    for (const InFlight& item : inFlight) {
+        uint32_t seq;
+        size_t length;
+        const char* delivered = receiver.receive(item.datagram.bytes, item.datagram.length, item.arrival / 1000, seq, length);
+        if (delivered) {
+            result.delivered++;
+            result.latencyMs.push_back((item.arrival - seq * model.intervalUs) / 1000.0);
+            updateTimes.push_back(item.arrival);
+        }
+    }
+    finishFreeze(result, updateTimes);
+    return result;
+}
+
+static LinkResult simulateTcp(const LinkModel& model) {
+    LinkResult result;
+    result.delivered = 0;
+    std::vector<double> updateTimes;
+    uint32_t lastDelivery = 0;
+    size_t count = UdpDatagram::fragmentCount(model.messageLength, DATAGRAM_SIZE);
+    for (uint32_t seq = 1; seq <= model.messages; seq++) {
+        uint32_t sendTime = seq * model.intervalUs;
+        uint32_t arrival = 0;
+        for (size_t i = 0; i < count; i++) {
+            // 每个段丢失后等待RTO重传（重传也可能丢失）
+            uint32_t segmentArrival = sendTime + i * 100 + model.delayUs + nextRandom() % model.jitterUs;
+            while (nextRandom() % 1000 < model.lossPerMille) {
+                segmentArrival += model.rtoUs;
+            }
+            arrival = std::max(arrival, segmentArrival);
+        }
+        // 按序交付：前面的消息未到齐时后面的消息也不能交给应用
+        arrival = std::max(arrival, lastDelivery);
+        lastDelivery = arrival;
+        result.delivered++;
+        result.latencyMs.push_back((arrival - sendTime) / 1000.0);
+        updateTimes.push_back(arrival);
+    }
+    finishFreeze(result, updateTimes);
+    return result;
+}
+
+static void reportLink(const char* name, const LinkResult& result, uint32_t messages) {
+    char message[200];
+    snprintf(message, sizeof(message), "%s: delivered %.1f%%, latency p50 %.2f ms p99 %.2f ms max %.2f ms, longest freeze %.1f ms",
+             name, 100.0 * result.delivered / messages, percentile(result.latencyMs, 50), percentile(result.latencyMs, 99),
+             percentile(result.latencyMs, 100), result.maxFreezeMs);
+    TEST_MESSAGE(message);
+}
+
+void test_lossy_link_udp_avoids_head_of_line_blocking(void) {
+    LinkModel model = {3000, 33000, 4000, 20, 8000, 6000, 200000};
+    LinkResult udp = simulateUdp(model);
+    LinkResult tcp = simulateTcp(model);
+    reportLink("simulated UDP", udp, model.messages);
+    reportLink("simulated WebSocket", tcp, model.messages);
+
+    // UDP丢失约(1-0.98^3)的消息，但延迟只取决于单向延迟和抖动；TCP的尾延迟和停顿包含重传等待
+    TEST_ASSERT_GREATER_OR_EQUAL(model.messages * 90 / 100, udp.delivered);
+    TEST_ASSERT_EQUAL_UINT32(model.messages, tcp.delivered);
+    TEST_ASSERT_LESS_OR_EQUAL(20, (uint32_t)percentile(udp.latencyMs, 100));
+    TEST_ASSERT_GREATER_THAN(200, (uint32_t)percentile(tcp.latencyMs, 99));
+    TEST_ASSERT_LESS_THAN(tcp.maxFreezeMs, udp.maxFreezeMs);
+}
+
+// 本机回环：发送线程按固定间隔发消息，接收线程记录到达时刻（同一进程，时钟相同）
+static const uint32_t LOOPBACK_MESSAGES = 2000;
+static const size_t LOOPBACK_LENGTH = 4000;
+
+static double steadyUs() {
+    return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int bindLoopback(int type, uint16_t& port) {
+    int fd = socket(AF_INET, type, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    if (fd < 0 || bind(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        return -1;
+    }
+    socklen_t addressLength = sizeof(address);
+    getsockname(fd, (sockaddr*)&address, &addressLength);
+    port = ntohs(address.sin_port);
+    int bufferSize = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    return fd;
+}
+
+static sockaddr_in loopbackAddress(uint16_t port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    return address;
+}
+
+static std::vector<double> sendTimes;
+
+static void paceSender(uint32_t seq, double start) {
+    double due = start + seq * 500.0;   // 每0.5ms一条消息
+    while (steadyUs() < due) {
+        std::this_thread::yield();
+    }
+    sendTimes[seq] = steadyUs();
+}
+
+static LinkResult loopbackUdp() {
+    uint16_t port = 0;
+    int receiverFd = bindLoopback(SOCK_DGRAM, port);
+    int senderFd = socket(AF_INET, SOCK_DGRAM, 0);
+    TEST_ASSERT_TRUE(receiverFd >= 0 && senderFd >= 0);
+    sockaddr_in target = loopbackAddress(port);
+    sendTimes.assign(LOOPBACK_MESSAGES + 1, 0.0);
+
+    LinkResult result;
+    result.delivered = 0;
+    std::vector<double> updateTimes;
+    std::atomic<bool> senderDone(false);
+    std::thread sender([&]() {
+        std::vector<char> message(LOOPBACK_LENGTH);
+        Datagram datagrams[4];
+        double start = steadyUs();
+        for (uint32_t seq = 1; seq <= LOOPBACK_MESSAGES; seq++) {
+            fillMessage(message.data(), LOOPBACK_LENGTH, seq);
+            size_t count = buildAll(seq, message.data(), LOOPBACK_LENGTH, datagrams);
+            paceSender(seq, start);
+            for (size_t i = 0; i < count; i++) {
+                sendto(senderFd, datagrams[i].bytes, datagrams[i].length, 0, (sockaddr*)&target, sizeof(target));
+            }
+        }
+        senderDone = true;
+    });
+
+    UdpReassembler receiver(DATAGRAM_SIZE, MAX_MESSAGE);
+    uint8_t buffer[DATAGRAM_SIZE];
+    pollfd pfd = {receiverFd, POLLIN, 0};
+    while (true) {
+        if (poll(&pfd, 1, 200) <= 0) {
+            if (senderDone) {
+                break;
+            }
+            continue;
+        }
+        ssize_t received = recv(receiverFd, buffer, sizeof(buffer), 0);
+        double now = steadyUs();
+        uint32_t seq;
+        size_t length;
+        if (received > 0 && receiver.receive(buffer, received, (uint32_t)(now / 1000), seq, length)) {
+            result.delivered++;
+            result.latencyMs.push_back((now - sendTimes[seq]) / 1000.0);
+            updateTimes.push_back(now);
+        }
+    }
+    sender.join();
+    close(senderFd);
+    close(receiverFd);
+    finishFreeze(result, updateTimes);
+    return result;
+}
+
+static LinkResult loopbackTcp() {
+    uint16_t port = 0;
+    int listenFd = bindLoopback(SOCK_STREAM, port);
+    TEST_ASSERT_TRUE(listenFd >= 0);
+    TEST_ASSERT_EQUAL_INT(0, listen(listenFd, 1));
+    int senderFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in target = loopbackAddress(port);
+    TEST_ASSERT_EQUAL_INT(0, connect(senderFd, (sockaddr*)&target, sizeof(target)));
+    int receiverFd = accept(listenFd, nullptr, nullptr);
+    int noDelay = 1;
+    setsockopt(senderFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    sendTimes.assign(LOOPBACK_MESSAGES + 1, 0.0);
+
+    std::thread sender([&]() {
+        // 与WebSocket相同：每条消息一个带长度的帧，消息体按MSS分片写入
+        std::vector<char> frame(8 + LOOPBACK_LENGTH);
+        double start = steadyUs();
+        for (uint32_t seq = 1; seq <= LOOPBACK_MESSAGES; seq++) {
+            uint32_t length = LOOPBACK_LENGTH;
+            memcpy(frame.data(), &seq, 4);
+            memcpy(frame.data() + 4, &length, 4);
+            fillMessage(frame.data() + 8, LOOPBACK_LENGTH, seq);
+            paceSender(seq, start);
+            for (size_t offset = 0; offset < frame.size(); offset += 1436) {
+                size_t chunk = std::min((size_t)1436, frame.size() - offset);
+                TEST_ASSERT_EQUAL_INT((int)chunk, (int)send(senderFd, frame.data() + offset, chunk, 0));
+            }
+        }
+        shutdown(senderFd, SHUT_WR);
+    });
+
+    LinkResult result;
+    result.delivered = 0;
+    std::vector<double> updateTimes;
+    std::vector<char> stream;
+    char buffer[65536];
+    while (true) {
+        ssize_t received = recv(receiverFd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        double now = steadyUs();
+        stream.insert(stream.end(), buffer, buffer + received);
+        size_t consumed = 0;
+        while (stream.size() - consumed >= 8) {
+            uint32_t seq;
+            uint32_t length;
+            memcpy(&seq, stream.data() + consumed, 4);
+            memcpy(&length, stream.data() + consumed + 4, 4);
+            if (stream.size() - consumed < 8 + length) {
+                break;
+            }
+            consumed += 8 + length;
+            result.delivered++;
+            result.latencyMs.push_back((now - sendTimes[seq]) / 1000.0);
+            updateTimes.push_back(now);
+        }
+        stream.erase(stream.begin(), stream.begin() + consumed);
+    }
+    sender.join();
+    close(senderFd);
+    close(receiverFd);
+    close(listenFd);
+    finishFreeze(result, updateTimes);
+    return result;
+}
+
+void test_loopback_latency_distribution(void) {
+    LinkResult udp = loopbackUdp();
+    LinkResult tcp = loopbackTcp();
+    reportLink("loopback UDP", udp, LOOPBACK_MESSAGES);
+    reportLink("loopback WebSocket", tcp, LOOPBACK_MESSAGES);
+    // 回环没有丢包时两条通道都应送达；延迟取决于主机负载，只报告分布
+    TEST_ASSERT_GREATER_OR_EQUAL(LOOPBACK_MESSAGES * 95 / 100, udp.delivered);
+    TEST_ASSERT_EQUAL_UINT32(LOOPBACK_MESSAGES, tcp.delivered);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fragment_layout);
+    RUN_TEST(test_malformed_datagrams_are_rejected);
+    RUN_TEST(test_reordered_and_duplicated_fragments_are_reassembled);
+    RUN_TEST(test_stale_and_incomplete_messages_are_dropped);
+    RUN_TEST(test_slot_overflow_evicts_oldest_and_seq_wraps);
+    RUN_TEST(test_lossy_link_udp_avoids_head_of_line_blocking);
+    RUN_TEST(test_loopback_latency_distribution);
+    return UNITY_END();
+}